@@ -0,0 +1,140 @@
+/**
+ * 均匀网格与扁平KD树的查询耗时对比，对应 AvtkKdTreePointLocator 的 GridCellSize 说明中的数据。
+ *
+ * 20 x 20 x 10 的范围内均匀随机生成 200000 个点（每单位体积50个点），10000 个随机查询点，
+ * 依次计时构建、半径 R0/4 与 R0 的球查询、边长 2R0 的包围盒查询、半径 R0/2 的无限圆柱查询（500 个查询点）
+ * 与16近邻查询，时间单位为毫秒。结果的最后一列为返回的点数之和，用于确认各结构的结果一致。
+ *
+ * 构建：cmake -DVTKAUTILS_BUILD_BENCHMARKS=ON，运行 UniformGridBenchmark。
+ */
+#include "AvtkKdTreePointLocator.h"
+
+#include <vtkIdList.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double ElapsedMilliseconds(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    vtkSmartPointer<vtkPolyData> RandomCloud(int numPoints, unsigned seed)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<double> uniform(-10, 10);
+        vtkNew<vtkPoints> points;
+        points->SetDataTypeToDouble();
+        for (int i = 0; i < numPoints; ++i)
+            points->InsertNextPoint(uniform(generator), uniform(generator), uniform(generator) * 0.5);
+        auto polyData = vtkSmartPointer<vtkPolyData>::New();
+        polyData->SetPoints(points);
+        return polyData;
+    }
+
+    void Run(const char *name, const char *param, AvtkKdTreePointLocator *locator, double radius,
+             const std::vector<std::array<double, 3>> &queries)
+    {
+        vtkNew<vtkIdList> result;
+        long long found = 0;
+        double times[6];
+
+        auto start = Clock::now();
+        locator->BuildLocator();
+        times[0] = ElapsedMilliseconds(start);
+
+        start = Clock::now();
+        for (const auto &q : queries)
+        {
+            locator->FindPointsWithinRadius(radius / 4, q.data(), result);
+            found += result->GetNumberOfIds();
+        }
+        times[1] = ElapsedMilliseconds(start);
+
+        start = Clock::now();
+        for (const auto &q : queries)
+        {
+            locator->FindPointsWithinRadius(radius, q.data(), result);
+            found += result->GetNumberOfIds();
+        }
+        times[2] = ElapsedMilliseconds(start);
+
+        start = Clock::now();
+        for (const auto &q : queries)
+        {
+            double area[6] = {q[0] - radius, q[0] + radius, q[1] - radius, q[1] + radius, q[2] - radius, q[2] + radius};
+            locator->FindPointsWithinArea(area, result);
+            found += result->GetNumberOfIds();
+        }
+        times[3] = ElapsedMilliseconds(start);
+
+        double direction[3] = {1, 2, 0.5};
+        start = Clock::now();
+        for (size_t i = 0; i < queries.size() / 20; ++i)
+        {
+            locator->FindPointsWithinCylinder(queries[i].data(), direction, radius / 2, result);
+            found += result->GetNumberOfIds();
+        }
+        times[4] = ElapsedMilliseconds(start);
+
+        start = Clock::now();
+        for (const auto &q : queries)
+        {
+            locator->FindClosestNPoints(16, q.data(), result);
+            found += result->GetNumberOfIds();
+        }
+        times[5] = ElapsedMilliseconds(start);
+
+        std::printf("  %-5s %-8s %6.0f %8.1f %6.1f %6.1f %6.1f %6.1f  (%lld)\n", name, param, times[0], times[1],
+                    times[2], times[3], times[4], times[5], found);
+    }
+}
+
+int main()
+{
+    auto polyData = RandomCloud(200000, 3);
+    std::mt19937 generator(9);
+    std::uniform_real_distribution<double> uniform(-10, 10);
+    std::vector<std::array<double, 3>> queries(10000);
+    for (auto &q : queries)
+        q = {uniform(generator), uniform(generator), uniform(generator) * 0.5};
+
+    for (double radius : {0.3, 0.8})
+    {
+        std::printf("R0=%g          build  r=R0/4   r=R0    box    cyl  knn16\n", radius);
+        {
+            vtkNew<AvtkKdTreePointLocator> locator;
+            locator->SetDataSet(polyData);
+            locator->SetTreeTypeToFlatKdTree();
+            Run("flat", "leaf16", locator, radius, queries);
+        }
+        for (double factor : {0.5, 1.0, 2.0})
+        {
+            vtkNew<AvtkKdTreePointLocator> locator;
+            locator->SetDataSet(polyData);
+            locator->SetTreeTypeToUniformGrid();
+            locator->SetGridCellSize(factor * radius);
+            char param[32];
+            std::snprintf(param, sizeof(param), "h=%gR0", factor);
+            Run("grid", param, locator, radius, queries);
+        }
+        {
+            vtkNew<AvtkKdTreePointLocator> locator;
+            locator->SetDataSet(polyData);
+            locator->SetTreeTypeToUniformGrid();
+            Run("grid", "auto", locator, radius, queries);
+        }
+    }
+    return 0;
+}
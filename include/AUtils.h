@@ -35,6 +35,10 @@ namespace AUtils
 
     void IdTypeArrayToIdList(vtkIdTypeArray *idTypeArray, vtkIdList *idList);
 
+    /**
+     * 整个法向量数组的归一化平均。只需要空间区域内的平均法向量时，使用 PointNormalProcessor::GetMeanNormalInArea 等函数
+     * 或 AvtkKdTreePointLocator::ComputeStatistics*，不需要逐点遍历。
+     */
     void GetMeanNormal(double *normal, vtkDataArray *array);
 
     template <typename... Arrays>
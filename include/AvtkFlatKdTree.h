@@ -0,0 +1,422 @@
+#pragma once
+
+#include <vtkObject.h>
+#include <vtkIdList.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <memory>
+#include <vector>
+#include "LeafKernels.h"
+#include "MappedFile.h"
+#include "QueryShapes.h"
+
+/**
+ * 基于数组的隐式KD树。
+ *
+ * 节点按广度优先顺序存放在连续数组中，节点i的子节点为2i+1与2i+2，
+ * 每个节点对应重排后点数组中的一段连续区间，区间在遍历时由中位数划分隐式计算。
+ * 叶子点的坐标按 x/y/z 分量分别连续存放（SoA），叶子扫描时不经过 vtkDataSet 的虚函数。
+ * 所有查询函数均为只读，构建完成后可以在多个线程中同时调用。
+ * 构建好的树可以保存为二进制文件，加载时直接内存映射文件，在映射的内存上查询，不做反序列化。
+ */
+class AvtkFlatKdTree : public vtkObject
+{
+public:
+    vtkTypeMacro(AvtkFlatKdTree, vtkObject);
+    static AvtkFlatKdTree *New();
+    void PrintSelf(ostream &os, vtkIndent indent) override;
+
+    /**
+     * 每个叶子最多包含的点数，构建前设置。
+     */
+    vtkSetClampMacro(NumberOfPointsPerLeaf, int, 1, 1 << 20);
+    vtkGetMacro(NumberOfPointsPerLeaf, int);
+
+    /**
+     * 是否并行构建。上层节点逐层处理，每个节点的包围盒与中位数选择并行计算；
+     * 节点数足够多后，各子树作为独立任务并行递归构建。
+     * 划分按 (坐标, id) 的严格全序进行，叶子内按id排序，因此并行与串行构建得到完全相同的树。
+     */
+    vtkSetMacro(ParallelBuild, vtkTypeBool);
+    vtkGetMacro(ParallelBuild, vtkTypeBool);
+    vtkBooleanMacro(ParallelBuild, vtkTypeBool);
+
+    /**
+     * 最近一次 BuildFromPoints 的耗时（秒）。
+     */
+    vtkGetMacro(BuildElapsedTime, double);
+
+    /**
+     * 是否以单精度存储点坐标，下次构建时生效，默认关闭。
+     * 开启后坐标在构建时舍入为float，点坐标的内存减半；float点数组直接读取，不损失精度。
+     * 查询仍以双精度在舍入后的坐标上进行，与双精度存储的差异只来自坐标舍入，
+     * 每个分量的误差不超过 |x| * 2^-24，位于查询区域边界附近这一距离内的点可能有不同的判定。
+     */
+    vtkSetMacro(SinglePrecision, vtkTypeBool);
+    vtkGetMacro(SinglePrecision, vtkTypeBool);
+    vtkBooleanMacro(SinglePrecision, vtkTypeBool);
+
+    /**
+     * 从点数组构建KD树，点id即为点在数组中的下标。
+     * @param points 要构建的点数组。
+     */
+    void BuildFromPoints(vtkPoints *points);
+
+    /**
+     * 从坐标数组构建KD树。
+     * @param coords 点坐标 (x, y, z)，长度为 3 * ids.size()。
+     * @param ids 各点的id。
+     */
+    void BuildFromPoints(const std::vector<double> &coords, const std::vector<vtkIdType> &ids);
+
+    /**
+     * 将树保存为可内存映射的二进制文件。文件包含格式版本、各数组的校验值，以及调用方给出的key，
+     * key 用于在加载时识别文件是否由同一份数据与参数构建。
+     * 先写入同目录下唯一的临时文件再重命名为 path，多个进程同时保存时互不干扰，写入过程中其它进程不会读到不完整的文件。
+     * @return 树为空或写入失败时返回false。
+     */
+    bool Save(const char *path, vtkTypeUInt64 key) const;
+
+    /**
+     * 内存映射 Save 保存的文件，树的数组直接指向映射的内存，文件在树释放或重新构建前保持映射。
+     * 每个叶子的点数与单精度存储按文件中的设置。
+     * @param key 与保存时的key不同则认为文件已过期，不加载。
+     * @param verifyChecksum 为true时校验所有数组，需要读取整个文件；否则只检查文件头与文件大小。
+     * @return 文件不存在、已过期、格式不兼容或损坏时返回false，此时树保持不变。
+     */
+    bool Load(const char *path, vtkTypeUInt64 key, bool verifyChecksum = false);
+
+    /**
+     * 当前的树是否来自内存映射的文件。
+     */
+    bool IsMapped() const { return this->Mapping != nullptr; }
+
+    /**
+     * KD树占用的内存（KiB），内存映射的数组不计入。
+     */
+    unsigned long GetActualMemorySize() const;
+
+    /**
+     * 释放树的所有数据。
+     */
+    void Initialize();
+
+    /**
+     * 与 source 共享树的数组，只拷贝删除标记，之后两棵树的删除互不影响。
+     * 共享期间持有 source 的引用；source 不能再重新构建，用于增量树在快照存在时的写时复制。
+     */
+    void ShallowCopy(AvtkFlatKdTree *source);
+
+    /**
+     * 树中存放的点数，包含已标记删除的点。
+     */
+    vtkIdType GetNumberOfPoints() const { return static_cast<vtkIdType>(this->Ids.size()); }
+
+    vtkIdType GetNumberOfRemovedPoints() const { return this->NumberOfRemovedPoints; }
+
+    /**
+     * 按树顺序下标访问点，下标范围为 [0, GetNumberOfPoints())。
+     */
+    vtkIdType GetPointId(vtkIdType index) const { return this->Ids[index]; }
+    void GetPoint(vtkIdType index, double x[3]) const;
+    bool IsPointRemoved(vtkIdType index) const { return !this->Removed.empty() && this->Removed[index]; }
+
+    /**
+     * 将树顺序下标为index的点标记为删除，之后的查询不再返回该点，树结构保持不变。
+     * @return 点此前未被删除时返回true。
+     */
+    bool RemovePointAt(vtkIdType index);
+
+    /**
+     * 树的层数，只有根节点时为1。
+     */
+    int GetNumberOfLevels() const { return this->Depth + 1; }
+
+    /**
+     * 获取所有点的包围盒。
+     */
+    void GetBounds(double bounds[6]) const;
+
+    /**
+     * 查找距离x最近的点。
+     * @param dist2 返回距离的平方。
+     * @return 最近点的id，树为空时返回-1。
+     */
+    vtkIdType FindClosestPoint(const double x[3], double &dist2) const;
+
+    /**
+     * 查找半径radius内距离x最近的点。
+     * @return 最近点的id，半径内没有点时返回-1。
+     */
+    vtkIdType FindClosestPointWithinRadius(double radius, const double x[3], double &dist2) const;
+
+    /**
+     * 查找距离x最近的N个点，结果按距离从近到远排序。
+     */
+    void FindClosestNPoints(int N, const double x[3], vtkIdList *result) const;
+
+    /**
+     * 在已有的最大堆上继续最近N点搜索，用于在多棵树之间合并结果。
+     * @param heap 按 (距离平方, id) 排列的最大堆，大小不超过N。
+     */
+    void SearchClosestPoints(const double x[3], size_t N, std::vector<std::pair<double, vtkIdType>> &heap) const;
+
+    /**
+     * 近似最近N点搜索。按节点包围盒到x的距离从近到远访问叶子（best-bin-first），
+     * 返回的第k个点的距离不超过真实第k近距离的 (1 + epsilon) 倍；
+     * maxLeaves 大于0时最多访问这么多个叶子，之后直接返回当前结果。
+     * epsilon 与 maxLeaves 均为0时结果与 FindClosestNPoints 相同。
+     * @param leavesVisited 非空时返回实际访问的叶子数。
+     */
+    void FindApproximateClosestNPoints(int N, const double x[3], double epsilon, int maxLeaves,
+                                       vtkIdList *result, int *leavesVisited = nullptr) const;
+
+    vtkIdType FindApproximateClosestPoint(const double x[3], double epsilon, int maxLeaves, double &dist2,
+                                          int *leavesVisited = nullptr) const;
+
+    /**
+     * 在已有的最大堆上继续近似搜索，用于在多棵树之间合并结果。
+     * @return 访问的叶子数。
+     */
+    int SearchApproximateClosestPoints(const double x[3], size_t N, double epsilon, int maxLeaves,
+                                       std::vector<std::pair<double, vtkIdType>> &heap) const;
+
+    /**
+     * 查找半径R内的所有点，结果不排序。
+     */
+    void FindPointsWithinRadius(double R, const double x[3], vtkIdList *result) const;
+
+    void FindPointsInArea(const double area[6], vtkIdList *ids) const;
+
+    void FindPointsInCuboid(const double cuboid[8][3], vtkIdList *ids) const;
+
+    /**
+     * 查找凸多面体内的所有点，每个平面 (nx, ny, nz, d)，法向指向外部，见 AUtils::ConvexPolytopeShape。
+     */
+    void FindPointsInConvexPolytope(const double *planes, int numPlanes, vtkIdList *ids) const;
+
+    /**
+     * 查找到多段线距离不超过 radius 的所有点（沿路径扫掠的管道），见 AUtils::TubeShape。
+     */
+    void FindPointsInTube(const double *points, int numPoints, double radius, vtkIdList *ids) const;
+
+    void FindPointsInCylinder(const double point[3], const double direction[3], double radius, vtkIdList *ids) const;
+
+    void FindPointsInCapsule(const double p0[3], const double p1[3], double radius, vtkIdList *ids) const;
+
+    /**
+     * 遍历形状内的所有点，点id按段以 visitor(const vtkIdType *ids, vtkIdType n) 的形式传出，
+     * 完全位于形状内部的子树作为一段整体传出，不经过中间容器。
+     * @param shape 查询形状，需提供 Classify(bounds) 与 Contains(point)，见 QueryShapes.h。
+     */
+    template <typename Shape, typename Visitor>
+    void VisitPointsInShape(const Shape &shape, Visitor &&visitor) const;
+
+    /**
+     * 对形状内的每个点调用 f(id)。
+     */
+    template <typename Shape, typename F>
+    void ForEachPointInShape(const Shape &shape, F &&f) const;
+
+    /**
+     * 统计形状内的点数，完全位于形状内部的子树只累加点数。
+     */
+    template <typename Shape>
+    vtkIdType CountPointsInShape(const Shape &shape) const;
+
+    /**
+     * 生成指定层级所有节点包围盒的多边形表示。
+     */
+    void GenerateRepresentation(int level, vtkPolyData *pd) const;
+
+    /**
+     * 将指定层级所有节点的包围盒追加到已有的点与多边形中。
+     */
+    void AppendRepresentation(int level, vtkPoints *pts, vtkCellArray *polys) const;
+
+protected:
+    AvtkFlatKdTree() = default;
+    ~AvtkFlatKdTree() override = default;
+
+    /**
+     * 由坐标构建整棵树，ids 为空时点id即为下标。
+     */
+    void BuildTree(const std::vector<double> &coords, const vtkIdType *ids);
+
+    /**
+     * 串行递归构建子树：计算包围盒，按包围盒最长边取中位数划分，叶子内按id排序。
+     * @param perm 点下标的排列，构建结束后即为重排后的点顺序。
+     * @param coords 原始点坐标 (x, y, z)。
+     */
+    void BuildNode(vtkIdType node, vtkIdType begin, vtkIdType end, int level,
+                   std::vector<vtkIdType> &perm, const std::vector<double> &coords);
+
+    /**
+     * 并行构建整棵树，见 ParallelBuild。
+     */
+    void BuildParallel(std::vector<vtkIdType> &perm, const std::vector<double> &coords);
+
+    /**
+     * 计算节点内点的包围盒，parallel 为 true 时并行归约。
+     */
+    void ComputeNodeBounds(vtkIdType node, vtkIdType begin, vtkIdType end, const std::vector<vtkIdType> &perm,
+                           const std::vector<double> &coords, bool parallel);
+
+    /**
+     * 选择划分维度并将中位数放到区间中点，tmp 非空时使用并行选择。
+     */
+    void SplitNode(vtkIdType node, vtkIdType begin, vtkIdType end, std::vector<vtkIdType> &perm,
+                   const std::vector<double> &coords, std::vector<vtkIdType> *tmp);
+
+    bool IsLeaf(vtkIdType node) const { return node >= this->FirstLeaf; }
+
+    const double *GetNodeBounds(vtkIdType node) const { return &this->NodeBounds[6 * node]; }
+
+    /**
+     * 递归遍历节点，传出位于形状内部的点。
+     */
+    template <typename Shape, typename Visitor>
+    void VisitPointsInShape(vtkIdType node, vtkIdType begin, vtkIdType end,
+                            const Shape &shape, Visitor &visitor) const;
+
+    template <typename Shape>
+    void FindPointsInShape(const Shape &shape, vtkIdList *ids) const;
+
+    /**
+     * 最近点搜索，closest 为当前最近点的 (距离平方, id)，初始为 (VTK_DOUBLE_MAX, -1)。
+     */
+    void SearchClosestPoint(vtkIdType node, vtkIdType begin, vtkIdType end, const double x[3],
+                            std::pair<double, vtkIdType> &closest) const;
+
+    /**
+     * 最近N点搜索，heap为按距离平方排列的最大堆，容量为N。
+     */
+    void SearchClosestPoints(vtkIdType node, vtkIdType begin, vtkIdType end, const double x[3], size_t N,
+                             std::vector<std::pair<double, vtkIdType>> &heap) const;
+
+    /**
+     * 将 [begin, end) 中未删除的点按距离加入最大堆。
+     */
+    void PushLeafCandidates(vtkIdType begin, vtkIdType end, const double x[3], size_t N,
+                            std::vector<std::pair<double, vtkIdType>> &heap) const;
+
+    void AddNodeRepresentation(vtkIdType node, vtkIdType begin, vtkIdType end, int level, int targetLevel,
+                               vtkPoints *pts, vtkCellArray *polys) const;
+
+    int NumberOfPointsPerLeaf = 16;
+    vtkTypeBool ParallelBuild = 0;
+    double BuildElapsedTime = 0.0;
+    int Depth = 0;             // 叶子所在层级
+    vtkIdType FirstLeaf = 0;   // 第一个叶子节点的下标
+
+    AUtils::TreeArray<unsigned char> SplitDim; // 各节点的划分维度
+    AUtils::TreeArray<double> SplitValue;      // 各节点的划分坐标
+    AUtils::TreeArray<double> NodeBounds;      // 各节点内点的包围盒，每个节点6个值
+
+    vtkTypeBool SinglePrecision = 0;
+    bool FloatStorage = false;           // 当前的树是否以单精度存储坐标
+    AUtils::TreeArray<double> X, Y, Z;   // 按树顺序重排的点坐标（双精度存储）
+    AUtils::TreeArray<float> XF, YF, ZF; // 按树顺序重排的点坐标（单精度存储）
+    AUtils::TreeArray<vtkIdType> Ids;    // 按树顺序重排的原始点id
+
+    std::unique_ptr<AUtils::MappedFile> Mapping; // 从文件加载时映射的文件
+    vtkSmartPointer<AvtkFlatKdTree> SharedSource; // ShallowCopy 时数组所在的树
+
+    std::vector<unsigned char> Removed; // 按树顺序的删除标记，没有删除时为空
+    vtkIdType NumberOfRemovedPoints = 0;
+
+private:
+    AvtkFlatKdTree(const AvtkFlatKdTree &) = delete;
+    void operator=(const AvtkFlatKdTree &) = delete;
+};
+
+template <typename Shape, typename Visitor>
+void AvtkFlatKdTree::VisitPointsInShape(vtkIdType node, vtkIdType begin, vtkIdType end,
+                                        const Shape &shape, Visitor &visitor) const
+{
+    if (begin >= end)
+        return;
+
+    AUtils::BoxRelation relation = shape.Classify(this->GetNodeBounds(node));
+    if (relation == AUtils::BoxRelation::Outside)
+        return;
+
+    // 子树完全在形状内部，其点在重排后的数组中连续，按未删除的连续段传出
+    if (relation == AUtils::BoxRelation::Inside)
+    {
+        if (this->NumberOfRemovedPoints == 0)
+        {
+            visitor(this->Ids.data() + begin, end - begin);
+            return;
+        }
+        vtkIdType run = begin;
+        for (vtkIdType i = begin; i <= end; ++i)
+        {
+            if (i == end || this->IsPointRemoved(i))
+            {
+                if (i > run)
+                    visitor(this->Ids.data() + run, i - run);
+                run = i + 1;
+            }
+        }
+        return;
+    }
+
+    if (this->IsLeaf(node) && this->NumberOfRemovedPoints > 0)
+    {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            if (this->IsPointRemoved(i))
+                continue;
+            double p[3];
+            this->GetPoint(i, p);
+            if (shape.Contains(p))
+                visitor(this->Ids.data() + i, vtkIdType(1));
+        }
+        return;
+    }
+
+    // 叶子中的点按分量连续存放，使用向量化的扫描内核
+    if (this->IsLeaf(node))
+    {
+        if (this->FloatStorage)
+            AUtils::ScanPoints(shape, this->XF.data() + begin, this->YF.data() + begin, this->ZF.data() + begin,
+                               this->Ids.data() + begin, end - begin, visitor);
+        else
+            AUtils::ScanPoints(shape, this->X.data() + begin, this->Y.data() + begin, this->Z.data() + begin,
+                               this->Ids.data() + begin, end - begin, visitor);
+        return;
+    }
+
+    vtkIdType mid = begin + (end - begin) / 2;
+    this->VisitPointsInShape(2 * node + 1, begin, mid, shape, visitor);
+    this->VisitPointsInShape(2 * node + 2, mid, end, shape, visitor);
+}
+
+template <typename Shape, typename Visitor>
+void AvtkFlatKdTree::VisitPointsInShape(const Shape &shape, Visitor &&visitor) const
+{
+    if (this->Ids.empty())
+        return;
+    this->VisitPointsInShape(0, 0, this->GetNumberOfPoints(), shape, visitor);
+}
+
+template <typename Shape, typename F>
+void AvtkFlatKdTree::ForEachPointInShape(const Shape &shape, F &&f) const
+{
+    this->VisitPointsInShape(shape, [&f](const vtkIdType *ids, vtkIdType n)
+                             {
+                                 for (vtkIdType i = 0; i < n; ++i)
+                                     f(ids[i]);
+                             });
+}
+
+template <typename Shape>
+vtkIdType AvtkFlatKdTree::CountPointsInShape(const Shape &shape) const
+{
+    vtkIdType count = 0;
+    this->VisitPointsInShape(shape, [&count](const vtkIdType *, vtkIdType n)
+                             { count += n; });
+    return count;
+}
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <vtkObject.h>
+#include <vtkIdList.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vector>
+#include "AvtkFlatKdTree.h"
+
+/**
+ * 支持增量插入与删除的KD树。
+ *
+ * 采用对数方法：新插入的点先放入未建索引的缓冲区，缓冲区满时与所有更小的树合并，
+ * 重建为一棵 AvtkFlatKdTree，第k棵树最多容纳 BufferSize * 2^k 个点，每个点被重建的次数为 O(log n)。
+ * 删除只在所在的树中做标记，某棵树中被删除点的比例超过 MaxRemovedFraction 时只重建这一棵树。
+ * 查询合并所有树与缓冲区的结果，在任意两次重建之间都是精确的。
+ * 点id要求为非负整数，按id索引点的位置，id应当较为紧凑（例如数据集中的点下标）。
+ */
+class AvtkIncrementalKdTree : public vtkObject
+{
+public:
+    vtkTypeMacro(AvtkIncrementalKdTree, vtkObject);
+    static AvtkIncrementalKdTree *New();
+    void PrintSelf(ostream &os, vtkIndent indent) override;
+
+    /**
+     * 每棵树的叶子最多包含的点数。
+     */
+    vtkSetClampMacro(NumberOfPointsPerLeaf, int, 1, 1 << 20);
+    vtkGetMacro(NumberOfPointsPerLeaf, int);
+
+    /**
+     * 未建索引的缓冲区容量，缓冲区中的点在查询时逐个比较。
+     */
+    vtkSetClampMacro(BufferSize, int, 1, 1 << 20);
+    vtkGetMacro(BufferSize, int);
+
+    /**
+     * 一棵树中被删除点的比例超过该值时重建该树。
+     */
+    vtkSetClampMacro(MaxRemovedFraction, double, 0.0, 1.0);
+    vtkGetMacro(MaxRemovedFraction, double);
+
+    /**
+     * 是否并行构建各棵树，见 AvtkFlatKdTree::SetParallelBuild。
+     */
+    vtkSetMacro(ParallelBuild, vtkTypeBool);
+    vtkGetMacro(ParallelBuild, vtkTypeBool);
+    vtkBooleanMacro(ParallelBuild, vtkTypeBool);
+
+    /**
+     * 是否以单精度存储点坐标，见 AvtkFlatKdTree::SetSinglePrecision。
+     * 只对之后插入或重建的点生效，通常在构建前设置。
+     */
+    vtkSetMacro(SinglePrecision, vtkTypeBool);
+    vtkGetMacro(SinglePrecision, vtkTypeBool);
+    vtkBooleanMacro(SinglePrecision, vtkTypeBool);
+
+    /**
+     * 清空后从点数组构建，点id即为点在数组中的下标，所有点放入一棵树。
+     */
+    void BuildFromPoints(vtkPoints *points);
+
+    /**
+     * 插入一个点，id已存在时视为移动该点。
+     */
+    void InsertPoint(vtkIdType id, const double x[3]);
+
+    /**
+     * 插入点数组中 [begin, end) 范围内的点，点id即为点在数组中的下标。
+     */
+    void InsertPoints(vtkPoints *points, vtkIdType begin, vtkIdType end);
+
+    /**
+     * 删除一个点。
+     * @return 点存在时返回true。
+     */
+    bool RemovePoint(vtkIdType id);
+
+    bool HasPoint(vtkIdType id) const;
+
+    /**
+     * 释放所有数据。
+     */
+    void Initialize();
+
+    /**
+     * 拷贝 source 的缓冲区与点位置，各棵树与 source 共享，开销与点数成正比，不重建任何树。
+     * 之后在任一方删除点时，被修改的树先通过 AvtkFlatKdTree::ShallowCopy 复制一份（写时复制），
+     * 另一方的查询结果保持不变，用于为只读快照保留当前状态。
+     */
+    void ShallowCopy(AvtkIncrementalKdTree *source);
+
+    /**
+     * 当前有效的点数，不包含已删除的点。
+     */
+    vtkIdType GetNumberOfPoints() const { return this->NumberOfPoints; }
+
+    /**
+     * 当前非空的树的数量，不包含缓冲区。
+     */
+    int GetNumberOfTrees() const;
+
+    /**
+     * 获取所有点的包围盒，删除点后包围盒不会收缩。
+     */
+    void GetBounds(double bounds[6]) const;
+
+    /**
+     * 所有树与缓冲区占用的内存（KiB）。
+     */
+    unsigned long GetActualMemorySize() const;
+
+    vtkIdType FindClosestPoint(const double x[3], double &dist2) const;
+
+    vtkIdType FindClosestPointWithinRadius(double radius, const double x[3], double &dist2) const;
+
+    /**
+     * 查找距离x最近的N个点，结果按距离从近到远排序。
+     */
+    void FindClosestNPoints(int N, const double x[3], vtkIdList *result) const;
+
+    /**
+     * 近似最近点搜索，见 AvtkFlatKdTree::FindApproximateClosestNPoints。
+     * 叶子预算在所有树之间共享，按从大到小的顺序访问各棵树，缓冲区计为一个叶子。
+     */
+    void FindApproximateClosestNPoints(int N, const double x[3], double epsilon, int maxLeaves,
+                                       vtkIdList *result, int *leavesVisited = nullptr) const;
+
+    vtkIdType FindApproximateClosestPoint(const double x[3], double epsilon, int maxLeaves, double &dist2,
+                                          int *leavesVisited = nullptr) const;
+
+    void FindPointsWithinRadius(double R, const double x[3], vtkIdList *result) const;
+
+    void FindPointsInArea(const double area[6], vtkIdList *ids) const;
+
+    void FindPointsInCuboid(const double cuboid[8][3], vtkIdList *ids) const;
+
+    /**
+     * 查找凸多面体内的所有点，每个平面 (nx, ny, nz, d)，法向指向外部，见 AUtils::ConvexPolytopeShape。
+     */
+    void FindPointsInConvexPolytope(const double *planes, int numPlanes, vtkIdList *ids) const;
+
+    /**
+     * 查找到多段线距离不超过 radius 的所有点（沿路径扫掠的管道），见 AUtils::TubeShape。
+     */
+    void FindPointsInTube(const double *points, int numPoints, double radius, vtkIdList *ids) const;
+
+    void FindPointsInCylinder(const double point[3], const double direction[3], double radius, vtkIdList *ids) const;
+
+    void FindPointsInCapsule(const double p0[3], const double p1[3], double radius, vtkIdList *ids) const;
+
+    /**
+     * 遍历所有树与缓冲区中位于形状内的点，见 AvtkFlatKdTree::VisitPointsInShape。
+     */
+    template <typename Shape, typename Visitor>
+    void VisitPointsInShape(const Shape &shape, Visitor &&visitor) const;
+
+    template <typename Shape, typename F>
+    void ForEachPointInShape(const Shape &shape, F &&f) const;
+
+    template <typename Shape>
+    vtkIdType CountPointsInShape(const Shape &shape) const;
+
+    /**
+     * 生成所有树在指定层级的节点包围盒。
+     */
+    void GenerateRepresentation(int level, vtkPolyData *pd) const;
+
+protected:
+    AvtkIncrementalKdTree() = default;
+    ~AvtkIncrementalKdTree() override = default;
+
+    /**
+     * 点的位置：Tree 为 -1 表示在缓冲区中，-2 表示不存在；Index 为缓冲区下标或树顺序下标。
+     */
+    struct Location
+    {
+        int Tree = -2;
+        vtkIdType Index = 0;
+    };
+
+    /**
+     * 将缓冲区与前面连续的非空树合并，构建到第一个空位。
+     */
+    void FlushBuffer();
+
+    /**
+     * 去掉第k棵树中已删除的点后重建。
+     */
+    void RebuildTree(int k);
+
+    /**
+     * 将第k棵树中有效的点追加到坐标和id数组。
+     */
+    void CollectTreePoints(int k, std::vector<double> &coords, std::vector<vtkIdType> &ids) const;
+
+    /**
+     * 由坐标构建第k棵树并更新其中点的位置。
+     */
+    void BuildTree(int k, const std::vector<double> &coords, const std::vector<vtkIdType> &ids);
+
+    void RemoveFromBuffer(vtkIdType index);
+
+    /**
+     * 在所有树与缓冲区上进行近似最近N点搜索。
+     * @return 访问的叶子数。
+     */
+    int SearchApproximateClosestPoints(const double x[3], size_t N, double epsilon, int maxLeaves,
+                                       std::vector<std::pair<double, vtkIdType>> &heap) const;
+
+    template <typename Shape>
+    void FindPointsInShape(const Shape &shape, vtkIdList *ids) const;
+
+    int NumberOfPointsPerLeaf = 16;
+    int BufferSize = 1024;
+    double MaxRemovedFraction = 0.5;
+    vtkTypeBool ParallelBuild = 0;
+    vtkTypeBool SinglePrecision = 0;
+
+    std::vector<vtkSmartPointer<AvtkFlatKdTree>> Trees; // 第k棵树为空或最多包含 BufferSize * 2^k 个点
+    std::vector<double> BufferPoints;                   // 缓冲区点坐标 (x, y, z)
+    std::vector<vtkIdType> BufferIds;                   // 缓冲区点id
+    std::vector<Location> Locations;                    // 按id索引的点位置
+    vtkIdType NumberOfPoints = 0;
+
+private:
+    AvtkIncrementalKdTree(const AvtkIncrementalKdTree &) = delete;
+    void operator=(const AvtkIncrementalKdTree &) = delete;
+};
+
+template <typename Shape, typename Visitor>
+void AvtkIncrementalKdTree::VisitPointsInShape(const Shape &shape, Visitor &&visitor) const
+{
+    for (const auto &tree : this->Trees)
+    {
+        if (tree)
+            tree->VisitPointsInShape(shape, visitor);
+    }
+    for (size_t j = 0; j < this->BufferIds.size(); ++j)
+    {
+        if (shape.Contains(&this->BufferPoints[3 * j]))
+            visitor(&this->BufferIds[j], vtkIdType(1));
+    }
+}
+
+template <typename Shape, typename F>
+void AvtkIncrementalKdTree::ForEachPointInShape(const Shape &shape, F &&f) const
+{
+    this->VisitPointsInShape(shape, [&f](const vtkIdType *ids, vtkIdType n)
+                             {
+                                 for (vtkIdType i = 0; i < n; ++i)
+                                     f(ids[i]);
+                             });
+}
+
+template <typename Shape>
+vtkIdType AvtkIncrementalKdTree::CountPointsInShape(const Shape &shape) const
+{
+    vtkIdType count = 0;
+    this->VisitPointsInShape(shape, [&count](const vtkIdType *, vtkIdType n)
+                             { count += n; });
+    return count;
+}
@@ -2,7 +2,13 @@
 
 #include <vtkKdTree.h>
 #include <vtkKdNode.h>
+#include <vtkDoubleArray.h>
+#include <vtkIdTypeArray.h>
+#include <vector>
 #include "CubeFrame.h"
+#include "LeafKernels.h"
+#include "PointStatistics.h"
+#include "QueryShapes.h"
 
 class AvtkKdTree : public vtkKdTree
 {
@@ -10,6 +16,41 @@ public:
     vtkTypeMacro(AvtkKdTree, vtkKdTree);
     static AvtkKdTree *New();
 
+    /**
+     * 从点集构建KD树，并按区域缓存点id与坐标。
+     * 区域查询（圆柱、胶囊体等）直接遍历缓存的叶子数据，每个点只测试一次。
+     * 缓存建立后释放vtkKdTree自身的定位点数组（LocatorPoints、LocatorIds），点查询改由缓存完成，见 FindClosestPoint。
+     * 同时为每个节点汇总子树内的点数、质心、二阶矩以及点集法向量（若有）之和，见 ComputeStatisticsInShape。
+     * @param pointset 要构建的点集。
+     */
+    void BuildLocatorFromPoints(vtkPointSet *pointset);
+    void BuildLocatorFromPoints(vtkPoints *ptArray);
+    void BuildLocatorFromPoints(vtkPoints **ptArrays, int numPtArrays);
+
+    /**
+     * 释放KD树以及区域点缓存。
+     */
+    void FreeSearchStructure() override;
+
+    /**
+     * 区域点缓存是否以单精度存储坐标，下次构建时生效，默认关闭。
+     * 开启后缓存每个点占用20字节（id与三个float分量），双精度时为32字节，区域查询在舍入为float的坐标上进行，
+     * 每个分量与双精度结果的误差不超过 |x| * 2^-24。vtkKdTree 本身的划分同样基于float坐标。
+     */
+    vtkSetMacro(SinglePrecision, vtkTypeBool);
+    vtkGetMacro(SinglePrecision, vtkTypeBool);
+    vtkBooleanMacro(SinglePrecision, vtkTypeBool);
+
+    /**
+     * 是否使用 vtkSMPTools 并行构建，下次构建时生效，默认关闭。
+     * 开启后按与vtkKdTree相同的规则（MaxLevel、MinCells、区域数限制与可划分方向）做中位数划分，
+     * 顶层节点使用并行选择，节点足够多后各子树作为独立任务，结果写入vtkKdTree自身的节点树与区域列表。
+     * 坐标相同的点较多时划分位置可能与串行构建略有不同，查询结果相同。
+     */
+    vtkSetMacro(ParallelBuild, vtkTypeBool);
+    vtkGetMacro(ParallelBuild, vtkTypeBool);
+    vtkBooleanMacro(ParallelBuild, vtkTypeBool);
+
     /**
      * 获取指定层级的所有区域的边界框。
      * @param level 要查询的层级。
@@ -21,27 +62,22 @@ public:
      * 获取指定层级的区域数量。
      *
      * @param level 要查询的层级。层级从0开始计数。
-     * @return 该层级的区域数量。
-     *         - 若层级小于0，返回0。
-     *         - 若层级超过最大层级，返回最大层级值。
-     *         - 否则返回该层级的实际区域数量。
+     * @return 该层级的区域数量，层级小于0或超过最大层级时返回0。
      */
     int GetNumberOfRegionsAtLevel(int level);
 
     /**
      * 获取KD树的最大层级。
      *
-     * @return int 最大层级值，从根节点开始计算层级深度。
+     * @return int 最大层级值，从根节点开始计算层级深度，树为空时返回-1。
      */
     int GetMaxLevel() const;
 
     /**
-     * 计算KD树从指定节点开始的最大层级。
-     * @param node 当前处理的KD树节点。
-     * @param currentLevel 当前节点所在的层级。
-     * @return 返回以node为根节点的子树的最大层级，若节点为空则返回-1。
+     * 获取指定层级的所有节点，按从左到右的顺序排列。
+     * @param level 要查询的层级，超出范围时返回空列表。
      */
-    int CalculateMaxLevel(vtkKdNode *node, int currentLevel) const;
+    const std::vector<vtkKdNode *> &GetNodesAtLevel(int level) const;
 
     /**
      * 根据给定点坐标获取包含该点的区域及其路径上的所有边界框
@@ -52,26 +88,169 @@ public:
      */
     std::vector<CubeFrame *> GetRegionBoundsByPoint(double x, double y, double z);
 
+    /**
+     * 查找以x为球心、半径为R的球内的所有点，在区域点缓存上按节点包围盒裁剪并以向量化内核扫描叶子。
+     * 没有区域点缓存时（如直接调用 vtkKdTree::BuildLocatorFromPoints 构建）使用vtkKdTree的实现。
+     * @param result 输出的点id列表，调用前的内容会被清空。
+     */
+    void FindPointsWithinRadius(double R, const double x[3], vtkIdList *result);
+    void FindPointsWithinRadius(double R, double x, double y, double z, vtkIdList *result)
+    {
+        double p[3] = {x, y, z};
+        this->FindPointsWithinRadius(R, p, result);
+    }
+
+    /**
+     * 查找轴对齐包围盒 area (xmin, xmax, ymin, ymax, zmin, zmax) 内的所有点，
+     * 没有区域点缓存时同样使用vtkKdTree的实现。
+     */
     void FindPointsInArea(double *area, vtkIdList *ids);
 
     void FindPointsInCuboid(double cuboid[8][3], vtkIdList *ids);
 
-protected:
     /**
-     * 统计指定层级下二叉树节点的数量。
-     *
-     * @param node 要统计的节点的根节点。
-     * @param currentLevel 当前节点所在的层级。
-     * @param targetLevel 目标层级，统计该层级下的节点数量。
-     * @return 返回目标层级下节点的数量。
+     * 查找凸多面体（若干半空间的交集）内的所有点，用于视锥裁剪与凸套索选择。
+     * 节点包围盒按各平面分为内部、外部与相交，完全在内部的子树整体加入结果，不逐点测试。
+     * @param planes numPlanes 个平面，每个平面 (nx, ny, nz, d)，法向指向外部，见 AUtils::ConvexPolytopeShape。
+     * @param ids 输出的点id列表，调用前的内容会被清空。
+     */
+    void FindPointsInConvexPolytope(const double *planes, int numPlanes, vtkIdList *ids);
+
+    /**
+     * 查找到多段线距离不超过 radius 的所有点，即半径为 radius 的球沿路径扫过的管道，用于刀具路径等扫掠查询。
+     * 整条路径只遍历一次树，节点只与包围盒重叠的线段比较，结果中每个点只出现一次。
+     * @param points numPoints 个连续的 (x, y, z)，只有一个点时退化为球体。
+     * @param ids 输出的点id列表，调用前的内容会被清空。
+     */
+    void FindPointsInTube(const double *points, int numPoints, double radius, vtkIdList *ids);
+
+    /**
+     * 查找无限长圆柱体内的所有点。
+     * 按节点包围盒到轴线的距离裁剪子树，完全位于圆柱内的子树整体加入结果。
+     * @param point 轴线上一点。
+     * @param direction 轴方向，无需归一化，长度为0时报错并返回空结果。
+     * @param radius 圆柱半径。
+     * @param ids 输出的点id列表，调用前的内容会被清空。
+     */
+    void FindPointsInCylinder(const double point[3], const double direction[3], double radius, vtkIdList *ids);
+
+    /**
+     * 查找胶囊体（线段 p0-p1 扫过半径为 radius 的球）内的所有点。
+     * @param p0 线段起点。
+     * @param p1 线段终点，与起点重合时退化为球查询。
+     * @param radius 胶囊体半径。
+     * @param ids 输出的点id列表，调用前的内容会被清空。
+     */
+    void FindPointsInCapsule(const double p0[3], const double p1[3], double radius, vtkIdList *ids);
+
+    /**
+     * 近似最近N点搜索。按区域包围盒到x的距离从近到远访问叶子（best-bin-first），
+     * 返回的第k个点的距离不超过真实第k近距离的 (1 + epsilon) 倍；
+     * maxLeaves 大于0时最多访问这么多个叶子。epsilon 与 maxLeaves 均为0时为精确搜索。
+     * @param result 输出的点id列表，按距离从近到远排序。
+     * @param leavesVisited 非空时返回实际访问的叶子数。
+     */
+    void FindApproximateClosestNPoints(int N, const double x[3], double epsilon, int maxLeaves,
+                                       vtkIdList *result, int *leavesVisited = nullptr) const;
+
+    vtkIdType FindApproximateClosestPoint(const double x[3], double epsilon, int maxLeaves, double &dist2,
+                                          int *leavesVisited = nullptr) const;
+
+    ///@{
+    /**
+     * vtkKdTree的点查询，在区域点缓存上以精确搜索实现，语义与vtkKdTree相同。
+     * 缓存建立后vtkKdTree的定位点数组已释放，须通过 AvtkKdTree 调用这些函数；
+     * 没有区域点缓存时（如直接调用 vtkKdTree::BuildLocatorFromPoints 构建）使用vtkKdTree的实现。
      */
-    int CountNodesAtLevel(vtkKdNode *, int currentLevel, int targetLevel);
+    vtkIdType FindClosestPoint(double *x, double &dist2);
+    vtkIdType FindClosestPoint(double x, double y, double z, double &dist2);
+    vtkIdType FindClosestPointWithinRadius(double radius, const double x[3], double &dist2);
+    vtkIdType FindClosestPointInRegion(int regionId, double *x, double &dist2);
+    vtkIdType FindClosestPointInRegion(int regionId, double x, double y, double z, double &dist2);
+    void FindClosestNPoints(int N, const double x[3], vtkIdList *result);
+    void FindPointsInArea(double *area, vtkIdTypeArray *ids, bool clearArray = true);
+    vtkIdTypeArray *GetPointsInRegion(int regionId);
+    ///@}
 
     /**
-     * 获取指定节点在Kd树中的层级。
+     * 查找坐标与x完全相同的点（单精度存储时先将x舍入为float），没有时返回-1。
+     */
+    vtkIdType FindPoint(double *x);
+    vtkIdType FindPoint(double x, double y, double z);
+
+    /**
+     * 将每个点映射到距离不超过 tolerance 的重复点中id最小的一个，返回的数组由调用者释放。
+     */
+    vtkIdTypeArray *BuildMapForDuplicatePoints(float tolerance);
+
+    /**
+     * 双树半径连接：查找本树的点 i 与 other 的点 j 之间距离不超过 radius 的所有点对。
+     * 同时遍历两棵树，包围盒距离大于 radius 的节点对整体裁剪，最远距离不超过 radius 的节点对整体输出，
+     * 互不相关的子树对使用 vtkSMPTools 并行处理。两棵树可以是同一棵树，此时包含 (i, i)。
+     * @param pairs 输出点对，2个分量 (i, j)，按 i、j 升序排列。
+     * @param dist2 非空时返回每个点对的距离平方。
+     */
+    void FindPairsWithinRadius(AvtkKdTree *other, double radius, vtkIdTypeArray *pairs,
+                               vtkDoubleArray *dist2 = nullptr);
+
+    /**
+     * 对本树中的每个点查找 other 中的最近点。以本树的叶子为单位遍历 other，
+     * 节点与叶子包围盒的距离超过叶内所有点当前最近距离时整体裁剪，各叶子并行处理。
+     * @param ids 按本树的点id排列，返回 other 中最近点的id，距离超过 maxDistance 时为-1。
+     * @param dist2 非空时返回距离平方，没有最近点时为 VTK_DOUBLE_MAX。
+     */
+    void FindClosestPointsInTree(AvtkKdTree *other, vtkIdTypeArray *ids, vtkDoubleArray *dist2 = nullptr,
+                                 double maxDistance = VTK_DOUBLE_MAX);
+
+    /**
+     * 遍历形状内的所有点，点id按段以 visitor(const vtkIdType *ids, vtkIdType n) 的形式传出，
+     * 完全位于形状内部的子树对应区域点缓存中的一段连续区间，整体传出，不经过中间容器。
+     * 区域点缓存不可用时不传出任何点。
+     * @param shape 查询形状，需提供 Classify(bounds) 与 Contains(point)，见 QueryShapes.h。
+     */
+    template <typename Shape, typename Visitor>
+    void VisitPointsInShape(const Shape &shape, Visitor &&visitor) const;
+
+    /**
+     * 对形状内的每个点调用 f(id)。
+     */
+    template <typename Shape, typename F>
+    void ForEachPointInShape(const Shape &shape, F &&f) const;
+
+    /**
+     * 统计形状内的点数，完全位于形状内部的子树只累加点数。
+     */
+    template <typename Shape>
+    vtkIdType CountPointsInShape(const Shape &shape) const;
+
+    /**
+     * 汇总形状内所有点的点数、质心、协方差与法向量之和，结果合并到 stats。
+     * 完全位于形状内部的子树直接合并构建时保存的节点汇总量，复杂度 O(1)，
+     * 只有与形状边界相交的叶子逐点累加，因此大区域的统计与区域内的点数无关。
+     * 法向量取自构建时点集的点法向量，没有法向量时 NormalSum 为0。区域点缓存不可用时不改变 stats。
+     * @param shape 查询形状，需提供 Classify(bounds) 与 Contains(point)，见 QueryShapes.h。
+     */
+    template <typename Shape>
+    void ComputeStatisticsInShape(const Shape &shape, AUtils::PointStatistics &stats) const;
+
+    /**
+     * 节点汇总量中是否包含法向量，即构建时的点集是否带有点法向量。
+     */
+    bool HasPointNormals() const { return !this->RegionNormals.empty(); }
+
+    /**
+     * 只用新的点法向量重新计算区域法向量缓存与节点汇总量中的法向量之和，不重建树。
+     * 点坐标不变、法向量在构建后才写入（如用本树查询邻域估计法向量）时代替重建。
+     * @param normals 与构建时的点一一对应的点法向量，为空或数量、分量数不符时清除法向量。
+     */
+    void UpdatePointNormals(vtkDataArray *normals);
+
+protected:
+    /**
+     * 获取指定节点在Kd树中的层级，沿父节点向上计数，复杂度为 O(depth)。
      *
      * @param node 目标节点的指针。
-     * @return 该节点的层级，根节点的层级为0。
+     * @return 该节点的层级，根节点的层级为0，节点不在树中时返回-1。
      */
     int GetNodeLevel(vtkKdNode *node) const;
 
@@ -88,7 +267,7 @@ protected:
     /**
      * 获取从根节点到指定目标节点的路径。
      *
-     * 该函数从Kd树的根节点开始，递归查找并返回从根节点到目标节点的完整路径。
+     * 该函数从目标节点沿父节点向上回溯到根节点，复杂度为 O(depth)。
      * 路径以节点指针的向量形式返回，顺序从根节点到目标节点。
      *
      * @param target 目标节点的指针。路径将终止于此节点。
@@ -102,5 +281,279 @@ protected:
     /// \return 返回从current到target的节点路径列表。若路径不存在或current为nullptr，返回空列表。
     std::vector<vtkKdNode *> getPath(vtkKdNode *current, vtkKdNode *target) const;
 
-    vtkPointSet *pointSet;
+    /**
+     * 按层级索引树中的节点。索引在构建后首次使用时生成，树重建或释放时失效。
+     */
+    void UpdateLevelIndex() const;
+
+    /**
+     * 构建KD树、区域点缓存与节点汇总量。
+     * @param normals 与点一一对应的点法向量，为空时汇总量不含法向量。
+     */
+    void BuildFromPointArrays(vtkPoints **ptArrays, int numPtArrays, vtkDataArray *normals);
+
+    /**
+     * 并行构建vtkKdTree的节点树、区域列表与 LocatorIds，代替 vtkKdTree::BuildLocatorFromPoints。
+     * 坐标随后由区域点缓存保存，因此不生成 LocatorPoints。
+     */
+    void BuildLocatorInParallel(vtkPoints **ptArrays, int numPtArrays);
+
+    /**
+     * 按区域顺序缓存所有点的原始id与坐标，并计算各区域的汇总量，点id取自vtkKdTree的 LocatorIds。
+     * 多个点数组时，原始id按数组顺序连续编号，与vtkKdTree保持一致。
+     */
+    void BuildRegionPointCache(vtkPoints **ptArrays, int numPtArrays, vtkDataArray *normals);
+
+    /**
+     * 自底向上合并区域汇总量，得到各内部节点的汇总量。
+     * @return 节点子树的汇总量。
+     */
+    const AUtils::PointStatistics &BuildNodeStatistics(vtkKdNode *node);
+
+    /**
+     * 节点子树的汇总量。叶子按区域id索引；内部节点的左右子树在区域id上以 Left->GetMaxID() 为界，
+     * 每个分界恰好属于一个内部节点，因此按该分界索引。
+     */
+    const AUtils::PointStatistics &GetNodeStatistics(vtkKdNode *node) const
+    {
+        if (node->GetLeft() == nullptr)
+            return this->RegionStatistics[node->GetID()];
+        return this->NodeStatistics[node->GetLeft()->GetMaxID()];
+    }
+
+    /**
+     * 逐点累加缓存区间 [begin, end) 中位于形状内部的点。
+     */
+    template <typename Shape>
+    void AccumulatePointsInShape(const Shape &shape, vtkIdType begin, vtkIdType end,
+                                 AUtils::PointStatisticsAccumulator &sums) const;
+
+    /**
+     * 递归汇总节点子树内位于形状内部的点。
+     */
+    template <typename Shape>
+    void ComputeStatisticsInShape(vtkKdNode *node, const Shape &shape, AUtils::PointStatistics &stats) const;
+
+    /**
+     * 缓存中第i个点的坐标。
+     */
+    void GetRegionPoint(vtkIdType i, double p[3]) const
+    {
+        if (this->RegionFloatStorage)
+        {
+            p[0] = this->RegionXF[i];
+            p[1] = this->RegionYF[i];
+            p[2] = this->RegionZF[i];
+            return;
+        }
+        p[0] = this->RegionX[i];
+        p[1] = this->RegionY[i];
+        p[2] = this->RegionZ[i];
+    }
+
+    /**
+     * 检查区域点缓存是否可用，不可用时输出错误信息。
+     */
+    bool CheckRegionPointCache();
+
+    /**
+     * 节点的包围盒，叶子为区域内点的紧包围盒，内部节点为空间划分的包围盒。
+     */
+    void GetNodeBounds(vtkKdNode *node, double bounds[6]) const;
+
+    /**
+     * 节点子树在区域点缓存中的区间 [begin, end)。
+     */
+    void GetNodeRange(vtkKdNode *node, vtkIdType &begin, vtkIdType &end) const
+    {
+        begin = this->RegionOffsets[node->GetMinID()];
+        end = this->RegionOffsets[node->GetMaxID() + 1];
+    }
+
+    /**
+     * 半径连接的一个结果，First 属于本树，Second 属于另一棵树。
+     */
+    struct PointPair
+    {
+        vtkIdType First;
+        vtkIdType Second;
+        double Dist2;
+    };
+
+    /**
+     * 双树半径连接的递归部分，node 属于本树，otherNode 属于 other，结果追加到 result。
+     */
+    void JoinNodes(const AvtkKdTree *other, vtkKdNode *node, vtkKdNode *otherNode, double radius2,
+                   std::vector<PointPair> &result) const;
+
+    /**
+     * 递归遍历节点，传出位于形状内部的点。
+     * @param node 当前节点。
+     * @param shape 查询形状，需提供 Classify(bounds) 与 Contains(point)。
+     * @param visitor 以 (const vtkIdType *ids, vtkIdType n) 接收点id。
+     */
+    template <typename Shape, typename Visitor>
+    void VisitPointsInShape(vtkKdNode *node, const Shape &shape, Visitor &visitor) const;
+
+    /**
+     * 将节点子树内位于形状内部的点id追加到结果。
+     */
+    template <typename Shape>
+    void FindPointsInShape(vtkKdNode *node, const Shape &shape, vtkIdList *ids) const;
+
+    /**
+     * 近似最近N点搜索，heap为按距离平方排列的最大堆。
+     * @return 访问的叶子数。
+     */
+    int SearchApproximateClosestPoints(const double x[3], size_t N, double epsilon, int maxLeaves,
+                                       std::vector<std::pair<double, vtkIdType>> &heap) const;
+
+    vtkPointSet *pointSet = nullptr;
+
+    std::vector<vtkIdType> RegionOffsets;  // 区域r的点位于缓存区间 [RegionOffsets[r], RegionOffsets[r+1])
+    std::vector<vtkIdType> RegionPointIds; // 按区域排列的原始点id
+    std::vector<double> RegionX;           // 按区域排列的点坐标分量，分量分开存放便于向量化扫描
+    std::vector<double> RegionY;
+    std::vector<double> RegionZ;
+    std::vector<float> RegionXF;           // 单精度存储时的点坐标分量
+    std::vector<float> RegionYF;
+    std::vector<float> RegionZF;
+    std::vector<double> RegionBounds;      // 各区域内点的紧包围盒，每个区域6个分量，空区域的最小值大于最大值
+    std::vector<float> RegionNormals;      // 按区域排列的点法向量，每个点3个分量，点集没有法向量时为空
+    std::vector<AUtils::PointStatistics> RegionStatistics; // 各区域的汇总量
+    std::vector<AUtils::PointStatistics> NodeStatistics;   // 各内部节点的汇总量，按 Left->GetMaxID() 索引
+    vtkTypeBool SinglePrecision = 0;
+    vtkTypeBool ParallelBuild = 0;
+    bool RegionFloatStorage = false;       // 当前缓存是否为单精度
+
+    mutable vtkKdNode *IndexedTop = nullptr;                    // 层级索引对应的根节点
+    mutable std::vector<std::vector<vtkKdNode *>> LevelNodes; // 每一层的节点，LevelNodes.size() - 1 为最大层级
 };
+
+template <typename Shape, typename Visitor>
+void AvtkKdTree::VisitPointsInShape(vtkKdNode *node, const Shape &shape, Visitor &visitor) const
+{
+    double bounds[6];
+    node->GetBounds(bounds);
+
+    AUtils::BoxRelation relation = shape.Classify(bounds);
+    if (relation == AUtils::BoxRelation::Outside)
+        return;
+
+    // 子树完全在形状内部，其区域id连续，对应缓存中的一段连续区间
+    if (relation == AUtils::BoxRelation::Inside)
+    {
+        vtkIdType begin = this->RegionOffsets[node->GetMinID()];
+        vtkIdType end = this->RegionOffsets[node->GetMaxID() + 1];
+        if (end > begin)
+            visitor(this->RegionPointIds.data() + begin, end - begin);
+        return;
+    }
+
+    if (node->GetLeft() == nullptr)
+    {
+        int regionID = node->GetID();
+        vtkIdType begin = this->RegionOffsets[regionID];
+        vtkIdType n = this->RegionOffsets[regionID + 1] - begin;
+        if (this->RegionFloatStorage)
+            AUtils::ScanPoints(shape, this->RegionXF.data() + begin, this->RegionYF.data() + begin, this->RegionZF.data() + begin,
+                               this->RegionPointIds.data() + begin, n, visitor);
+        else
+            AUtils::ScanPoints(shape, this->RegionX.data() + begin, this->RegionY.data() + begin, this->RegionZ.data() + begin,
+                               this->RegionPointIds.data() + begin, n, visitor);
+        return;
+    }
+
+    this->VisitPointsInShape(node->GetLeft(), shape, visitor);
+    this->VisitPointsInShape(node->GetRight(), shape, visitor);
+}
+
+template <typename Shape, typename Visitor>
+void AvtkKdTree::VisitPointsInShape(const Shape &shape, Visitor &&visitor) const
+{
+    if (!this->Top || this->RegionOffsets.empty())
+        return;
+    this->VisitPointsInShape(this->Top, shape, visitor);
+}
+
+template <typename Shape, typename F>
+void AvtkKdTree::ForEachPointInShape(const Shape &shape, F &&f) const
+{
+    this->VisitPointsInShape(shape, [&f](const vtkIdType *ids, vtkIdType n)
+                             {
+                                 for (vtkIdType i = 0; i < n; ++i)
+                                     f(ids[i]);
+                             });
+}
+
+template <typename Shape>
+vtkIdType AvtkKdTree::CountPointsInShape(const Shape &shape) const
+{
+    vtkIdType count = 0;
+    this->VisitPointsInShape(shape, [&count](const vtkIdType *, vtkIdType n)
+                             { count += n; });
+    return count;
+}
+
+template <typename Shape>
+void AvtkKdTree::AccumulatePointsInShape(const Shape &shape, vtkIdType begin, vtkIdType end,
+                                         AUtils::PointStatisticsAccumulator &sums) const
+{
+    bool normals = !this->RegionNormals.empty();
+    for (vtkIdType i = begin; i < end; ++i)
+    {
+        double p[3];
+        this->GetRegionPoint(i, p);
+        if (!shape.Contains(p))
+            continue;
+        sums.AddPoint(p);
+        if (normals)
+        {
+            const float *n = &this->RegionNormals[3 * i];
+            double normal[3] = {n[0], n[1], n[2]};
+            sums.AddNormal(normal);
+        }
+    }
+}
+
+template <typename Shape>
+void AvtkKdTree::ComputeStatisticsInShape(vtkKdNode *node, const Shape &shape, AUtils::PointStatistics &stats) const
+{
+    double bounds[6];
+    this->GetNodeBounds(node, bounds);
+    AUtils::BoxRelation relation = shape.Classify(bounds);
+    if (relation == AUtils::BoxRelation::Outside)
+        return;
+
+    // 子树完全在形状内部，直接合并构建时的汇总量
+    if (relation == AUtils::BoxRelation::Inside)
+    {
+        stats.Add(this->GetNodeStatistics(node));
+        return;
+    }
+
+    if (node->GetLeft() == nullptr)
+    {
+        // 以叶子包围盒的中心为平移原点逐点累加
+        double center[3];
+        for (int k = 0; k < 3; ++k)
+            center[k] = 0.5 * (bounds[2 * k] + bounds[2 * k + 1]);
+        AUtils::PointStatisticsAccumulator sums;
+        sums.Init(center);
+        int regionID = node->GetID();
+        this->AccumulatePointsInShape(shape, this->RegionOffsets[regionID], this->RegionOffsets[regionID + 1], sums);
+        sums.AddTo(stats);
+        return;
+    }
+
+    this->ComputeStatisticsInShape(node->GetLeft(), shape, stats);
+    this->ComputeStatisticsInShape(node->GetRight(), shape, stats);
+}
+
+template <typename Shape>
+void AvtkKdTree::ComputeStatisticsInShape(const Shape &shape, AUtils::PointStatistics &stats) const
+{
+    if (!this->Top || this->RegionStatistics.empty())
+        return;
+    this->ComputeStatisticsInShape(this->Top, shape, stats);
+}
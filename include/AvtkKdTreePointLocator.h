@@ -3,8 +3,20 @@
 #include "vtkAbstractPointLocator.h"
 #include "vtkCommonDataModelModule.h" // For export macro
 
+#include "AvtkFlatKdTree.h"        // For the templated region queries
+#include "AvtkIncrementalKdTree.h" // For the templated region queries
+#include "AvtkKdTree.h"            // For the templated region queries
+#include "AvtkUniformGrid.h"       // For the templated region queries
+#include "AvtkPointLocatorSnapshot.h" // For the frozen read path
+#include "vtkSmartPointer.h"          // For the published snapshot
+#include "vtkWeakPointer.h"           // For the indexed point array
+
+#include <mutex> // For the published snapshot
+#include <set>   // For the removed point ids
+
 class vtkIdList;
-class AvtkKdTree;
+class vtkIdTypeArray;
+class vtkDoubleArray;
 
 class AvtkKdTreePointLocator : public vtkAbstractPointLocator
 {
@@ -13,6 +25,98 @@ public:
     static AvtkKdTreePointLocator *New();
     void PrintSelf(ostream &os, vtkIndent indent) override;
 
+    /**
+     * Select the search structure. VTK_KD_TREE (the default) wraps vtkKdTree
+     * and provides the region navigation used by GetKdTree(). FLAT_KD_TREE
+     * uses AvtkFlatKdTree, an implicit breadth-first kd-tree whose leaf points
+     * are stored contiguously; it answers the same queries with far fewer
+     * cache misses but has no vtkKdNode regions, so GetKdTree() returns
+     * nullptr. INCREMENTAL_KD_TREE uses AvtkIncrementalKdTree, a forest of
+     * flat kd-trees that supports insertion and removal (see RemovePoint()).
+     * UNIFORM_GRID uses AvtkUniformGrid, a hashed grid of cubic cells that
+     * only stores the non-empty cells; it suits fixed-radius workloads when
+     * GridCellSize is set to the query radius. Changing the type causes a
+     * rebuild on the next query.
+     */
+    enum TreeTypes
+    {
+        VTK_KD_TREE = 0,
+        FLAT_KD_TREE = 1,
+        INCREMENTAL_KD_TREE = 2,
+        UNIFORM_GRID = 3
+    };
+    vtkSetClampMacro(TreeType, int, VTK_KD_TREE, UNIFORM_GRID);
+    vtkGetMacro(TreeType, int);
+    void SetTreeTypeToVtkKdTree() { this->SetTreeType(VTK_KD_TREE); }
+    void SetTreeTypeToFlatKdTree() { this->SetTreeType(FLAT_KD_TREE); }
+    void SetTreeTypeToIncrementalKdTree() { this->SetTreeType(INCREMENTAL_KD_TREE); }
+    void SetTreeTypeToUniformGrid() { this->SetTreeType(UNIFORM_GRID); }
+
+    /**
+     * Maximum number of points per leaf of the flat kd-tree. Only used when
+     * TreeType is FLAT_KD_TREE or INCREMENTAL_KD_TREE. With UNIFORM_GRID and
+     * an automatic GridCellSize it is the average number of points per cell.
+     */
+    vtkSetClampMacro(NumberOfPointsPerLeaf, int, 1, 1 << 20);
+    vtkGetMacro(NumberOfPointsPerLeaf, int);
+
+    /**
+     * Edge length of the uniform grid cells, only used when TreeType is
+     * UNIFORM_GRID. A radius query visits 3x3x3 cells when it equals the
+     * query radius; the grid is fastest when a cell holds some 10 to 30
+     * points, so sparse data wants cells larger than the radius. 0 (the
+     * default) derives it from NumberOfPointsPerLeaf.
+     */
+    vtkSetClampMacro(GridCellSize, double, 0.0, VTK_DOUBLE_MAX);
+    vtkGetMacro(GridCellSize, double);
+
+    /**
+     * Build the search structure in parallel with vtkSMPTools. The flat
+     * kd-tree is identical to the serial one. With VTK_KD_TREE the median
+     * partitioning follows vtkKdTree's own rules and fills its tree and
+     * locator arrays; cut positions may differ from the serial build where
+     * many points share a coordinate, but queries return the same answers.
+     */
+    vtkSetMacro(ParallelBuild, vtkTypeBool);
+    vtkGetMacro(ParallelBuild, vtkTypeBool);
+    vtkBooleanMacro(ParallelBuild, vtkTypeBool);
+
+    /**
+     * Store the indexed point coordinates in single precision. Float point
+     * arrays are read as they are, other arrays are rounded to float, and the
+     * coordinates kept by the locator take half the memory. Queries still
+     * compute in double on the stored coordinates, so results differ from the
+     * double path only through the rounding: a point within |x| * 2^-24 of a
+     * query boundary (per component) may be classified differently, and
+     * returned squared distances differ by the same relative amount. Takes
+     * effect at the next build. Off by default.
+     */
+    vtkSetMacro(SinglePrecision, vtkTypeBool);
+    vtkGetMacro(SinglePrecision, vtkTypeBool);
+    vtkBooleanMacro(SinglePrecision, vtkTypeBool);
+
+    /**
+     * Wall-clock time in seconds spent by the last locator build.
+     */
+    vtkGetMacro(BuildElapsedTime, double);
+
+    ///@{
+    /**
+     * Approximate nearest neighbour mode. When ApproximationEpsilon is
+     * positive, the k-th returned point is at most (1 + epsilon) times
+     * farther than the true k-th nearest point. When MaxNumberOfLeavesVisited
+     * is positive, the search stops after visiting that many leaves, in order
+     * of increasing distance, and returns the best points found so far.
+     * Both default to 0, which gives exact results. FindClosestPoint(),
+     * FindClosestNPoints() and their batched versions honour these settings.
+     * The uniform grid ignores them and always returns exact results.
+     */
+    vtkSetClampMacro(ApproximationEpsilon, double, 0.0, VTK_DOUBLE_MAX);
+    vtkGetMacro(ApproximationEpsilon, double);
+    vtkSetClampMacro(MaxNumberOfLeavesVisited, int, 0, VTK_INT_MAX);
+    vtkGetMacro(MaxNumberOfLeavesVisited, int);
+    ///@}
+
     /**
      * Given a position x, return the id of the point closest to it. Alternative
      * method requires separate x-y-z values.
@@ -38,6 +142,16 @@ public:
      */
     void FindClosestNPoints(int N, const double x[3], vtkIdList *result) override;
 
+    ///@{
+    /**
+     * Same as FindClosestPoint() and FindClosestNPoints() with the approximate
+     * mode settings, also reporting the number of leaves actually visited so
+     * that MaxNumberOfLeavesVisited can be tuned.
+     */
+    vtkIdType FindClosestPoint(const double x[3], double &dist2, int *leavesVisited);
+    void FindClosestNPoints(int N, const double x[3], vtkIdList *result, int *leavesVisited);
+    ///@}
+
     /**
      * Find all points within a specified radius R of position x.
      * The result is not sorted in any specific manner.
@@ -50,6 +164,185 @@ public:
 
     void FindPointsWithinCuboid(double cuboid[8][3], vtkIdList *result);
 
+    /**
+     * Find all points inside a convex polytope given as the intersection of
+     * numPlanes half-spaces, e.g. a camera frustum or a convex selection
+     * lasso. Each plane is (nx, ny, nz, d) with the normal pointing outward,
+     * so a point x is inside when n.x + d <= 0 for every plane (the vtkPlanes
+     * convention); normals need not be normalized. Tree nodes are classified
+     * against the planes and subtrees completely inside are emitted in bulk.
+     * The result is not sorted.
+     */
+    void FindPointsWithinConvexPolytope(const double *planes, int numPlanes, vtkIdList *result);
+
+    /**
+     * Find all points within an infinite cylinder given by a point on its axis,
+     * the axis direction (need not be normalized) and a radius. The kd-tree is
+     * pruned by the distance between each node box and the axis, and every
+     * candidate point is tested exactly once. The result is not sorted.
+     */
+    void FindPointsWithinCylinder(const double point[3], const double direction[3], double radius, vtkIdList *result);
+
+    /**
+     * Find all points within the capsule swept by a sphere of the given radius
+     * moving from p0 to p1. The result is not sorted.
+     */
+    void FindPointsWithinCapsule(const double p0[3], const double p1[3], double radius, vtkIdList *result);
+
+    /**
+     * Find all points within distance radius of a polyline given as numPoints
+     * consecutive (x, y, z) vertices, i.e. inside the tube swept by a sphere
+     * moving along a multi-segment path. The segments are organized in a small
+     * bounding volume hierarchy and the tree is traversed once against the
+     * whole path, so every point is reported once however many segments it is
+     * close to. A single vertex degenerates to a sphere. The result is not
+     * sorted.
+     *
+     * When segmentIds or parameters is given, it receives for every returned
+     * point the closest segment (segment i joins vertices i and i + 1) and the
+     * parameter in [0, 1] of the closest approach along that segment, in the
+     * order of result.
+     */
+    void FindPointsWithinTube(const double *points, int numPoints, double radius, vtkIdList *result,
+                              vtkIdTypeArray *segmentIds = nullptr, vtkDoubleArray *parameters = nullptr);
+
+    ///@{
+    /**
+     * Count the points inside a region without building an id list. Subtrees
+     * that lie completely inside the region only add their size.
+     */
+    vtkIdType CountPointsWithinRadius(double R, const double x[3]);
+    vtkIdType CountPointsWithinArea(double *area);
+    vtkIdType CountPointsWithinCuboid(double cuboid[8][3]);
+    vtkIdType CountPointsWithinConvexPolytope(const double *planes, int numPlanes);
+    vtkIdType CountPointsWithinCylinder(const double point[3], const double direction[3], double radius);
+    vtkIdType CountPointsWithinCapsule(const double p0[3], const double p1[3], double radius);
+    vtkIdType CountPointsWithinTube(const double *points, int numPoints, double radius);
+    ///@}
+
+    ///@{
+    /**
+     * Call f(id) for every point inside a region. The ids are streamed
+     * straight from the tree leaves without an intermediate list and are not
+     * sorted. f may run further queries on this locator.
+     */
+    template <typename F>
+    void ForEachPointWithinRadius(double R, const double x[3], F &&f);
+    template <typename F>
+    void ForEachPointWithinArea(double *area, F &&f);
+    template <typename F>
+    void ForEachPointWithinCuboid(double cuboid[8][3], F &&f);
+    template <typename F>
+    void ForEachPointWithinConvexPolytope(const double *planes, int numPlanes, F &&f);
+    template <typename F>
+    void ForEachPointWithinCylinder(const double point[3], const double direction[3], double radius, F &&f);
+    template <typename F>
+    void ForEachPointWithinCapsule(const double p0[3], const double p1[3], double radius, F &&f);
+    template <typename F>
+    void ForEachPointWithinTube(const double *points, int numPoints, double radius, F &&f);
+    ///@}
+
+    ///@{
+    /**
+     * Region queries for any shape that provides Classify(bounds) and
+     * Contains(point), see QueryShapes.h. VisitPointsInShape passes the ids in
+     * runs as visitor(const vtkIdType *ids, vtkIdType n); a subtree that lies
+     * completely inside the shape is passed as a single run.
+     */
+    template <typename Shape, typename Visitor>
+    void VisitPointsInShape(const Shape &shape, Visitor &&visitor);
+    template <typename Shape, typename F>
+    void ForEachPointInShape(const Shape &shape, F &&f);
+    template <typename Shape>
+    vtkIdType CountPointsInShape(const Shape &shape);
+    ///@}
+
+    ///@{
+    /**
+     * Summary statistics of the points inside a region: point count,
+     * centroid, covariance and the sum of the point normals of the dataset
+     * (zero if it has none), see AUtils::PointStatistics. Returns the number
+     * of points.
+     *
+     * With TreeType VTK_KD_TREE every tree node stores the statistics of its
+     * subtree at build time, so a subtree that lies completely inside the
+     * region is merged in O(1) and only the leaves crossing the region
+     * boundary are scanned point by point. The other tree types visit every
+     * point of the region. The normals are those of the dataset at build time
+     * or at the last UpdatePointNormals().
+     */
+    vtkIdType ComputeStatisticsWithinRadius(double R, const double x[3], AUtils::PointStatistics &stats);
+    vtkIdType ComputeStatisticsWithinArea(double *area, AUtils::PointStatistics &stats);
+    vtkIdType ComputeStatisticsWithinCuboid(double cuboid[8][3], AUtils::PointStatistics &stats);
+    vtkIdType ComputeStatisticsWithinConvexPolytope(const double *planes, int numPlanes,
+                                                    AUtils::PointStatistics &stats);
+    vtkIdType ComputeStatisticsWithinCylinder(const double point[3], const double direction[3], double radius,
+                                              AUtils::PointStatistics &stats);
+    vtkIdType ComputeStatisticsWithinCapsule(const double p0[3], const double p1[3], double radius,
+                                             AUtils::PointStatistics &stats);
+    template <typename Shape>
+    vtkIdType ComputeStatisticsInShape(const Shape &shape, AUtils::PointStatistics &stats);
+    ///@}
+
+    /**
+     * Refresh the normal sums stored in the VTK_KD_TREE node statistics from
+     * the current point normals of the dataset, without rebuilding the tree.
+     * Use it after the normals were written in place, e.g. when they are
+     * computed with the locator itself. If a snapshot still shares the tree
+     * it is rebuilt instead. No-op for the other tree types.
+     */
+    void UpdatePointNormals();
+
+    ///@{
+    /**
+     * Batched queries. The positions x are given as numQueries consecutive
+     * (x, y, z) triples. BuildLocator() is called once per batch, the queries
+     * run in parallel with vtkSMPTools and reuse per-thread scratch lists, so
+     * there is no allocation per query.
+     *
+     * FindClosestPointsBatch writes one id per query into ids (-1 if none) and
+     * optionally the squared distance into dist2.
+     *
+     * FindClosestNPointsBatch and FindPointsWithinRadiusBatch return the
+     * results in a flat CSR layout: the ids of query i are
+     * ids[offsets[i]] ... ids[offsets[i+1]-1] (offsets has numQueries+1
+     * values). If dist2 is given it receives the squared distance of each
+     * returned id. N-nearest results are sorted from closest to farthest,
+     * radius results are not sorted.
+     *
+     * These methods are thread safe in the same sense as the single queries.
+     */
+    void FindClosestPointsBatch(vtkIdType numQueries, const double *x, vtkIdTypeArray *ids,
+                                vtkDoubleArray *dist2 = nullptr);
+    void FindClosestNPointsBatch(vtkIdType numQueries, int N, const double *x, vtkIdTypeArray *offsets,
+                                 vtkIdTypeArray *ids, vtkDoubleArray *dist2 = nullptr);
+    void FindPointsWithinRadiusBatch(vtkIdType numQueries, double R, const double *x, vtkIdTypeArray *offsets,
+                                     vtkIdTypeArray *ids, vtkDoubleArray *dist2 = nullptr);
+    ///@}
+
+    ///@{
+    /**
+     * Joins between the points of this locator and the points of other.
+     * Both locators are built if needed.
+     *
+     * FindPairsWithinRadius returns every pair (i, j) of a point i of this
+     * dataset and a point j of other with distance <= R, as 2-component
+     * tuples sorted by i and then j. FindClosestPointsInLocator returns for
+     * each point of this dataset the id of the closest point of other, or -1
+     * if it is farther than maxDistance. If dist2 is given it receives the
+     * squared distance of each pair or closest point (VTK_DOUBLE_MAX for -1).
+     *
+     * When both TreeTypes are VTK_KD_TREE the join walks both trees at once
+     * (see AvtkKdTree::FindPairsWithinRadius) and is always exact. Otherwise
+     * the points of this dataset are used as the positions of the batched
+     * queries of other, so the approximate settings of other apply.
+     */
+    void FindPairsWithinRadius(AvtkKdTreePointLocator *other, double R, vtkIdTypeArray *pairs,
+                               vtkDoubleArray *dist2 = nullptr);
+    void FindClosestPointsInLocator(AvtkKdTreePointLocator *other, vtkIdTypeArray *ids,
+                                    vtkDoubleArray *dist2 = nullptr, double maxDistance = VTK_DOUBLE_MAX);
+    ///@}
+
     ///@{
     /**
      * See vtkLocator interface documentation.
@@ -61,17 +354,345 @@ public:
     void GenerateRepresentation(int level, vtkPolyData *pd) override;
     ///@}
 
+    ///@{
+    /**
+     * Persist the built tree so that a later process can skip the build.
+     * Save() builds the locator if needed and writes the flat kd-tree to a
+     * versioned binary file. Load() memory-maps such a file and queries it in
+     * place, without reading or converting the arrays, and switches TreeType
+     * to FLAT_KD_TREE whatever it was before (GetKdTree() then returns
+     * nullptr).
+     *
+     * Only TreeType FLAT_KD_TREE can be saved. The vtkKdTree node hierarchy
+     * behind VTK_KD_TREE, the incremental forest and the uniform grid have no
+     * file format; Save() with any of them reports an error naming the tree
+     * type and returns false without building. Select FLAT_KD_TREE for
+     * locators that should be cached.
+     *
+     * The file is keyed by a checksum of the dataset point coordinates
+     * together with NumberOfPointsPerLeaf and SinglePrecision, so a file
+     * written for other points or settings is rejected as stale. (MTime
+     * cannot be used for this since it does not survive the process.)
+     * Load() returns false if the file is missing, stale, written by an
+     * incompatible version or platform, or truncated; the locator is left
+     * unchanged and will build as usual. With verifyChecksum the tree arrays
+     * are checked as well, which reads the whole file.
+     *
+     * Checksumming the coordinates reads every point. When the caller already
+     * knows where the points came from, SaveWithSourceKey() and
+     * LoadWithSourceKey() use its sourceKey in place of the coordinates (the
+     * settings above are still part of the key), e.g. AUtils::GetFileKey() of
+     * the file the points were read from. The caller is then responsible for
+     * changing the sourceKey whenever the points change.
+     */
+    bool Save(const char *path);
+    bool Load(const char *path, bool verifyChecksum = false);
+    bool SaveWithSourceKey(const char *path, vtkTypeUInt64 sourceKey);
+    bool LoadWithSourceKey(const char *path, vtkTypeUInt64 sourceKey, bool verifyChecksum = false);
+    ///@}
+
+    ///@{
+    /**
+     * Frozen read path for concurrent queries. Every query above first calls
+     * BuildLocator(), which compares modification times and may rebuild, so
+     * those queries are only safe from several threads while nothing modifies
+     * the locator or its dataset. Freeze() builds the locator if needed and
+     * returns an immutable snapshot of the current search structure (see
+     * AvtkPointLocatorSnapshot) whose queries never rebuild and are safe from
+     * any number of threads.
+     *
+     * After the first Freeze(), every rebuild (ForceBuildLocator(), a
+     * rebuild triggered by a query, Load()) publishes a new snapshot; readers
+     * that still hold the previous one finish on it undisturbed. Incremental
+     * edits of an INCREMENTAL_KD_TREE (appended points, RemovePoint(),
+     * RestorePoint()) are applied to a copy-on-write copy of the shared tree
+     * and published by the next Freeze(), so a batch of edits costs one copy.
+     *
+     * GetSnapshot() returns the latest published snapshot, or nullptr before
+     * the first Freeze(); it only takes a short lock and may be called from
+     * any thread, also while another thread modifies and rebuilds the
+     * locator. Freeze() itself is not thread safe, like BuildLocator().
+     */
+    vtkSmartPointer<AvtkPointLocatorSnapshot> Freeze();
+    vtkSmartPointer<AvtkPointLocatorSnapshot> GetSnapshot();
+    ///@}
+
     AvtkKdTree *GetKdTree();
 
+    AvtkFlatKdTree *GetFlatKdTree();
+
+    AvtkIncrementalKdTree *GetIncrementalKdTree();
+
+    AvtkUniformGrid *GetUniformGrid();
+
+    ///@{
+    /**
+     * Incremental updates, only available when TreeType is INCREMENTAL_KD_TREE.
+     *
+     * When the dataset is modified, BuildLocator() does not rebuild the
+     * incremental tree; it only inserts the points appended to the dataset
+     * since the last build, so streaming appends cost O(log n) amortized per
+     * point. Appends are recognized by the point count alone: the tree is
+     * rebuilt if the point array was replaced (vtkPoints::SetData() or
+     * vtkPointSet::SetPoints()), if the number of points decreased, or if
+     * the points were modified (vtkPoints::Modified()) without any being
+     * appended. Moving already indexed points in place together with
+     * appending new ones is not detected; call ForceBuildLocator() or
+     * Modified() on the locator after such an edit.
+     *
+     * RemovePoint() hides the point with the given id from all queries while
+     * it stays in the dataset; RestorePoint() inserts it again from the
+     * dataset coordinates. Both return false if nothing changed. Hidden
+     * points stay hidden when the tree is rebuilt from the same dataset,
+     * unless their id is no longer a valid point id; SetDataSet() with
+     * another dataset restores all of them.
+     */
+    bool RemovePoint(vtkIdType id);
+    bool RestorePoint(vtkIdType id);
+    ///@}
+
 protected:
     AvtkKdTreePointLocator();
     ~AvtkKdTreePointLocator() override;
 
     void BuildLocatorInternal() override;
 
+    /**
+     * Insert the points appended to the dataset since the last build into
+     * the incremental tree.
+     */
+    void UpdateIncrementalKdTree();
+
+    /**
+     * True if the dataset still uses the indexed point array and it either
+     * grew or was not modified since the last build.
+     */
+    bool OnlyPointsAppended();
+
+    /**
+     * Point normals of the dataset, or nullptr if it has none.
+     */
+    vtkDataArray *GetPointNormals();
+
+    /**
+     * Publish a snapshot of the current search structure for GetSnapshot().
+     */
+    void PublishSnapshot();
+
+    /**
+     * Before an in-place edit of the incremental tree, replace it with a
+     * shallow copy if a snapshot still shares it.
+     */
+    void DetachIncrementalKdTree();
+
+    /**
+     * Key identifying the tree built from the current dataset and settings,
+     * see Save() and Load(). ComputeTreeSettingsKey() covers the settings
+     * only and seeds both ComputeTreeFileKey() and the sourceKey keys.
+     */
+    vtkTypeUInt64 ComputeTreeFileKey();
+    vtkTypeUInt64 ComputeTreeSettingsKey();
+
+    /**
+     * Map the file written by Save() if its key matches.
+     */
+    bool LoadTreeFile(const char *path, vtkTypeUInt64 key, bool verifyChecksum);
+
+    /**
+     * Shared by Save() and SaveWithSourceKey(); the key is built from
+     * sourceKey when useSourceKey is set, from the coordinates otherwise.
+     */
+    bool SaveTreeFile(const char *path, bool useSourceKey, vtkTypeUInt64 sourceKey);
+
+    /**
+     * Call f with the search structure that was built: the incremental tree,
+     * the flat tree, the uniform grid or the vtkKdTree. Returns false without
+     * calling f if the last build failed, e.g. because the dataset is missing
+     * or has no points; callers then report an empty result.
+     */
+    template <typename F>
+    bool DispatchSearchStructure(F &&f);
+
+    bool IsApproximate() const
+    {
+        return this->ApproximationEpsilon > 0.0 || this->MaxNumberOfLeavesVisited > 0;
+    }
+
+    /**
+     * Fill dist2 with the squared distance between each query position and
+     * the ids listed for it in the CSR result.
+     */
+    void ComputeBatchDistances(vtkIdType numQueries, const double *x, vtkIdTypeArray *offsets,
+                               vtkIdTypeArray *ids, vtkDoubleArray *dist2);
+
     AvtkKdTree *KdTree;
+    AvtkFlatKdTree *FlatKdTree;
+    AvtkIncrementalKdTree *IncrementalKdTree;
+    AvtkUniformGrid *UniformGrid;
+    vtkIdType NumberOfIndexedPoints;
+    vtkWeakPointer<vtkDataArray> IndexedPointData;
+    vtkMTimeType IndexedPointsMTime;
+    std::set<vtkIdType> RemovedPointIds;
+    vtkWeakPointer<vtkDataSet> RemovedPointsDataSet;
+    double ApproximationEpsilon;
+    int MaxNumberOfLeavesVisited;
+    int TreeType;
+    int NumberOfPointsPerLeaf;
+    double GridCellSize;
+    vtkTypeBool ParallelBuild;
+    vtkTypeBool SinglePrecision;
+    double BuildElapsedTime;
+    vtkSmartPointer<AvtkPointLocatorSnapshot> Snapshot;
+    std::mutex SnapshotMutex;
 
 private:
     AvtkKdTreePointLocator(const AvtkKdTreePointLocator &) = delete;
     void operator=(const AvtkKdTreePointLocator &) = delete;
-};
\ No newline at end of file
+};
+
+template <typename F>
+bool AvtkKdTreePointLocator::DispatchSearchStructure(F &&f)
+{
+    if (this->IncrementalKdTree)
+    {
+        f(this->IncrementalKdTree);
+        return true;
+    }
+    if (this->FlatKdTree)
+    {
+        f(this->FlatKdTree);
+        return true;
+    }
+    if (this->UniformGrid)
+    {
+        f(this->UniformGrid);
+        return true;
+    }
+    if (this->KdTree)
+    {
+        f(this->KdTree);
+        return true;
+    }
+    return false;
+}
+
+template <typename Shape, typename Visitor>
+void AvtkKdTreePointLocator::VisitPointsInShape(const Shape &shape, Visitor &&visitor)
+{
+    this->BuildLocator();
+    this->DispatchSearchStructure([&](auto *tree)
+                                  { tree->VisitPointsInShape(shape, visitor); });
+}
+
+template <typename Shape, typename F>
+void AvtkKdTreePointLocator::ForEachPointInShape(const Shape &shape, F &&f)
+{
+    this->VisitPointsInShape(shape, [&f](const vtkIdType *ids, vtkIdType n)
+                             {
+                                 for (vtkIdType i = 0; i < n; ++i)
+                                     f(ids[i]);
+                             });
+}
+
+template <typename Shape>
+vtkIdType AvtkKdTreePointLocator::CountPointsInShape(const Shape &shape)
+{
+    vtkIdType count = 0;
+    this->VisitPointsInShape(shape, [&count](const vtkIdType *, vtkIdType n)
+                             { count += n; });
+    return count;
+}
+
+template <typename Shape>
+vtkIdType AvtkKdTreePointLocator::ComputeStatisticsInShape(const Shape &shape, AUtils::PointStatistics &stats)
+{
+    stats = AUtils::PointStatistics();
+    this->BuildLocator();
+    if (this->KdTree)
+    {
+        this->KdTree->ComputeStatisticsInShape(shape, stats);
+        return stats.Count;
+    }
+
+    // the other structures visit every point, accumulated around the center of the bounds
+    double center[3];
+    for (int k = 0; k < 3; ++k)
+        center[k] = 0.5 * (this->Bounds[2 * k] + this->Bounds[2 * k + 1]);
+    AUtils::PointStatisticsAccumulator sums;
+    sums.Init(center);
+    vtkDataArray *normals = this->GetPointNormals();
+    this->ForEachPointInShape(shape, [&](vtkIdType id)
+                              {
+                                  double p[3];
+                                  this->DataSet->GetPoint(id, p);
+                                  sums.AddPoint(p);
+                                  if (normals)
+                                  {
+                                      double n[3];
+                                      normals->GetTuple(id, n);
+                                      sums.AddNormal(n);
+                                  }
+                              });
+    sums.AddTo(stats);
+    return stats.Count;
+}
+
+template <typename F>
+void AvtkKdTreePointLocator::ForEachPointWithinRadius(double R, const double x[3], F &&f)
+{
+    AUtils::SphereShape sphere;
+    sphere.Init(x, R);
+    this->ForEachPointInShape(sphere, f);
+}
+
+template <typename F>
+void AvtkKdTreePointLocator::ForEachPointWithinArea(double *area, F &&f)
+{
+    AUtils::AreaShape areaShape;
+    areaShape.Init(area);
+    this->ForEachPointInShape(areaShape, f);
+}
+
+template <typename F>
+void AvtkKdTreePointLocator::ForEachPointWithinCuboid(double cuboid[8][3], F &&f)
+{
+    AUtils::CuboidShape cuboidShape;
+    cuboidShape.Init(cuboid);
+    this->ForEachPointInShape(cuboidShape, f);
+}
+
+template <typename F>
+void AvtkKdTreePointLocator::ForEachPointWithinConvexPolytope(const double *planes, int numPlanes, F &&f)
+{
+    AUtils::ConvexPolytopeShape polytope;
+    polytope.Init(planes, numPlanes);
+    this->ForEachPointInShape(polytope, f);
+}
+
+template <typename F>
+void AvtkKdTreePointLocator::ForEachPointWithinCylinder(const double point[3], const double direction[3], double radius, F &&f)
+{
+    AUtils::CylinderShape cylinder;
+    if (!cylinder.InitCylinder(point, direction, radius))
+    {
+        vtkErrorMacro(<< "ForEachPointWithinCylinder - direction vector is zero");
+        return;
+    }
+    this->ForEachPointInShape(cylinder, f);
+}
+
+template <typename F>
+void AvtkKdTreePointLocator::ForEachPointWithinCapsule(const double p0[3], const double p1[3], double radius, F &&f)
+{
+    AUtils::CylinderShape capsule;
+    capsule.InitCapsule(p0, p1, radius);
+    this->ForEachPointInShape(capsule, f);
+}
+
+template <typename F>
+void AvtkKdTreePointLocator::ForEachPointWithinTube(const double *points, int numPoints, double radius, F &&f)
+{
+    AUtils::TubeShape tube;
+    tube.Init(points, numPoints, radius);
+    this->ForEachPointInShape(tube, f);
+}
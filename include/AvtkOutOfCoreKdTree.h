@@ -0,0 +1,385 @@
+#pragma once
+
+#include <vtkObject.h>
+#include <vtkIdList.h>
+#include <vtkPoints.h>
+#include <vtkSmartPointer.h>
+#include <atomic>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+#include "AvtkFlatKdTree.h"
+#include "QueryShapes.h"
+
+/**
+ * 外存KD树，用于无法整体放入内存的点云（数十亿点）。
+ *
+ * 顶层树常驻内存，每个叶子对应磁盘上的一个页面。页面是一棵以 AvtkFlatKdTree::Save 格式保存的KD树，
+ * 查询时按需内存映射加载，已加载的页面按最近最少使用（LRU）的顺序保留，总大小不超过 PageCacheSize。
+ *
+ * 构建分为 BeginBuild、若干次 AddPoints 与 EndBuild，点按块流式传入，任何时候都不持有整个点云：
+ * 点先追加到临时文件，同时保留固定大小的随机样本；EndBuild 由样本确定顶层树的划分，
+ * 再顺序读取临时文件，统计各页面的点数（超限的页面再次划分后重新统计）并按页面写回，最后逐页构建并保存。
+ * 构建时的内存约为样本、各页面的写缓冲与单个页面之和。点id为点传入的顺序，从0开始。
+ *
+ * 文件由 path 指定：path 为顶层树的索引文件，页面为 path.page<i>，构建过程中的临时文件为 path.*.tmp。
+ * 重新构建时页面先写为临时文件，索引文件替换成功后才替换页面并删除多出的旧页面，构建失败不会破坏已有的树。
+ * 所有查询函数均为只读，可以在多个线程中同时调用，页面缓存内部加锁；查询期间使用的页面不会被释放。
+ */
+class AvtkOutOfCoreKdTree : public vtkObject
+{
+public:
+    vtkTypeMacro(AvtkOutOfCoreKdTree, vtkObject);
+    static AvtkOutOfCoreKdTree *New();
+    void PrintSelf(ostream &os, vtkIndent indent) override;
+
+    /**
+     * 每个页面的目标点数，构建前设置。页面的实际点数由样本估计，可能略有偏差；
+     * 统计后超过两倍的页面由其自身的点再次抽样划分，除非点全部重合，页面点数不会超过两倍。
+     */
+    vtkSetClampMacro(NumberOfPointsPerPage, vtkIdType, 1, VTK_ID_MAX);
+    vtkGetMacro(NumberOfPointsPerPage, vtkIdType);
+
+    /**
+     * 页面内每个叶子最多包含的点数，见 AvtkFlatKdTree::SetNumberOfPointsPerLeaf。
+     */
+    vtkSetClampMacro(NumberOfPointsPerLeaf, int, 1, 1 << 20);
+    vtkGetMacro(NumberOfPointsPerLeaf, int);
+
+    /**
+     * 确定顶层树划分所用的随机样本的点数，构建前设置。
+     */
+    vtkSetClampMacro(SampleSize, vtkIdType, 1, VTK_ID_MAX);
+    vtkGetMacro(SampleSize, vtkIdType);
+
+    /**
+     * 页面是否以单精度存储坐标，见 AvtkFlatKdTree::SetSinglePrecision。
+     */
+    vtkSetMacro(SinglePrecision, vtkTypeBool);
+    vtkGetMacro(SinglePrecision, vtkTypeBool);
+    vtkBooleanMacro(SinglePrecision, vtkTypeBool);
+
+    /**
+     * 已加载页面的总大小上限（KiB），超出时释放最久未使用的页面，至少保留一个页面。
+     */
+    vtkSetMacro(PageCacheSize, unsigned long);
+    vtkGetMacro(PageCacheSize, unsigned long);
+
+    /**
+     * 构建时各页面写缓冲的总大小（KiB），写回临时文件时每个页面的缓冲写满后写入一次。
+     */
+    vtkSetClampMacro(BuildBufferSize, unsigned long, 1, VTK_UNSIGNED_LONG_MAX);
+    vtkGetMacro(BuildBufferSize, unsigned long);
+
+    /**
+     * 开始构建，关闭已打开的树并创建临时文件。
+     * @param path 索引文件的路径，页面与临时文件位于同一目录。
+     * @return 无法创建临时文件时返回false。
+     */
+    bool BeginBuild(const char *path);
+
+    /**
+     * 追加一块点，点id按追加顺序连续编号。
+     * @param coords numPoints 个连续的 (x, y, z)。
+     * @return 不在构建过程中或写入失败时返回false。
+     */
+    bool AddPoints(const double *coords, vtkIdType numPoints);
+    bool AddPoints(vtkPoints *points);
+
+    /**
+     * 完成构建：划分页面、写入页面与索引文件并删除临时文件，之后可以直接查询。
+     * @return 没有点或写入失败时返回false，此时树为空，path 处已有的树保持不变。
+     */
+    bool EndBuild();
+
+    /**
+     * 打开 EndBuild 写入的树，只读取索引文件，页面在查询时加载。
+     * @return 索引文件不存在、格式不兼容或损坏时返回false，此时树为空。
+     */
+    bool Open(const char *path);
+
+    /**
+     * 关闭树并释放所有页面，中止未完成的构建。
+     */
+    void Close();
+
+    vtkIdType GetNumberOfPoints() const { return this->NumberOfPoints; }
+
+    int GetNumberOfPages() const { return static_cast<int>(this->PageCounts.size()); }
+
+    vtkIdType GetNumberOfPointsInPage(int page) const { return this->PageCounts[page]; }
+
+    /**
+     * 所有点的包围盒。
+     */
+    void GetBounds(double bounds[6]) const;
+
+    /**
+     * 当前已加载的页面数与总大小（KiB）。
+     */
+    int GetNumberOfResidentPages() const;
+    unsigned long GetResidentMemorySize() const;
+
+    /**
+     * 打开或构建以来从磁盘加载页面的次数，用于观察页面缓存的命中情况。
+     */
+    vtkIdType GetNumberOfPageLoads() const { return this->NumberOfPageLoads; }
+
+    /**
+     * 释放所有已加载的页面。
+     */
+    void ReleasePages();
+
+    /**
+     * 查找距离x最近的点。按顶层节点包围盒到x的距离从近到远访问页面，
+     * 包围盒距离超过当前最近距离的页面不会加载。
+     * @return 最近点的id，树为空时返回-1。
+     */
+    vtkIdType FindClosestPoint(const double x[3], double &dist2) const;
+
+    /**
+     * 查找半径radius内距离x最近的点，半径内没有点时返回-1，dist2 为 VTK_DOUBLE_MAX。
+     * 包围盒到x的距离超过半径的页面不会加载。
+     */
+    vtkIdType FindClosestPointWithinRadius(double radius, const double x[3], double &dist2) const;
+
+    /**
+     * 查找距离x最近的N个点，结果按距离从近到远排序。
+     */
+    void FindClosestNPoints(int N, const double x[3], vtkIdList *result) const;
+
+    /**
+     * 在已有的最大堆上继续最近N点搜索，用于在多棵树之间合并结果。
+     * @param heap 按 (距离平方, id) 排列的最大堆，大小不超过N。
+     */
+    void SearchClosestPoints(const double x[3], size_t N, std::vector<std::pair<double, vtkIdType>> &heap) const;
+
+    /**
+     * 查找半径R内的所有点，结果不排序。
+     */
+    void FindPointsWithinRadius(double R, const double x[3], vtkIdList *result) const;
+
+    void FindPointsInArea(const double area[6], vtkIdList *ids) const;
+
+    void FindPointsInCuboid(const double cuboid[8][3], vtkIdList *ids) const;
+
+    /**
+     * 遍历形状内的所有点，点id按段以 visitor(const vtkIdType *ids, vtkIdType n) 的形式传出。
+     * 只加载包围盒与形状相交的页面，ids 在 visitor 返回前有效。
+     * @param shape 查询形状，需提供 Classify(bounds) 与 Contains(point)，见 QueryShapes.h。
+     */
+    template <typename Shape, typename Visitor>
+    void VisitPointsInShape(const Shape &shape, Visitor &&visitor) const;
+
+    /**
+     * 对形状内的每个点调用 f(id)。
+     */
+    template <typename Shape, typename F>
+    void ForEachPointInShape(const Shape &shape, F &&f) const;
+
+    /**
+     * 统计形状内的点数，完全位于形状内部的页面只累加点数，不加载。
+     */
+    template <typename Shape>
+    vtkIdType CountPointsInShape(const Shape &shape) const;
+
+protected:
+    AvtkOutOfCoreKdTree() = default;
+    ~AvtkOutOfCoreKdTree() override;
+
+    /**
+     * 顶层树的节点。内部节点按 SplitDim 上的坐标是否小于 SplitValue 划分到左右子节点，
+     * 叶子对应一个页面。Bounds 为子树内点的紧包围盒。
+     */
+    struct TopNode
+    {
+        double Bounds[6];
+        double SplitValue;
+        vtkTypeInt32 SplitDim;
+        vtkTypeInt32 Left;  // 叶子为-1
+        vtkTypeInt32 Right; // 叶子为-1
+        vtkTypeInt32 Page;  // 内部节点为-1
+    };
+
+    /**
+     * 由样本中 [begin, end) 的点递归划分顶层节点，每个样本点代表 pointsPerSample 个实际点。
+     * @return 节点下标。
+     */
+    vtkTypeInt32 BuildTopNode(vtkIdType begin, vtkIdType end, std::vector<vtkIdType> &order, double pointsPerSample);
+
+    /**
+     * 读取临时点文件，统计各页面的点数与紧包围盒（每个页面6个分量）。
+     */
+    bool CountPages(std::vector<double> &pageBounds);
+
+    /**
+     * 点数超过 NumberOfPointsPerPage 两倍的页面，由该页面的点重新抽样并划分为子树。
+     * @param split 返回是否有页面被划分，划分后页面重新编号，点数需要重新统计。
+     * @return 读取临时文件失败时返回false。
+     */
+    bool SplitOversizedPages(const std::vector<double> &pageBounds, bool &split);
+
+    /**
+     * 按深度优先顺序重新存放顶层节点并为页面编号。
+     */
+    void RenumberPages();
+
+    /**
+     * 点所在的页面。
+     */
+    vtkTypeInt32 RoutePoint(const double p[3]) const;
+
+    /**
+     * 由叶子的包围盒自底向上合并内部节点的包围盒。
+     */
+    void UpdateNodeBounds(vtkTypeInt32 node);
+
+    /**
+     * 按顺序读取临时点文件，以 (coords, firstId, n) 的形式传出每块点。
+     */
+    template <typename F>
+    bool ReadSpillFile(F &&f);
+
+    /**
+     * 构建各页面并保存为 path.page<i>.tmp，然后写入索引文件，由 EndBuild 在索引写入成功后替换页面。
+     */
+    bool WritePages();
+    bool WriteIndex();
+
+    std::string GetPagePath(int page) const;
+
+    /**
+     * 页面对应的树，未加载时从磁盘加载，并按 PageCacheSize 释放最久未使用的页面。
+     * @return 页面为空或加载失败时返回空指针。
+     */
+    vtkSmartPointer<AvtkFlatKdTree> GetPage(int page) const;
+
+    /**
+     * 释放最久未使用的页面，直到总大小不超过上限，keep 不会被释放。调用方持有 CacheMutex。
+     */
+    void EvictPages(int keep) const;
+
+    /**
+     * 页面保存时使用的key，用于识别不属于本索引的页面文件。
+     */
+    vtkTypeUInt64 GetPageKey(int page) const;
+
+    /**
+     * 递归遍历顶层节点，对与形状相交的页面调用 AvtkFlatKdTree::VisitPointsInShape。
+     */
+    template <typename Shape, typename Visitor>
+    void VisitPointsInShape(vtkTypeInt32 node, const Shape &shape, Visitor &visitor) const;
+
+    template <typename Shape>
+    void FindPointsInShape(const Shape &shape, vtkIdList *ids) const;
+
+    template <typename Shape>
+    void CountPointsInShape(vtkTypeInt32 node, const Shape &shape, vtkIdType &count) const;
+
+    vtkIdType NumberOfPointsPerPage = 1 << 20;
+    int NumberOfPointsPerLeaf = 16;
+    vtkIdType SampleSize = 1 << 20;
+    vtkTypeBool SinglePrecision = 0;
+    unsigned long PageCacheSize = 1 << 20;  // 1 GiB
+    unsigned long BuildBufferSize = 1 << 18; // 256 MiB
+
+    std::string Path;                     // 索引文件路径
+    vtkTypeUInt64 Key = 0;                // 本次构建的标识，写入索引并用于各页面
+    vtkIdType NumberOfPoints = 0;
+    std::vector<TopNode> Nodes;           // 顶层树，根节点为0
+    std::vector<vtkIdType> PageCounts;    // 各页面的点数
+    std::vector<vtkTypeUInt64> PageSizes; // 各页面文件的字节数
+
+    // 构建过程中的状态
+    bool Building = false;
+    std::ofstream SpillFile;              // 按传入顺序保存所有点坐标的临时文件
+    std::vector<double> Sample;           // 蓄水池抽样得到的点坐标
+    std::mt19937_64 SampleGenerator;
+
+    // 页面缓存，按最近使用的顺序排列，表头为最近使用
+    mutable std::mutex CacheMutex;
+    mutable std::vector<vtkSmartPointer<AvtkFlatKdTree>> ResidentPages;
+    mutable std::list<int> PageUsage;
+    mutable std::vector<std::list<int>::iterator> PageUsagePositions;
+    mutable vtkTypeUInt64 ResidentSize = 0;
+    mutable std::atomic<vtkIdType> NumberOfPageLoads{0};
+
+private:
+    AvtkOutOfCoreKdTree(const AvtkOutOfCoreKdTree &) = delete;
+    void operator=(const AvtkOutOfCoreKdTree &) = delete;
+};
+
+template <typename Shape, typename Visitor>
+void AvtkOutOfCoreKdTree::VisitPointsInShape(vtkTypeInt32 node, const Shape &shape, Visitor &visitor) const
+{
+    const TopNode &topNode = this->Nodes[node];
+    if (shape.Classify(topNode.Bounds) == AUtils::BoxRelation::Outside)
+        return;
+
+    if (topNode.Page >= 0)
+    {
+        // 页面在遍历期间由局部引用保持加载
+        vtkSmartPointer<AvtkFlatKdTree> page = this->GetPage(topNode.Page);
+        if (page)
+            page->VisitPointsInShape(shape, visitor);
+        return;
+    }
+
+    this->VisitPointsInShape(topNode.Left, shape, visitor);
+    this->VisitPointsInShape(topNode.Right, shape, visitor);
+}
+
+template <typename Shape, typename Visitor>
+void AvtkOutOfCoreKdTree::VisitPointsInShape(const Shape &shape, Visitor &&visitor) const
+{
+    if (this->Nodes.empty())
+        return;
+    this->VisitPointsInShape(0, shape, visitor);
+}
+
+template <typename Shape, typename F>
+void AvtkOutOfCoreKdTree::ForEachPointInShape(const Shape &shape, F &&f) const
+{
+    this->VisitPointsInShape(shape, [&f](const vtkIdType *ids, vtkIdType n)
+                             {
+                                 for (vtkIdType i = 0; i < n; ++i)
+                                     f(ids[i]);
+                             });
+}
+
+template <typename Shape>
+void AvtkOutOfCoreKdTree::CountPointsInShape(vtkTypeInt32 node, const Shape &shape, vtkIdType &count) const
+{
+    const TopNode &topNode = this->Nodes[node];
+    AUtils::BoxRelation relation = shape.Classify(topNode.Bounds);
+    if (relation == AUtils::BoxRelation::Outside)
+        return;
+
+    if (topNode.Page >= 0)
+    {
+        if (relation == AUtils::BoxRelation::Inside)
+        {
+            count += this->PageCounts[topNode.Page];
+            return;
+        }
+        vtkSmartPointer<AvtkFlatKdTree> page = this->GetPage(topNode.Page);
+        if (page)
+            count += page->CountPointsInShape(shape);
+        return;
+    }
+
+    this->CountPointsInShape(topNode.Left, shape, count);
+    this->CountPointsInShape(topNode.Right, shape, count);
+}
+
+template <typename Shape>
+vtkIdType AvtkOutOfCoreKdTree::CountPointsInShape(const Shape &shape) const
+{
+    vtkIdType count = 0;
+    if (!this->Nodes.empty())
+        this->CountPointsInShape(0, shape, count);
+    return count;
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "vtkObject.h"
+#include "vtkSmartPointer.h" // For the shared search structures
+
+#include "AvtkFlatKdTree.h"        // For the templated region queries
+#include "AvtkIncrementalKdTree.h" // For the templated region queries
+#include "AvtkKdTree.h"            // For the templated region queries
+#include "AvtkUniformGrid.h"       // For the templated region queries
+
+class vtkIdList;
+class AvtkKdTreePointLocator;
+
+/**
+ * Immutable, reference counted view of a built AvtkKdTreePointLocator,
+ * obtained from AvtkKdTreePointLocator::Freeze() or GetSnapshot().
+ *
+ * A snapshot shares the search structure that was current when it was
+ * published. It never rebuilds, never compares modification times and never
+ * reads the dataset, so its queries are const, non-virtual and safe to call
+ * from any number of threads at once, including while the locator is being
+ * modified and rebuilt: a rebuild creates a new structure and publishes a new
+ * snapshot, and the structure of an older snapshot stays alive until its last
+ * reference is released. ApproximationEpsilon and MaxNumberOfLeavesVisited
+ * are copied from the locator at publication.
+ */
+class AvtkPointLocatorSnapshot : public vtkObject
+{
+public:
+    vtkTypeMacro(AvtkPointLocatorSnapshot, vtkObject);
+    static AvtkPointLocatorSnapshot *New();
+    void PrintSelf(ostream &os, vtkIndent indent) override;
+
+    /**
+     * The AvtkKdTreePointLocator::TreeTypes value of the shared structure.
+     */
+    int GetTreeType() const { return this->TreeType; }
+
+    /**
+     * Bounds of the indexed points at publication.
+     */
+    void GetBounds(double bounds[6]) const;
+
+    double GetApproximationEpsilon() const { return this->ApproximationEpsilon; }
+    int GetMaxNumberOfLeavesVisited() const { return this->MaxNumberOfLeavesVisited; }
+
+    ///@{
+    /**
+     * Same as the AvtkKdTreePointLocator queries of the same name, answered
+     * from the frozen structure. A zero cylinder direction yields an empty
+     * result instead of an error.
+     */
+    vtkIdType FindClosestPoint(const double x[3]) const;
+    vtkIdType FindClosestPoint(const double x[3], double &dist2) const;
+    vtkIdType FindClosestPointWithinRadius(double radius, const double x[3], double &dist2) const;
+    void FindClosestNPoints(int N, const double x[3], vtkIdList *result) const;
+    void FindPointsWithinRadius(double R, const double x[3], vtkIdList *result) const;
+    void FindPointsWithinArea(const double area[6], vtkIdList *result) const;
+    void FindPointsWithinCuboid(const double cuboid[8][3], vtkIdList *result) const;
+    void FindPointsWithinConvexPolytope(const double *planes, int numPlanes, vtkIdList *result) const;
+    void FindPointsWithinCylinder(const double point[3], const double direction[3], double radius,
+                                  vtkIdList *result) const;
+    void FindPointsWithinCapsule(const double p0[3], const double p1[3], double radius, vtkIdList *result) const;
+    void FindPointsWithinTube(const double *points, int numPoints, double radius, vtkIdList *result) const;
+    vtkIdType CountPointsWithinRadius(double R, const double x[3]) const;
+    ///@}
+
+    ///@{
+    /**
+     * Region traversal with any shape of QueryShapes.h, see
+     * AvtkKdTreePointLocator::ForEachPointWithinRadius(). The visitor is
+     * called as visitor(const vtkIdType *ids, vtkIdType n) per leaf run.
+     */
+    template <typename Shape, typename Visitor>
+    void VisitPointsInShape(const Shape &shape, Visitor &&visitor) const;
+
+    template <typename Shape, typename F>
+    void ForEachPointInShape(const Shape &shape, F &&f) const;
+
+    template <typename Shape>
+    vtkIdType CountPointsInShape(const Shape &shape) const;
+    ///@}
+
+protected:
+    AvtkPointLocatorSnapshot() = default;
+    ~AvtkPointLocatorSnapshot() override = default;
+
+    bool IsApproximate() const
+    {
+        return this->ApproximationEpsilon > 0.0 || this->MaxNumberOfLeavesVisited > 0;
+    }
+
+    // Exactly one of the structures is set, filled in by the locator.
+    friend class AvtkKdTreePointLocator;
+    vtkSmartPointer<AvtkKdTree> KdTree;
+    vtkSmartPointer<AvtkFlatKdTree> FlatKdTree;
+    vtkSmartPointer<AvtkIncrementalKdTree> IncrementalKdTree;
+    vtkSmartPointer<AvtkUniformGrid> UniformGrid;
+    int TreeType = 0;
+    double Bounds[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    double ApproximationEpsilon = 0.0;
+    int MaxNumberOfLeavesVisited = 0;
+
+private:
+    AvtkPointLocatorSnapshot(const AvtkPointLocatorSnapshot &) = delete;
+    void operator=(const AvtkPointLocatorSnapshot &) = delete;
+};
+
+template <typename Shape, typename Visitor>
+void AvtkPointLocatorSnapshot::VisitPointsInShape(const Shape &shape, Visitor &&visitor) const
+{
+    if (this->IncrementalKdTree)
+    {
+        this->IncrementalKdTree->VisitPointsInShape(shape, visitor);
+        return;
+    }
+    if (this->FlatKdTree)
+    {
+        this->FlatKdTree->VisitPointsInShape(shape, visitor);
+        return;
+    }
+    if (this->UniformGrid)
+    {
+        this->UniformGrid->VisitPointsInShape(shape, visitor);
+        return;
+    }
+    if (this->KdTree)
+    {
+        this->KdTree->VisitPointsInShape(shape, visitor);
+    }
+}
+
+template <typename Shape, typename F>
+void AvtkPointLocatorSnapshot::ForEachPointInShape(const Shape &shape, F &&f) const
+{
+    this->VisitPointsInShape(shape, [&f](const vtkIdType *ids, vtkIdType n)
+                             {
+                                 for (vtkIdType i = 0; i < n; ++i)
+                                     f(ids[i]);
+                             });
+}
+
+template <typename Shape>
+vtkIdType AvtkPointLocatorSnapshot::CountPointsInShape(const Shape &shape) const
+{
+    vtkIdType count = 0;
+    this->VisitPointsInShape(shape, [&count](const vtkIdType *, vtkIdType n)
+                             { count += n; });
+    return count;
+}
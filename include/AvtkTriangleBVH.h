@@ -0,0 +1,245 @@
+#pragma once
+
+#include <vtkObject.h>
+#include <vtkDoubleArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkImageData.h>
+#include <vtkPolyData.h>
+#include <vector>
+
+namespace AUtils
+{
+    /**
+     * 查询点在三角网格表面上的最近点。
+     */
+    struct SurfacePoint
+    {
+        double Point[3];       // 表面上的最近点
+        double Distance;       // 有符号距离，位于法向量一侧时为正
+        double Barycentric[3]; // 最近点在三角形中的重心坐标，对应三角形的三个顶点
+        vtkIdType CellId;      // 最近三角形在多边形数据中的单元id，网格为空时为-1
+    };
+
+    /**
+     * 射线与三角网格表面的交点。
+     */
+    struct RayHit
+    {
+        double Point[3];       // 交点
+        double Distance;       // 交点到射线起点的距离
+        double Normal[3];      // 三角形的单位面法向量，朝向与有符号距离的正方向一致
+        double Barycentric[3]; // 交点在三角形中的重心坐标，对应三角形的三个顶点
+        vtkIdType CellId;      // 三角形在多边形数据中的单元id，未命中时为-1
+    };
+};
+
+/**
+ * 三角形包围盒层次结构（BVH），用于求点到三角网格表面的精确最近点、有符号距离以及射线与表面的交点。
+ *
+ * 节点按深度优先顺序存放在连续数组中，左子节点紧跟在父节点之后；三角形按节点顺序重排，
+ * 三角形用到的点按重排后首次出现的顺序重新编号，三角形以32位序号引用共享的点，查询时不经过 vtkPolyData 的单元访问。
+ * 距离的符号由最近点所在特征（面、边或顶点）的伪法向量决定：面取面法向量，边取相邻两面法向量之和，
+ * 顶点取按顶角加权的相邻面法向量之和，对封闭且朝向一致的网格，符号在顶点与边附近同样正确。
+ * 顶点与边的伪法向量按点和边各存一份，相邻三角形共用，连同节点每个三角形约占150字节。
+ * 所有查询函数均为只读，构建完成后可以在多个线程中同时调用。
+ */
+class AvtkTriangleBVH : public vtkObject
+{
+public:
+    vtkTypeMacro(AvtkTriangleBVH, vtkObject);
+    static AvtkTriangleBVH *New();
+    void PrintSelf(ostream &os, vtkIndent indent) override;
+
+    /**
+     * 每个叶子最多包含的三角形数，构建前设置。
+     */
+    vtkSetClampMacro(NumberOfTrianglesPerLeaf, int, 1, 256);
+    vtkGetMacro(NumberOfTrianglesPerLeaf, int);
+
+    /**
+     * 最近一次 BuildFromPolyData 的耗时（秒）。
+     */
+    vtkGetMacro(BuildElapsedTime, double);
+
+    /**
+     * 从多边形数据的三角形单元构建，顶点、线与非三角形的多边形单元被忽略，需要时先用 vtkTriangleFilter 三角化。
+     * 三角形的朝向由顶点顺序决定；数据带有点法向量时，以三个顶点法向量之和的方向为准，
+     * 与按点法向量判断内外的结果一致。三角形数超过 VTK_TYPE_INT32_MAX / 3 时报错并保持为空。
+     */
+    void BuildFromPolyData(vtkPolyData *polyData);
+
+    /**
+     * 将构建结果写入二进制文件，先写入同目录下唯一的临时文件再替换目标文件，没有三角形时同样可以保存。
+     * @param key 调用方给出的数据标识，Load 时用于判断文件是否过期。
+     */
+    bool Save(const char *path, vtkTypeUInt64 key) const;
+
+    /**
+     * 读取 Save 保存的文件代替 BuildFromPolyData，数组整体拷贝，不重新划分三角形与计算伪法向量。
+     * 无论是否校验，都检查节点的子节点与三角形区间、树的深度以及三角形的点与边序号是否在范围内，
+     * 损坏的文件不会使查询越界。
+     * @param verifyChecksum 为true时同时校验所有数组。
+     * @return 文件不存在、标识不符、由不兼容的版本或平台写入、不完整或结构无效时返回false，已有的数据不变。
+     */
+    bool Load(const char *path, vtkTypeUInt64 key, bool verifyChecksum = false);
+
+    /**
+     * 释放所有数据。
+     */
+    void Initialize();
+
+    /**
+     * 三角形的数量。
+     */
+    vtkIdType GetNumberOfTriangles() const { return static_cast<vtkIdType>(this->CellIds.size()); }
+
+    /**
+     * 占用的内存（KiB）。
+     */
+    unsigned long GetActualMemorySize() const;
+
+    /**
+     * 查找x在表面上的最近点。
+     * @return 网格为空时返回false，result.CellId 为-1。
+     */
+    bool FindClosestPoint(const double x[3], AUtils::SurfacePoint &result) const;
+
+    /**
+     * x到表面的有符号距离，网格为空时返回 VTK_DOUBLE_MAX。
+     */
+    double GetSignedDistance(const double x[3]) const;
+
+    /**
+     * 批量查询，numQueries 个查询点以连续的 (x, y, z) 给出，查询使用 vtkSMPTools 并行执行。
+     * @param distances 返回每个查询点的有符号距离。
+     * @param cellIds 非空时返回最近三角形的单元id。
+     * @param closestPoints 非空时返回最近点，3个分量。
+     * @param barycentrics 非空时返回最近点的重心坐标，3个分量。
+     */
+    void FindClosestPointsBatch(vtkIdType numQueries, const double *x, vtkDoubleArray *distances,
+                                vtkIdTypeArray *cellIds = nullptr, vtkDoubleArray *closestPoints = nullptr,
+                                vtkDoubleArray *barycentrics = nullptr) const;
+
+    /**
+     * 求射线 origin + t * direction（t >= 0）与表面的第一个交点，direction 不必是单位向量。
+     * @param maxDistance 只查找到起点距离不超过 maxDistance 的交点。
+     * @return 没有交点时返回false，hit.CellId 为-1。
+     */
+    bool IntersectRay(const double origin[3], const double direction[3], AUtils::RayHit &hit,
+                      double maxDistance = VTK_DOUBLE_MAX) const;
+
+    /**
+     * 求射线与表面的所有交点，按到起点的距离从近到远排列。
+     * 射线穿过相邻三角形的公共边或顶点时，每个三角形各报告一次。
+     * @return 交点数。
+     */
+    int IntersectRayAll(const double origin[3], const double direction[3], std::vector<AUtils::RayHit> &hits,
+                        double maxDistance = VTK_DOUBLE_MAX) const;
+
+    /**
+     * 批量求第一个交点，numRays 条射线的起点与方向以连续的 (x, y, z) 给出，使用 vtkSMPTools 并行执行。
+     * @param distances 返回交点到起点的距离，未命中时为 VTK_DOUBLE_MAX。
+     * @param cellIds 非空时返回三角形的单元id，未命中时为-1。
+     * @param points 非空时返回交点，3个分量，未命中时为射线起点。
+     */
+    void IntersectRays(vtkIdType numRays, const double *origins, const double *directions, vtkDoubleArray *distances,
+                       vtkIdTypeArray *cellIds = nullptr, vtkDoubleArray *points = nullptr,
+                       double maxDistance = VTK_DOUBLE_MAX) const;
+
+    /**
+     * 在规则网格上采样有符号距离场，结果写入 field 的点标量 "Distance"。
+     * 网格的原点为 bounds 的最小角点，各方向 dims 个采样点均匀覆盖 bounds。
+     * 各条x方向的扫描线并行计算，扫描线内利用相邻采样点的连续性：
+     * 以上一个采样点的最近三角形为种子，它的距离作为遍历的初始上界；
+     * maxDistance 大于0时为窄带，距离截断到 [-maxDistance, maxDistance]，
+     * 距离是1-Lipschitz的，由上一个精确距离可知仍在窄带外的采样点不再搜索，直接沿用其符号。
+     * @param maxDistance 窄带宽度，0 表示计算所有采样点的精确距离。
+     * @param scalarType VTK_FLOAT 或 VTK_DOUBLE，单精度输出的内存减半。
+     */
+    void ComputeDistanceField(const double bounds[6], const int dims[3], double maxDistance, int scalarType,
+                              vtkImageData *field) const;
+
+protected:
+    AvtkTriangleBVH() = default;
+    ~AvtkTriangleBVH() override = default;
+
+    /**
+     * BVH节点。内部节点的左子节点为下一个节点，右子节点为 Right；叶子包含三角形 [First, First + Count)。
+     */
+    struct Node
+    {
+        double Bounds[6];
+        vtkIdType First;
+        vtkIdType Right;
+        int Count;
+    };
+
+    /**
+     * 递归构建三角形区间 [begin, end) 的子树，order 为三角形的排列，centroids 为各三角形的重心。
+     */
+    void BuildNode(vtkIdType begin, vtkIdType end, std::vector<vtkIdType> &order,
+                   const std::vector<double> &centroids, const std::vector<double> &triangleBounds);
+
+    /**
+     * 由重排后的 Points 与 TrianglePoints 计算面、点与边的伪法向量，并为各三角形的边编号。
+     * @param orientation 各三角形（重排后的序号）的朝向，-1 表示面法向量与顶点顺序决定的方向相反。
+     */
+    void ComputePseudoNormals(const std::vector<double> &orientation);
+
+    /**
+     * 检查读入的数组能否安全查询：内部节点的左子节点为下一个节点，右子节点在其后，除根以外每个节点恰有一个父节点，
+     * 深度不超过遍历栈的深度；叶子的三角形区间在 [0, numTriangles) 内；点与边的序号在范围内。
+     */
+    static bool IsValidStructure(const Node *nodes, vtkIdType numNodes, vtkIdType numTriangles,
+                                 const vtkTypeInt32 *trianglePoints, vtkIdType numPoints,
+                                 const vtkTypeInt32 *triangleEdges, vtkIdType numEdges);
+
+    /**
+     * 查找最近点，seed 不为-1时先以该三角形（重排后的序号）的距离作为初始上界。
+     * @return 最近三角形重排后的序号，网格为空时返回-1。
+     */
+    vtkIdType SearchClosestPoint(const double x[3], vtkIdType seed, AUtils::SurfacePoint &result) const;
+
+    /**
+     * 计算距离场中的一条扫描线，values 为该扫描线的 dims[0] 个输出值。
+     */
+    template <typename T>
+    void ComputeDistanceLine(const double start[3], double step, int count, double maxDistance, T *values) const;
+
+    /**
+     * 求单位方向射线与三角形 t 的交点，t 为重排后的序号。
+     * @param distance 返回交点到起点的距离。
+     * @param u,v 返回交点关于第二、第三个顶点的重心坐标。
+     */
+    bool IntersectTriangle(vtkIdType t, const double origin[3], const double direction[3], double &distance,
+                           double &u, double &v) const;
+
+    /**
+     * 由 IntersectTriangle 的结果填写交点。
+     */
+    void FillRayHit(vtkIdType t, const double origin[3], const double direction[3], double distance, double u,
+                    double v, AUtils::RayHit &hit) const;
+
+    /**
+     * 求x到三角形 t 的最近点，返回距离平方，feature 返回最近点所在的特征：
+     * 0-2 为顶点，3-5 为边（顶点0-1、1-2、2-0），6 为面内部。
+     */
+    double ClosestPointOnTriangle(vtkIdType t, const double x[3], double closest[3], double bary[3],
+                                  int &feature) const;
+
+    int NumberOfTrianglesPerLeaf = 4;
+    double BuildElapsedTime = 0.0;
+
+    std::vector<Node> Nodes;
+    std::vector<double> Points;               // 三角形用到的点，每个点3个分量
+    std::vector<vtkTypeInt32> TrianglePoints; // 各三角形的三个点在 Points 中的序号
+    std::vector<vtkTypeInt32> TriangleEdges;  // 各三角形的三条边（顶点0-1、1-2、2-0）在 EdgeNormals 中的序号
+    std::vector<vtkIdType> CellIds;           // 各三角形在多边形数据中的单元id
+    std::vector<double> FaceNormals;          // 各三角形的单位面法向量，每个三角形3个分量
+    std::vector<float> PointNormals;          // 各点的伪法向量，与 Points 对应，只用于判断符号，单精度存储
+    std::vector<float> EdgeNormals;           // 各条边的伪法向量，共享该边的三角形共用
+
+private:
+    AvtkTriangleBVH(const AvtkTriangleBVH &) = delete;
+    void operator=(const AvtkTriangleBVH &) = delete;
+};
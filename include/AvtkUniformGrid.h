@@ -0,0 +1,365 @@
+#pragma once
+
+#include <vtkObject.h>
+#include <vtkIdList.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "LeafKernels.h"
+#include "QueryShapes.h"
+
+/**
+ * 基于空间哈希的均匀网格点定位结构，适合固定半径的查询。
+ *
+ * 空间划分为边长为 CellSize 的立方体单元格，只保存包含点的单元格：
+ * 点按所在单元格的 Morton 编码排序后连续存放（SoA），单元格编码到单元格的映射存放在开放寻址的哈希表中，
+ * 曲面等稀疏数据的内存只与点数有关。单元格边长等于查询半径时，一次半径查询只访问 3x3x3 个单元格。
+ * 区域查询先由形状的包围盒确定单元格范围，再对范围递归二分，按形状裁剪；
+ * 范围内的单元格数超过非空单元格数时改为遍历非空单元格。
+ * 所有查询函数均为只读，构建完成后可以在多个线程中同时调用。
+ */
+class AvtkUniformGrid : public vtkObject
+{
+public:
+    vtkTypeMacro(AvtkUniformGrid, vtkObject);
+    static AvtkUniformGrid *New();
+    void PrintSelf(ostream &os, vtkIndent indent) override;
+
+    /**
+     * 单元格边长，构建前设置。为0（默认）时按 NumberOfPointsPerCell 自动选择。
+     * 固定半径的查询应设置为查询半径。单元格坐标每个方向最多 2^21 个，超出时边长自动放大。
+     */
+    vtkSetClampMacro(CellSize, double, 0.0, VTK_DOUBLE_MAX);
+    vtkGetMacro(CellSize, double);
+
+    /**
+     * 自动选择单元格边长时，包围盒内每个单元格的平均点数。
+     */
+    vtkSetClampMacro(NumberOfPointsPerCell, int, 1, 1 << 20);
+    vtkGetMacro(NumberOfPointsPerCell, int);
+
+    /**
+     * 是否并行构建，单元格编码的计算与排序并行进行，结果与串行构建相同。
+     */
+    vtkSetMacro(ParallelBuild, vtkTypeBool);
+    vtkGetMacro(ParallelBuild, vtkTypeBool);
+    vtkBooleanMacro(ParallelBuild, vtkTypeBool);
+
+    /**
+     * 是否以单精度存储点坐标，见 AvtkFlatKdTree::SetSinglePrecision。
+     */
+    vtkSetMacro(SinglePrecision, vtkTypeBool);
+    vtkGetMacro(SinglePrecision, vtkTypeBool);
+    vtkBooleanMacro(SinglePrecision, vtkTypeBool);
+
+    /**
+     * 最近一次 BuildFromPoints 的耗时（秒）。
+     */
+    vtkGetMacro(BuildElapsedTime, double);
+
+    /**
+     * 从点数组构建网格，点id即为点在数组中的下标。
+     */
+    void BuildFromPoints(vtkPoints *points);
+
+    /**
+     * 释放网格的所有数据。
+     */
+    void Initialize();
+
+    /**
+     * 网格占用的内存（KiB）。
+     */
+    unsigned long GetActualMemorySize() const;
+
+    vtkIdType GetNumberOfPoints() const { return static_cast<vtkIdType>(this->Ids.size()); }
+
+    /**
+     * 非空单元格的数量。
+     */
+    vtkIdType GetNumberOfCells() const { return static_cast<vtkIdType>(this->CellKeys.size()); }
+
+    /**
+     * 构建时实际使用的单元格边长。
+     */
+    double GetSpacing() const { return this->Spacing; }
+
+    /**
+     * 获取所有点的包围盒。
+     */
+    void GetBounds(double bounds[6]) const;
+
+    /**
+     * 查找距离x最近的点，从x所在的单元格开始逐层向外搜索。
+     * @param dist2 返回距离的平方。
+     * @param cellsVisited 非空时返回访问的非空单元格数。
+     * @return 最近点的id，网格为空时返回-1。
+     */
+    vtkIdType FindClosestPoint(const double x[3], double &dist2, int *cellsVisited = nullptr) const;
+
+    vtkIdType FindClosestPointWithinRadius(double radius, const double x[3], double &dist2) const;
+
+    /**
+     * 查找距离x最近的N个点，结果按距离从近到远排序。
+     */
+    void FindClosestNPoints(int N, const double x[3], vtkIdList *result, int *cellsVisited = nullptr) const;
+
+    /**
+     * 查找半径R内的所有点，结果不排序。
+     */
+    void FindPointsWithinRadius(double R, const double x[3], vtkIdList *result) const;
+
+    void FindPointsInArea(const double area[6], vtkIdList *ids) const;
+
+    void FindPointsInCuboid(const double cuboid[8][3], vtkIdList *ids) const;
+
+    /**
+     * 查找凸多面体内的所有点，每个平面 (nx, ny, nz, d)，法向指向外部，见 AUtils::ConvexPolytopeShape。
+     */
+    void FindPointsInConvexPolytope(const double *planes, int numPlanes, vtkIdList *ids) const;
+
+    /**
+     * 查找到多段线距离不超过 radius 的所有点（沿路径扫掠的管道），见 AUtils::TubeShape。
+     */
+    void FindPointsInTube(const double *points, int numPoints, double radius, vtkIdList *ids) const;
+
+    void FindPointsInCylinder(const double point[3], const double direction[3], double radius, vtkIdList *ids) const;
+
+    void FindPointsInCapsule(const double p0[3], const double p1[3], double radius, vtkIdList *ids) const;
+
+    /**
+     * 遍历形状内的所有点，点id按段以 visitor(const vtkIdType *ids, vtkIdType n) 的形式传出，
+     * 完全位于形状内部的单元格作为一段整体传出。
+     * @param shape 查询形状，需提供 Classify(bounds) 与 Contains(point)，见 QueryShapes.h。
+     */
+    template <typename Shape, typename Visitor>
+    void VisitPointsInShape(const Shape &shape, Visitor &&visitor) const;
+
+    template <typename Shape, typename F>
+    void ForEachPointInShape(const Shape &shape, F &&f) const;
+
+    template <typename Shape>
+    vtkIdType CountPointsInShape(const Shape &shape) const;
+
+    /**
+     * 生成所有非空单元格的多边形表示，level 不起作用。
+     */
+    void GenerateRepresentation(int level, vtkPolyData *pd) const;
+
+protected:
+    AvtkUniformGrid() = default;
+    ~AvtkUniformGrid() override = default;
+
+    /**
+     * 坐标所在的单元格坐标，超出网格范围时截断到边界。
+     */
+    int GetCellCoordinate(double x, int axis) const
+    {
+        double c = std::floor((x - this->Origin[axis]) / this->Spacing);
+        return static_cast<int>(std::min(std::max(c, 0.0), static_cast<double>(this->Dimensions[axis] - 1)));
+    }
+
+    /**
+     * 单元格坐标为 (i, j, k) 的非空单元格的下标，单元格为空时返回-1。
+     */
+    vtkIdType FindCell(int i, int j, int k) const;
+
+    /**
+     * 非空单元格 cell 的单元格坐标。
+     */
+    void GetCellCoordinates(vtkIdType cell, int ijk[3]) const;
+
+    /**
+     * 单元格坐标范围 [lo, hi] 的包围盒。
+     */
+    void GetRangeBounds(const int lo[3], const int hi[3], double bounds[6]) const;
+
+    /**
+     * 递归遍历单元格坐标范围 [lo, hi]，传出位于形状内部的点。
+     */
+    template <typename Shape, typename Visitor>
+    void VisitRange(const int lo[3], const int hi[3], const Shape &shape, Visitor &visitor) const;
+
+    /**
+     * 传出单元格坐标为 ijk 的非空单元格 cell 中位于形状内部的点，inside 为 true 时表示单元格已知完全在形状内部。
+     */
+    template <typename Shape, typename Visitor>
+    void VisitCell(vtkIdType cell, const int ijk[3], bool inside, const Shape &shape, Visitor &visitor) const;
+
+    template <typename Shape>
+    void FindPointsInShape(const Shape &shape, vtkIdList *ids) const;
+
+    /**
+     * 最近N点搜索，heap为按距离平方排列的最大堆，容量为N。
+     * @return 访问的非空单元格数。
+     */
+    int SearchClosestPoints(const double x[3], size_t N, std::vector<std::pair<double, vtkIdType>> &heap) const;
+
+    /**
+     * 将单元格中的点按距离加入最大堆。
+     */
+    void PushCellCandidates(vtkIdType cell, const double x[3], size_t N,
+                            std::vector<std::pair<double, vtkIdType>> &heap) const;
+
+    double CellSize = 0.0;
+    int NumberOfPointsPerCell = 4;
+    vtkTypeBool ParallelBuild = 0;
+    vtkTypeBool SinglePrecision = 0;
+    double BuildElapsedTime = 0.0;
+
+    double Bounds[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0}; // 所有点的包围盒
+    double Origin[3] = {0.0, 0.0, 0.0};                // 单元格 (0, 0, 0) 的最小角点
+    double Spacing = 1.0;                              // 实际使用的单元格边长
+    int Dimensions[3] = {1, 1, 1};                     // 各方向的单元格数
+    double Tolerance = 0.0;                            // 单元格包围盒的外扩量，避免舍入误差漏掉边界上的点
+
+    std::vector<vtkTypeUInt64> CellKeys; // 非空单元格的 Morton 编码，升序
+    std::vector<vtkIdType> CellOffsets;  // 各非空单元格的点在点数组中的起始下标，末尾为点数
+
+    std::vector<vtkTypeUInt64> HashKeys; // 哈希表：单元格编码，空位为 EmptyHashKey
+    std::vector<vtkIdType> HashCells;    // 哈希表：对应的非空单元格下标
+    vtkTypeUInt64 HashMask = 0;
+
+    bool FloatStorage = false;     // 当前的网格是否以单精度存储坐标
+    std::vector<double> X, Y, Z;   // 按单元格排序的点坐标（双精度存储）
+    std::vector<float> XF, YF, ZF; // 按单元格排序的点坐标（单精度存储）
+    std::vector<vtkIdType> Ids;    // 按单元格排序的原始点id
+
+private:
+    AvtkUniformGrid(const AvtkUniformGrid &) = delete;
+    void operator=(const AvtkUniformGrid &) = delete;
+};
+
+template <typename Shape, typename Visitor>
+void AvtkUniformGrid::VisitCell(vtkIdType cell, const int ijk[3], bool inside, const Shape &shape,
+                                Visitor &visitor) const
+{
+    vtkIdType begin = this->CellOffsets[cell];
+    vtkIdType end = this->CellOffsets[cell + 1];
+    if (!inside)
+    {
+        double bounds[6];
+        this->GetRangeBounds(ijk, ijk, bounds);
+        AUtils::BoxRelation relation = shape.Classify(bounds);
+        if (relation == AUtils::BoxRelation::Outside)
+            return;
+        inside = relation == AUtils::BoxRelation::Inside;
+    }
+
+    if (inside)
+    {
+        visitor(this->Ids.data() + begin, end - begin);
+        return;
+    }
+    if (this->FloatStorage)
+        AUtils::ScanPoints(shape, this->XF.data() + begin, this->YF.data() + begin, this->ZF.data() + begin,
+                           this->Ids.data() + begin, end - begin, visitor);
+    else
+        AUtils::ScanPoints(shape, this->X.data() + begin, this->Y.data() + begin, this->Z.data() + begin,
+                           this->Ids.data() + begin, end - begin, visitor);
+}
+
+template <typename Shape, typename Visitor>
+void AvtkUniformGrid::VisitRange(const int lo[3], const int hi[3], const Shape &shape, Visitor &visitor) const
+{
+    double bounds[6];
+    this->GetRangeBounds(lo, hi, bounds);
+    AUtils::BoxRelation relation = shape.Classify(bounds);
+    if (relation == AUtils::BoxRelation::Outside)
+        return;
+    bool inside = relation == AUtils::BoxRelation::Inside;
+
+    double size[3] = {static_cast<double>(hi[0] - lo[0] + 1), static_cast<double>(hi[1] - lo[1] + 1),
+                      static_cast<double>(hi[2] - lo[2] + 1)};
+    double volume = size[0] * size[1] * size[2];
+
+    // 范围完全在形状内部时需要逐个查找范围内的单元格，单元格多于非空单元格时改为直接遍历非空单元格；
+    // 与形状相交的范围继续二分时大部分被裁剪，只在远多于非空单元格时遍历
+    double numCells = static_cast<double>(this->CellKeys.size());
+    if (volume > (inside ? numCells : 16.0 * numCells))
+    {
+        for (vtkIdType cell = 0; cell < this->GetNumberOfCells(); ++cell)
+        {
+            int ijk[3];
+            this->GetCellCoordinates(cell, ijk);
+            if (ijk[0] < lo[0] || ijk[0] > hi[0] || ijk[1] < lo[1] || ijk[1] > hi[1] || ijk[2] < lo[2] || ijk[2] > hi[2])
+                continue;
+            this->VisitCell(cell, ijk, inside, shape, visitor);
+        }
+        return;
+    }
+
+    // 范围足够小或已完全在形状内部时，逐个查找单元格
+    if (inside || volume <= 27.0)
+    {
+        for (int k = lo[2]; k <= hi[2]; ++k)
+        {
+            for (int j = lo[1]; j <= hi[1]; ++j)
+            {
+                for (int i = lo[0]; i <= hi[0]; ++i)
+                {
+                    vtkIdType cell = this->FindCell(i, j, k);
+                    if (cell >= 0)
+                    {
+                        int ijk[3] = {i, j, k};
+                        this->VisitCell(cell, ijk, inside, shape, visitor);
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+    // 沿单元格数最多的方向二分
+    int axis = size[0] >= size[1] && size[0] >= size[2] ? 0 : (size[1] >= size[2] ? 1 : 2);
+    int mid = lo[axis] + (hi[axis] - lo[axis]) / 2;
+    int loHi[3] = {hi[0], hi[1], hi[2]};
+    int hiLo[3] = {lo[0], lo[1], lo[2]};
+    loHi[axis] = mid;
+    hiLo[axis] = mid + 1;
+    this->VisitRange(lo, loHi, shape, visitor);
+    this->VisitRange(hiLo, hi, shape, visitor);
+}
+
+template <typename Shape, typename Visitor>
+void AvtkUniformGrid::VisitPointsInShape(const Shape &shape, Visitor &&visitor) const
+{
+    if (this->Ids.empty())
+        return;
+
+    int lo[3] = {0, 0, 0};
+    int hi[3] = {this->Dimensions[0] - 1, this->Dimensions[1] - 1, this->Dimensions[2] - 1};
+    double bounds[6];
+    if (AUtils::GetShapeBounds(shape, bounds))
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            if (bounds[2 * i] > this->Bounds[2 * i + 1] || bounds[2 * i + 1] < this->Bounds[2 * i])
+                return;
+            lo[i] = this->GetCellCoordinate(bounds[2 * i], i);
+            hi[i] = this->GetCellCoordinate(bounds[2 * i + 1], i);
+        }
+    }
+    this->VisitRange(lo, hi, shape, visitor);
+}
+
+template <typename Shape, typename F>
+void AvtkUniformGrid::ForEachPointInShape(const Shape &shape, F &&f) const
+{
+    this->VisitPointsInShape(shape, [&f](const vtkIdType *ids, vtkIdType n)
+                             {
+                                 for (vtkIdType i = 0; i < n; ++i)
+                                     f(ids[i]);
+                             });
+}
+
+template <typename Shape>
+vtkIdType AvtkUniformGrid::CountPointsInShape(const Shape &shape) const
+{
+    vtkIdType count = 0;
+    this->VisitPointsInShape(shape, [&count](const vtkIdType *, vtkIdType n)
+                             { count += n; });
+    return count;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <vtkIdList.h>
+#include <vtkType.h>
+#include <algorithm>
+#include "QueryShapes.h"
+
+namespace AUtils
+{
+    /**
+     * 叶子扫描使用的指令集。
+     */
+    enum class SimdLevel
+    {
+        Scalar = 0, // 逐点调用形状的 Contains
+        SSE2 = 1,   // 每次测试2个点
+        AVX2 = 2    // 每次测试4个点
+    };
+
+    /**
+     * 运行时检测到的CPU与操作系统所支持的最高指令集，非x86平台为 Scalar。
+     */
+    SimdLevel GetSupportedSimdLevel();
+
+    /**
+     * 当前叶子扫描使用的指令集，默认为 GetSupportedSimdLevel()。
+     */
+    SimdLevel GetSimdLevel();
+
+    /**
+     * 设置叶子扫描使用的指令集，超过CPU支持的级别时使用支持的最高级别，主要用于测试与性能对比。
+     */
+    void SetSimdLevel(SimdLevel level);
+
+    ///@{
+    /**
+     * 叶子扫描：测试按 x/y/z 分量分别连续存放的n个点，将位于形状内部的点的id按原顺序写入out。
+     * 向量化实现与形状的 Contains 使用相同的运算顺序（不使用FMA），判定结果完全一致；
+     * 单精度坐标读入后先转换为双精度再测试，结果与把同样的坐标存为双精度时一致。
+     * @param x,y,z 点坐标分量。
+     * @param ids 各点的id。
+     * @param n 点数。
+     * @param out 输出缓冲区，至少能容纳n个id。
+     * @return 写入out的id数量。
+     */
+    vtkIdType ScanLeaf(const SphereShape &shape, const double *x, const double *y, const double *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out);
+    vtkIdType ScanLeaf(const SphereShape &shape, const float *x, const float *y, const float *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out);
+    vtkIdType ScanLeaf(const AreaShape &shape, const double *x, const double *y, const double *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out);
+    vtkIdType ScanLeaf(const AreaShape &shape, const float *x, const float *y, const float *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out);
+    vtkIdType ScanLeaf(const CuboidShape &shape, const double *x, const double *y, const double *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out);
+    vtkIdType ScanLeaf(const CuboidShape &shape, const float *x, const float *y, const float *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out);
+    vtkIdType ScanLeaf(const ConvexPolytopeShape &shape, const double *x, const double *y, const double *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out);
+    vtkIdType ScanLeaf(const ConvexPolytopeShape &shape, const float *x, const float *y, const float *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out);
+    vtkIdType ScanLeaf(const CylinderShape &shape, const double *x, const double *y, const double *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out);
+    vtkIdType ScanLeaf(const CylinderShape &shape, const float *x, const float *y, const float *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out);
+    ///@}
+
+    ///@{
+    /**
+     * 管道的叶子扫描：先由叶子中各点的包围盒筛选出附近的线段，只有一条时使用胶囊体的向量化扫描，
+     * 否则逐点只测试这些线段，不必对每个点遍历整条路径的线段层次结构。
+     */
+    vtkIdType ScanLeaf(const TubeShape &shape, const double *x, const double *y, const double *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out);
+    vtkIdType ScanLeaf(const TubeShape &shape, const float *x, const float *y, const float *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out);
+    ///@}
+
+    /**
+     * 其它形状的叶子扫描，逐点调用 Contains。
+     */
+    template <typename Shape, typename T>
+    vtkIdType ScanLeaf(const Shape &shape, const T *x, const T *y, const T *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+    {
+        vtkIdType count = 0;
+        for (vtkIdType i = 0; i < n; ++i)
+        {
+            double p[3] = {x[i], y[i], z[i]};
+            if (shape.Contains(p))
+                out[count++] = ids[i];
+        }
+        return count;
+    }
+
+    // ScanPoints 每段扫描的点数
+    const vtkIdType LeafScanChunkSize = 256;
+
+    /**
+     * 分段扫描任意长度的点区间，每段的结果以 visitor(const vtkIdType *ids, vtkIdType n) 的形式传出。
+     * 结果缓冲区位于栈上，visitor 中可以再次发起查询。
+     */
+    template <typename Shape, typename T, typename Visitor>
+    void ScanPoints(const Shape &shape, const T *x, const T *y, const T *z,
+                    const vtkIdType *ids, vtkIdType n, Visitor &visitor)
+    {
+        vtkIdType out[LeafScanChunkSize];
+        for (vtkIdType begin = 0; begin < n; begin += LeafScanChunkSize)
+        {
+            vtkIdType size = n - begin < LeafScanChunkSize ? n - begin : LeafScanChunkSize;
+            vtkIdType count = ScanLeaf(shape, x + begin, y + begin, z + begin, ids + begin, size, out);
+            if (count > 0)
+                visitor(static_cast<const vtkIdType *>(out), count);
+        }
+    }
+
+    /**
+     * 将一段点id追加到列表末尾。
+     */
+    inline void AppendIds(vtkIdList *list, const vtkIdType *ids, vtkIdType n)
+    {
+        vtkIdType *dst = list->WritePointer(list->GetNumberOfIds(), n);
+        std::copy(ids, ids + n, dst);
+    }
+};
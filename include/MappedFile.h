@@ -0,0 +1,127 @@
+#pragma once
+
+#include <vtkType.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace AUtils
+{
+    /**
+     * 只读的内存映射文件，析构时解除映射。
+     */
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        ~MappedFile() { this->Close(); }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        /**
+         * 以只读方式映射整个文件。
+         * @return 文件不存在、为空或映射失败时返回false。
+         */
+        bool Open(const char *path);
+
+        void Close();
+
+        const char *GetData() const { return this->Data; }
+        size_t GetSize() const { return this->Size; }
+
+    private:
+        const char *Data = nullptr;
+        size_t Size = 0;
+#ifdef _WIN32
+        void *FileHandle = nullptr;
+        void *MappingHandle = nullptr;
+#endif
+    };
+
+    /**
+     * 计算一段内存的64位校验值。数据按1MiB分块并行计算后再合并，结果与线程数无关。
+     */
+    vtkTypeUInt64 Checksum(const void *data, size_t size, vtkTypeUInt64 seed = 0);
+
+    /**
+     * 由文件的路径、大小与修改时间计算标识，不读取文件内容，可作为由该文件得到的数据的缓存键。
+     * @return 文件不存在时返回0。
+     */
+    vtkTypeUInt64 GetFileKey(const char *path);
+
+    /**
+     * 与 path 同目录的临时文件名，附加进程id与进程内的序号，多个进程或线程同时保存同一文件时不会写入同一个临时文件。
+     */
+    std::string GetTempPath(const char *path);
+
+    /**
+     * 将完整写入的临时文件 tmpPath 重命名为 path，替换已有的文件，写入中途失败时不会留下不完整的 path。
+     * @return 失败时返回false，tmpPath 保留。
+     */
+    bool ReplaceFile(const char *tmpPath, const char *path);
+
+    /**
+     * 树的数据数组：构建时持有自己的数据，从文件加载时直接指向映射的内存，不做拷贝。
+     * 映射的内存只读，只有持有数据时才能写入。
+     */
+    template <typename T>
+    class TreeArray
+    {
+    public:
+        size_t size() const { return this->Size; }
+        bool empty() const { return this->Size == 0; }
+
+        const T *data() const { return this->Data; }
+        T *data() { return const_cast<T *>(this->Data); }
+        const T *begin() const { return this->Data; }
+        const T *end() const { return this->Data + this->Size; }
+
+        const T &operator[](size_t i) const { return this->Data[i]; }
+        T &operator[](size_t i) { return const_cast<T *>(this->Data)[i]; }
+
+        void assign(size_t n, const T &value)
+        {
+            this->Owned.assign(n, value);
+            this->Sync();
+        }
+
+        void resize(size_t n)
+        {
+            this->Owned.resize(n);
+            this->Sync();
+        }
+
+        void clear()
+        {
+            this->Owned.clear();
+            this->Sync();
+        }
+
+        /**
+         * 指向外部内存，调用方保证内存在数组使用期间有效。
+         */
+        void Map(const T *data, size_t n)
+        {
+            std::vector<T>().swap(this->Owned);
+            this->Data = data;
+            this->Size = n;
+        }
+
+        /**
+         * 持有的数据占用的字节数，映射的内存不计入。
+         */
+        size_t GetOwnedMemorySize() const { return this->Owned.capacity() * sizeof(T); }
+
+    private:
+        void Sync()
+        {
+            this->Data = this->Owned.data();
+            this->Size = this->Owned.size();
+        }
+
+        std::vector<T> Owned;
+        const T *Data = nullptr;
+        size_t Size = 0;
+    };
+};
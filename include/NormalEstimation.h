@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vtkFloatArray.h>
+#include <vtkPoints.h>
+#include <vtkType.h>
+
+class AvtkKdTreePointLocator;
+
+namespace AUtils
+{
+    /**
+     * 点法向量的计算方式。
+     */
+    enum class NormalMethod
+    {
+        Surface = 0,   // 三角化后由 vtkPolyDataNormals 计算，需要输入带有多边形单元
+        PointCloud = 1 // 由每个点的邻域做局部主成分分析（PCA），不需要单元，适用于扫描得到的原始点云
+    };
+
+    /**
+     * PCA 法向量的定向方式。PCA 只确定法向量所在的直线，方向需要另外确定。
+     */
+    enum class NormalOrientation
+    {
+        None = 0,               // 不定向，方向任意
+        Viewpoint = 1,          // 每个法向量朝向视点，适用于单站扫描
+        MinimumSpanningTree = 2 // 沿邻域图的最小生成树传播方向（Hoppe 方法），每个连通部分中离视点最近的点朝向视点。
+                                // 串行执行，额外保存每个点的定向邻点，堆中最多 2·n·k 条边，大规模点云上明显慢于估计本身
+    };
+
+    /**
+     * PCA 法向量估计的参数。
+     */
+    struct NormalEstimationOptions
+    {
+        int NumberOfNeighbors = 16; // k近邻邻域的点数（包含点本身），Radius 大于0时不使用
+        double Radius = 0.0;        // 大于0时使用该半径内的所有点作为邻域
+        NormalOrientation Orientation = NormalOrientation::Viewpoint; // 闭合或多站扫描的曲面需要一致方向时改为 MinimumSpanningTree
+        double Viewpoint[3] = {0.0, 0.0, 0.0};
+        int NumberOfOrientationNeighbors = 8; // 最小生成树定向时每个点连接的最近邻数，取自法向量的邻域
+    };
+
+    /**
+     * 由局部 PCA 估计每个点的法向量：邻域协方差矩阵最小特征值对应的特征向量。
+     * 邻域查询与特征分解按点并行（vtkSMPTools），最小生成树定向为串行的 Prim 算法。
+     * @param points 点坐标。
+     * @param locator 以 points 的点id构建的定位器，查询前按需构建。
+     * @param normals 输出的单位法向量，3个分量，大小与点数一致时原地写入；邻域少于3个点或退化为一点时为零向量。
+     * @param curvature 非空时输出表面变化度 λ0 / (λ0 + λ1 + λ2)（λ0 为最小特征值），平面为0，各向同性时为 1/3。
+     */
+    void EstimateNormals(vtkPoints *points, AvtkKdTreePointLocator *locator, const NormalEstimationOptions &options,
+                         vtkFloatArray *normals, vtkFloatArray *curvature = nullptr);
+
+    /**
+     * 按 options 中的定向方式统一已有法向量的方向。
+     * @param neighbors 每个点 numNeighbors 个邻点的id（最小生成树定向使用），-1 表示没有邻点。
+     */
+    void OrientNormals(vtkPoints *points, const NormalEstimationOptions &options, const vtkIdType *neighbors,
+                       int numNeighbors, vtkFloatArray *normals);
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <vtkSMPTools.h>
+#include <vtkType.h>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace AUtils
+{
+    /**
+     * 小于该点数的区间使用串行选择。
+     */
+    const vtkIdType ParallelSelectCutoff = 1 << 16;
+
+    /**
+     * 并行快速选择：每轮以抽样中位数为枢轴，分块统计后并行分散到临时数组，
+     * 只在包含第nth个元素的一侧继续，区间足够小后改用 std::nth_element。
+     * 结果满足 std::nth_element 的约定。less 须为严格全序（如坐标相同时再比较id），使枢轴唯一。
+     * @param tmp 与 perm 大小相同的临时数组。
+     */
+    template <typename Index, typename Less>
+    void ParallelSelect(std::vector<Index> &perm, std::vector<Index> &tmp,
+                        vtkIdType begin, vtkIdType nth, vtkIdType end, const Less &less)
+    {
+        const vtkIdType numThreads = std::max(1, vtkSMPTools::GetEstimatedNumberOfThreads());
+        while (end - begin > ParallelSelectCutoff)
+        {
+            vtkIdType n = end - begin;
+
+            // 9个等距样本的中位数作为枢轴
+            std::array<Index, 9> samples;
+            for (int k = 0; k < 9; ++k)
+            {
+                samples[k] = perm[begin + k * (n - 1) / 8];
+            }
+            std::nth_element(samples.begin(), samples.begin() + 4, samples.end(), less);
+            const Index pivot = samples[4];
+
+            const vtkIdType numBlocks = std::min(numThreads * 4, n / 4096 + 1);
+            std::vector<vtkIdType> lessCount(numBlocks + 1, 0);
+            std::vector<vtkIdType> greaterCount(numBlocks + 1, 0);
+            auto blockBegin = [&](vtkIdType b)
+            { return begin + b * n / numBlocks; };
+
+            vtkSMPTools::For(0, numBlocks, 1,
+                             [&](vtkIdType b0, vtkIdType b1)
+                             {
+                                 for (vtkIdType b = b0; b < b1; ++b)
+                                 {
+                                     vtkIdType numLess = 0, numGreater = 0;
+                                     for (vtkIdType j = blockBegin(b); j < blockBegin(b + 1); ++j)
+                                     {
+                                         if (less(perm[j], pivot))
+                                             ++numLess;
+                                         else if (perm[j] != pivot)
+                                             ++numGreater;
+                                     }
+                                     lessCount[b + 1] = numLess;
+                                     greaterCount[b + 1] = numGreater;
+                                 }
+                             });
+            for (vtkIdType b = 0; b < numBlocks; ++b)
+            {
+                lessCount[b + 1] += lessCount[b];
+                greaterCount[b + 1] += greaterCount[b];
+            }
+            const vtkIdType pos = begin + lessCount[numBlocks];
+
+            vtkSMPTools::For(0, numBlocks, 1,
+                             [&](vtkIdType b0, vtkIdType b1)
+                             {
+                                 for (vtkIdType b = b0; b < b1; ++b)
+                                 {
+                                     vtkIdType lessDst = begin + lessCount[b];
+                                     vtkIdType greaterDst = pos + 1 + greaterCount[b];
+                                     for (vtkIdType j = blockBegin(b); j < blockBegin(b + 1); ++j)
+                                     {
+                                         if (less(perm[j], pivot))
+                                             tmp[lessDst++] = perm[j];
+                                         else if (perm[j] != pivot)
+                                             tmp[greaterDst++] = perm[j];
+                                     }
+                                 }
+                             });
+            tmp[pos] = pivot;
+            vtkSMPTools::For(begin, end,
+                             [&](vtkIdType j0, vtkIdType j1)
+                             { std::copy(tmp.begin() + j0, tmp.begin() + j1, perm.begin() + j0); });
+
+            if (nth == pos)
+                return;
+            if (nth < pos)
+                end = pos;
+            else
+                begin = pos + 1;
+        }
+        std::nth_element(perm.begin() + begin, perm.begin() + nth, perm.begin() + end, less);
+    }
+};
@@ -10,18 +10,25 @@
 #include <vtkArrowSource.h>
 #include <vtkGlyph3D.h>
 #include <vtkAlgorithmOutput.h>
+#include <vtkPlanes.h>
 #include <unordered_set>
 #include <cmath>
 #include <limits>
 
 #include <vector>
 #include <array>
+#include <atomic>
+#include <mutex>
 #include <cmath>
 #include <stdexcept>
+#include <string>
 
 #include "VisualizationPipeline.h"
 #include "CubeFrame.h"
+#include "SpaceFillingCurve.h"
+#include "NormalEstimation.h"
 #include "AvtkKdTree.h"
+#include "AvtkTriangleBVH.h"
 
 class PointNormalProcessor
 {
@@ -41,6 +48,19 @@ public:
 
     AvtkKdTreePointLocator *GetPointLocator() const { return pointLocator; }
 
+    /**
+     * 冻结定位器，返回当前搜索结构的只读快照，可以在任意多个线程中同时查询，
+     * 见 AvtkKdTreePointLocator::Freeze。之后重新构建定位器会发布新的快照，已取得的快照不受影响。
+     */
+    vtkSmartPointer<AvtkPointLocatorSnapshot> FreezeLocator() { return pointLocator->Freeze(); }
+
+    /**
+     * 替换使用的定位器，可以传入预先设置好搜索结构类型与参数的定位器，例如
+     * 固定半径的查询使用 UNIFORM_GRID 类型并将 GridCellSize 设置为查询半径。
+     * 已有处理结果时立即以新的定位器构建。定位器为空时抛出 std::invalid_argument。
+     */
+    void SetPointLocator(AvtkKdTreePointLocator *locator);
+
     double *GetPoint(vtkIdType id) const;
     void GetPoint(vtkIdType id, double *point) const;
 
@@ -52,35 +72,326 @@ public:
 
     void FindPointsInCylinder(const double *point, const double *direction, double radius, vtkIdList *resultIds);
 
+    vtkSmartPointer<vtkIdList> FindPointsInCapsule(const double *start, const double *end, double radius);
+
+    void FindPointsInCapsule(const double *start, const double *end, double radius, vtkIdList *resultIds);
+
     void FindPointsInArea(double *area, vtkIdList *ids);
 
     void FindPointsInCuboid(double cuboid[8][3], vtkIdList *ids);
 
+    /**
+     * 查找凸多面体内的所有点，每个平面 (nx, ny, nz, d)，法向指向外部，
+     * 见 AvtkKdTreePointLocator::FindPointsWithinConvexPolytope。
+     */
+    void FindPointsInConvexPolytope(const double *planes, int numPlanes, vtkIdList *ids);
+
+    /**
+     * 以 vtkPlanes 给出的凸多面体查询，例如由 vtkPlanes::SetFrustumPlanes 得到的相机视锥。
+     */
+    void FindPointsInConvexPolytope(vtkPlanes *planes, vtkIdList *ids);
+
+    /**
+     * 查找到多段线距离不超过 radius 的所有点（沿刀具路径扫掠的管道），整条路径只遍历一次KD树，结果不重复。
+     * @param points numPoints 个连续的 (x, y, z) 顶点。
+     * @param segmentIds 非空时返回每个结果点最近的线段序号，第i段连接第i与第i+1个顶点。
+     * @param parameters 非空时返回最近点在该线段上的参数，0 为起点，1 为终点。
+     */
+    void FindPointsInTube(const double *points, int numPoints, double radius, vtkIdList *ids,
+                          vtkIdTypeArray *segmentIds = nullptr, vtkDoubleArray *parameters = nullptr);
+
+    /**
+     * 只统计区域内的点数，不生成点id列表。
+     */
+    vtkIdType CountPointsWithinRadius(double radius, const double *center) const;
+
+    vtkIdType CountPointsInCylinder(const double *point, const double *direction, double radius);
+
+    vtkIdType CountPointsInCapsule(const double *start, const double *end, double radius);
+
+    vtkIdType CountPointsInArea(double *area);
+
+    vtkIdType CountPointsInCuboid(double cuboid[8][3]);
+
+    vtkIdType CountPointsInConvexPolytope(const double *planes, int numPlanes);
+
+    vtkIdType CountPointsInTube(const double *points, int numPoints, double radius);
+
+    /**
+     * 区域内点的汇总统计：点数、质心、协方差与法向量之和，见 AUtils::PointStatistics。
+     * 平均法向量由 GetMeanNormal() 取得，与按区域点id调用 GetMeanNormal(ids, normal) 的结果一致，
+     * 也可以直接调用 GetMeanNormalWithinRadius 等函数。
+     * 默认的KD树在构建时为每个节点保存子树的汇总量，完全位于区域内的子树 O(1) 合并，不逐点枚举。
+     */
+    AUtils::PointStatistics GetStatisticsWithinRadius(double radius, const double *center);
+
+    AUtils::PointStatistics GetStatisticsInCylinder(const double *point, const double *direction, double radius);
+
+    AUtils::PointStatistics GetStatisticsInCapsule(const double *start, const double *end, double radius);
+
+    AUtils::PointStatistics GetStatisticsInArea(double *area);
+
+    AUtils::PointStatistics GetStatisticsInCuboid(double cuboid[8][3]);
+
+    AUtils::PointStatistics GetStatisticsInConvexPolytope(const double *planes, int numPlanes);
+
+    /**
+     * 对区域内的每个点调用 f(id)，点id直接从KD树的叶子传出，不生成中间列表，顺序不确定。
+     */
+    template <typename F>
+    void ForEachPointWithinRadius(double radius, const double *center, F &&f) const
+    {
+        pointLocator->ForEachPointWithinRadius(radius, center, std::forward<F>(f));
+    }
+
+    template <typename F>
+    void ForEachPointInCylinder(const double *point, const double *direction, double radius, F &&f)
+    {
+        CheckDirection(direction);
+        pointLocator->ForEachPointWithinCylinder(point, direction, radius, std::forward<F>(f));
+    }
+
+    template <typename F>
+    void ForEachPointInCapsule(const double *start, const double *end, double radius, F &&f)
+    {
+        pointLocator->ForEachPointWithinCapsule(start, end, radius, std::forward<F>(f));
+    }
+
+    template <typename F>
+    void ForEachPointInArea(double *area, F &&f)
+    {
+        pointLocator->ForEachPointWithinArea(area, std::forward<F>(f));
+    }
+
+    template <typename F>
+    void ForEachPointInCuboid(double cuboid[8][3], F &&f)
+    {
+        pointLocator->ForEachPointWithinCuboid(cuboid, std::forward<F>(f));
+    }
+
+    template <typename F>
+    void ForEachPointInConvexPolytope(const double *planes, int numPlanes, F &&f)
+    {
+        pointLocator->ForEachPointWithinConvexPolytope(planes, numPlanes, std::forward<F>(f));
+    }
+
+    template <typename F>
+    void ForEachPointInTube(const double *points, int numPoints, double radius, F &&f)
+    {
+        pointLocator->ForEachPointWithinTube(points, numPoints, radius, std::forward<F>(f));
+    }
+
     vtkIdType FindClosestPoint(const double x[3]) const;
 
+    /**
+     * 与另一个处理器的点做半径连接，返回本数据的点 i 与 other 的点 j 之间距离不超过 radius 的所有点对，
+     * 2个分量 (i, j)，按 i、j 升序排列。两者都使用 VTK_KD_TREE 定位器时同时遍历两棵KD树，
+     * 见 AvtkKdTreePointLocator::FindPairsWithinRadius。
+     * @param dist2 非空时返回每个点对的距离平方。
+     */
+    void FindPairsWithinRadius(const PointNormalProcessor &other, double radius, vtkIdTypeArray *pairs,
+                               vtkDoubleArray *dist2 = nullptr) const;
+
+    /**
+     * 对本数据的每个点查找 other 中的最近点，距离超过 maxDistance 时为-1。
+     * @param dist2 非空时返回距离平方，没有最近点时为 VTK_DOUBLE_MAX。
+     */
+    void FindClosestPoints(const PointNormalProcessor &other, vtkIdTypeArray *ids, vtkDoubleArray *dist2 = nullptr,
+                           double maxDistance = VTK_DOUBLE_MAX) const;
+
     void GetMeanNormal(vtkIdList *ids, double *normal);
 
+    /**
+     * 区域内点的平均法向量，由 GetStatistics* 的法向量之和归一化得到，不生成点id列表，
+     * 结果与对区域点id调用 GetMeanNormal(ids, normal) 一致。
+     * @return 区域内没有点或法向量之和为0时返回false，normal 为零向量。
+     */
+    bool GetMeanNormalWithinRadius(double radius, const double *center, double *normal);
+
+    bool GetMeanNormalInCylinder(const double *point, const double *direction, double radius, double *normal);
+
+    bool GetMeanNormalInCapsule(const double *start, const double *end, double radius, double *normal);
+
+    bool GetMeanNormalInArea(double *area, double *normal);
+
+    bool GetMeanNormalInCuboid(double cuboid[8][3], double *normal);
+
+    bool GetMeanNormalInConvexPolytope(const double *planes, int numPlanes, double *normal);
+
     void SetGlyph3DVisibility(bool visibility);
 
+    /**
+     * 设置箭头的缩放系数，默认为1。箭头在下次渲染时按需重新生成，不可见时不生成。
+     */
     void SetGlyph3DScaleFactor(double scaleFactor);
 
     vtkSmartPointer<vtkActor> GetArrowActor();
 
-    void SetRadiusRatio(double ratio);
-    void SetIntervalRatio(double ratio);
+    /**
+     * 已弃用：球链近似参数。FindPointsInCylinder 已改为KD树原生查询，这两个参数不再影响任何结果，
+     * 只为兼容已有的调用保留，将在之后的版本中移除。
+     */
+    [[deprecated("FindPointsInCylinder 不再使用球链近似，该参数无效")]] void SetRadiusRatio(double ratio);
+    [[deprecated("FindPointsInCylinder 不再使用球链近似，该参数无效")]] void SetIntervalRatio(double ratio);
 
-    double GetRadiusRatio() const { return radiusRatio; }
-    double GetIntervalRatio() const { return intervalRatio; }
+    [[deprecated("FindPointsInCylinder 不再使用球链近似，该参数无效")]] double GetRadiusRatio() const { return radiusRatio; }
+    [[deprecated("FindPointsInCylinder 不再使用球链近似，该参数无效")]] double GetIntervalRatio() const { return intervalRatio; }
 
+    /**
+     * x到表面的有符号距离，位于法向量一侧时为正。
+     * 有三角形时为到三角网格表面的精确距离，否则为到最近点的距离，符号取该点的法向量。
+     */
     double GetDistance(const double x[3]) const;
 
+    /**
+     * 查找x在三角网格表面上的最近点，返回最近点、三角形的单元id、重心坐标与有符号距离。
+     * @return 没有三角形时返回false。
+     */
+    bool FindClosestSurfacePoint(const double x[3], AUtils::SurfacePoint &result) const;
+
+    /**
+     * 批量计算到三角网格表面的有符号距离，numQueries 个查询点以连续的 (x, y, z) 给出，并行执行，
+     * 见 AvtkTriangleBVH::FindClosestPointsBatch。没有三角形时距离为 VTK_DOUBLE_MAX。
+     */
+    void GetDistances(vtkIdType numQueries, const double *x, vtkDoubleArray *distances,
+                      vtkIdTypeArray *cellIds = nullptr, vtkDoubleArray *closestPoints = nullptr) const;
+
+    /**
+     * 求射线 origin + t * direction（t >= 0）与三角网格表面的第一个交点，用于拾取，
+     * 见 AvtkTriangleBVH::IntersectRay。只查找到起点距离不超过 maxDistance 的交点。
+     * @return 没有三角形或没有交点时返回false。
+     */
+    bool IntersectRay(const double origin[3], const double direction[3], AUtils::RayHit &hit,
+                      double maxDistance = VTK_DOUBLE_MAX) const;
+
+    /**
+     * 求射线与三角网格表面的所有交点，按距离从近到远排列，返回交点数。
+     */
+    int IntersectRayAll(const double origin[3], const double direction[3], std::vector<AUtils::RayHit> &hits,
+                        double maxDistance = VTK_DOUBLE_MAX) const;
+
+    /**
+     * 批量求第一个交点，numRays 条射线的起点与方向以连续的 (x, y, z) 给出，并行执行，
+     * 见 AvtkTriangleBVH::IntersectRays。未命中时距离为 VTK_DOUBLE_MAX。
+     */
+    void IntersectRays(vtkIdType numRays, const double *origins, const double *directions, vtkDoubleArray *distances,
+                       vtkIdTypeArray *cellIds = nullptr, vtkDoubleArray *points = nullptr,
+                       double maxDistance = VTK_DOUBLE_MAX) const;
+
+    /**
+     * 在 bounds 范围内 dims 个采样点的规则网格上计算有符号距离场，并行执行，距离存放在点标量 "Distance" 中。
+     * 有三角形时见 AvtkTriangleBVH::ComputeDistanceField，否则逐点调用 GetDistance。
+     * @param maxDistance 窄带宽度，大于0时距离截断到 [-maxDistance, maxDistance]，窄带外的点跳过精确搜索。
+     * @param singlePrecision 为true时输出 vtkFloatArray，否则输出 vtkDoubleArray。
+     */
+    vtkSmartPointer<vtkImageData> ComputeDistanceField(const double bounds[6], const int dims[3],
+                                                       double maxDistance = 0.0, bool singlePrecision = true) const;
+
+    /**
+     * 处理后数据的三角形BVH。Update 不构建BVH，在第一次表面查询或调用本函数时构建，只用点查询时不占用内存与时间。
+     */
+    AvtkTriangleBVH *GetSurfaceLocator() const;
+
+    /**
+     * 按阶段更新，每个阶段只在其输入变化时重新执行：
+     * 1. 法向量：输入数据（指针与修改时间）、法向量计算方式、PCA 参数、重排方式变化时重新计算；
+     *    Surface 方式下输入已是带点法向量的三角网格时直接浅拷贝，不再三角化与计算法向量。
+     * 2. 定位器：处理后的数据、点定位器或缓存文件变化时重建点定位器；处理后的数据变化时三角形BVH标记为过期，
+     *    在下一次表面查询时重建，使用缓存时随缓存一起读取或写入。
+     * 3. 箭头：vtkGlyph3D 以管线连接到箭头的 mapper，只在箭头 actor 可见并渲染时按需生成。
+     * 输入与参数都没有变化时 Update 不做任何计算。使用缓存时见 SetCacheSourceKey。
+     */
     void Update();
 
+    /**
+     * 设置计算法向量后点的重排方式，下次 Update 时生效，默认为 None（保持 vtkPolyDataNormals 输出的顺序）。
+     * 重排后空间上相邻的点在内存中也相邻，查询结果读取坐标与法向量时访问的缓存行更少。
+     * 点坐标、法向量等点数据与单元连接关系一起重排，查询返回的点id均为重排后的id。
+     */
+    void SetPointOrdering(AUtils::SpaceFillingCurve curve);
+    AUtils::SpaceFillingCurve GetPointOrdering() const { return pointOrdering; }
+
+    /**
+     * 设置法向量的计算方式，下次 Update 时生效，默认为 Surface。
+     * PointCloud 不三角化，直接由输入点的邻域做并行 PCA，没有单元的点云也能得到法向量，
+     * 邻域查询使用当前的点定位器，参数见 SetNormalEstimationOptions。
+     */
+    void SetNormalMethod(AUtils::NormalMethod method);
+    AUtils::NormalMethod GetNormalMethod() const { return normalMethod; }
+
+    /**
+     * PointCloud 方式的邻域与定向参数，见 AUtils::NormalEstimationOptions。
+     */
+    void SetNormalEstimationOptions(const AUtils::NormalEstimationOptions &options);
+    const AUtils::NormalEstimationOptions &GetNormalEstimationOptions() const { return normalEstimationOptions; }
+
+    /**
+     * PointCloud 方式下是否同时输出表面变化度，存放在点数据 "Curvature" 中，默认为false。
+     */
+    void SetComputeCurvature(bool compute);
+    bool GetComputeCurvature() const { return computeCurvature; }
+
+    /**
+     * 表面变化度数组，未计算时返回nullptr。
+     */
+    vtkDataArray *GetCurvature() const
+    {
+        return processedPolyData ? processedPolyData->GetPointData()->GetArray("Curvature") : nullptr;
+    }
+
+    /**
+     * 重排前的点id到重排后点id的映射，重排前的点id即 vtkPolyDataNormals 输出中的点id，PointCloud 方式下即输入中的点id。
+     * 未重排时为空；AppendPoints 追加的点不在映射中。
+     */
+    const std::vector<vtkIdType> &GetOldToNewPointIds() const { return oldToNewPointIds; }
+
+    /**
+     * 重排后的点id到重排前点id的映射，未重排时为空。
+     */
+    const std::vector<vtkIdType> &GetNewToOldPointIds() const { return newToOldPointIds; }
+
+    /**
+     * 设置定位器的缓存文件，为空时不使用缓存（默认）。
+     * 只在定位器为 FLAT_KD_TREE 类型时生效：构建定位器时先尝试内存映射缓存文件，
+     * 文件不存在或与当前数据、参数不符时重新构建并写入缓存，见 AvtkKdTreePointLocator::Load。
+     */
+    void SetLocatorCacheFile(const std::string &path);
+    const std::string &GetLocatorCacheFile() const { return locatorCacheFile; }
+
+    /**
+     * 设置输入数据来源的标识，例如读入文件的 AUtils::GetFileKey（路径、大小与修改时间），为0时不使用（默认）。
+     * 不为0且设置了缓存文件时缓存整个处理结果：处理后的数据写入 <缓存文件>.vtp，三角形BVH写入 <缓存文件>.bvh，
+     * FLAT_KD_TREE 类型的KD树写入缓存文件本身，均以该标识与处理参数为键。
+     * 输入变化后的 Update 先读取这些文件，都有效时跳过三角化、法向量计算与BVH、KD树的构建，也不再对点坐标求校验值。
+     * 标识由调用者保证与输入数据对应，数据改变而标识不变时会读到过期的结果；AppendPoints 之后的数据不写入缓存。
+     */
+    void SetCacheSourceKey(vtkTypeUInt64 key);
+    vtkTypeUInt64 GetCacheSourceKey() const { return cacheSourceKey; }
+
+    /**
+     * 向处理后的数据追加点，不重新三角化与计算法向量。
+     * 定位器为 INCREMENTAL_KD_TREE 类型时只插入新增的点，否则重建定位器；箭头在下次 Update 时刷新。
+     * 法向量以外的点数据数组（如曲率、标量）同样扩展到新的点数，新增点的值为0。
+     * @param points 要追加的点。
+     * @param normals 新增点的法向量，处理后的数据带有法向量时必须提供，数量与点数一致，分量数与已有法向量相同。
+     */
+    void AppendPoints(vtkPoints *points, vtkDataArray *normals);
+
+    /**
+     * 从查询中移除一个点，点仍保留在数据中，需要定位器为 INCREMENTAL_KD_TREE 类型。
+     * @return 点此前可以被查询到时返回true。
+     */
+    bool RemovePoint(vtkIdType id);
+
     vtkSmartPointer<vtkIdList> GetUniquePointsInSpheres(
         const std::vector<std::array<double, 3>> &sphereCenters,
         double sphereRadius) const;
 
-    static std::vector<std::array<double, 3>> GenerateSphereCenters(
+    /**
+     * 已弃用：沿线段 start-end 以 sphereInterval 为间隔生成球心，原用于以球链近似圆柱查询。
+     * 圆柱与胶囊体查询已改为KD树原生查询，需要沿线段的邻域时使用 FindPointsInCapsule。
+     */
+    [[deprecated("使用 FindPointsInCapsule 代替球链近似")]] static std::vector<std::array<double, 3>> GenerateSphereCenters(
         const double start[3],
         const double end[3],
         double sphereInterval,
@@ -91,16 +402,70 @@ public:
     std::vector<CubeFrame *> GetRegionBoundsByPoint(double x, double y, double z);
 
 private:
-    double ComputeProjection(const double v[3], const double u[3]) const;
-    std::array<double, 2> ComputeBoundingBoxProjectionRange(const double point[3], const double direction[3]) const;
     void BuildLocator();
 
-    double radiusRatio = 1.2247;
-    double intervalRatio = 1.4142;
+    /**
+     * Update 的法向量阶段，输出 processedPolyData。
+     */
+    void UpdateNormals();
+
+    /**
+     * 缓存文件的键，由来源标识与影响处理结果的参数组成。
+     */
+    vtkTypeUInt64 ComputeCacheKey() const;
+
+    /**
+     * 从缓存文件读取处理后的数据与三角形BVH，代替法向量阶段。
+     * @return 文件不存在或已过期时返回false。
+     */
+    bool LoadCache();
+
+    /**
+     * 将处理后的数据与三角形BVH写入缓存文件。
+     */
+    void SaveCache();
+
+    /**
+     * 返回三角形BVH，过期时先由处理后的数据重建。表面查询可能在多个线程中同时调用，构建只执行一次。
+     */
+    AvtkTriangleBVH *GetSurface() const;
+
+    /**
+     * 方向向量长度为0时抛出 std::invalid_argument。
+     */
+    static void CheckDirection(const double *direction);
+
+    double radiusRatio = 1.2247;   // 已弃用，不再使用
+    double intervalRatio = 1.4142; // 已弃用，不再使用
 
     vtkSmartPointer<vtkPolyData> inputData;
     vtkSmartPointer<vtkPolyData> processedPolyData;
     vtkSmartPointer<AvtkKdTreePointLocator> pointLocator;
+    vtkSmartPointer<AvtkTriangleBVH> surfaceLocator;
+    std::string locatorCacheFile;
+    vtkTypeUInt64 cacheSourceKey = 0;
+    // 处理后的数据未经 AppendPoints 修改，与来源标识对应
+    bool processedFromSource = false;
+    AUtils::SpaceFillingCurve pointOrdering = AUtils::SpaceFillingCurve::None;
+    AUtils::NormalMethod normalMethod = AUtils::NormalMethod::Surface;
+    AUtils::NormalEstimationOptions normalEstimationOptions;
+    bool computeCurvature = false;
+    // 各阶段上次执行时的输入，用于判断是否需要重新执行
+    vtkPolyData *normalsInput = nullptr;
+    vtkMTimeType normalsInputMTime = 0;
+    bool normalsModified = true;
+    vtkPolyData *locatorInput = nullptr;
+    vtkMTimeType locatorInputMTime = 0;
+    bool locatorModified = true;
+    vtkPolyData *surfaceInput = nullptr;
+    vtkMTimeType surfaceInputMTime = 0;
+    // 三角形BVH是否与 surfaceInput 对应，为false时在第一次表面查询时构建
+    mutable std::atomic<bool> surfaceBuilt{false};
+    mutable std::mutex surfaceMutex;
+    vtkPolyData *connectionSource = nullptr;
+    vtkMTimeType connectionSourceMTime = 0;
+    std::vector<vtkIdType> oldToNewPointIds;
+    std::vector<vtkIdType> newToOldPointIds;
     vtkSmartPointer<vtkArrowSource> arrowSource;
     vtkSmartPointer<vtkGlyph3D> glyph3D;
 
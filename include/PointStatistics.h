@@ -0,0 +1,157 @@
+#pragma once
+#include <vtkType.h>
+#include <cmath>
+
+namespace AUtils
+{
+    /**
+     * 一组点的汇总统计：点数、质心、相对质心的二阶中心矩与法向量之和。
+     * 两组统计量可以在 O(1) 内合并（Chan 的并行方差合并公式），
+     * 合并时不涉及坐标平方的大数相减，远离原点的点集同样稳定。
+     */
+    struct PointStatistics
+    {
+        vtkIdType Count = 0;
+        double Mean[3] = {0.0, 0.0, 0.0};                // 质心
+        double M2[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};   // 相对质心的二阶矩之和，依次为 xx, xy, xz, yy, yz, zz
+        double NormalSum[3] = {0.0, 0.0, 0.0};           // 法向量之和，没有法向量时为0
+
+        /**
+         * 合并另一组点的统计量。
+         */
+        void Add(const PointStatistics &other)
+        {
+            if (other.Count == 0)
+                return;
+            if (Count == 0)
+            {
+                *this = other;
+                return;
+            }
+            double n = static_cast<double>(Count + other.Count);
+            double wa = static_cast<double>(Count) / n;
+            double wb = static_cast<double>(other.Count) / n;
+            double d[3] = {other.Mean[0] - Mean[0], other.Mean[1] - Mean[1], other.Mean[2] - Mean[2]};
+            double w = static_cast<double>(Count) * wb;
+            M2[0] += other.M2[0] + w * d[0] * d[0];
+            M2[1] += other.M2[1] + w * d[0] * d[1];
+            M2[2] += other.M2[2] + w * d[0] * d[2];
+            M2[3] += other.M2[3] + w * d[1] * d[1];
+            M2[4] += other.M2[4] + w * d[1] * d[2];
+            M2[5] += other.M2[5] + w * d[2] * d[2];
+            for (int k = 0; k < 3; ++k)
+            {
+                Mean[k] = wa * Mean[k] + wb * other.Mean[k];
+                NormalSum[k] += other.NormalSum[k];
+            }
+            Count += other.Count;
+        }
+
+        /**
+         * 质心，没有点时返回false。
+         */
+        bool GetCentroid(double centroid[3]) const
+        {
+            for (int k = 0; k < 3; ++k)
+                centroid[k] = Mean[k];
+            return Count > 0;
+        }
+
+        /**
+         * 总体协方差矩阵 M2 / Count，没有点时返回false。
+         */
+        bool GetCovariance(double covariance[3][3]) const
+        {
+            double scale = Count > 0 ? 1.0 / static_cast<double>(Count) : 0.0;
+            covariance[0][0] = M2[0] * scale;
+            covariance[0][1] = covariance[1][0] = M2[1] * scale;
+            covariance[0][2] = covariance[2][0] = M2[2] * scale;
+            covariance[1][1] = M2[3] * scale;
+            covariance[1][2] = covariance[2][1] = M2[4] * scale;
+            covariance[2][2] = M2[5] * scale;
+            return Count > 0;
+        }
+
+        /**
+         * 归一化的平均法向量，与 PointNormalProcessor::GetMeanNormal 一致；
+         * 法向量之和为0（没有点或没有法向量）时返回false并输出零向量。
+         */
+        bool GetMeanNormal(double normal[3]) const
+        {
+            double len = std::sqrt(NormalSum[0] * NormalSum[0] + NormalSum[1] * NormalSum[1] + NormalSum[2] * NormalSum[2]);
+            for (int k = 0; k < 3; ++k)
+                normal[k] = len > 0.0 ? NormalSum[k] / len : 0.0;
+            return len > 0.0;
+        }
+    };
+
+    /**
+     * 逐点累加 PointStatistics。坐标先减去平移原点再累加一阶与二阶原点矩，
+     * 原点取在点集附近（如所在叶子包围盒的中心）时避免大数相减造成的精度损失。
+     */
+    struct PointStatisticsAccumulator
+    {
+        double Origin[3] = {0.0, 0.0, 0.0};
+        vtkIdType Count = 0;
+        double Sum[3] = {0.0, 0.0, 0.0};
+        double Moments[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+        double NormalSum[3] = {0.0, 0.0, 0.0};
+
+        /**
+         * 清空累加结果并设置平移原点。
+         */
+        void Init(const double origin[3])
+        {
+            *this = PointStatisticsAccumulator();
+            for (int k = 0; k < 3; ++k)
+                Origin[k] = origin[k];
+        }
+
+        void AddPoint(const double p[3])
+        {
+            double d[3] = {p[0] - Origin[0], p[1] - Origin[1], p[2] - Origin[2]};
+            ++Count;
+            Sum[0] += d[0];
+            Sum[1] += d[1];
+            Sum[2] += d[2];
+            Moments[0] += d[0] * d[0];
+            Moments[1] += d[0] * d[1];
+            Moments[2] += d[0] * d[2];
+            Moments[3] += d[1] * d[1];
+            Moments[4] += d[1] * d[2];
+            Moments[5] += d[2] * d[2];
+        }
+
+        void AddNormal(const double n[3])
+        {
+            NormalSum[0] += n[0];
+            NormalSum[1] += n[1];
+            NormalSum[2] += n[2];
+        }
+
+        /**
+         * 将累加结果转换为 PointStatistics 并合并到 stats。
+         */
+        void AddTo(PointStatistics &stats) const
+        {
+            if (Count == 0)
+                return;
+            PointStatistics local;
+            double n = static_cast<double>(Count);
+            double m[3] = {Sum[0] / n, Sum[1] / n, Sum[2] / n};
+            local.Count = Count;
+            local.M2[0] = Moments[0] - Sum[0] * m[0];
+            local.M2[1] = Moments[1] - Sum[0] * m[1];
+            local.M2[2] = Moments[2] - Sum[0] * m[2];
+            local.M2[3] = Moments[3] - Sum[1] * m[1];
+            local.M2[4] = Moments[4] - Sum[1] * m[2];
+            local.M2[5] = Moments[5] - Sum[2] * m[2];
+            for (int k = 0; k < 3; ++k)
+            {
+                local.Mean[k] = Origin[k] + m[k];
+                local.NormalSum[k] = NormalSum[k];
+            }
+            stats.Add(local);
+        }
+    };
+};
@@ -0,0 +1,832 @@
+#pragma once
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace AUtils
+{
+    /**
+     * 包围盒与查询形状的空间关系。
+     */
+    enum class BoxRelation
+    {
+        Outside,   // 包围盒与形状不相交
+        Intersect, // 包围盒与形状部分相交
+        Inside     // 包围盒完全位于形状内部
+    };
+
+    /**
+     * 圆柱体查询形状，支持无限长圆柱与有限长胶囊体（两端为半球）。
+     * 用于KD树遍历时的节点裁剪与叶子内的点测试。
+     */
+    struct CylinderShape
+    {
+        double Origin[3];   // 轴线起点
+        double Axis[3];     // 单位轴向量
+        double Radius;      // 半径
+        double Radius2;     // 半径平方
+        double Length;      // 胶囊体轴线长度
+        bool Finite;        // true 表示胶囊体，false 表示无限长圆柱
+        double AxisBounds[6]; // 胶囊体的正轴包围盒（仅 Finite 时有效）
+
+        /**
+         * 初始化为无限长圆柱。
+         * @param point 轴线上一点
+         * @param direction 轴方向，无需归一化
+         * @param radius 圆柱半径
+         * @return 方向向量长度为0时返回false
+         */
+        bool InitCylinder(const double point[3], const double direction[3], double radius)
+        {
+            double norm = std::sqrt(direction[0] * direction[0] +
+                                    direction[1] * direction[1] +
+                                    direction[2] * direction[2]);
+            if (norm < 1e-8)
+                return false;
+            for (int i = 0; i < 3; ++i)
+            {
+                Origin[i] = point[i];
+                Axis[i] = direction[i] / norm;
+            }
+            Radius = radius;
+            Radius2 = radius * radius;
+            Length = 0.0;
+            Finite = false;
+            return true;
+        }
+
+        /**
+         * 初始化为胶囊体（线段 p0-p1 扫过半径为 radius 的球）。
+         * 当 p0 与 p1 重合时退化为球体。
+         */
+        bool InitCapsule(const double p0[3], const double p1[3], double radius)
+        {
+            double d[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+            double len = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+            for (int i = 0; i < 3; ++i)
+            {
+                Origin[i] = p0[i];
+                Axis[i] = len > 1e-12 ? d[i] / len : (i == 0 ? 1.0 : 0.0);
+                AxisBounds[2 * i] = std::min(p0[i], p1[i]) - radius;
+                AxisBounds[2 * i + 1] = std::max(p0[i], p1[i]) + radius;
+            }
+            Radius = radius;
+            Radius2 = radius * radius;
+            Length = len > 1e-12 ? len : 0.0;
+            Finite = true;
+            return true;
+        }
+
+        /**
+         * 点到轴线（或线段）距离的平方。
+         */
+        double Distance2(const double p[3]) const
+        {
+            double v[3] = {p[0] - Origin[0], p[1] - Origin[1], p[2] - Origin[2]};
+            double t = v[0] * Axis[0] + v[1] * Axis[1] + v[2] * Axis[2];
+            if (Finite)
+                t = std::min(std::max(t, 0.0), Length);
+            double w[3] = {v[0] - t * Axis[0], v[1] - t * Axis[1], v[2] - t * Axis[2]};
+            return w[0] * w[0] + w[1] * w[1] + w[2] * w[2];
+        }
+
+        bool Contains(const double p[3]) const
+        {
+            return Distance2(p) <= Radius2;
+        }
+
+        /**
+         * 判断正轴包围盒与形状的关系。
+         * 外部判定为保守判定：返回Outside时一定不相交，返回Intersect时可能实际不相交。
+         * @param bounds 包围盒 {xmin, xmax, ymin, ymax, zmin, zmax}
+         */
+        BoxRelation Classify(const double bounds[6]) const
+        {
+            if (Finite)
+            {
+                for (int i = 0; i < 3; ++i)
+                {
+                    if (bounds[2 * i] > AxisBounds[2 * i + 1] || bounds[2 * i + 1] < AxisBounds[2 * i])
+                        return BoxRelation::Outside;
+                }
+            }
+
+            // 以包围盒中心到轴线的垂直方向作为分离轴
+            double c[3], h[3];
+            for (int i = 0; i < 3; ++i)
+            {
+                c[i] = 0.5 * (bounds[2 * i] + bounds[2 * i + 1]);
+                h[i] = 0.5 * (bounds[2 * i + 1] - bounds[2 * i]);
+            }
+            double v[3] = {c[0] - Origin[0], c[1] - Origin[1], c[2] - Origin[2]};
+            double t = v[0] * Axis[0] + v[1] * Axis[1] + v[2] * Axis[2];
+            double perp[3] = {v[0] - t * Axis[0], v[1] - t * Axis[1], v[2] - t * Axis[2]};
+            double d = std::sqrt(perp[0] * perp[0] + perp[1] * perp[1] + perp[2] * perp[2]);
+            if (d > 0.0)
+            {
+                double rn = (h[0] * std::fabs(perp[0]) + h[1] * std::fabs(perp[1]) + h[2] * std::fabs(perp[2])) / d;
+                if (d - rn > Radius)
+                    return BoxRelation::Outside;
+            }
+
+            // 形状为凸体，8个角点全部在内部则包围盒完全在内部
+            for (int i = 0; i < 8; ++i)
+            {
+                double p[3] = {bounds[(i & 1) ? 1 : 0], bounds[(i & 2) ? 3 : 2], bounds[(i & 4) ? 5 : 4]};
+                if (!Contains(p))
+                    return BoxRelation::Intersect;
+            }
+            return BoxRelation::Inside;
+        }
+    };
+
+    /**
+     * 长方体查询形状，由8个角点定义（角点顺序与AUtils::cubeIndices一致）。
+     * 6个面的平面方程在初始化时计算一次，节点分类使用分离轴测试。
+     */
+    struct CuboidShape
+    {
+        double Normals[6][3]; // 各面的外法向
+        double D[6];          // 平面方程常数项 (n·x + d = 0)
+        double Bounds[6];     // 角点的正轴包围盒
+        double Axes[9][3];    // 长方体棱方向与坐标轴的叉积
+        double AxisRange[9][2]; // 角点在各叉积轴上的投影范围
+
+        void Init(const double cuboid[8][3])
+        {
+            // 各面由4个角点定义，参考AUtils::cubeEdges的顺序
+            const int faces[6][4] = {
+                {0, 1, 3, 2}, // 底面
+                {4, 5, 7, 6}, // 顶面
+                {0, 1, 5, 4}, // 侧面1
+                {1, 3, 7, 5}, // 侧面2
+                {3, 2, 6, 7}, // 侧面3
+                {2, 0, 4, 6}  // 侧面4
+            };
+
+            double center[3] = {0, 0, 0};
+            for (int i = 0; i < 3; ++i)
+            {
+                Bounds[2 * i] = cuboid[0][i];
+                Bounds[2 * i + 1] = cuboid[0][i];
+            }
+            for (int j = 0; j < 8; ++j)
+            {
+                for (int i = 0; i < 3; ++i)
+                {
+                    center[i] += cuboid[j][i] / 8.0;
+                    Bounds[2 * i] = std::min(Bounds[2 * i], cuboid[j][i]);
+                    Bounds[2 * i + 1] = std::max(Bounds[2 * i + 1], cuboid[j][i]);
+                }
+            }
+
+            for (int i = 0; i < 6; ++i)
+            {
+                const double *p0 = cuboid[faces[i][0]];
+                const double *p1 = cuboid[faces[i][1]];
+                const double *p2 = cuboid[faces[i][2]];
+                double v1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+                double v2[3] = {p2[0] - p1[0], p2[1] - p1[1], p2[2] - p1[2]};
+                double *n = Normals[i];
+                n[0] = v1[1] * v2[2] - v1[2] * v2[1];
+                n[1] = v1[2] * v2[0] - v1[0] * v2[2];
+                n[2] = v1[0] * v2[1] - v1[1] * v2[0];
+                double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if (length > 0)
+                {
+                    n[0] /= length;
+                    n[1] /= length;
+                    n[2] /= length;
+                }
+                D[i] = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+
+                // 确保法向量指向长方体外部
+                double dot = n[0] * (center[0] - p0[0]) + n[1] * (center[1] - p0[1]) + n[2] * (center[2] - p0[2]);
+                if (dot > 0)
+                {
+                    n[0] = -n[0];
+                    n[1] = -n[1];
+                    n[2] = -n[2];
+                    D[i] = -D[i];
+                }
+            }
+
+            // 棱方向 (0-1, 0-2, 0-4) 与坐标轴的叉积，作为分离轴测试的补充轴
+            const int edges[3] = {1, 2, 4};
+            for (int e = 0; e < 3; ++e)
+            {
+                double dir[3] = {cuboid[edges[e]][0] - cuboid[0][0],
+                                 cuboid[edges[e]][1] - cuboid[0][1],
+                                 cuboid[edges[e]][2] - cuboid[0][2]};
+                for (int k = 0; k < 3; ++k)
+                {
+                    double *a = Axes[3 * e + k];
+                    double unit[3] = {0, 0, 0};
+                    unit[k] = 1.0;
+                    a[0] = dir[1] * unit[2] - dir[2] * unit[1];
+                    a[1] = dir[2] * unit[0] - dir[0] * unit[2];
+                    a[2] = dir[0] * unit[1] - dir[1] * unit[0];
+                    double *range = AxisRange[3 * e + k];
+                    range[0] = range[1] = a[0] * cuboid[0][0] + a[1] * cuboid[0][1] + a[2] * cuboid[0][2];
+                    for (int j = 1; j < 8; ++j)
+                    {
+                        double proj = a[0] * cuboid[j][0] + a[1] * cuboid[j][1] + a[2] * cuboid[j][2];
+                        range[0] = std::min(range[0], proj);
+                        range[1] = std::max(range[1], proj);
+                    }
+                }
+            }
+        }
+
+        bool Contains(const double p[3]) const
+        {
+            for (int j = 0; j < 6; ++j)
+            {
+                // 点到平面的距离为正，则点在平面外部
+                if (Normals[j][0] * p[0] + Normals[j][1] * p[1] + Normals[j][2] * p[2] + D[j] > 0)
+                    return false;
+            }
+            return true;
+        }
+
+        BoxRelation Classify(const double bounds[6]) const
+        {
+            // 坐标轴作为分离轴
+            for (int i = 0; i < 3; ++i)
+            {
+                if (bounds[2 * i] > Bounds[2 * i + 1] || bounds[2 * i + 1] < Bounds[2 * i])
+                    return BoxRelation::Outside;
+            }
+
+            double c[3], h[3];
+            for (int i = 0; i < 3; ++i)
+            {
+                c[i] = 0.5 * (bounds[2 * i] + bounds[2 * i + 1]);
+                h[i] = 0.5 * (bounds[2 * i + 1] - bounds[2 * i]);
+            }
+
+            // 面法向作为分离轴，同时判断包围盒是否完全在内部
+            bool inside = true;
+            for (int j = 0; j < 6; ++j)
+            {
+                const double *n = Normals[j];
+                double s = n[0] * c[0] + n[1] * c[1] + n[2] * c[2] + D[j];
+                double r = h[0] * std::fabs(n[0]) + h[1] * std::fabs(n[1]) + h[2] * std::fabs(n[2]);
+                if (s - r > 0)
+                    return BoxRelation::Outside;
+                if (s + r > 0)
+                    inside = false;
+            }
+            if (inside)
+                return BoxRelation::Inside;
+
+            // 棱与坐标轴的叉积作为分离轴
+            for (int k = 0; k < 9; ++k)
+            {
+                const double *a = Axes[k];
+                double s = a[0] * c[0] + a[1] * c[1] + a[2] * c[2];
+                double r = h[0] * std::fabs(a[0]) + h[1] * std::fabs(a[1]) + h[2] * std::fabs(a[2]);
+                if (s - r > AxisRange[k][1] || s + r < AxisRange[k][0])
+                    return BoxRelation::Outside;
+            }
+            return BoxRelation::Intersect;
+        }
+    };
+
+    /**
+     * 凸多面体查询形状，由若干半空间的交集定义，可以是无界的（如相机视锥、任意凸套索）。
+     * 每个平面以 (nx, ny, nz, d) 给出，法向指向外部，满足 n·x + d <= 0 的点位于该半空间内，
+     * 与 vtkPlanes 的约定一致；法向无需归一化。位于所有平面上或内侧的点视为在内部。
+     */
+    struct ConvexPolytopeShape
+    {
+        std::vector<double> Planes;     // 每个平面4个分量 (nx, ny, nz, d)
+        std::vector<double> AbsNormals; // 各平面法向分量的绝对值，用于包围盒的投影半径
+        int NumberOfPlanes = 0;         // 平面数
+
+        void Init(const double *planes, int numPlanes)
+        {
+            NumberOfPlanes = std::max(numPlanes, 0);
+            Planes.assign(planes, planes + 4 * NumberOfPlanes);
+            AbsNormals.resize(3 * NumberOfPlanes);
+            for (int j = 0; j < NumberOfPlanes; ++j)
+            {
+                for (int k = 0; k < 3; ++k)
+                    AbsNormals[3 * j + k] = std::fabs(Planes[4 * j + k]);
+            }
+        }
+
+        bool Contains(const double p[3]) const
+        {
+            const double *plane = Planes.data();
+            for (int j = 0; j < NumberOfPlanes; ++j, plane += 4)
+            {
+                if (plane[0] * p[0] + plane[1] * p[1] + plane[2] * p[2] + plane[3] > 0)
+                    return false;
+            }
+            return true;
+        }
+
+        BoxRelation Classify(const double bounds[6]) const
+        {
+            double c[3], h[3];
+            for (int i = 0; i < 3; ++i)
+            {
+                c[i] = 0.5 * (bounds[2 * i] + bounds[2 * i + 1]);
+                h[i] = 0.5 * (bounds[2 * i + 1] - bounds[2 * i]);
+            }
+
+            // 包围盒在某个平面外侧时在外部，在所有平面内侧时在内部。
+            // 只使用面法向作为分离轴，靠近多面体棱角的外部包围盒可能被判为相交，由叶子逐点测试排除
+            bool inside = true;
+            const double *plane = Planes.data();
+            const double *absNormal = AbsNormals.data();
+            for (int j = 0; j < NumberOfPlanes; ++j, plane += 4, absNormal += 3)
+            {
+                double s = plane[0] * c[0] + plane[1] * c[1] + plane[2] * c[2] + plane[3];
+                double r = h[0] * absNormal[0] + h[1] * absNormal[1] + h[2] * absNormal[2];
+                if (s - r > 0)
+                    return BoxRelation::Outside;
+                if (s + r > 0)
+                    inside = false;
+            }
+            return inside ? BoxRelation::Inside : BoxRelation::Intersect;
+        }
+    };
+
+    /**
+     * 管道查询形状：半径为 radius 的球沿多段线扫过的区域，即各线段胶囊体的并集，用于刀具路径等扫掠查询。
+     * 线段按胶囊体包围盒组织为一棵小的层次包围盒树，节点分类只测试包围盒与节点重叠的线段，
+     * 数百段的路径只需对点集的树遍历一次，结果自然没有重复。
+     * 各胶囊体的并集不是凸体，只有某一个胶囊体完全包含包围盒时才判为内部，其余相交的包围盒由叶子逐点测试。
+     */
+    struct TubeShape
+    {
+        /**
+         * 线段层次结构的节点。内部节点的左子节点为下一个节点，右子节点为 Right；
+         * 叶子包含 Order 中 [First, First + Count) 的线段。
+         */
+        struct Node
+        {
+            double Bounds[6];
+            int First;
+            int Count;
+            int Right;
+        };
+
+        std::vector<CylinderShape> Segments; // 各线段的胶囊体，第i段连接第i与第i+1个点
+        std::vector<Node> Nodes;             // 按深度优先顺序存放的节点
+        std::vector<int> Order;              // 按节点顺序排列的线段序号
+
+        /**
+         * @param points 多段线的顶点，numPoints 个连续的 (x, y, z)
+         * @param numPoints 顶点数，为1时退化为球体，为0时形状为空
+         * @param radius 管道半径
+         */
+        void Init(const double *points, int numPoints, double radius)
+        {
+            Segments.clear();
+            Nodes.clear();
+            Order.clear();
+            if (numPoints <= 0)
+                return;
+
+            int numSegments = std::max(numPoints - 1, 1);
+            Segments.resize(numSegments);
+            for (int i = 0; i < numSegments; ++i)
+            {
+                const double *p0 = points + 3 * i;
+                const double *p1 = numPoints > 1 ? p0 + 3 : p0;
+                Segments[i].InitCapsule(p0, p1, radius);
+            }
+            Order.resize(numSegments);
+            for (int i = 0; i < numSegments; ++i)
+                Order[i] = i;
+            BuildNode(0, numSegments);
+        }
+
+        bool Contains(const double p[3]) const
+        {
+            if (Nodes.empty())
+                return false;
+            int stack[64];
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0)
+            {
+                int index = stack[--top];
+                const Node &node = Nodes[index];
+                if (p[0] < node.Bounds[0] || p[0] > node.Bounds[1] ||
+                    p[1] < node.Bounds[2] || p[1] > node.Bounds[3] ||
+                    p[2] < node.Bounds[4] || p[2] > node.Bounds[5])
+                    continue;
+                if (node.Count > 0)
+                {
+                    for (int k = node.First; k < node.First + node.Count; ++k)
+                    {
+                        if (Segments[Order[k]].Contains(p))
+                            return true;
+                    }
+                    continue;
+                }
+                stack[top++] = node.Right;
+                stack[top++] = index + 1;
+            }
+            return false;
+        }
+
+        BoxRelation Classify(const double bounds[6]) const
+        {
+            if (Nodes.empty())
+                return BoxRelation::Outside;
+            // 包围盒某一边长超过管道直径时不可能被任何胶囊体包含，找到第一条相交的线段即可返回
+            double diameter = 2.0 * Segments[0].Radius;
+            bool canBeInside = bounds[1] - bounds[0] <= diameter && bounds[3] - bounds[2] <= diameter &&
+                               bounds[5] - bounds[4] <= diameter;
+            bool intersect = false;
+            int stack[64];
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0)
+            {
+                int index = stack[--top];
+                const Node &node = Nodes[index];
+                if (bounds[0] > node.Bounds[1] || bounds[1] < node.Bounds[0] ||
+                    bounds[2] > node.Bounds[3] || bounds[3] < node.Bounds[2] ||
+                    bounds[4] > node.Bounds[5] || bounds[5] < node.Bounds[4])
+                    continue;
+                if (node.Count > 0)
+                {
+                    for (int k = node.First; k < node.First + node.Count; ++k)
+                    {
+                        BoxRelation relation = Segments[Order[k]].Classify(bounds);
+                        if (relation == BoxRelation::Inside)
+                            return BoxRelation::Inside;
+                        if (relation == BoxRelation::Intersect)
+                        {
+                            if (!canBeInside)
+                                return BoxRelation::Intersect;
+                            intersect = true;
+                        }
+                    }
+                    continue;
+                }
+                stack[top++] = node.Right;
+                stack[top++] = index + 1;
+            }
+            return intersect ? BoxRelation::Intersect : BoxRelation::Outside;
+        }
+
+        /**
+         * 收集胶囊体与包围盒可能相交的线段，用于叶子扫描时只测试附近的线段。
+         * @param segments 输出缓冲区，至少能容纳 maxSegments 个线段序号
+         * @return 线段数，超过 maxSegments 时返回-1
+         */
+        int CollectSegments(const double bounds[6], int *segments, int maxSegments) const
+        {
+            if (Nodes.empty())
+                return 0;
+            int count = 0;
+            int stack[64];
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0)
+            {
+                int index = stack[--top];
+                const Node &node = Nodes[index];
+                if (bounds[0] > node.Bounds[1] || bounds[1] < node.Bounds[0] ||
+                    bounds[2] > node.Bounds[3] || bounds[3] < node.Bounds[2] ||
+                    bounds[4] > node.Bounds[5] || bounds[5] < node.Bounds[4])
+                    continue;
+                if (node.Count > 0)
+                {
+                    for (int k = node.First; k < node.First + node.Count; ++k)
+                    {
+                        if (Segments[Order[k]].Classify(bounds) == BoxRelation::Outside)
+                            continue;
+                        if (count == maxSegments)
+                            return -1;
+                        segments[count++] = Order[k];
+                    }
+                    continue;
+                }
+                stack[top++] = node.Right;
+                stack[top++] = index + 1;
+            }
+            return count;
+        }
+
+        /**
+         * 求点到多段线的最近点所在的线段。
+         * @param segment 返回线段序号，第i段连接第i与第i+1个点，形状为空时为-1
+         * @param t 返回最近点在线段上的参数，0 为起点，1 为终点
+         * @return 点到多段线的距离平方，形状为空时返回 std::numeric_limits<double>::max()
+         */
+        double ClosestSegment(const double p[3], int &segment, double &t) const
+        {
+            segment = -1;
+            t = 0.0;
+            double best = std::numeric_limits<double>::max();
+            if (Nodes.empty())
+                return best;
+
+            // 节点包围盒按半径扩展过，点到包围盒的距离仍是到其中线段距离的下界
+            int stack[64];
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0)
+            {
+                int index = stack[--top];
+                const Node &node = Nodes[index];
+                if (BoxDistance2(node.Bounds, p) > best)
+                    continue;
+                if (node.Count > 0)
+                {
+                    for (int k = node.First; k < node.First + node.Count; ++k)
+                    {
+                        double dist2 = Segments[Order[k]].Distance2(p);
+                        if (dist2 < best || (dist2 == best && Order[k] < segment))
+                        {
+                            best = dist2;
+                            segment = Order[k];
+                        }
+                    }
+                    continue;
+                }
+                // 先访问较近的子节点
+                int left = index + 1, right = node.Right;
+                if (BoxDistance2(Nodes[left].Bounds, p) > BoxDistance2(Nodes[right].Bounds, p))
+                    std::swap(left, right);
+                stack[top++] = right;
+                stack[top++] = left;
+            }
+
+            const CylinderShape &capsule = Segments[segment];
+            if (capsule.Length > 0.0)
+            {
+                double proj = (p[0] - capsule.Origin[0]) * capsule.Axis[0] +
+                              (p[1] - capsule.Origin[1]) * capsule.Axis[1] +
+                              (p[2] - capsule.Origin[2]) * capsule.Axis[2];
+                t = std::min(std::max(proj / capsule.Length, 0.0), 1.0);
+            }
+            return best;
+        }
+
+    private:
+        static double BoxDistance2(const double bounds[6], const double p[3])
+        {
+            double dist2 = 0.0;
+            for (int i = 0; i < 3; ++i)
+            {
+                double d = std::max(std::max(bounds[2 * i] - p[i], p[i] - bounds[2 * i + 1]), 0.0);
+                dist2 += d * d;
+            }
+            return dist2;
+        }
+
+        /**
+         * 构建 Order 中 [begin, end) 的子树，沿线段中点跨度最大的轴按中位数划分。
+         */
+        void BuildNode(int begin, int end)
+        {
+            int index = static_cast<int>(Nodes.size());
+            Nodes.emplace_back();
+            double bounds[6], centerBounds[6];
+            for (int i = 0; i < 3; ++i)
+            {
+                bounds[2 * i] = centerBounds[2 * i] = std::numeric_limits<double>::max();
+                bounds[2 * i + 1] = centerBounds[2 * i + 1] = -std::numeric_limits<double>::max();
+            }
+            for (int k = begin; k < end; ++k)
+            {
+                const double *b = Segments[Order[k]].AxisBounds;
+                for (int i = 0; i < 3; ++i)
+                {
+                    double c = 0.5 * (b[2 * i] + b[2 * i + 1]);
+                    bounds[2 * i] = std::min(bounds[2 * i], b[2 * i]);
+                    bounds[2 * i + 1] = std::max(bounds[2 * i + 1], b[2 * i + 1]);
+                    centerBounds[2 * i] = std::min(centerBounds[2 * i], c);
+                    centerBounds[2 * i + 1] = std::max(centerBounds[2 * i + 1], c);
+                }
+            }
+            std::copy(bounds, bounds + 6, Nodes[index].Bounds);
+
+            const int maxLeafSize = 4;
+            if (end - begin <= maxLeafSize)
+            {
+                Nodes[index].First = begin;
+                Nodes[index].Count = end - begin;
+                Nodes[index].Right = -1;
+                return;
+            }
+
+            int axis = 0;
+            for (int i = 1; i < 3; ++i)
+            {
+                if (centerBounds[2 * i + 1] - centerBounds[2 * i] > centerBounds[2 * axis + 1] - centerBounds[2 * axis])
+                    axis = i;
+            }
+            int mid = begin + (end - begin) / 2;
+            std::nth_element(Order.begin() + begin, Order.begin() + mid, Order.begin() + end,
+                             [this, axis](int a, int b)
+                             {
+                                 const double *ba = Segments[a].AxisBounds;
+                                 const double *bb = Segments[b].AxisBounds;
+                                 return ba[2 * axis] + ba[2 * axis + 1] < bb[2 * axis] + bb[2 * axis + 1];
+                             });
+            Nodes[index].First = begin;
+            Nodes[index].Count = 0;
+            BuildNode(begin, mid);
+            Nodes[index].Right = static_cast<int>(Nodes.size());
+            BuildNode(mid, end);
+        }
+    };
+
+    /**
+     * 正轴包围盒查询形状，边界上的点视为在内部。
+     */
+    struct AreaShape
+    {
+        double Area[6]; // {xmin, xmax, ymin, ymax, zmin, zmax}
+
+        void Init(const double area[6])
+        {
+            for (int i = 0; i < 6; ++i)
+                Area[i] = area[i];
+        }
+
+        bool Contains(const double p[3]) const
+        {
+            return p[0] >= Area[0] && p[0] <= Area[1] &&
+                   p[1] >= Area[2] && p[1] <= Area[3] &&
+                   p[2] >= Area[4] && p[2] <= Area[5];
+        }
+
+        BoxRelation Classify(const double bounds[6]) const
+        {
+            bool inside = true;
+            for (int i = 0; i < 3; ++i)
+            {
+                if (bounds[2 * i] > Area[2 * i + 1] || bounds[2 * i + 1] < Area[2 * i])
+                    return BoxRelation::Outside;
+                if (bounds[2 * i] < Area[2 * i] || bounds[2 * i + 1] > Area[2 * i + 1])
+                    inside = false;
+            }
+            return inside ? BoxRelation::Inside : BoxRelation::Intersect;
+        }
+    };
+
+    /**
+     * 球体查询形状，与 FindPointsWithinRadius 的判定一致（距离等于半径时视为在内部）。
+     */
+    struct SphereShape
+    {
+        double Center[3];
+        double Radius2;
+
+        void Init(const double center[3], double radius)
+        {
+            for (int i = 0; i < 3; ++i)
+                Center[i] = center[i];
+            Radius2 = radius * radius;
+        }
+
+        bool Contains(const double p[3]) const
+        {
+            double dx = p[0] - Center[0], dy = p[1] - Center[1], dz = p[2] - Center[2];
+            return dx * dx + dy * dy + dz * dz <= Radius2;
+        }
+
+        BoxRelation Classify(const double bounds[6]) const
+        {
+            // 球心到包围盒的最近距离与最远距离
+            double near2 = 0.0, far2 = 0.0;
+            for (int i = 0; i < 3; ++i)
+            {
+                double lo = bounds[2 * i] - Center[i];
+                double hi = Center[i] - bounds[2 * i + 1];
+                double d = std::max(std::max(lo, hi), 0.0);
+                near2 += d * d;
+                double f = std::max(std::fabs(lo), std::fabs(hi));
+                far2 += f * f;
+            }
+            if (near2 > Radius2)
+                return BoxRelation::Outside;
+            return far2 <= Radius2 ? BoxRelation::Inside : BoxRelation::Intersect;
+        }
+    };
+
+    ///@{
+    /**
+     * 形状的正轴包围盒，用于均匀网格等需要直接确定候选范围的结构。
+     * 无限长圆柱与未提供重载的形状返回false，表示范围无界。
+     */
+    inline bool GetShapeBounds(const SphereShape &shape, double bounds[6])
+    {
+        double radius = std::sqrt(shape.Radius2);
+        for (int i = 0; i < 3; ++i)
+        {
+            bounds[2 * i] = shape.Center[i] - radius;
+            bounds[2 * i + 1] = shape.Center[i] + radius;
+        }
+        return true;
+    }
+
+    inline bool GetShapeBounds(const AreaShape &shape, double bounds[6])
+    {
+        std::copy(shape.Area, shape.Area + 6, bounds);
+        return true;
+    }
+
+    inline bool GetShapeBounds(const CuboidShape &shape, double bounds[6])
+    {
+        std::copy(shape.Bounds, shape.Bounds + 6, bounds);
+        return true;
+    }
+
+    inline bool GetShapeBounds(const CylinderShape &shape, double bounds[6])
+    {
+        if (!shape.Finite)
+            return false;
+        std::copy(shape.AxisBounds, shape.AxisBounds + 6, bounds);
+        return true;
+    }
+
+    inline bool GetShapeBounds(const TubeShape &shape, double bounds[6])
+    {
+        if (shape.Nodes.empty())
+            return false;
+        std::copy(shape.Nodes[0].Bounds, shape.Nodes[0].Bounds + 6, bounds);
+        return true;
+    }
+
+    template <typename Shape>
+    inline bool GetShapeBounds(const Shape &, double[6])
+    {
+        return false;
+    }
+    ///@}
+
+    /**
+     * 点到正轴包围盒的最近距离平方，点在包围盒内部时为0。
+     */
+    inline double BoundsDistance2(const double bounds[6], const double p[3])
+    {
+        double dist2 = 0.0;
+        for (int i = 0; i < 3; ++i)
+        {
+            double d = std::max(std::max(bounds[2 * i] - p[i], p[i] - bounds[2 * i + 1]), 0.0);
+            dist2 += d * d;
+        }
+        return dist2;
+    }
+
+    /**
+     * 两个正轴包围盒之间的最近距离平方，相交时为0。
+     */
+    inline double BoundsToBoundsDistance2(const double a[6], const double b[6])
+    {
+        double dist2 = 0.0;
+        for (int i = 0; i < 3; ++i)
+        {
+            double d = std::max(std::max(a[2 * i] - b[2 * i + 1], b[2 * i] - a[2 * i + 1]), 0.0);
+            dist2 += d * d;
+        }
+        return dist2;
+    }
+
+    /**
+     * 两个正轴包围盒中任意两点之间的最远距离平方。
+     */
+    inline double BoundsToBoundsMaxDistance2(const double a[6], const double b[6])
+    {
+        double dist2 = 0.0;
+        for (int i = 0; i < 3; ++i)
+        {
+            double d = std::max(a[2 * i + 1] - b[2 * i], b[2 * i + 1] - a[2 * i]);
+            dist2 += d * d;
+        }
+        return dist2;
+    }
+
+    /**
+     * 向容量为N、按 (距离平方, id) 排列的最大堆中加入一个候选点，用于最近N点搜索。
+     */
+    template <typename IdType>
+    inline void PushCandidate(std::vector<std::pair<double, IdType>> &heap, size_t N, double dist2, IdType id)
+    {
+        if (heap.size() < N)
+        {
+            heap.emplace_back(dist2, id);
+            std::push_heap(heap.begin(), heap.end());
+        }
+        else if (dist2 < heap.front().first)
+        {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.back() = std::make_pair(dist2, id);
+            std::push_heap(heap.begin(), heap.end());
+        }
+    }
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkType.h>
+#include <vector>
+
+namespace AUtils
+{
+    /**
+     * 点重排使用的空间填充曲线。
+     */
+    enum class SpaceFillingCurve
+    {
+        None = 0,   // 保持原顺序
+        Morton = 1, // Z序，计算最快
+        Hilbert = 2 // 相邻编码的点在空间上总是相邻，局部性优于 Morton
+    };
+
+    // 每个坐标分量量化的位数，编码共 3 * CurveBits 位
+    const int CurveBits = 21;
+
+    /**
+     * 三维 Morton 编码，各分量的低 CurveBits 位按 x、y、z 的顺序从高位到低位交错。
+     */
+    vtkTypeUInt64 MortonKey(unsigned int x, unsigned int y, unsigned int z);
+
+    /**
+     * 三维 Hilbert 编码（Skilling 的转置算法），各分量取低 CurveBits 位。
+     */
+    vtkTypeUInt64 HilbertKey(unsigned int x, unsigned int y, unsigned int z);
+
+    /**
+     * 计算点沿空间填充曲线的顺序。坐标在所有点包围盒的外接立方体内量化为 CurveBits 位，
+     * 按 (编码, 原id) 排序，结果与线程数无关。
+     * @param newToOld 返回新顺序下各点的原id，curve 为 None 时为恒等排列。
+     */
+    void ComputeCurveOrder(vtkPoints *points, SpaceFillingCurve curve, std::vector<vtkIdType> &newToOld);
+
+    /**
+     * 按给定顺序重排多边形数据的点：点坐标与点数据（包括法向量）按 newToOld 排列，
+     * 所有单元的连接关系改写为新的点id，单元顺序与单元数据不变。
+     * @param newToOld 新顺序下各点的原id，必须是 [0, 点数) 的排列。
+     * @param oldToNew 返回原id到新id的映射。
+     */
+    void ReorderPoints(vtkPolyData *input, const std::vector<vtkIdType> &newToOld, vtkPolyData *output,
+                       std::vector<vtkIdType> &oldToNew);
+};
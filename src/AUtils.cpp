@@ -1,5 +1,7 @@
 #include "AUtils.h"
 
+#include <algorithm>
+
 void AUtils::GetCornersFromBounds(const double *bounds, double **corners)
 {
     for (int i = 0; i < 8; ++i)
@@ -12,12 +14,14 @@ void AUtils::GetCornersFromBounds(const double *bounds, double **corners)
 
 void AUtils::IdTypeArrayToIdList(vtkIdTypeArray *idTypeArray, vtkIdList *idList)
 {
-    idList->SetNumberOfIds(idTypeArray->GetNumberOfTuples());
-    for (int i = 0; i < idTypeArray->GetNumberOfTuples(); ++i)
+    // 整段复制，不逐个调用 SetId
+    vtkIdType numIds = idTypeArray->GetNumberOfTuples();
+    idList->SetNumberOfIds(numIds);
+    if (numIds > 0)
     {
-        idList->SetId(i, idTypeArray->GetValue(i));
+        const vtkIdType *src = idTypeArray->GetPointer(0);
+        std::copy(src, src + numIds, idList->GetPointer(0));
     }
-    idList->Squeeze();
 }
 
 void AUtils::GetMeanNormal(double *normal, vtkDataArray *array)
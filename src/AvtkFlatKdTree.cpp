@@ -0,0 +1,1136 @@
+#include "AvtkFlatKdTree.h"
+#include "ParallelSelect.h"
+#include "vtkObjectFactory.h"
+#include "vtkCellArray.h"
+#include "vtkSMPThreadLocal.h"
+#include "vtkSMPTools.h"
+#include "vtkTimerLog.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <string>
+
+vtkStandardNewMacro(AvtkFlatKdTree);
+
+namespace
+{
+    /**
+     * 以 (坐标, id) 作为严格全序，中位数唯一，串行与并行选择得到相同的划分。
+     */
+    struct KeyLess
+    {
+        const double *Coords;
+        int Dim;
+
+        bool operator()(vtkIdType a, vtkIdType b) const
+        {
+            double ca = Coords[3 * a + Dim];
+            double cb = Coords[3 * b + Dim];
+            return ca < cb || (ca == cb && a < b);
+        }
+    };
+
+    /**
+     * 并行计算一段点的包围盒。
+     */
+    struct RangeBounds
+    {
+        const double *Coords;
+        const vtkIdType *Perm;
+        vtkSMPThreadLocal<std::array<double, 6>> TLocal;
+        double Bounds[6];
+
+        void Initialize()
+        {
+            this->TLocal.Local() = {VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX,
+                                    -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX};
+        }
+
+        void operator()(vtkIdType begin, vtkIdType end)
+        {
+            std::array<double, 6> &bounds = this->TLocal.Local();
+            for (vtkIdType j = begin; j < end; ++j)
+            {
+                const double *p = this->Coords + 3 * this->Perm[j];
+                for (int i = 0; i < 3; ++i)
+                {
+                    bounds[2 * i] = std::min(bounds[2 * i], p[i]);
+                    bounds[2 * i + 1] = std::max(bounds[2 * i + 1], p[i]);
+                }
+            }
+        }
+
+        void Reduce()
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                this->Bounds[2 * i] = VTK_DOUBLE_MAX;
+                this->Bounds[2 * i + 1] = -VTK_DOUBLE_MAX;
+            }
+            for (const auto &bounds : this->TLocal)
+            {
+                for (int i = 0; i < 3; ++i)
+                {
+                    this->Bounds[2 * i] = std::min(this->Bounds[2 * i], bounds[2 * i]);
+                    this->Bounds[2 * i + 1] = std::max(this->Bounds[2 * i + 1], bounds[2 * i + 1]);
+                }
+            }
+        }
+    };
+
+    /**
+     * 将叶子中未删除的点按到x的距离平方加入最大堆。
+     */
+    template <typename T>
+    void PushCandidates(const T *px, const T *py, const T *pz, const vtkIdType *ids, const unsigned char *removed,
+                        vtkIdType begin, vtkIdType end, const double x[3], size_t N,
+                        std::vector<std::pair<double, vtkIdType>> &heap)
+    {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            if (removed && removed[i])
+                continue;
+            double dx = px[i] - x[0];
+            double dy = py[i] - x[1];
+            double dz = pz[i] - x[2];
+            AUtils::PushCandidate(heap, N, dx * dx + dy * dy + dz * dz, ids[i]);
+        }
+    }
+
+    /**
+     * 将叶子中未删除的点与当前最近点比较，只保留距离平方最小的一个。
+     */
+    template <typename T>
+    void UpdateClosest(const T *px, const T *py, const T *pz, const vtkIdType *ids, const unsigned char *removed,
+                       vtkIdType begin, vtkIdType end, const double x[3], std::pair<double, vtkIdType> &closest)
+    {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            if (removed && removed[i])
+                continue;
+            double dx = px[i] - x[0];
+            double dy = py[i] - x[1];
+            double dz = pz[i] - x[2];
+            double dist2 = dx * dx + dy * dy + dz * dz;
+            if (dist2 < closest.first)
+                closest = {dist2, ids[i]};
+        }
+    }
+
+    // 线程局部的查询堆保留的最大容量，超过时在下一次查询前释放
+    const size_t MaximumScratchHeapCapacity = 1 << 16;
+
+    /**
+     * 返回当前线程清空后的查询堆，避免每次最近N点查询分配内存。
+     * 查询期间不调用外部代码，同一线程内不会嵌套使用。
+     */
+    std::vector<std::pair<double, vtkIdType>> &GetScratchHeap()
+    {
+        thread_local std::vector<std::pair<double, vtkIdType>> heap;
+        if (heap.capacity() > MaximumScratchHeapCapacity)
+            std::vector<std::pair<double, vtkIdType>>().swap(heap);
+        heap.clear();
+        return heap;
+    }
+
+    // 树文件的格式版本，文件布局改变时递增
+    const vtkTypeUInt32 TreeFileVersion = 1;
+    const char TreeFileMagic[8] = {'A', 'K', 'D', 'T', 'R', 'E', 'E', '\0'};
+    // 按本机字节序写入，用于识别字节序不同的文件
+    const vtkTypeUInt32 TreeFileByteOrder = 0x01020304;
+    // 各数组在文件中的对齐字节数，映射地址按页对齐，因此数组在内存中同样对齐
+    const vtkTypeUInt64 TreeFileAlignment = 64;
+
+    enum TreeFileSection
+    {
+        SplitDimSection = 0,
+        SplitValueSection,
+        NodeBoundsSection,
+        XSection,
+        YSection,
+        ZSection,
+        IdsSection,
+        RemovedSection,
+        NumberOfTreeFileSections
+    };
+
+    /**
+     * 树文件的文件头，之后依次为各数组，每个数组按 TreeFileAlignment 对齐。
+     */
+    struct TreeFileHeader
+    {
+        char Magic[8];
+        vtkTypeUInt32 Version;
+        vtkTypeUInt32 ByteOrder;
+        vtkTypeUInt32 IdTypeSize;
+        vtkTypeUInt32 FloatStorage;
+        vtkTypeInt32 Depth;
+        vtkTypeInt32 NumberOfPointsPerLeaf;
+        vtkTypeInt64 NumberOfPoints;
+        vtkTypeInt64 NumberOfRemovedPoints;
+        vtkTypeUInt64 Key;      // 调用方给出的数据标识
+        vtkTypeUInt64 Checksum; // 所有数组的校验值
+        vtkTypeUInt64 FileSize;
+        vtkTypeUInt64 SectionOffsets[NumberOfTreeFileSections];
+        vtkTypeUInt64 SectionSizes[NumberOfTreeFileSections];
+    };
+
+    /**
+     * 使每个叶子的点数不超过 numPointsPerLeaf 的最小层数。
+     */
+    int ComputeTreeDepth(vtkIdType numPoints, int numPointsPerLeaf)
+    {
+        int depth = 0;
+        while ((numPoints + (vtkIdType(1) << depth) - 1) / (vtkIdType(1) << depth) > numPointsPerLeaf)
+        {
+            ++depth;
+        }
+        return depth;
+    }
+
+    /**
+     * 由点数、层数等字段计算各数组的偏移与大小以及文件大小。
+     */
+    void ComputeTreeFileLayout(TreeFileHeader &header)
+    {
+        vtkTypeUInt64 numNodes = (vtkTypeUInt64(1) << (header.Depth + 1)) - 1;
+        vtkTypeUInt64 numPoints = static_cast<vtkTypeUInt64>(header.NumberOfPoints);
+        vtkTypeUInt64 coordSize = header.FloatStorage ? sizeof(float) : sizeof(double);
+        header.SectionSizes[SplitDimSection] = numNodes * sizeof(unsigned char);
+        header.SectionSizes[SplitValueSection] = numNodes * sizeof(double);
+        header.SectionSizes[NodeBoundsSection] = 6 * numNodes * sizeof(double);
+        header.SectionSizes[XSection] = numPoints * coordSize;
+        header.SectionSizes[YSection] = numPoints * coordSize;
+        header.SectionSizes[ZSection] = numPoints * coordSize;
+        header.SectionSizes[IdsSection] = numPoints * header.IdTypeSize;
+        header.SectionSizes[RemovedSection] = header.NumberOfRemovedPoints > 0 ? numPoints : 0;
+
+        vtkTypeUInt64 offset = sizeof(TreeFileHeader);
+        for (int i = 0; i < NumberOfTreeFileSections; ++i)
+        {
+            offset = (offset + TreeFileAlignment - 1) / TreeFileAlignment * TreeFileAlignment;
+            header.SectionOffsets[i] = offset;
+            offset += header.SectionSizes[i];
+        }
+        header.FileSize = offset;
+    }
+
+    /**
+     * 各数组的校验值依次合并。
+     */
+    vtkTypeUInt64 TreeFileChecksum(const TreeFileHeader &header, const void *const sections[NumberOfTreeFileSections])
+    {
+        vtkTypeUInt64 checksum = 0;
+        for (int i = 0; i < NumberOfTreeFileSections; ++i)
+        {
+            checksum = AUtils::Checksum(sections[i], header.SectionSizes[i], checksum);
+        }
+        return checksum;
+    }
+}
+
+void AvtkFlatKdTree::Initialize()
+{
+    this->Depth = 0;
+    this->FirstLeaf = 0;
+    this->SplitDim.clear();
+    this->SplitValue.clear();
+    this->NodeBounds.clear();
+    this->X.clear();
+    this->Y.clear();
+    this->Z.clear();
+    this->XF.clear();
+    this->YF.clear();
+    this->ZF.clear();
+    this->FloatStorage = false;
+    this->Ids.clear();
+    this->Removed.clear();
+    this->NumberOfRemovedPoints = 0;
+    this->Mapping.reset();
+    this->SharedSource = nullptr;
+}
+
+void AvtkFlatKdTree::ShallowCopy(AvtkFlatKdTree *source)
+{
+    if (source == this)
+        return;
+    this->Initialize();
+    if (!source)
+        return;
+
+    this->NumberOfPointsPerLeaf = source->NumberOfPointsPerLeaf;
+    this->ParallelBuild = source->ParallelBuild;
+    this->SinglePrecision = source->SinglePrecision;
+    this->BuildElapsedTime = 0.0;
+    this->Depth = source->Depth;
+    this->FirstLeaf = source->FirstLeaf;
+    this->FloatStorage = source->FloatStorage;
+    this->SplitDim.Map(source->SplitDim.data(), source->SplitDim.size());
+    this->SplitValue.Map(source->SplitValue.data(), source->SplitValue.size());
+    this->NodeBounds.Map(source->NodeBounds.data(), source->NodeBounds.size());
+    this->X.Map(source->X.data(), source->X.size());
+    this->Y.Map(source->Y.data(), source->Y.size());
+    this->Z.Map(source->Z.data(), source->Z.size());
+    this->XF.Map(source->XF.data(), source->XF.size());
+    this->YF.Map(source->YF.data(), source->YF.size());
+    this->ZF.Map(source->ZF.data(), source->ZF.size());
+    this->Ids.Map(source->Ids.data(), source->Ids.size());
+    this->Removed = source->Removed;
+    this->NumberOfRemovedPoints = source->NumberOfRemovedPoints;
+    this->SharedSource = source;
+    this->Modified();
+}
+
+void AvtkFlatKdTree::BuildFromPoints(vtkPoints *points)
+{
+    vtkIdType numPoints = points ? points->GetNumberOfPoints() : 0;
+    std::vector<double> coords(3 * numPoints);
+    // float/double 点数组直接读取内存，单精度存储时坐标舍入为float
+    int dataType = numPoints > 0 ? points->GetDataType() : VTK_DOUBLE;
+    const void *data = numPoints > 0 ? points->GetData()->GetVoidPointer(0) : nullptr;
+    const bool singlePrecision = this->SinglePrecision != 0;
+    auto copyPoints = [&](vtkIdType begin, vtkIdType end)
+    {
+        if (dataType == VTK_FLOAT)
+        {
+            const float *src = static_cast<const float *>(data);
+            std::copy(src + 3 * begin, src + 3 * end, coords.begin() + 3 * begin);
+        }
+        else if (dataType == VTK_DOUBLE)
+        {
+            const double *src = static_cast<const double *>(data);
+            std::copy(src + 3 * begin, src + 3 * end, coords.begin() + 3 * begin);
+        }
+        else
+        {
+            for (vtkIdType i = begin; i < end; ++i)
+            {
+                points->GetPoint(i, &coords[3 * i]);
+            }
+        }
+        if (singlePrecision && dataType != VTK_FLOAT)
+        {
+            for (vtkIdType i = 3 * begin; i < 3 * end; ++i)
+            {
+                coords[i] = static_cast<float>(coords[i]);
+            }
+        }
+    };
+    if (this->ParallelBuild)
+        vtkSMPTools::For(0, numPoints, copyPoints);
+    else
+        copyPoints(0, numPoints);
+    this->BuildTree(coords, nullptr);
+}
+
+void AvtkFlatKdTree::BuildFromPoints(const std::vector<double> &coords, const std::vector<vtkIdType> &ids)
+{
+    if (coords.size() != 3 * ids.size())
+    {
+        vtkErrorMacro(<< "AvtkFlatKdTree - coordinates and ids do not match");
+        return;
+    }
+    if (this->SinglePrecision)
+    {
+        std::vector<double> rounded(coords.size());
+        for (size_t i = 0; i < coords.size(); ++i)
+        {
+            rounded[i] = static_cast<float>(coords[i]);
+        }
+        this->BuildTree(rounded, ids.data());
+        return;
+    }
+    this->BuildTree(coords, ids.data());
+}
+
+void AvtkFlatKdTree::BuildTree(const std::vector<double> &coords, const vtkIdType *ids)
+{
+    vtkNew<vtkTimerLog> timer;
+    timer->StartTimer();
+
+    this->Initialize();
+    vtkIdType numPoints = static_cast<vtkIdType>(coords.size() / 3);
+    if (numPoints < 1)
+    {
+        vtkErrorMacro(<< "AvtkFlatKdTree - no points to build");
+        return;
+    }
+
+    // 选择层数，使每个叶子的点数不超过 NumberOfPointsPerLeaf
+    this->Depth = ComputeTreeDepth(numPoints, this->NumberOfPointsPerLeaf);
+    vtkIdType numNodes = (vtkIdType(1) << (this->Depth + 1)) - 1;
+    this->FirstLeaf = (vtkIdType(1) << this->Depth) - 1;
+    this->SplitDim.assign(numNodes, 0);
+    this->SplitValue.assign(numNodes, 0.0);
+    this->NodeBounds.assign(6 * numNodes, 0.0);
+
+    std::vector<vtkIdType> perm(numPoints);
+    for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+        perm[i] = i;
+    }
+    if (this->ParallelBuild)
+        this->BuildParallel(perm, coords);
+    else
+        this->BuildNode(0, 0, numPoints, 0, perm, coords);
+
+    // 按树顺序拷贝点坐标，叶子内的点在内存中连续
+    this->FloatStorage = this->SinglePrecision != 0;
+    if (this->FloatStorage)
+    {
+        this->XF.resize(numPoints);
+        this->YF.resize(numPoints);
+        this->ZF.resize(numPoints);
+    }
+    else
+    {
+        this->X.resize(numPoints);
+        this->Y.resize(numPoints);
+        this->Z.resize(numPoints);
+    }
+    this->Ids.resize(numPoints);
+    auto gatherPoints = [&](vtkIdType begin, vtkIdType end)
+    {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            const double *p = &coords[3 * perm[i]];
+            if (this->FloatStorage)
+            {
+                this->XF[i] = static_cast<float>(p[0]);
+                this->YF[i] = static_cast<float>(p[1]);
+                this->ZF[i] = static_cast<float>(p[2]);
+            }
+            else
+            {
+                this->X[i] = p[0];
+                this->Y[i] = p[1];
+                this->Z[i] = p[2];
+            }
+            this->Ids[i] = ids ? ids[perm[i]] : perm[i];
+        }
+    };
+    if (this->ParallelBuild)
+        vtkSMPTools::For(0, numPoints, gatherPoints);
+    else
+        gatherPoints(0, numPoints);
+
+    timer->StopTimer();
+    this->BuildElapsedTime = timer->GetElapsedTime();
+    vtkDebugMacro(<< "Built flat kd-tree with " << numPoints << " points in " << this->BuildElapsedTime << " s");
+    this->Modified();
+}
+
+bool AvtkFlatKdTree::Save(const char *path, vtkTypeUInt64 key) const
+{
+    if (!path || this->Ids.empty())
+    {
+        vtkErrorMacro(<< "AvtkFlatKdTree - no tree to save");
+        return false;
+    }
+
+    TreeFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.Magic, TreeFileMagic, sizeof(header.Magic));
+    header.Version = TreeFileVersion;
+    header.ByteOrder = TreeFileByteOrder;
+    header.IdTypeSize = sizeof(vtkIdType);
+    header.FloatStorage = this->FloatStorage ? 1 : 0;
+    header.Depth = this->Depth;
+    header.NumberOfPointsPerLeaf = this->NumberOfPointsPerLeaf;
+    header.NumberOfPoints = this->GetNumberOfPoints();
+    header.NumberOfRemovedPoints = this->NumberOfRemovedPoints;
+    header.Key = key;
+    ComputeTreeFileLayout(header);
+
+    const void *sections[NumberOfTreeFileSections] = {
+        this->SplitDim.data(), this->SplitValue.data(), this->NodeBounds.data(),
+        this->FloatStorage ? static_cast<const void *>(this->XF.data()) : this->X.data(),
+        this->FloatStorage ? static_cast<const void *>(this->YF.data()) : this->Y.data(),
+        this->FloatStorage ? static_cast<const void *>(this->ZF.data()) : this->Z.data(),
+        this->Ids.data(), this->Removed.data()};
+    header.Checksum = TreeFileChecksum(header, sections);
+
+    // 先写入临时文件，完整写入后再替换目标文件
+    std::string tmpPath = AUtils::GetTempPath(path);
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            vtkErrorMacro(<< "AvtkFlatKdTree - cannot open " << tmpPath << " for writing");
+            return false;
+        }
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        vtkTypeUInt64 offset = sizeof(header);
+        const char padding[TreeFileAlignment] = {};
+        for (int i = 0; i < NumberOfTreeFileSections; ++i)
+        {
+            file.write(padding, static_cast<std::streamsize>(header.SectionOffsets[i] - offset));
+            file.write(static_cast<const char *>(sections[i]), static_cast<std::streamsize>(header.SectionSizes[i]));
+            offset = header.SectionOffsets[i] + header.SectionSizes[i];
+        }
+        file.close();
+        if (!file)
+        {
+            vtkErrorMacro(<< "AvtkFlatKdTree - failed to write " << tmpPath);
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+    if (!AUtils::ReplaceFile(tmpPath.c_str(), path))
+    {
+        vtkErrorMacro(<< "AvtkFlatKdTree - cannot replace " << path);
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool AvtkFlatKdTree::Load(const char *path, vtkTypeUInt64 key, bool verifyChecksum)
+{
+    std::unique_ptr<AUtils::MappedFile> file(new AUtils::MappedFile);
+    if (!file->Open(path))
+    {
+        vtkDebugMacro(<< "Cannot map kd-tree file " << (path ? path : "(null)"));
+        return false;
+    }
+
+    TreeFileHeader header;
+    if (file->GetSize() < sizeof(header))
+    {
+        vtkErrorMacro(<< "AvtkFlatKdTree - " << path << " is not a kd-tree file");
+        return false;
+    }
+    std::memcpy(&header, file->GetData(), sizeof(header));
+    if (std::memcmp(header.Magic, TreeFileMagic, sizeof(header.Magic)) != 0)
+    {
+        vtkErrorMacro(<< "AvtkFlatKdTree - " << path << " is not a kd-tree file");
+        return false;
+    }
+    if (header.Version != TreeFileVersion || header.ByteOrder != TreeFileByteOrder ||
+        header.IdTypeSize != sizeof(vtkIdType))
+    {
+        vtkErrorMacro(<< "AvtkFlatKdTree - " << path << " was written by an incompatible version or platform");
+        return false;
+    }
+    if (header.Key != key)
+    {
+        vtkDebugMacro(<< "Kd-tree file " << path << " is stale");
+        return false;
+    }
+
+    // 点数与节点数先由文件大小约束，推算层数与布局时不会溢出：每个点至少占 3 * sizeof(float) + sizeof(vtkIdType) 字节，
+    // 每个节点占1个分量、1个划分值与6个边界，共57字节
+    vtkTypeUInt64 fileSize = file->GetSize();
+    const vtkTypeUInt64 nodeFileSize = sizeof(unsigned char) + 7 * sizeof(double);
+    bool valid = header.NumberOfPoints > 0 &&
+                 static_cast<vtkTypeUInt64>(header.NumberOfPoints) <= fileSize / (3 * sizeof(float) + sizeof(vtkIdType)) &&
+                 header.Depth >= 0 && header.Depth < 62 &&
+                 (vtkTypeUInt64(1) << (header.Depth + 1)) - 1 <= fileSize / nodeFileSize &&
+                 header.NumberOfPointsPerLeaf > 0 && header.NumberOfRemovedPoints >= 0 &&
+                 header.NumberOfRemovedPoints <= header.NumberOfPoints;
+    // 构建时的层数不超过每个叶子一个点时的层数；文件头中的布局必须与由点数与层数推算的布局一致
+    valid = valid && header.Depth <= ComputeTreeDepth(header.NumberOfPoints, 1);
+    if (valid)
+    {
+        TreeFileHeader expected = header;
+        ComputeTreeFileLayout(expected);
+        valid = std::memcmp(&expected, &header, sizeof(header)) == 0 && header.FileSize == fileSize;
+    }
+    const char *base = file->GetData();
+    const void *sections[NumberOfTreeFileSections];
+    for (int i = 0; valid && i < NumberOfTreeFileSections; ++i)
+    {
+        sections[i] = base + header.SectionOffsets[i];
+    }
+    // 查询以划分分量为下标读取坐标，不校验时同样要保证它在范围内
+    if (valid)
+    {
+        const unsigned char *splitDim = static_cast<const unsigned char *>(sections[SplitDimSection]);
+        valid = std::all_of(splitDim, splitDim + header.SectionSizes[SplitDimSection],
+                            [](unsigned char dim) { return dim < 3; });
+    }
+    if (valid && verifyChecksum)
+        valid = TreeFileChecksum(header, sections) == header.Checksum;
+    if (!valid)
+    {
+        vtkErrorMacro(<< "AvtkFlatKdTree - " << path << " is truncated or corrupt");
+        return false;
+    }
+
+    this->Initialize();
+    size_t numPoints = static_cast<size_t>(header.NumberOfPoints);
+    size_t numNodes = static_cast<size_t>(header.SectionSizes[SplitDimSection]);
+    this->Depth = header.Depth;
+    this->FirstLeaf = (vtkIdType(1) << this->Depth) - 1;
+    this->NumberOfPointsPerLeaf = header.NumberOfPointsPerLeaf;
+    this->FloatStorage = header.FloatStorage != 0;
+    this->SinglePrecision = this->FloatStorage ? 1 : 0;
+    this->SplitDim.Map(static_cast<const unsigned char *>(sections[SplitDimSection]), numNodes);
+    this->SplitValue.Map(static_cast<const double *>(sections[SplitValueSection]), numNodes);
+    this->NodeBounds.Map(static_cast<const double *>(sections[NodeBoundsSection]), 6 * numNodes);
+    if (this->FloatStorage)
+    {
+        this->XF.Map(static_cast<const float *>(sections[XSection]), numPoints);
+        this->YF.Map(static_cast<const float *>(sections[YSection]), numPoints);
+        this->ZF.Map(static_cast<const float *>(sections[ZSection]), numPoints);
+    }
+    else
+    {
+        this->X.Map(static_cast<const double *>(sections[XSection]), numPoints);
+        this->Y.Map(static_cast<const double *>(sections[YSection]), numPoints);
+        this->Z.Map(static_cast<const double *>(sections[ZSection]), numPoints);
+    }
+    this->Ids.Map(static_cast<const vtkIdType *>(sections[IdsSection]), numPoints);
+
+    // 删除标记在加载后仍可修改，拷贝到自己的内存
+    if (header.NumberOfRemovedPoints > 0)
+    {
+        const unsigned char *removed = static_cast<const unsigned char *>(sections[RemovedSection]);
+        this->Removed.assign(removed, removed + numPoints);
+        this->NumberOfRemovedPoints = static_cast<vtkIdType>(header.NumberOfRemovedPoints);
+    }
+    this->Mapping = std::move(file);
+    this->BuildElapsedTime = 0.0;
+    this->Modified();
+    return true;
+}
+
+bool AvtkFlatKdTree::RemovePointAt(vtkIdType index)
+{
+    if (index < 0 || index >= this->GetNumberOfPoints())
+        return false;
+    if (this->Removed.empty())
+        this->Removed.assign(this->Ids.size(), 0);
+    if (this->Removed[index])
+        return false;
+    this->Removed[index] = 1;
+    ++this->NumberOfRemovedPoints;
+    this->Modified();
+    return true;
+}
+
+void AvtkFlatKdTree::GetPoint(vtkIdType index, double x[3]) const
+{
+    if (this->FloatStorage)
+    {
+        x[0] = this->XF[index];
+        x[1] = this->YF[index];
+        x[2] = this->ZF[index];
+        return;
+    }
+    x[0] = this->X[index];
+    x[1] = this->Y[index];
+    x[2] = this->Z[index];
+}
+
+void AvtkFlatKdTree::ComputeNodeBounds(vtkIdType node, vtkIdType begin, vtkIdType end, const std::vector<vtkIdType> &perm,
+                                       const std::vector<double> &coords, bool parallel)
+{
+    double *bounds = &this->NodeBounds[6 * node];
+    if (begin >= end)
+    {
+        // 空节点使用反向包围盒，遍历时直接跳过
+        for (int i = 0; i < 3; ++i)
+        {
+            bounds[2 * i] = VTK_DOUBLE_MAX;
+            bounds[2 * i + 1] = -VTK_DOUBLE_MAX;
+        }
+        return;
+    }
+
+    if (parallel)
+    {
+        RangeBounds rangeBounds;
+        rangeBounds.Coords = coords.data();
+        rangeBounds.Perm = perm.data();
+        vtkSMPTools::For(begin, end, rangeBounds);
+        std::copy(rangeBounds.Bounds, rangeBounds.Bounds + 6, bounds);
+        return;
+    }
+
+    const double *p = &coords[3 * perm[begin]];
+    for (int i = 0; i < 3; ++i)
+    {
+        bounds[2 * i] = bounds[2 * i + 1] = p[i];
+    }
+    for (vtkIdType j = begin + 1; j < end; ++j)
+    {
+        p = &coords[3 * perm[j]];
+        for (int i = 0; i < 3; ++i)
+        {
+            bounds[2 * i] = std::min(bounds[2 * i], p[i]);
+            bounds[2 * i + 1] = std::max(bounds[2 * i + 1], p[i]);
+        }
+    }
+}
+
+void AvtkFlatKdTree::SplitNode(vtkIdType node, vtkIdType begin, vtkIdType end, std::vector<vtkIdType> &perm,
+                               const std::vector<double> &coords, std::vector<vtkIdType> *tmp)
+{
+    // 沿包围盒最长边划分
+    const double *bounds = this->GetNodeBounds(node);
+    int dim = 0;
+    double maxExtent = -1.0;
+    for (int i = 0; i < 3; ++i)
+    {
+        double extent = bounds[2 * i + 1] - bounds[2 * i];
+        if (extent > maxExtent)
+        {
+            maxExtent = extent;
+            dim = i;
+        }
+    }
+
+    vtkIdType mid = begin + (end - begin) / 2;
+    KeyLess less = {coords.data(), dim};
+    if (end - begin > 1)
+    {
+        if (tmp)
+            AUtils::ParallelSelect(perm, *tmp, begin, mid, end, less);
+        else
+            std::nth_element(perm.begin() + begin, perm.begin() + mid, perm.begin() + end, less);
+    }
+    this->SplitDim[node] = static_cast<unsigned char>(dim);
+    this->SplitValue[node] = mid < end ? coords[3 * perm[mid] + dim] : bounds[2 * dim];
+}
+
+void AvtkFlatKdTree::BuildNode(vtkIdType node, vtkIdType begin, vtkIdType end, int level,
+                               std::vector<vtkIdType> &perm, const std::vector<double> &coords)
+{
+    this->ComputeNodeBounds(node, begin, end, perm, coords, false);
+
+    if (level == this->Depth)
+    {
+        // 叶子内按id排序，使结果顺序与构建方式无关
+        std::sort(perm.begin() + begin, perm.begin() + end);
+        return;
+    }
+
+    this->SplitNode(node, begin, end, perm, coords, nullptr);
+
+    vtkIdType mid = begin + (end - begin) / 2;
+    this->BuildNode(2 * node + 1, begin, mid, level + 1, perm, coords);
+    this->BuildNode(2 * node + 2, mid, end, level + 1, perm, coords);
+}
+
+void AvtkFlatKdTree::BuildParallel(std::vector<vtkIdType> &perm, const std::vector<double> &coords)
+{
+    const vtkIdType numTasks = 4 * std::max(1, vtkSMPTools::GetEstimatedNumberOfThreads());
+    std::vector<vtkIdType> tmp(perm.size());
+
+    // 当前层各节点的点区间
+    std::vector<std::pair<vtkIdType, vtkIdType>> ranges = {{0, static_cast<vtkIdType>(perm.size())}};
+    for (int level = 0;; ++level)
+    {
+        vtkIdType first = (vtkIdType(1) << level) - 1;
+
+        // 节点数足够多后，各子树作为独立任务串行递归
+        if (static_cast<vtkIdType>(ranges.size()) >= numTasks || level == this->Depth)
+        {
+            vtkSMPTools::For(0, static_cast<vtkIdType>(ranges.size()), 1,
+                             [&](vtkIdType begin, vtkIdType end)
+                             {
+                                 for (vtkIdType i = begin; i < end; ++i)
+                                 {
+                                     this->BuildNode(first + i, ranges[i].first, ranges[i].second, level, perm, coords);
+                                 }
+                             });
+            return;
+        }
+
+        // 上层节点逐个处理，包围盒与中位数选择内部并行
+        std::vector<std::pair<vtkIdType, vtkIdType>> next;
+        next.reserve(2 * ranges.size());
+        for (size_t i = 0; i < ranges.size(); ++i)
+        {
+            vtkIdType node = first + static_cast<vtkIdType>(i);
+            vtkIdType begin = ranges[i].first;
+            vtkIdType end = ranges[i].second;
+            this->ComputeNodeBounds(node, begin, end, perm, coords, true);
+            this->SplitNode(node, begin, end, perm, coords, &tmp);
+            vtkIdType mid = begin + (end - begin) / 2;
+            next.emplace_back(begin, mid);
+            next.emplace_back(mid, end);
+        }
+        ranges.swap(next);
+    }
+}
+
+void AvtkFlatKdTree::GetBounds(double bounds[6]) const
+{
+    if (this->NodeBounds.empty())
+    {
+        std::fill(bounds, bounds + 6, 0.0);
+        return;
+    }
+    std::copy(this->NodeBounds.begin(), this->NodeBounds.begin() + 6, bounds);
+}
+
+template <typename Shape>
+void AvtkFlatKdTree::FindPointsInShape(const Shape &shape, vtkIdList *ids) const
+{
+    ids->Reset();
+    this->VisitPointsInShape(shape, [ids](const vtkIdType *segment, vtkIdType n)
+                             { AUtils::AppendIds(ids, segment, n); });
+}
+
+void AvtkFlatKdTree::PushLeafCandidates(vtkIdType begin, vtkIdType end, const double x[3], size_t N,
+                                        std::vector<std::pair<double, vtkIdType>> &heap) const
+{
+    const unsigned char *removed = this->Removed.empty() ? nullptr : this->Removed.data();
+    if (this->FloatStorage)
+        PushCandidates(this->XF.data(), this->YF.data(), this->ZF.data(), this->Ids.data(), removed, begin, end, x, N, heap);
+    else
+        PushCandidates(this->X.data(), this->Y.data(), this->Z.data(), this->Ids.data(), removed, begin, end, x, N, heap);
+}
+
+void AvtkFlatKdTree::SearchClosestPoints(vtkIdType node, vtkIdType begin, vtkIdType end, const double x[3], size_t N,
+                                         std::vector<std::pair<double, vtkIdType>> &heap) const
+{
+    if (begin >= end)
+        return;
+    if (heap.size() == N && AUtils::BoundsDistance2(this->GetNodeBounds(node), x) > heap.front().first)
+        return;
+
+    if (this->IsLeaf(node))
+    {
+        this->PushLeafCandidates(begin, end, x, N, heap);
+        return;
+    }
+
+    // 先搜索查询点所在一侧的子节点
+    vtkIdType mid = begin + (end - begin) / 2;
+    vtkIdType left = 2 * node + 1;
+    vtkIdType right = 2 * node + 2;
+    if (x[this->SplitDim[node]] <= this->SplitValue[node])
+    {
+        this->SearchClosestPoints(left, begin, mid, x, N, heap);
+        this->SearchClosestPoints(right, mid, end, x, N, heap);
+    }
+    else
+    {
+        this->SearchClosestPoints(right, mid, end, x, N, heap);
+        this->SearchClosestPoints(left, begin, mid, x, N, heap);
+    }
+}
+
+void AvtkFlatKdTree::SearchClosestPoint(vtkIdType node, vtkIdType begin, vtkIdType end, const double x[3],
+                                        std::pair<double, vtkIdType> &closest) const
+{
+    if (begin >= end || AUtils::BoundsDistance2(this->GetNodeBounds(node), x) > closest.first)
+        return;
+
+    if (this->IsLeaf(node))
+    {
+        const unsigned char *removed = this->Removed.empty() ? nullptr : this->Removed.data();
+        if (this->FloatStorage)
+            UpdateClosest(this->XF.data(), this->YF.data(), this->ZF.data(), this->Ids.data(), removed, begin, end, x,
+                          closest);
+        else
+            UpdateClosest(this->X.data(), this->Y.data(), this->Z.data(), this->Ids.data(), removed, begin, end, x,
+                          closest);
+        return;
+    }
+
+    // 先搜索查询点所在一侧的子节点
+    vtkIdType mid = begin + (end - begin) / 2;
+    vtkIdType left = 2 * node + 1;
+    vtkIdType right = 2 * node + 2;
+    if (x[this->SplitDim[node]] <= this->SplitValue[node])
+    {
+        this->SearchClosestPoint(left, begin, mid, x, closest);
+        this->SearchClosestPoint(right, mid, end, x, closest);
+    }
+    else
+    {
+        this->SearchClosestPoint(right, mid, end, x, closest);
+        this->SearchClosestPoint(left, begin, mid, x, closest);
+    }
+}
+
+vtkIdType AvtkFlatKdTree::FindClosestPoint(const double x[3], double &dist2) const
+{
+    dist2 = VTK_DOUBLE_MAX;
+    if (this->Ids.empty())
+        return -1;
+
+    // 只需要一个点，不使用堆
+    std::pair<double, vtkIdType> closest(VTK_DOUBLE_MAX, -1);
+    this->SearchClosestPoint(0, 0, this->GetNumberOfPoints(), x, closest);
+    if (closest.second < 0)
+        return -1;
+    dist2 = closest.first;
+    return closest.second;
+}
+
+void AvtkFlatKdTree::SearchClosestPoints(const double x[3], size_t N, std::vector<std::pair<double, vtkIdType>> &heap) const
+{
+    if (N == 0 || this->Ids.empty())
+        return;
+    this->SearchClosestPoints(0, 0, this->GetNumberOfPoints(), x, N, heap);
+}
+
+int AvtkFlatKdTree::SearchApproximateClosestPoints(const double x[3], size_t N, double epsilon, int maxLeaves,
+                                                   std::vector<std::pair<double, vtkIdType>> &heap) const
+{
+    if (N == 0 || this->Ids.empty())
+        return 0;
+
+    // 节点按包围盒距离平方排列的最小堆
+    struct Entry
+    {
+        double Dist2;
+        vtkIdType Node;
+        vtkIdType Begin;
+        vtkIdType End;
+
+        bool operator>(const Entry &other) const { return this->Dist2 > other.Dist2; }
+    };
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+
+    const double scale = (1.0 + epsilon) * (1.0 + epsilon);
+    auto pruned = [&](double dist2)
+    { return heap.size() == N && dist2 * scale > heap.front().first; };
+
+    queue.push({AUtils::BoundsDistance2(this->GetNodeBounds(0), x), 0, 0, this->GetNumberOfPoints()});
+    int leavesVisited = 0;
+    while (!queue.empty())
+    {
+        Entry entry = queue.top();
+        queue.pop();
+        if (pruned(entry.Dist2))
+            break;
+
+        // 沿较近的子节点下降到叶子，较远的子节点放入队列
+        vtkIdType node = entry.Node;
+        vtkIdType begin = entry.Begin;
+        vtkIdType end = entry.End;
+        while (!this->IsLeaf(node))
+        {
+            vtkIdType mid = begin + (end - begin) / 2;
+            bool leftNear = x[this->SplitDim[node]] <= this->SplitValue[node];
+            vtkIdType nearNode = leftNear ? 2 * node + 1 : 2 * node + 2;
+            vtkIdType farNode = leftNear ? 2 * node + 2 : 2 * node + 1;
+            vtkIdType nearBegin = leftNear ? begin : mid;
+            vtkIdType nearEnd = leftNear ? mid : end;
+            vtkIdType farBegin = leftNear ? mid : begin;
+            vtkIdType farEnd = leftNear ? end : mid;
+            if (nearBegin >= nearEnd)
+            {
+                std::swap(nearNode, farNode);
+                std::swap(nearBegin, farBegin);
+                std::swap(nearEnd, farEnd);
+            }
+            if (farBegin < farEnd)
+            {
+                double dist2 = AUtils::BoundsDistance2(this->GetNodeBounds(farNode), x);
+                if (!pruned(dist2))
+                    queue.push({dist2, farNode, farBegin, farEnd});
+            }
+            node = nearNode;
+            begin = nearBegin;
+            end = nearEnd;
+        }
+
+        this->PushLeafCandidates(begin, end, x, N, heap);
+        if (++leavesVisited == maxLeaves)
+            break;
+    }
+    return leavesVisited;
+}
+
+void AvtkFlatKdTree::FindApproximateClosestNPoints(int N, const double x[3], double epsilon, int maxLeaves,
+                                                   vtkIdList *result, int *leavesVisited) const
+{
+    result->Reset();
+    std::vector<std::pair<double, vtkIdType>> &heap = GetScratchHeap();
+    int visited = 0;
+    if (N > 0)
+    {
+        size_t maxCount = std::min(static_cast<size_t>(N), this->Ids.size());
+        heap.reserve(maxCount);
+        visited = this->SearchApproximateClosestPoints(x, maxCount, epsilon, maxLeaves, heap);
+    }
+    if (leavesVisited)
+        *leavesVisited = visited;
+
+    std::sort_heap(heap.begin(), heap.end());
+    result->SetNumberOfIds(static_cast<vtkIdType>(heap.size()));
+    for (size_t i = 0; i < heap.size(); ++i)
+    {
+        result->SetId(static_cast<vtkIdType>(i), heap[i].second);
+    }
+}
+
+vtkIdType AvtkFlatKdTree::FindApproximateClosestPoint(const double x[3], double epsilon, int maxLeaves, double &dist2,
+                                                      int *leavesVisited) const
+{
+    std::vector<std::pair<double, vtkIdType>> &heap = GetScratchHeap();
+    int visited = this->SearchApproximateClosestPoints(x, 1, epsilon, maxLeaves, heap);
+    if (leavesVisited)
+        *leavesVisited = visited;
+    if (heap.empty())
+    {
+        dist2 = VTK_DOUBLE_MAX;
+        return -1;
+    }
+    dist2 = heap.front().first;
+    return heap.front().second;
+}
+
+vtkIdType AvtkFlatKdTree::FindClosestPointWithinRadius(double radius, const double x[3], double &dist2) const
+{
+    vtkIdType id = this->FindClosestPoint(x, dist2);
+    if (id < 0 || dist2 > radius * radius)
+        return -1;
+    return id;
+}
+
+void AvtkFlatKdTree::FindClosestNPoints(int N, const double x[3], vtkIdList *result) const
+{
+    result->Reset();
+    if (N <= 0 || this->Ids.empty())
+        return;
+
+    std::vector<std::pair<double, vtkIdType>> &heap = GetScratchHeap();
+    size_t maxCount = std::min(static_cast<size_t>(N), this->Ids.size());
+    heap.reserve(maxCount);
+    this->SearchClosestPoints(0, 0, this->GetNumberOfPoints(), x, maxCount, heap);
+
+    std::sort_heap(heap.begin(), heap.end());
+    result->SetNumberOfIds(static_cast<vtkIdType>(heap.size()));
+    for (size_t i = 0; i < heap.size(); ++i)
+    {
+        result->SetId(static_cast<vtkIdType>(i), heap[i].second);
+    }
+}
+
+void AvtkFlatKdTree::FindPointsWithinRadius(double R, const double x[3], vtkIdList *result) const
+{
+    AUtils::SphereShape sphere;
+    sphere.Init(x, R);
+    this->FindPointsInShape(sphere, result);
+}
+
+void AvtkFlatKdTree::FindPointsInArea(const double area[6], vtkIdList *ids) const
+{
+    AUtils::AreaShape areaShape;
+    areaShape.Init(area);
+    this->FindPointsInShape(areaShape, ids);
+}
+
+void AvtkFlatKdTree::FindPointsInCuboid(const double cuboid[8][3], vtkIdList *ids) const
+{
+    AUtils::CuboidShape cuboidShape;
+    cuboidShape.Init(cuboid);
+    this->FindPointsInShape(cuboidShape, ids);
+}
+
+void AvtkFlatKdTree::FindPointsInConvexPolytope(const double *planes, int numPlanes, vtkIdList *ids) const
+{
+    AUtils::ConvexPolytopeShape polytope;
+    polytope.Init(planes, numPlanes);
+    this->FindPointsInShape(polytope, ids);
+}
+
+void AvtkFlatKdTree::FindPointsInTube(const double *points, int numPoints, double radius, vtkIdList *ids) const
+{
+    AUtils::TubeShape tube;
+    tube.Init(points, numPoints, radius);
+    this->FindPointsInShape(tube, ids);
+}
+
+void AvtkFlatKdTree::FindPointsInCylinder(const double point[3], const double direction[3], double radius, vtkIdList *ids) const
+{
+    AUtils::CylinderShape cylinder;
+    if (!cylinder.InitCylinder(point, direction, radius))
+    {
+        ids->Reset();
+        vtkErrorMacro(<< "FindPointsInCylinder - direction vector is zero");
+        return;
+    }
+    this->FindPointsInShape(cylinder, ids);
+}
+
+void AvtkFlatKdTree::FindPointsInCapsule(const double p0[3], const double p1[3], double radius, vtkIdList *ids) const
+{
+    AUtils::CylinderShape capsule;
+    capsule.InitCapsule(p0, p1, radius);
+    this->FindPointsInShape(capsule, ids);
+}
+
+void AvtkFlatKdTree::AddNodeRepresentation(vtkIdType node, vtkIdType begin, vtkIdType end, int level, int targetLevel,
+                                           vtkPoints *pts, vtkCellArray *polys) const
+{
+    if (begin >= end)
+        return;
+
+    if (level < targetLevel && !this->IsLeaf(node))
+    {
+        vtkIdType mid = begin + (end - begin) / 2;
+        this->AddNodeRepresentation(2 * node + 1, begin, mid, level + 1, targetLevel, pts, polys);
+        this->AddNodeRepresentation(2 * node + 2, mid, end, level + 1, targetLevel, pts, polys);
+        return;
+    }
+
+    // 包围盒的8个角点与6个面，角点顺序与AUtils::cubeIndices一致
+    const double *bounds = this->GetNodeBounds(node);
+    vtkIdType first = pts->GetNumberOfPoints();
+    for (int i = 0; i < 8; ++i)
+    {
+        pts->InsertNextPoint(bounds[(i & 1) ? 1 : 0], bounds[(i & 2) ? 3 : 2], bounds[(i & 4) ? 5 : 4]);
+    }
+    const vtkIdType faces[6][4] = {
+        {0, 1, 3, 2}, {4, 5, 7, 6}, {0, 1, 5, 4}, {1, 3, 7, 5}, {3, 2, 6, 7}, {2, 0, 4, 6}};
+    for (int f = 0; f < 6; ++f)
+    {
+        vtkIdType quad[4] = {first + faces[f][0], first + faces[f][1], first + faces[f][2], first + faces[f][3]};
+        polys->InsertNextCell(4, quad);
+    }
+}
+
+void AvtkFlatKdTree::AppendRepresentation(int level, vtkPoints *pts, vtkCellArray *polys) const
+{
+    if (this->Ids.empty())
+        return;
+    this->AddNodeRepresentation(0, 0, this->GetNumberOfPoints(), 0, std::max(level, 0), pts, polys);
+}
+
+void AvtkFlatKdTree::GenerateRepresentation(int level, vtkPolyData *pd) const
+{
+    vtkNew<vtkPoints> pts;
+    vtkNew<vtkCellArray> polys;
+    this->AppendRepresentation(level, pts, polys);
+    pd->Initialize();
+    pd->SetPoints(pts);
+    pd->SetPolys(polys);
+}
+
+void AvtkFlatKdTree::PrintSelf(ostream &os, vtkIndent indent)
+{
+    this->Superclass::PrintSelf(os, indent);
+
+    os << indent << "NumberOfPointsPerLeaf: " << this->NumberOfPointsPerLeaf << "\n";
+    os << indent << "NumberOfPoints: " << this->GetNumberOfPoints() << "\n";
+    os << indent << "NumberOfRemovedPoints: " << this->NumberOfRemovedPoints << "\n";
+    os << indent << "NumberOfLevels: " << this->GetNumberOfLevels() << "\n";
+    os << indent << "ParallelBuild: " << this->ParallelBuild << "\n";
+    os << indent << "BuildElapsedTime: " << this->BuildElapsedTime << "\n";
+    os << indent << "SinglePrecision: " << this->SinglePrecision << "\n";
+    os << indent << "Mapped: " << (this->IsMapped() ? "On" : "Off") << "\n";
+}
+
+unsigned long AvtkFlatKdTree::GetActualMemorySize() const
+{
+    size_t size = this->SplitDim.GetOwnedMemorySize() + this->SplitValue.GetOwnedMemorySize() +
+                  this->NodeBounds.GetOwnedMemorySize() + this->X.GetOwnedMemorySize() +
+                  this->Y.GetOwnedMemorySize() + this->Z.GetOwnedMemorySize() + this->XF.GetOwnedMemorySize() +
+                  this->YF.GetOwnedMemorySize() + this->ZF.GetOwnedMemorySize() + this->Ids.GetOwnedMemorySize() +
+                  this->Removed.capacity() * sizeof(unsigned char);
+    return static_cast<unsigned long>((size + 1023) / 1024);
+}
\ No newline at end of file
@@ -0,0 +1,496 @@
+#include "AvtkIncrementalKdTree.h"
+#include "vtkObjectFactory.h"
+#include "vtkCellArray.h"
+#include "vtkMath.h"
+
+#include <algorithm>
+
+vtkStandardNewMacro(AvtkIncrementalKdTree);
+
+void AvtkIncrementalKdTree::Initialize()
+{
+    this->Trees.clear();
+    this->BufferPoints.clear();
+    this->BufferIds.clear();
+    this->Locations.clear();
+    this->NumberOfPoints = 0;
+    this->Modified();
+}
+
+void AvtkIncrementalKdTree::ShallowCopy(AvtkIncrementalKdTree *source)
+{
+    if (!source || source == this)
+        return;
+    this->NumberOfPointsPerLeaf = source->NumberOfPointsPerLeaf;
+    this->BufferSize = source->BufferSize;
+    this->MaxRemovedFraction = source->MaxRemovedFraction;
+    this->ParallelBuild = source->ParallelBuild;
+    this->SinglePrecision = source->SinglePrecision;
+    this->Trees = source->Trees;
+    this->BufferPoints = source->BufferPoints;
+    this->BufferIds = source->BufferIds;
+    this->Locations = source->Locations;
+    this->NumberOfPoints = source->NumberOfPoints;
+    this->Modified();
+}
+
+void AvtkIncrementalKdTree::BuildFromPoints(vtkPoints *points)
+{
+    this->Initialize();
+    vtkIdType numPoints = points ? points->GetNumberOfPoints() : 0;
+    if (numPoints < 1)
+        return;
+
+    std::vector<double> coords(3 * numPoints);
+    std::vector<vtkIdType> ids(numPoints);
+    for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+        points->GetPoint(i, &coords[3 * i]);
+        ids[i] = i;
+    }
+    this->Locations.resize(numPoints);
+    this->NumberOfPoints = numPoints;
+
+    // 放入能容纳全部点的最小一层
+    int k = 0;
+    while ((static_cast<vtkIdType>(this->BufferSize) << k) < numPoints)
+    {
+        ++k;
+    }
+    this->Trees.resize(k + 1);
+    this->BuildTree(k, coords, ids);
+}
+
+void AvtkIncrementalKdTree::InsertPoint(vtkIdType id, const double x[3])
+{
+    if (id < 0)
+    {
+        vtkErrorMacro(<< "AvtkIncrementalKdTree - point id must be non-negative");
+        return;
+    }
+    if (this->HasPoint(id))
+    {
+        this->RemovePoint(id);
+    }
+    if (id >= static_cast<vtkIdType>(this->Locations.size()))
+    {
+        this->Locations.resize(id + 1);
+    }
+
+    this->Locations[id].Tree = -1;
+    this->Locations[id].Index = static_cast<vtkIdType>(this->BufferIds.size());
+    // 单精度存储时缓冲区中的坐标同样舍入，合并到树中前后的查询结果一致
+    for (int i = 0; i < 3; ++i)
+    {
+        this->BufferPoints.push_back(this->SinglePrecision ? static_cast<float>(x[i]) : x[i]);
+    }
+    this->BufferIds.push_back(id);
+    ++this->NumberOfPoints;
+
+    if (static_cast<vtkIdType>(this->BufferIds.size()) >= this->BufferSize)
+    {
+        this->FlushBuffer();
+    }
+    this->Modified();
+}
+
+void AvtkIncrementalKdTree::InsertPoints(vtkPoints *points, vtkIdType begin, vtkIdType end)
+{
+    end = std::min(end, points->GetNumberOfPoints());
+    double x[3];
+    for (vtkIdType i = begin; i < end; ++i)
+    {
+        points->GetPoint(i, x);
+        this->InsertPoint(i, x);
+    }
+}
+
+bool AvtkIncrementalKdTree::HasPoint(vtkIdType id) const
+{
+    return id >= 0 && id < static_cast<vtkIdType>(this->Locations.size()) && this->Locations[id].Tree != -2;
+}
+
+bool AvtkIncrementalKdTree::RemovePoint(vtkIdType id)
+{
+    if (!this->HasPoint(id))
+        return false;
+
+    Location location = this->Locations[id];
+    this->Locations[id].Tree = -2;
+    --this->NumberOfPoints;
+    if (location.Tree == -1)
+    {
+        this->RemoveFromBuffer(location.Index);
+    }
+    else
+    {
+        // 与其它增量树共享的树先复制一份，不修改对方看到的删除标记
+        if (this->Trees[location.Tree]->GetReferenceCount() > 1)
+        {
+            auto copy = vtkSmartPointer<AvtkFlatKdTree>::New();
+            copy->ShallowCopy(this->Trees[location.Tree]);
+            this->Trees[location.Tree] = copy;
+        }
+        AvtkFlatKdTree *tree = this->Trees[location.Tree];
+        tree->RemovePointAt(location.Index);
+        if (tree->GetNumberOfRemovedPoints() > this->MaxRemovedFraction * tree->GetNumberOfPoints())
+        {
+            this->RebuildTree(location.Tree);
+        }
+    }
+    this->Modified();
+    return true;
+}
+
+void AvtkIncrementalKdTree::RemoveFromBuffer(vtkIdType index)
+{
+    // 用最后一个点填补空位
+    vtkIdType last = static_cast<vtkIdType>(this->BufferIds.size()) - 1;
+    if (index != last)
+    {
+        std::copy(this->BufferPoints.begin() + 3 * last, this->BufferPoints.begin() + 3 * last + 3,
+                  this->BufferPoints.begin() + 3 * index);
+        this->BufferIds[index] = this->BufferIds[last];
+        this->Locations[this->BufferIds[index]].Index = index;
+    }
+    this->BufferPoints.resize(3 * last);
+    this->BufferIds.pop_back();
+}
+
+void AvtkIncrementalKdTree::FlushBuffer()
+{
+    std::vector<double> coords;
+    std::vector<vtkIdType> ids;
+    coords.swap(this->BufferPoints);
+    ids.swap(this->BufferIds);
+
+    // 与二进制计数的进位相同：合并所有连续的非空树
+    size_t k = 0;
+    while (k < this->Trees.size() && this->Trees[k])
+    {
+        this->CollectTreePoints(static_cast<int>(k), coords, ids);
+        this->Trees[k] = nullptr;
+        ++k;
+    }
+    if (k == this->Trees.size())
+    {
+        this->Trees.emplace_back();
+    }
+    this->BuildTree(static_cast<int>(k), coords, ids);
+}
+
+void AvtkIncrementalKdTree::RebuildTree(int k)
+{
+    std::vector<double> coords;
+    std::vector<vtkIdType> ids;
+    this->CollectTreePoints(k, coords, ids);
+    this->BuildTree(k, coords, ids);
+}
+
+void AvtkIncrementalKdTree::CollectTreePoints(int k, std::vector<double> &coords, std::vector<vtkIdType> &ids) const
+{
+    const AvtkFlatKdTree *tree = this->Trees[k];
+    vtkIdType numPoints = tree->GetNumberOfPoints();
+    coords.reserve(coords.size() + 3 * (numPoints - tree->GetNumberOfRemovedPoints()));
+    ids.reserve(ids.size() + numPoints - tree->GetNumberOfRemovedPoints());
+    double x[3];
+    for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+        if (tree->IsPointRemoved(i))
+            continue;
+        tree->GetPoint(i, x);
+        coords.insert(coords.end(), x, x + 3);
+        ids.push_back(tree->GetPointId(i));
+    }
+}
+
+void AvtkIncrementalKdTree::BuildTree(int k, const std::vector<double> &coords, const std::vector<vtkIdType> &ids)
+{
+    if (ids.empty())
+    {
+        this->Trees[k] = nullptr;
+        return;
+    }
+
+    auto tree = vtkSmartPointer<AvtkFlatKdTree>::New();
+    tree->SetNumberOfPointsPerLeaf(this->NumberOfPointsPerLeaf);
+    tree->SetParallelBuild(this->ParallelBuild);
+    tree->SetSinglePrecision(this->SinglePrecision);
+    tree->BuildFromPoints(coords, ids);
+    for (vtkIdType i = 0; i < tree->GetNumberOfPoints(); ++i)
+    {
+        Location &location = this->Locations[tree->GetPointId(i)];
+        location.Tree = k;
+        location.Index = i;
+    }
+    this->Trees[k] = tree;
+}
+
+int AvtkIncrementalKdTree::GetNumberOfTrees() const
+{
+    return static_cast<int>(std::count_if(this->Trees.begin(), this->Trees.end(),
+                                          [](const vtkSmartPointer<AvtkFlatKdTree> &tree)
+                                          { return tree != nullptr; }));
+}
+
+void AvtkIncrementalKdTree::GetBounds(double bounds[6]) const
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        bounds[2 * i] = VTK_DOUBLE_MAX;
+        bounds[2 * i + 1] = -VTK_DOUBLE_MAX;
+    }
+    for (const auto &tree : this->Trees)
+    {
+        if (!tree)
+            continue;
+        double treeBounds[6];
+        tree->GetBounds(treeBounds);
+        for (int i = 0; i < 3; ++i)
+        {
+            bounds[2 * i] = std::min(bounds[2 * i], treeBounds[2 * i]);
+            bounds[2 * i + 1] = std::max(bounds[2 * i + 1], treeBounds[2 * i + 1]);
+        }
+    }
+    for (size_t j = 0; j < this->BufferIds.size(); ++j)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            bounds[2 * i] = std::min(bounds[2 * i], this->BufferPoints[3 * j + i]);
+            bounds[2 * i + 1] = std::max(bounds[2 * i + 1], this->BufferPoints[3 * j + i]);
+        }
+    }
+    if (bounds[0] > bounds[1])
+    {
+        std::fill(bounds, bounds + 6, 0.0);
+    }
+}
+
+unsigned long AvtkIncrementalKdTree::GetActualMemorySize() const
+{
+    unsigned long size = 0;
+    for (const auto &tree : this->Trees)
+    {
+        if (tree)
+            size += tree->GetActualMemorySize();
+    }
+    size_t buffers = this->BufferPoints.capacity() * sizeof(double) + this->BufferIds.capacity() * sizeof(vtkIdType) +
+                     this->Locations.capacity() * sizeof(Location);
+    return size + static_cast<unsigned long>((buffers + 1023) / 1024);
+}
+
+vtkIdType AvtkIncrementalKdTree::FindClosestPoint(const double x[3], double &dist2) const
+{
+    std::vector<std::pair<double, vtkIdType>> heap;
+    heap.reserve(1);
+    for (const auto &tree : this->Trees)
+    {
+        if (tree)
+            tree->SearchClosestPoints(x, 1, heap);
+    }
+    for (size_t j = 0; j < this->BufferIds.size(); ++j)
+    {
+        AUtils::PushCandidate(heap, 1, vtkMath::Distance2BetweenPoints(x, &this->BufferPoints[3 * j]), this->BufferIds[j]);
+    }
+
+    if (heap.empty())
+    {
+        dist2 = VTK_DOUBLE_MAX;
+        return -1;
+    }
+    dist2 = heap.front().first;
+    return heap.front().second;
+}
+
+vtkIdType AvtkIncrementalKdTree::FindClosestPointWithinRadius(double radius, const double x[3], double &dist2) const
+{
+    vtkIdType id = this->FindClosestPoint(x, dist2);
+    if (id < 0 || dist2 > radius * radius)
+        return -1;
+    return id;
+}
+
+void AvtkIncrementalKdTree::FindClosestNPoints(int N, const double x[3], vtkIdList *result) const
+{
+    result->Reset();
+    if (N <= 0 || this->NumberOfPoints == 0)
+        return;
+
+    size_t maxCount = std::min(static_cast<size_t>(N), static_cast<size_t>(this->NumberOfPoints));
+    std::vector<std::pair<double, vtkIdType>> heap;
+    heap.reserve(maxCount);
+    for (const auto &tree : this->Trees)
+    {
+        if (tree)
+            tree->SearchClosestPoints(x, maxCount, heap);
+    }
+    for (size_t j = 0; j < this->BufferIds.size(); ++j)
+    {
+        AUtils::PushCandidate(heap, maxCount, vtkMath::Distance2BetweenPoints(x, &this->BufferPoints[3 * j]), this->BufferIds[j]);
+    }
+
+    std::sort_heap(heap.begin(), heap.end());
+    result->SetNumberOfIds(static_cast<vtkIdType>(heap.size()));
+    for (size_t i = 0; i < heap.size(); ++i)
+    {
+        result->SetId(static_cast<vtkIdType>(i), heap[i].second);
+    }
+}
+
+int AvtkIncrementalKdTree::SearchApproximateClosestPoints(const double x[3], size_t N, double epsilon, int maxLeaves,
+                                                          std::vector<std::pair<double, vtkIdType>> &heap) const
+{
+    int leavesVisited = 0;
+    if (N == 0)
+        return leavesVisited;
+
+    // 缓冲区按一个叶子计算
+    if (!this->BufferIds.empty())
+    {
+        for (size_t j = 0; j < this->BufferIds.size(); ++j)
+        {
+            AUtils::PushCandidate(heap, N, vtkMath::Distance2BetweenPoints(x, &this->BufferPoints[3 * j]), this->BufferIds[j]);
+        }
+        ++leavesVisited;
+    }
+    for (auto tree = this->Trees.rbegin(); tree != this->Trees.rend(); ++tree)
+    {
+        if (!*tree)
+            continue;
+        if (maxLeaves > 0 && leavesVisited >= maxLeaves)
+            break;
+        int budget = maxLeaves > 0 ? maxLeaves - leavesVisited : 0;
+        leavesVisited += (*tree)->SearchApproximateClosestPoints(x, N, epsilon, budget, heap);
+    }
+    return leavesVisited;
+}
+
+void AvtkIncrementalKdTree::FindApproximateClosestNPoints(int N, const double x[3], double epsilon, int maxLeaves,
+                                                          vtkIdList *result, int *leavesVisited) const
+{
+    result->Reset();
+    std::vector<std::pair<double, vtkIdType>> heap;
+    int visited = 0;
+    if (N > 0 && this->NumberOfPoints > 0)
+    {
+        size_t maxCount = std::min(static_cast<size_t>(N), static_cast<size_t>(this->NumberOfPoints));
+        heap.reserve(maxCount);
+        visited = this->SearchApproximateClosestPoints(x, maxCount, epsilon, maxLeaves, heap);
+    }
+    if (leavesVisited)
+        *leavesVisited = visited;
+
+    std::sort_heap(heap.begin(), heap.end());
+    result->SetNumberOfIds(static_cast<vtkIdType>(heap.size()));
+    for (size_t i = 0; i < heap.size(); ++i)
+    {
+        result->SetId(static_cast<vtkIdType>(i), heap[i].second);
+    }
+}
+
+vtkIdType AvtkIncrementalKdTree::FindApproximateClosestPoint(const double x[3], double epsilon, int maxLeaves, double &dist2,
+                                                             int *leavesVisited) const
+{
+    std::vector<std::pair<double, vtkIdType>> heap;
+    heap.reserve(1);
+    int visited = this->SearchApproximateClosestPoints(x, 1, epsilon, maxLeaves, heap);
+    if (leavesVisited)
+        *leavesVisited = visited;
+    if (heap.empty())
+    {
+        dist2 = VTK_DOUBLE_MAX;
+        return -1;
+    }
+    dist2 = heap.front().first;
+    return heap.front().second;
+}
+
+template <typename Shape>
+void AvtkIncrementalKdTree::FindPointsInShape(const Shape &shape, vtkIdList *ids) const
+{
+    ids->Reset();
+    this->VisitPointsInShape(shape, [ids](const vtkIdType *segment, vtkIdType n)
+                             { AUtils::AppendIds(ids, segment, n); });
+}
+
+void AvtkIncrementalKdTree::FindPointsWithinRadius(double R, const double x[3], vtkIdList *result) const
+{
+    AUtils::SphereShape sphere;
+    sphere.Init(x, R);
+    this->FindPointsInShape(sphere, result);
+}
+
+void AvtkIncrementalKdTree::FindPointsInArea(const double area[6], vtkIdList *ids) const
+{
+    AUtils::AreaShape areaShape;
+    areaShape.Init(area);
+    this->FindPointsInShape(areaShape, ids);
+}
+
+void AvtkIncrementalKdTree::FindPointsInCuboid(const double cuboid[8][3], vtkIdList *ids) const
+{
+    AUtils::CuboidShape cuboidShape;
+    cuboidShape.Init(cuboid);
+    this->FindPointsInShape(cuboidShape, ids);
+}
+
+void AvtkIncrementalKdTree::FindPointsInConvexPolytope(const double *planes, int numPlanes, vtkIdList *ids) const
+{
+    AUtils::ConvexPolytopeShape polytope;
+    polytope.Init(planes, numPlanes);
+    this->FindPointsInShape(polytope, ids);
+}
+
+void AvtkIncrementalKdTree::FindPointsInTube(const double *points, int numPoints, double radius, vtkIdList *ids) const
+{
+    AUtils::TubeShape tube;
+    tube.Init(points, numPoints, radius);
+    this->FindPointsInShape(tube, ids);
+}
+
+void AvtkIncrementalKdTree::FindPointsInCylinder(const double point[3], const double direction[3], double radius, vtkIdList *ids) const
+{
+    AUtils::CylinderShape cylinder;
+    if (!cylinder.InitCylinder(point, direction, radius))
+    {
+        ids->Reset();
+        vtkErrorMacro(<< "FindPointsInCylinder - direction vector is zero");
+        return;
+    }
+    this->FindPointsInShape(cylinder, ids);
+}
+
+void AvtkIncrementalKdTree::FindPointsInCapsule(const double p0[3], const double p1[3], double radius, vtkIdList *ids) const
+{
+    AUtils::CylinderShape capsule;
+    capsule.InitCapsule(p0, p1, radius);
+    this->FindPointsInShape(capsule, ids);
+}
+
+void AvtkIncrementalKdTree::GenerateRepresentation(int level, vtkPolyData *pd) const
+{
+    vtkNew<vtkPoints> pts;
+    vtkNew<vtkCellArray> polys;
+    for (const auto &tree : this->Trees)
+    {
+        if (tree)
+            tree->AppendRepresentation(level, pts, polys);
+    }
+    pd->Initialize();
+    pd->SetPoints(pts);
+    pd->SetPolys(polys);
+}
+
+void AvtkIncrementalKdTree::PrintSelf(ostream &os, vtkIndent indent)
+{
+    this->Superclass::PrintSelf(os, indent);
+
+    os << indent << "NumberOfPointsPerLeaf: " << this->NumberOfPointsPerLeaf << "\n";
+    os << indent << "BufferSize: " << this->BufferSize << "\n";
+    os << indent << "MaxRemovedFraction: " << this->MaxRemovedFraction << "\n";
+    os << indent << "ParallelBuild: " << this->ParallelBuild << "\n";
+    os << indent << "SinglePrecision: " << this->SinglePrecision << "\n";
+    os << indent << "NumberOfPoints: " << this->NumberOfPoints << "\n";
+    os << indent << "NumberOfTrees: " << this->GetNumberOfTrees() << "\n";
+    os << indent << "NumberOfBufferedPoints: " << this->BufferIds.size() << "\n";
+}
@@ -1,296 +1,1384 @@
 #include "AvtkKdTree.h"
+#include "ParallelSelect.h"
 #include "vtkObjectFactory.h"
 #include "vtkKdNode.h"
+#include "vtkMath.h"
+#include "vtkNew.h"
+#include "vtkPointData.h"
+#include "vtkSMPThreadLocal.h"
+#include "vtkSMPTools.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
 
 vtkStandardNewMacro(AvtkKdTree);
 
-std::vector<CubeFrame *> AvtkKdTree::GetRegionsBoundariesByLevel(int level)
+namespace
 {
-    std::vector<CubeFrame *> frames;
+    /**
+     * 以 (坐标, id) 作为严格全序，使并行选择的枢轴唯一。
+     */
+    struct FloatKeyLess
+    {
+        const float *Coords;
+        int Dim;
 
-    // 获取指定层级的所有节点
-    int numRegions = this->GetNumberOfRegionsAtLevel(level);
-    vtkKdNode **nodes = new vtkKdNode *[numRegions];
-    this->GetRegionsAtLevel(level, nodes);
+        bool operator()(vtkIdType a, vtkIdType b) const
+        {
+            float ca = Coords[3 * a + Dim];
+            float cb = Coords[3 * b + Dim];
+            return ca < cb || (ca == cb && a < b);
+        }
+    };
 
-    // 遍历每个节点，获取边界并创建对应的CubeFrame
-    for (int i = 0; i < numRegions; ++i)
+    /**
+     * 中位数两侧的汇总：与中位数相等的点数、左侧小于中位数的最大值与右侧大于中位数的最小值。
+     */
+    struct SplitSummary
     {
-        double bounds[6];
-        nodes[i]->GetBounds(bounds);
-        CubeFrame *frame = new CubeFrame(bounds);
-        frames.push_back(frame);
+        vtkIdType EqualLeft = 0;
+        vtkIdType EqualRight = 0;
+        float MaxLess = -VTK_FLOAT_MAX;
+        float MinGreater = VTK_FLOAT_MAX;
+
+        void Add(const SplitSummary &other)
+        {
+            this->EqualLeft += other.EqualLeft;
+            this->EqualRight += other.EqualRight;
+            this->MaxLess = std::max(this->MaxLess, other.MaxLess);
+            this->MinGreater = std::min(this->MinGreater, other.MinGreater);
+        }
+    };
+
+    /**
+     * 汇总 [begin, end) 中除中位数位置 mid 以外的点。
+     */
+    void SummarizeSplit(const float *coords, const vtkIdType *perm, int dim, vtkIdType mid, float median,
+                        vtkIdType begin, vtkIdType end, SplitSummary &summary)
+    {
+        for (vtkIdType j = begin; j < end; ++j)
+        {
+            if (j == mid)
+                continue;
+            float c = coords[3 * perm[j] + dim];
+            if (c == median)
+                ++(j < mid ? summary.EqualLeft : summary.EqualRight);
+            else if (c < median)
+                summary.MaxLess = std::max(summary.MaxLess, c);
+            else
+                summary.MinGreater = std::min(summary.MinGreater, c);
+        }
     }
 
-    // 释放节点数组的内存
-    delete[] nodes;
-    return frames;
+    struct ParallelSplitSummary
+    {
+        const float *Coords;
+        const vtkIdType *Perm;
+        int Dim;
+        vtkIdType Mid;
+        float Median;
+        vtkSMPThreadLocal<SplitSummary> TLocal;
+        SplitSummary Result;
+
+        void Initialize() { this->TLocal.Local() = SplitSummary(); }
+
+        void operator()(vtkIdType begin, vtkIdType end)
+        {
+            SummarizeSplit(this->Coords, this->Perm, this->Dim, this->Mid, this->Median, begin, end, this->TLocal.Local());
+        }
+
+        void Reduce()
+        {
+            for (const SplitSummary &summary : this->TLocal)
+                this->Result.Add(summary);
+        }
+    };
+
+    /**
+     * 并行构建时的中位数划分，划分条件与vtkKdTree相同。
+     * 左子树对应 Perm 中的 [begin, split)，右子树对应 [split, end)，叶子按从左到右的顺序排列，与区域id一致。
+     */
+    struct ParallelKdDivider
+    {
+        const float *Coords;
+        std::vector<vtkIdType> Perm;
+        std::vector<vtkIdType> Tmp; // 并行选择的临时数组，只在顶层划分时使用
+        int MaxLevel;
+        int MinCells;
+        int NumberOfRegionsOrLess;
+        int NumberOfRegionsOrMore;
+        int ValidDirections;
+
+        bool ShouldDivide(vtkIdType numPoints, int level) const
+        {
+            if (numPoints < 2 || level >= this->MaxLevel)
+                return false;
+            if (this->MinCells && this->MinCells > numPoints / 2)
+                return false;
+            vtkIdType numRegions = vtkIdType(1) << level;
+            if (this->NumberOfRegionsOrLess && 2 * numRegions > this->NumberOfRegionsOrLess)
+                return false;
+            if (this->NumberOfRegionsOrMore && numRegions >= this->NumberOfRegionsOrMore)
+                return false;
+            return true;
+        }
+
+        /**
+         * 划分节点并创建子节点。
+         * @return 左右子树的分界，节点不再划分时返回-1。
+         */
+        vtkIdType Divide(vtkKdNode *node, vtkIdType begin, vtkIdType end, int level, bool parallel)
+        {
+            node->SetNumberOfPoints(static_cast<int>(end - begin));
+            if (!this->ShouldDivide(end - begin, level))
+                return -1;
+
+            // 按空间包围盒的边长从长到短尝试各划分方向
+            double bounds[6];
+            node->GetBounds(bounds);
+            int dims[3] = {0, 1, 2};
+            std::stable_sort(dims, dims + 3, [&bounds](int a, int b)
+                             { return bounds[2 * a + 1] - bounds[2 * a] > bounds[2 * b + 1] - bounds[2 * b]; });
+
+            vtkIdType mid = begin + (end - begin) / 2;
+            for (int dim : dims)
+            {
+                if (!(this->ValidDirections & (1 << dim)))
+                    continue;
+
+                FloatKeyLess less = {this->Coords, dim};
+                if (parallel)
+                    AUtils::ParallelSelect(this->Perm, this->Tmp, begin, mid, end, less);
+                else
+                    std::nth_element(this->Perm.begin() + begin, this->Perm.begin() + mid, this->Perm.begin() + end, less);
+                const float median = this->Coords[3 * this->Perm[mid] + dim];
+
+                SplitSummary summary;
+                if (parallel)
+                {
+                    ParallelSplitSummary functor;
+                    functor.Coords = this->Coords;
+                    functor.Perm = this->Perm.data();
+                    functor.Dim = dim;
+                    functor.Mid = mid;
+                    functor.Median = median;
+                    vtkSMPTools::For(begin, end, functor);
+                    summary = functor.Result;
+                }
+                else
+                {
+                    SummarizeSplit(this->Coords, this->Perm.data(), dim, mid, median, begin, end, summary);
+                }
+
+                // 与中位数相等的点必须位于同一侧，分界取相等区间 [lo, hi) 离中点较近且不使一侧为空的一端
+                vtkIdType split = mid;
+                float maxLeft = summary.MaxLess;
+                float minRight = median;
+                if (summary.EqualLeft > 0 || summary.EqualRight > 0)
+                {
+                    vtkIdType lo = mid - summary.EqualLeft;
+                    vtkIdType hi = mid + 1 + summary.EqualRight;
+                    if (lo == begin && hi == end)
+                        continue;
+                    auto coordOf = [&](vtkIdType id)
+                    { return this->Coords[3 * id + dim]; };
+                    std::partition(this->Perm.begin() + begin, this->Perm.begin() + mid,
+                                   [&](vtkIdType id)
+                                   { return coordOf(id) < median; });
+                    std::partition(this->Perm.begin() + mid + 1, this->Perm.begin() + end,
+                                   [&](vtkIdType id)
+                                   { return coordOf(id) == median; });
+                    if (lo == begin || (hi < end && hi - mid <= mid - lo))
+                    {
+                        split = hi;
+                        maxLeft = median;
+                        minRight = summary.MinGreater;
+                    }
+                    else
+                    {
+                        split = lo;
+                    }
+                }
+                if (split == begin || split == end)
+                    continue;
+
+                double cut = 0.5 * (static_cast<double>(maxLeft) + static_cast<double>(minRight));
+                double leftBounds[6], rightBounds[6];
+                std::copy(bounds, bounds + 6, leftBounds);
+                std::copy(bounds, bounds + 6, rightBounds);
+                leftBounds[2 * dim + 1] = cut;
+                rightBounds[2 * dim] = cut;
+
+                vtkKdNode *left = vtkKdNode::New();
+                vtkKdNode *right = vtkKdNode::New();
+                left->SetBounds(leftBounds[0], leftBounds[1], leftBounds[2], leftBounds[3], leftBounds[4], leftBounds[5]);
+                right->SetBounds(rightBounds[0], rightBounds[1], rightBounds[2], rightBounds[3], rightBounds[4], rightBounds[5]);
+                node->SetDim(dim);
+                node->AddChildNodes(left, right);
+                return split;
+            }
+            return -1;
+        }
+
+        void DivideSubtree(vtkKdNode *node, vtkIdType begin, vtkIdType end, int level)
+        {
+            vtkIdType split = this->Divide(node, begin, end, level, false);
+            if (split < 0)
+                return;
+            this->DivideSubtree(node->GetLeft(), begin, split, level + 1);
+            this->DivideSubtree(node->GetRight(), split, end, level + 1);
+        }
+    };
+
+    /**
+     * 自底向上合并子节点的数据包围盒，叶子的数据包围盒须已设置。
+     */
+    void MergeDataBounds(vtkKdNode *node)
+    {
+        if (node->GetLeft() == nullptr)
+            return;
+        MergeDataBounds(node->GetLeft());
+        MergeDataBounds(node->GetRight());
+        double left[6], right[6];
+        node->GetLeft()->GetDataBounds(left);
+        node->GetRight()->GetDataBounds(right);
+        node->SetDataBounds(std::min(left[0], right[0]), std::max(left[1], right[1]),
+                            std::min(left[2], right[2]), std::max(left[3], right[3]),
+                            std::min(left[4], right[4]), std::max(left[5], right[5]));
+    }
 }
 
-int AvtkKdTree::GetNumberOfRegionsAtLevel(int level)
+void AvtkKdTree::BuildLocatorFromPoints(vtkPointSet *pointset)
 {
-    if (level < 0)
-        return 0;
-    // 处理层级小于0的情况，直接返回0
+    this->pointSet = pointset;
+    vtkPoints *points = pointset->GetPoints();
+    vtkDataArray *normals = pointset->GetPointData()->GetNormals();
+    // 法向量数量或分量数与点不一致时不参与汇总
+    if (normals && (normals->GetNumberOfComponents() != 3 ||
+                    normals->GetNumberOfTuples() != pointset->GetNumberOfPoints()))
+        normals = nullptr;
+    this->BuildFromPointArrays(&points, 1, normals);
+}
 
-    auto maxLevel = this->GetMaxLevel();
-    if (level > maxLevel)
-        return maxLevel;
-    // 如果层级超过最大层级，返回最大层级值
+void AvtkKdTree::BuildLocatorFromPoints(vtkPoints *ptArray)
+{
+    this->BuildLocatorFromPoints(&ptArray, 1);
+}
 
-    return CountNodesAtLevel(this->Top, 0, level);
-    // 调用递归或迭代方法统计指定层级的节点数量
+void AvtkKdTree::BuildLocatorFromPoints(vtkPoints **ptArrays, int numPtArrays)
+{
+    this->BuildFromPointArrays(ptArrays, numPtArrays, nullptr);
 }
 
-int AvtkKdTree::GetMaxLevel() const
+void AvtkKdTree::BuildFromPointArrays(vtkPoints **ptArrays, int numPtArrays, vtkDataArray *normals)
 {
-    return CalculateMaxLevel(this->Top, 0);
+    if (this->ParallelBuild)
+        this->BuildLocatorInParallel(ptArrays, numPtArrays);
+    else
+        this->vtkKdTree::BuildLocatorFromPoints(ptArrays, numPtArrays);
+    if (!this->Top)
+        return;
+    this->BuildRegionPointCache(ptArrays, numPtArrays, normals);
+
+    // 缓存已包含定位点数组的全部内容，释放vtkKdTree的副本，点查询改由缓存完成
+    delete[] this->LocatorPoints;
+    this->LocatorPoints = nullptr;
+    delete[] this->LocatorIds;
+    this->LocatorIds = nullptr;
+    delete[] this->LocatorRegionLocation;
+    this->LocatorRegionLocation = nullptr;
+    this->NumberOfLocatorPoints = 0;
+
+    this->NodeStatistics.assign(std::max(this->GetNumberOfRegions() - 1, 0), AUtils::PointStatistics());
+    this->BuildNodeStatistics(this->Top);
+    this->UpdateLevelIndex();
 }
 
-int AvtkKdTree::CalculateMaxLevel(vtkKdNode *node, int currentLevel) const
+void AvtkKdTree::BuildLocatorInParallel(vtkPoints **ptArrays, int numPtArrays)
 {
-    if (!node)
-        return -1; // 空节点返回无效层级
+    this->FreeSearchStructure();
+
+    std::vector<vtkIdType> arrayOffsets(numPtArrays + 1, 0);
+    for (int i = 0; i < numPtArrays; ++i)
+    {
+        arrayOffsets[i + 1] = arrayOffsets[i] + ptArrays[i]->GetNumberOfPoints();
+    }
+    const vtkIdType numPoints = arrayOffsets[numPtArrays];
+    if (numPoints < 1)
+    {
+        vtkErrorMacro(<< "AvtkKdTree::BuildLocatorInParallel - no points");
+        return;
+    }
+    if (numPoints >= VTK_INT_MAX)
+    {
+        vtkErrorMacro(<< "AvtkKdTree::BuildLocatorInParallel - too many points for vtkKdTree");
+        return;
+    }
+
+    // 与vtkKdTree相同，划分与定位点均使用float坐标
+    std::vector<float> coords(3 * numPoints);
+    double bounds[6] = {VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX};
+    for (int a = 0; a < numPtArrays; ++a)
+    {
+        vtkPoints *points = ptArrays[a];
+        float *dst = coords.data() + 3 * arrayOffsets[a];
+        vtkSMPTools::For(0, points->GetNumberOfPoints(),
+                         [&](vtkIdType begin, vtkIdType end)
+                         {
+                             for (vtkIdType i = begin; i < end; ++i)
+                             {
+                                 double p[3];
+                                 points->GetPoint(i, p);
+                                 for (int k = 0; k < 3; ++k)
+                                     dst[3 * i + k] = static_cast<float>(p[k]);
+                             }
+                         });
+        if (points->GetNumberOfPoints() > 0)
+        {
+            double arrayBounds[6];
+            points->GetBounds(arrayBounds);
+            for (int k = 0; k < 3; ++k)
+            {
+                bounds[2 * k] = std::min(bounds[2 * k], arrayBounds[2 * k]);
+                bounds[2 * k + 1] = std::max(bounds[2 * k + 1], arrayBounds[2 * k + 1]);
+            }
+        }
+    }
+
+    // 根节点的包围盒与vtkKdTree一样略微外扩，退化的方向按最大边长外扩
+    double aLittle = 0.0;
+    for (int k = 0; k < 3; ++k)
+        aLittle = std::max(aLittle, bounds[2 * k + 1] - bounds[2 * k]);
+    if (aLittle <= 0.0)
+        aLittle = 1.0;
+    this->FudgeFactor = aLittle * 10e-4;
+    for (int k = 0; k < 3; ++k)
+    {
+        double pad = bounds[2 * k + 1] > bounds[2 * k] ? this->FudgeFactor : aLittle;
+        bounds[2 * k] -= pad;
+        bounds[2 * k + 1] += pad;
+    }
+
+    vtkKdNode *top = vtkKdNode::New();
+    top->SetBounds(bounds[0], bounds[1], bounds[2], bounds[3], bounds[4], bounds[5]);
+
+    ParallelKdDivider divider;
+    divider.Coords = coords.data();
+    divider.Perm.resize(numPoints);
+    for (vtkIdType i = 0; i < numPoints; ++i)
+        divider.Perm[i] = i;
+    divider.Tmp.resize(numPoints);
+    divider.MaxLevel = this->MaxLevel;
+    divider.MinCells = this->GetMinCells();
+    divider.NumberOfRegionsOrLess = this->GetNumberOfRegionsOrLess();
+    divider.NumberOfRegionsOrMore = this->GetNumberOfRegionsOrMore();
+    divider.ValidDirections = this->ValidDirections;
+
+    // 顶层节点逐个使用并行选择划分，节点数足够多后各子树作为独立任务串行递归
+    struct Task
+    {
+        vtkKdNode *Node;
+        vtkIdType Begin;
+        vtkIdType End;
+        int Level;
+    };
+    const size_t numTasks = 4 * static_cast<size_t>(std::max(1, vtkSMPTools::GetEstimatedNumberOfThreads()));
+    std::vector<Task> tasks = {{top, 0, numPoints, 0}};
+    while (!tasks.empty() && tasks.size() < numTasks)
+    {
+        std::vector<Task> next;
+        for (const Task &task : tasks)
+        {
+            vtkIdType split = divider.Divide(task.Node, task.Begin, task.End, task.Level, true);
+            if (split < 0)
+                continue;
+            next.push_back({task.Node->GetLeft(), task.Begin, split, task.Level + 1});
+            next.push_back({task.Node->GetRight(), split, task.End, task.Level + 1});
+        }
+        tasks.swap(next);
+    }
+    std::vector<vtkIdType>().swap(divider.Tmp);
+    vtkSMPTools::For(0, static_cast<vtkIdType>(tasks.size()), 1,
+                     [&](vtkIdType begin, vtkIdType end)
+                     {
+                         for (vtkIdType i = begin; i < end; ++i)
+                             divider.DivideSubtree(tasks[i].Node, tasks[i].Begin, tasks[i].End, tasks[i].Level);
+                     });
+
+    this->Top = top;
+    this->SetActualLevel();
+    this->BuildRegionList();
 
-    // 递归计算左右子节点的最大层级
-    int leftMax = CalculateMaxLevel(node->GetLeft(), currentLevel + 1);
-    int rightMax = CalculateMaxLevel(node->GetRight(), currentLevel + 1);
+    // 点id按区域顺序排列，即划分后的点顺序；坐标由之后的区域点缓存保存，不生成 LocatorPoints
+    const int numRegions = this->NumberOfRegions;
+    this->LocatorIds = new int[numPoints];
+    this->LocatorRegionLocation = new int[numRegions];
+    this->NumberOfLocatorPoints = static_cast<int>(numPoints);
+    int location = 0;
+    for (int r = 0; r < numRegions; ++r)
+    {
+        this->LocatorRegionLocation[r] = location;
+        location += this->RegionList[r]->GetNumberOfPoints();
+    }
+    vtkSMPTools::For(0, numRegions,
+                     [&](vtkIdType begin, vtkIdType end)
+                     {
+                         for (vtkIdType r = begin; r < end; ++r)
+                         {
+                             double dataBounds[6] = {VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX,
+                                                     -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX};
+                             vtkIdType first = this->LocatorRegionLocation[r];
+                             vtkIdType last = first + this->RegionList[r]->GetNumberOfPoints();
+                             for (vtkIdType i = first; i < last; ++i)
+                             {
+                                 vtkIdType id = divider.Perm[i];
+                                 this->LocatorIds[i] = static_cast<int>(id);
+                                 for (int k = 0; k < 3; ++k)
+                                 {
+                                     float c = coords[3 * id + k];
+                                     dataBounds[2 * k] = std::min(dataBounds[2 * k], static_cast<double>(c));
+                                     dataBounds[2 * k + 1] = std::max(dataBounds[2 * k + 1], static_cast<double>(c));
+                                 }
+                             }
+                             this->RegionList[r]->SetDataBounds(dataBounds[0], dataBounds[1], dataBounds[2],
+                                                                dataBounds[3], dataBounds[4], dataBounds[5]);
+                         }
+                     });
+    MergeDataBounds(this->Top);
 
-    // 比较左右子树的最大层级与当前层级，返回较大值
-    return std::max(leftMax, rightMax) > currentLevel ? std::max(leftMax, rightMax) : currentLevel;
+    this->SetCalculator(this->Top);
+    this->BuildTime.Modified();
 }
 
-std::vector<CubeFrame *> AvtkKdTree::GetRegionBoundsByPoint(double x, double y, double z)
+void AvtkKdTree::FreeSearchStructure()
 {
-    int regionID = this->GetRegionContainingPoint(x, y, z);
-    if (regionID < 0)
-        return {};
+    this->RegionOffsets.clear();
+    this->RegionPointIds.clear();
+    this->RegionX.clear();
+    this->RegionY.clear();
+    this->RegionZ.clear();
+    this->RegionXF.clear();
+    this->RegionYF.clear();
+    this->RegionZF.clear();
+    this->RegionBounds.clear();
+    this->RegionNormals.clear();
+    this->RegionStatistics.clear();
+    this->NodeStatistics.clear();
+    this->IndexedTop = nullptr;
+    this->LevelNodes.clear();
+    this->vtkKdTree::FreeSearchStructure();
+}
 
-    vtkKdNode *targetNode = this->RegionList[regionID];
-    if (!targetNode)
-        return {};
+void AvtkKdTree::BuildRegionPointCache(vtkPoints **ptArrays, int numPtArrays, vtkDataArray *normals)
+{
+    int numRegions = this->GetNumberOfRegions();
 
-    /**
-     * 获取从根节点到目标节点的完整路径
-     */
-    std::vector<vtkKdNode *> path = this->GetPathFromRootToNode(targetNode);
-    if (path.empty())
-        return {};
+    // 每个点数组的起始全局id
+    std::vector<vtkIdType> arrayOffsets(numPtArrays + 1, 0);
+    for (int i = 0; i < numPtArrays; ++i)
+    {
+        arrayOffsets[i + 1] = arrayOffsets[i] + ptArrays[i]->GetNumberOfPoints();
+    }
 
-    /**
-     * 遍历路径中的每个节点，收集其边界框信息
-     */
-    std::vector<CubeFrame *> frames;
-    for (auto node : path)
+    this->RegionOffsets.assign(numRegions + 1, 0);
+    for (int r = 0; r < numRegions; ++r)
     {
-        double bounds[6];
-        node->GetBounds(bounds);
-        frames.push_back(new CubeFrame(bounds));
+        this->RegionOffsets[r + 1] = this->RegionOffsets[r] + this->RegionList[r]->GetNumberOfPoints();
     }
-    return frames;
+    vtkIdType numPoints = this->RegionOffsets[numRegions];
+    this->RegionPointIds.resize(numPoints);
+    this->RegionFloatStorage = this->SinglePrecision != 0;
+    if (this->RegionFloatStorage)
+    {
+        this->RegionXF.resize(numPoints);
+        this->RegionYF.resize(numPoints);
+        this->RegionZF.resize(numPoints);
+    }
+    else
+    {
+        this->RegionX.resize(numPoints);
+        this->RegionY.resize(numPoints);
+        this->RegionZ.resize(numPoints);
+    }
+    this->RegionBounds.resize(6 * numRegions);
+    this->RegionStatistics.assign(numRegions, AUtils::PointStatistics());
+    if (normals)
+        this->RegionNormals.resize(3 * numPoints);
+    else
+        this->RegionNormals.clear();
+
+    // 各区域写入缓存中互不重叠的区间，可以并行填充
+    vtkSMPTools::For(0, numRegions,
+                     [&](vtkIdType begin, vtkIdType end)
+                     {
+                         for (vtkIdType r = begin; r < end; ++r)
+                         {
+                             const int *regionIds = this->LocatorIds + this->LocatorRegionLocation[r];
+                             vtkIdType offset = this->RegionOffsets[r];
+                             for (vtkIdType i = 0; i < this->RegionOffsets[r + 1] - offset; ++i)
+                             {
+                                 vtkIdType id = regionIds[i];
+                                 int array = static_cast<int>(std::upper_bound(arrayOffsets.begin(), arrayOffsets.end(), id) - arrayOffsets.begin()) - 1;
+                                 double p[3];
+                                 ptArrays[array]->GetPoint(id - arrayOffsets[array], p);
+                                 this->RegionPointIds[offset + i] = id;
+                                 if (normals)
+                                 {
+                                     double n[3];
+                                     normals->GetTuple(id, n);
+                                     for (int k = 0; k < 3; ++k)
+                                         this->RegionNormals[3 * (offset + i) + k] = static_cast<float>(n[k]);
+                                 }
+                                 if (this->RegionFloatStorage)
+                                 {
+                                     this->RegionXF[offset + i] = static_cast<float>(p[0]);
+                                     this->RegionYF[offset + i] = static_cast<float>(p[1]);
+                                     this->RegionZF[offset + i] = static_cast<float>(p[2]);
+                                 }
+                                 else
+                                 {
+                                     this->RegionX[offset + i] = p[0];
+                                     this->RegionY[offset + i] = p[1];
+                                     this->RegionZ[offset + i] = p[2];
+                                 }
+                             }
+
+                             // 紧包围盒按缓存中的坐标计算，单精度存储时同样包含舍入后的点
+                             double *bounds = &this->RegionBounds[6 * r];
+                             for (int k = 0; k < 3; ++k)
+                             {
+                                 bounds[2 * k] = VTK_DOUBLE_MAX;
+                                 bounds[2 * k + 1] = -VTK_DOUBLE_MAX;
+                             }
+                             for (vtkIdType i = offset; i < this->RegionOffsets[r + 1]; ++i)
+                             {
+                                 double p[3];
+                                 this->GetRegionPoint(i, p);
+                                 for (int k = 0; k < 3; ++k)
+                                 {
+                                     bounds[2 * k] = std::min(bounds[2 * k], p[k]);
+                                     bounds[2 * k + 1] = std::max(bounds[2 * k + 1], p[k]);
+                                 }
+                             }
+
+                             // 区域汇总量以紧包围盒的中心为平移原点累加
+                             double center[3];
+                             for (int k = 0; k < 3; ++k)
+                                 center[k] = 0.5 * (bounds[2 * k] + bounds[2 * k + 1]);
+                             AUtils::PointStatisticsAccumulator sums;
+                             sums.Init(center);
+                             for (vtkIdType i = offset; i < this->RegionOffsets[r + 1]; ++i)
+                             {
+                                 double p[3];
+                                 this->GetRegionPoint(i, p);
+                                 sums.AddPoint(p);
+                                 if (normals)
+                                 {
+                                     const float *n = &this->RegionNormals[3 * i];
+                                     double normal[3] = {n[0], n[1], n[2]};
+                                     sums.AddNormal(normal);
+                                 }
+                             }
+                             sums.AddTo(this->RegionStatistics[r]);
+                         }
+                     });
 }
 
-void AvtkKdTree::FindPointsInArea(double *area, vtkIdList *ids)
+void AvtkKdTree::UpdatePointNormals(vtkDataArray *normals)
 {
-    vtkNew<vtkIdTypeArray> idList;
-    this->vtkKdTree::FindPointsInArea(area, idList);
-    AUtils::IdTypeArrayToIdList(idList, ids);
+    if (!this->Top || this->RegionOffsets.empty())
+        return;
+    int numRegions = this->GetNumberOfRegions();
+    vtkIdType numPoints = this->RegionOffsets[numRegions];
+    if (normals && (normals->GetNumberOfComponents() != 3 || normals->GetNumberOfTuples() != numPoints))
+        normals = nullptr;
+    if (normals)
+        this->RegionNormals.resize(3 * numPoints);
+    else
+        this->RegionNormals.clear();
+
+    // 坐标与二阶矩不变，只替换各区域的法向量之和
+    vtkSMPTools::For(0, numRegions,
+                     [&](vtkIdType begin, vtkIdType end)
+                     {
+                         for (vtkIdType r = begin; r < end; ++r)
+                         {
+                             double sum[3] = {0.0, 0.0, 0.0};
+                             for (vtkIdType i = this->RegionOffsets[r]; normals && i < this->RegionOffsets[r + 1]; ++i)
+                             {
+                                 double n[3];
+                                 normals->GetTuple(this->RegionPointIds[i], n);
+                                 for (int k = 0; k < 3; ++k)
+                                 {
+                                     this->RegionNormals[3 * i + k] = static_cast<float>(n[k]);
+                                     sum[k] += static_cast<float>(n[k]);
+                                 }
+                             }
+                             for (int k = 0; k < 3; ++k)
+                                 this->RegionStatistics[r].NormalSum[k] = sum[k];
+                         }
+                     });
+    this->BuildNodeStatistics(this->Top);
 }
 
-void AvtkKdTree::FindPointsInCuboid(double cuboid[8][3], vtkIdList *ids)
+const AUtils::PointStatistics &AvtkKdTree::BuildNodeStatistics(vtkKdNode *node)
+{
+    if (node->GetLeft() == nullptr)
+        return this->RegionStatistics[node->GetID()];
+
+    AUtils::PointStatistics &stats = this->NodeStatistics[node->GetLeft()->GetMaxID()];
+    stats = this->BuildNodeStatistics(node->GetLeft());
+    stats.Add(this->BuildNodeStatistics(node->GetRight()));
+    return stats;
+}
+
+bool AvtkKdTree::CheckRegionPointCache()
 {
-    // 计算正轴包围盒
-    double bounds[6] = {DBL_MAX, -DBL_MAX, DBL_MAX, -DBL_MAX, DBL_MAX, -DBL_MAX};
-    for (int i = 0; i < 8; ++i)
+    if (!this->Top || this->RegionOffsets.empty())
     {
-        bounds[0] = std::min(bounds[0], cuboid[i][0]); // xmin
-        bounds[1] = std::max(bounds[1], cuboid[i][0]); // xmax
-        bounds[2] = std::min(bounds[2], cuboid[i][1]); // ymin
-        bounds[3] = std::max(bounds[3], cuboid[i][1]); // ymax
-        bounds[4] = std::min(bounds[4], cuboid[i][2]); // zmin
-        bounds[5] = std::max(bounds[5], cuboid[i][2]); // zmax
+        vtkErrorMacro(<< "AvtkKdTree - must build locator from points first");
+        return false;
     }
+    return true;
+}
 
-    // 使用KD树快速查找包围盒内的候选点
-    vtkNew<vtkIdList> candidateIds;
-    this->FindPointsInArea(bounds, candidateIds);
+template <typename Shape>
+void AvtkKdTree::FindPointsInShape(vtkKdNode *node, const Shape &shape, vtkIdList *ids) const
+{
+    auto append = [ids](const vtkIdType *segment, vtkIdType n)
+    { AUtils::AppendIds(ids, segment, n); };
+    this->VisitPointsInShape(node, shape, append);
+}
+
+void AvtkKdTree::FindPointsInCylinder(const double point[3], const double direction[3], double radius, vtkIdList *ids)
+{
+    ids->Reset();
+    if (!this->CheckRegionPointCache())
+        return;
 
-    // 如果没有候选点，直接返回
-    if (candidateIds->GetNumberOfIds() == 0)
+    AUtils::CylinderShape cylinder;
+    if (!cylinder.InitCylinder(point, direction, radius))
     {
+        vtkErrorMacro(<< "FindPointsInCylinder - direction vector is zero");
         return;
     }
+    this->FindPointsInShape(this->Top, cylinder, ids);
+}
 
-    // 获取所有点的数据集
-    vtkDataSet *dataSet = this->GetDataSet();
-    vtkPointSet *pointSet = vtkPointSet::SafeDownCast(dataSet);
-    if (!pointSet)
+void AvtkKdTree::FindPointsInCapsule(const double p0[3], const double p1[3], double radius, vtkIdList *ids)
+{
+    ids->Reset();
+    if (!this->CheckRegionPointCache())
         return;
-    vtkPoints *points = pointSet->GetPoints();
-
-    // 计算立方体的6个面，每个面由4个点定义
-    // 面的定义参考AUtils::cubeEdges的顺序
-    // 底面: 0,1,3,2
-    // 顶面: 4,5,7,6
-    // 侧面1: 0,1,5,4
-    // 侧面2: 1,3,7,5
-    // 侧面3: 3,2,6,7
-    // 侧面4: 2,0,4,6
-    int faces[6][4] = {
-        {0, 1, 3, 2}, // 底面
-        {4, 5, 7, 6}, // 顶面
-        {0, 1, 5, 4}, // 侧面1
-        {1, 3, 7, 5}, // 侧面2
-        {3, 2, 6, 7}, // 侧面3
-        {2, 0, 4, 6}  // 侧面4
-    };
 
-    // 计算每个面的法向量和平面方程
-    double normals[6][3];
-    double d[6];
+    AUtils::CylinderShape capsule;
+    capsule.InitCapsule(p0, p1, radius);
+    this->FindPointsInShape(this->Top, capsule, ids);
+}
 
-    for (int i = 0; i < 6; ++i)
+int AvtkKdTree::SearchApproximateClosestPoints(const double x[3], size_t N, double epsilon, int maxLeaves,
+                                               std::vector<std::pair<double, vtkIdType>> &heap) const
+{
+    if (N == 0 || !this->Top || this->RegionOffsets.empty())
+        return 0;
+
+    // 节点按包围盒距离平方排列的最小堆
+    using Entry = std::pair<double, vtkKdNode *>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+
+    const double scale = (1.0 + epsilon) * (1.0 + epsilon);
+    auto pruned = [&](double dist2)
+    { return heap.size() == N && dist2 * scale > heap.front().first; };
+    auto nodeDistance2 = [x](vtkKdNode *node)
     {
-        // 计算面的两个向量
-        double v1[3], v2[3];
-        for (int j = 0; j < 3; ++j)
-        {
-            v1[j] = cuboid[faces[i][1]][j] - cuboid[faces[i][0]][j];
-            v2[j] = cuboid[faces[i][2]][j] - cuboid[faces[i][1]][j];
-        }
+        double bounds[6];
+        node->GetBounds(bounds);
+        return AUtils::BoundsDistance2(bounds, x);
+    };
 
-        // 计算法向量 (v1 x v2)
-        normals[i][0] = v1[1] * v2[2] - v1[2] * v2[1];
-        normals[i][1] = v1[2] * v2[0] - v1[0] * v2[2];
-        normals[i][2] = v1[0] * v2[1] - v1[1] * v2[0];
+    queue.emplace(nodeDistance2(this->Top), this->Top);
+    int leavesVisited = 0;
+    while (!queue.empty())
+    {
+        Entry entry = queue.top();
+        queue.pop();
+        if (pruned(entry.first))
+            break;
 
-        // 归一化法向量
-        double length = sqrt(normals[i][0] * normals[i][0] +
-                             normals[i][1] * normals[i][1] +
-                             normals[i][2] * normals[i][2]);
-        if (length > 0)
+        // 沿较近的子节点下降到叶子，较远的子节点放入队列
+        vtkKdNode *node = entry.second;
+        while (node->GetLeft())
         {
-            normals[i][0] /= length;
-            normals[i][1] /= length;
-            normals[i][2] /= length;
+            double leftDist2 = nodeDistance2(node->GetLeft());
+            double rightDist2 = nodeDistance2(node->GetRight());
+            bool leftNear = leftDist2 <= rightDist2;
+            double farDist2 = leftNear ? rightDist2 : leftDist2;
+            if (!pruned(farDist2))
+                queue.emplace(farDist2, leftNear ? node->GetRight() : node->GetLeft());
+            node = leftNear ? node->GetLeft() : node->GetRight();
         }
 
-        // 计算平面方程的常数项 d (ax + by + cz + d = 0)
-        d[i] = -(normals[i][0] * cuboid[faces[i][0]][0] +
-                 normals[i][1] * cuboid[faces[i][0]][1] +
-                 normals[i][2] * cuboid[faces[i][0]][2]);
-
-        // 确保法向量指向立方体外部
-        // 计算立方体中心点
-        double center[3] = {0, 0, 0};
-        for (int j = 0; j < 8; ++j)
+        int regionID = node->GetID();
+        for (vtkIdType i = this->RegionOffsets[regionID]; i < this->RegionOffsets[regionID + 1]; ++i)
         {
-            center[0] += cuboid[j][0];
-            center[1] += cuboid[j][1];
-            center[2] += cuboid[j][2];
+            double p[3];
+            this->GetRegionPoint(i, p);
+            AUtils::PushCandidate(heap, N, vtkMath::Distance2BetweenPoints(x, p), this->RegionPointIds[i]);
         }
-        center[0] /= 8.0;
-        center[1] /= 8.0;
-        center[2] /= 8.0;
+        if (++leavesVisited == maxLeaves)
+            break;
+    }
+    return leavesVisited;
+}
+
+void AvtkKdTree::FindApproximateClosestNPoints(int N, const double x[3], double epsilon, int maxLeaves,
+                                               vtkIdList *result, int *leavesVisited) const
+{
+    result->Reset();
+    std::vector<std::pair<double, vtkIdType>> heap;
+    int visited = 0;
+    if (N > 0)
+    {
+        size_t maxCount = std::min(static_cast<size_t>(N), this->RegionPointIds.size());
+        heap.reserve(maxCount);
+        visited = this->SearchApproximateClosestPoints(x, maxCount, epsilon, maxLeaves, heap);
+    }
+    if (leavesVisited)
+        *leavesVisited = visited;
 
-        // 检查法向量方向
-        double dot = normals[i][0] * (center[0] - cuboid[faces[i][0]][0]) +
-                     normals[i][1] * (center[1] - cuboid[faces[i][0]][1]) +
-                     normals[i][2] * (center[2] - cuboid[faces[i][0]][2]);
+    std::sort_heap(heap.begin(), heap.end());
+    result->SetNumberOfIds(static_cast<vtkIdType>(heap.size()));
+    for (size_t i = 0; i < heap.size(); ++i)
+    {
+        result->SetId(static_cast<vtkIdType>(i), heap[i].second);
+    }
+}
 
-        // 如果法向量指向内部，则反转
-        if (dot > 0)
+vtkIdType AvtkKdTree::FindApproximateClosestPoint(const double x[3], double epsilon, int maxLeaves, double &dist2,
+                                                  int *leavesVisited) const
+{
+    std::vector<std::pair<double, vtkIdType>> heap;
+    heap.reserve(1);
+    int visited = this->SearchApproximateClosestPoints(x, 1, epsilon, maxLeaves, heap);
+    if (leavesVisited)
+        *leavesVisited = visited;
+    if (heap.empty())
+    {
+        dist2 = VTK_DOUBLE_MAX;
+        return -1;
+    }
+    dist2 = heap.front().first;
+    return heap.front().second;
+}
+
+vtkIdType AvtkKdTree::FindClosestPoint(double *x, double &dist2)
+{
+    if (this->RegionOffsets.empty())
+        return this->vtkKdTree::FindClosestPoint(x, dist2);
+    return this->FindApproximateClosestPoint(x, 0.0, 0, dist2);
+}
+
+vtkIdType AvtkKdTree::FindClosestPoint(double x, double y, double z, double &dist2)
+{
+    double p[3] = {x, y, z};
+    return this->FindClosestPoint(p, dist2);
+}
+
+vtkIdType AvtkKdTree::FindClosestPointWithinRadius(double radius, const double x[3], double &dist2)
+{
+    if (this->RegionOffsets.empty())
+        return this->vtkKdTree::FindClosestPointWithinRadius(radius, x, dist2);
+    vtkIdType id = this->FindApproximateClosestPoint(x, 0.0, 0, dist2);
+    return dist2 <= radius * radius ? id : -1;
+}
+
+vtkIdType AvtkKdTree::FindClosestPointInRegion(int regionId, double *x, double &dist2)
+{
+    if (this->RegionOffsets.empty())
+        return this->vtkKdTree::FindClosestPointInRegion(regionId, x, dist2);
+    dist2 = VTK_DOUBLE_MAX;
+    if (regionId < 0 || regionId >= this->GetNumberOfRegions())
+    {
+        vtkErrorMacro(<< "FindClosestPointInRegion - invalid region id " << regionId);
+        return -1;
+    }
+
+    vtkIdType closest = -1;
+    for (vtkIdType i = this->RegionOffsets[regionId]; i < this->RegionOffsets[regionId + 1]; ++i)
+    {
+        double p[3];
+        this->GetRegionPoint(i, p);
+        double d2 = vtkMath::Distance2BetweenPoints(x, p);
+        if (d2 < dist2)
         {
-            normals[i][0] = -normals[i][0];
-            normals[i][1] = -normals[i][1];
-            normals[i][2] = -normals[i][2];
-            d[i] = -d[i];
+            dist2 = d2;
+            closest = this->RegionPointIds[i];
         }
     }
+    return closest;
+}
 
-    // 遍历所有候选点，检查是否在立方体内部
-    ids->Reset();
-    for (vtkIdType i = 0; i < candidateIds->GetNumberOfIds(); ++i)
+vtkIdType AvtkKdTree::FindClosestPointInRegion(int regionId, double x, double y, double z, double &dist2)
+{
+    double p[3] = {x, y, z};
+    return this->FindClosestPointInRegion(regionId, p, dist2);
+}
+
+void AvtkKdTree::FindClosestNPoints(int N, const double x[3], vtkIdList *result)
+{
+    if (this->RegionOffsets.empty())
     {
-        vtkIdType pointId = candidateIds->GetId(i);
-        double point[3];
-        points->GetPoint(pointId, point);
+        this->vtkKdTree::FindClosestNPoints(N, x, result);
+        return;
+    }
+    this->FindApproximateClosestNPoints(N, x, 0.0, 0, result);
+}
 
-        // 检查点是否在所有平面的内侧
-        bool inside = true;
-        for (int j = 0; j < 6; ++j)
-        {
-            // 计算点到平面的距离
-            double distance = normals[j][0] * point[0] +
-                              normals[j][1] * point[1] +
-                              normals[j][2] * point[2] + d[j];
+void AvtkKdTree::FindPointsInArea(double *area, vtkIdTypeArray *ids, bool clearArray)
+{
+    if (this->RegionOffsets.empty())
+    {
+        this->vtkKdTree::FindPointsInArea(area, ids, clearArray);
+        return;
+    }
+    if (clearArray)
+        ids->Reset();
+
+    AUtils::AreaShape areaShape;
+    areaShape.Init(area);
+    this->VisitPointsInShape(areaShape, [ids](const vtkIdType *segment, vtkIdType n)
+                             {
+                                 vtkIdType *dst = ids->WritePointer(ids->GetNumberOfTuples(), n);
+                                 std::copy(segment, segment + n, dst);
+                             });
+}
+
+vtkIdTypeArray *AvtkKdTree::GetPointsInRegion(int regionId)
+{
+    if (this->RegionOffsets.empty())
+        return this->vtkKdTree::GetPointsInRegion(regionId);
+    if (regionId < 0 || regionId >= this->GetNumberOfRegions())
+    {
+        vtkErrorMacro(<< "GetPointsInRegion - invalid region id " << regionId);
+        return nullptr;
+    }
+
+    vtkIdType begin = this->RegionOffsets[regionId];
+    vtkIdType end = this->RegionOffsets[regionId + 1];
+    vtkIdTypeArray *ids = vtkIdTypeArray::New();
+    ids->SetNumberOfValues(end - begin);
+    std::copy(this->RegionPointIds.begin() + begin, this->RegionPointIds.begin() + end, ids->GetPointer(0));
+    return ids;
+}
+
+vtkIdType AvtkKdTree::FindPoint(double *x)
+{
+    if (this->RegionOffsets.empty())
+        return this->vtkKdTree::FindPoint(x);
+
+    // 与缓存中的坐标比较，单精度存储时先按相同方式舍入
+    double p[3] = {x[0], x[1], x[2]};
+    if (this->RegionFloatStorage)
+    {
+        for (int k = 0; k < 3; ++k)
+            p[k] = static_cast<float>(p[k]);
+    }
+    double dist2;
+    vtkIdType id = this->FindApproximateClosestPoint(p, 0.0, 0, dist2);
+    return dist2 == 0.0 ? id : -1;
+}
 
-            // 如果距离为正，则点在平面外部
-            if (distance > 0)
+vtkIdType AvtkKdTree::FindPoint(double x, double y, double z)
+{
+    double p[3] = {x, y, z};
+    return this->FindPoint(p);
+}
+
+vtkIdTypeArray *AvtkKdTree::BuildMapForDuplicatePoints(float tolerance)
+{
+    if (this->RegionOffsets.empty())
+        return this->vtkKdTree::BuildMapForDuplicatePoints(tolerance);
+    if (tolerance < 0.0f)
+    {
+        vtkErrorMacro(<< "BuildMapForDuplicatePoints - invalid tolerance " << tolerance);
+        tolerance = 0.0f;
+    }
+
+    const vtkIdType numPoints = static_cast<vtkIdType>(this->RegionPointIds.size());
+    std::vector<vtkIdType> position(numPoints);
+    for (vtkIdType i = 0; i < numPoints; ++i)
+        position[this->RegionPointIds[i]] = i;
+
+    // 按id从小到大，每个尚未映射的点把容差内尚未映射的点映射到自己
+    vtkIdTypeArray *uniqueIds = vtkIdTypeArray::New();
+    uniqueIds->SetNumberOfValues(numPoints);
+    vtkIdType *map = uniqueIds->GetPointer(0);
+    std::fill(map, map + numPoints, -1);
+    for (vtkIdType id = 0; id < numPoints; ++id)
+    {
+        if (map[id] >= 0)
+            continue;
+        double p[3];
+        this->GetRegionPoint(position[id], p);
+        AUtils::SphereShape sphere;
+        sphere.Init(p, tolerance);
+        this->ForEachPointInShape(sphere, [map, id](vtkIdType other)
+                                  {
+                                      if (map[other] < 0)
+                                          map[other] = id;
+                                  });
+        map[id] = id;
+    }
+    return uniqueIds;
+}
+
+void AvtkKdTree::GetNodeBounds(vtkKdNode *node, double bounds[6]) const
+{
+    if (node->GetLeft() == nullptr)
+    {
+        std::copy_n(&this->RegionBounds[6 * node->GetID()], 6, bounds);
+        return;
+    }
+    node->GetBounds(bounds);
+}
+
+void AvtkKdTree::JoinNodes(const AvtkKdTree *other, vtkKdNode *node, vtkKdNode *otherNode, double radius2,
+                           std::vector<PointPair> &result) const
+{
+    double bounds[6], otherBounds[6];
+    this->GetNodeBounds(node, bounds);
+    other->GetNodeBounds(otherNode, otherBounds);
+    if (AUtils::BoundsToBoundsDistance2(bounds, otherBounds) > radius2)
+        return;
+
+    vtkIdType begin, end, otherBegin, otherEnd;
+    this->GetNodeRange(node, begin, end);
+    other->GetNodeRange(otherNode, otherBegin, otherEnd);
+    bool leaf = node->GetLeft() == nullptr;
+    bool otherLeaf = otherNode->GetLeft() == nullptr;
+
+    // 两个叶子，或两个节点中任意两点的距离都不超过半径时，不再向下拆分，直接逐对比较
+    bool allWithin = AUtils::BoundsToBoundsMaxDistance2(bounds, otherBounds) <= radius2;
+    if (allWithin || (leaf && otherLeaf))
+    {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            double p[3];
+            this->GetRegionPoint(i, p);
+            if (!allWithin && AUtils::BoundsDistance2(otherBounds, p) > radius2)
+                continue;
+            for (vtkIdType j = otherBegin; j < otherEnd; ++j)
             {
-                inside = false;
-                break;
+                double q[3];
+                other->GetRegionPoint(j, q);
+                double dist2 = vtkMath::Distance2BetweenPoints(p, q);
+                if (dist2 <= radius2)
+                    result.push_back({this->RegionPointIds[i], other->RegionPointIds[j], dist2});
             }
         }
+        return;
+    }
+
+    // 拆分点数较多的内部节点
+    if (!leaf && (otherLeaf || end - begin >= otherEnd - otherBegin))
+    {
+        this->JoinNodes(other, node->GetLeft(), otherNode, radius2, result);
+        this->JoinNodes(other, node->GetRight(), otherNode, radius2, result);
+    }
+    else
+    {
+        this->JoinNodes(other, node, otherNode->GetLeft(), radius2, result);
+        this->JoinNodes(other, node, otherNode->GetRight(), radius2, result);
+    }
+}
 
-        // 如果点在所有平面内侧，则添加到结果中
-        if (inside)
+void AvtkKdTree::FindPairsWithinRadius(AvtkKdTree *other, double radius, vtkIdTypeArray *pairs,
+                                       vtkDoubleArray *dist2)
+{
+    pairs->SetNumberOfComponents(2);
+    pairs->SetNumberOfTuples(0);
+    if (dist2)
+    {
+        dist2->SetNumberOfComponents(1);
+        dist2->SetNumberOfTuples(0);
+    }
+    if (!this->CheckRegionPointCache() || !other->CheckRegionPointCache() || radius < 0.0)
+        return;
+    double radius2 = radius * radius;
+
+    // 同时展开两棵树的上层，得到互不相关的节点对，每个节点对作为一个并行任务
+    using NodePair = std::pair<vtkKdNode *, vtkKdNode *>;
+    std::vector<NodePair> tasks{{this->Top, other->Top}};
+    const size_t minTasks = 16 * std::max(1, vtkSMPTools::GetEstimatedNumberOfThreads());
+    bool expanded = true;
+    while (expanded && tasks.size() < minTasks)
+    {
+        expanded = false;
+        std::vector<NodePair> next;
+        for (const NodePair &task : tasks)
         {
-            ids->InsertNextId(pointId);
+            double bounds[6], otherBounds[6];
+            this->GetNodeBounds(task.first, bounds);
+            other->GetNodeBounds(task.second, otherBounds);
+            if (AUtils::BoundsToBoundsDistance2(bounds, otherBounds) > radius2)
+                continue;
+            vtkKdNode *left = task.first->GetLeft();
+            vtkKdNode *otherLeft = task.second->GetLeft();
+            if (!left && !otherLeft)
+            {
+                next.push_back(task);
+                continue;
+            }
+            expanded = true;
+            vtkKdNode *children[2] = {left ? left : task.first, left ? task.first->GetRight() : nullptr};
+            vtkKdNode *otherChildren[2] = {otherLeft ? otherLeft : task.second,
+                                           otherLeft ? task.second->GetRight() : nullptr};
+            for (vtkKdNode *child : children)
+            {
+                for (vtkKdNode *otherChild : otherChildren)
+                {
+                    if (child && otherChild)
+                        next.emplace_back(child, otherChild);
+                }
+            }
         }
+        tasks.swap(next);
+    }
+
+    std::vector<std::vector<PointPair>> results(tasks.size());
+    vtkSMPTools::For(0, static_cast<vtkIdType>(tasks.size()), 1,
+                     [&](vtkIdType begin, vtkIdType end)
+                     {
+                         for (vtkIdType t = begin; t < end; ++t)
+                         {
+                             this->JoinNodes(other, tasks[t].first, tasks[t].second, radius2, results[t]);
+                         }
+                     });
+
+    std::vector<PointPair> all;
+    size_t numPairs = 0;
+    for (const auto &result : results)
+    {
+        numPairs += result.size();
+    }
+    all.reserve(numPairs);
+    for (auto &result : results)
+    {
+        all.insert(all.end(), result.begin(), result.end());
+        std::vector<PointPair>().swap(result);
+    }
+    vtkSMPTools::Sort(all.begin(), all.end(), [](const PointPair &a, const PointPair &b)
+                      { return a.First != b.First ? a.First < b.First : a.Second < b.Second; });
+
+    pairs->SetNumberOfTuples(static_cast<vtkIdType>(numPairs));
+    vtkIdType *pairIds = pairs->GetPointer(0);
+    double *pairDist2 = nullptr;
+    if (dist2)
+    {
+        dist2->SetNumberOfTuples(static_cast<vtkIdType>(numPairs));
+        pairDist2 = dist2->GetPointer(0);
+    }
+    for (size_t k = 0; k < numPairs; ++k)
+    {
+        pairIds[2 * k] = all[k].First;
+        pairIds[2 * k + 1] = all[k].Second;
+        if (pairDist2)
+            pairDist2[k] = all[k].Dist2;
     }
 }
 
-std::vector<vtkKdNode *> AvtkKdTree::GetPathFromRootToNode(vtkKdNode *target) const
+void AvtkKdTree::FindClosestPointsInTree(AvtkKdTree *other, vtkIdTypeArray *ids, vtkDoubleArray *dist2,
+                                         double maxDistance)
 {
-    return this->getPath(this->Top, target);
+    ids->SetNumberOfComponents(1);
+    ids->SetNumberOfTuples(0);
+    if (dist2)
+    {
+        dist2->SetNumberOfComponents(1);
+        dist2->SetNumberOfTuples(0);
+    }
+    if (!this->CheckRegionPointCache() || !other->CheckRegionPointCache())
+        return;
+
+    vtkIdType numPoints = this->RegionOffsets.back();
+    ids->SetNumberOfTuples(numPoints);
+    vtkIdType *closestIds = ids->GetPointer(0);
+    double *closestDist2 = nullptr;
+    if (dist2)
+    {
+        dist2->SetNumberOfTuples(numPoints);
+        closestDist2 = dist2->GetPointer(0);
+    }
+    const double maxDist2 = maxDistance < VTK_DOUBLE_MAX ? maxDistance * maxDistance : VTK_DOUBLE_MAX;
+
+    // 每个区域的点一起遍历 other，裁剪条件取区域内所有点当前最近距离的最大值
+    vtkSMPTools::For(0, this->GetNumberOfRegions(),
+                     [&](vtkIdType regionBegin, vtkIdType regionEnd)
+                     {
+                         std::vector<double> best;
+                         std::vector<vtkIdType> bestIds;
+                         std::vector<std::pair<vtkKdNode *, double>> stack;
+                         for (vtkIdType r = regionBegin; r < regionEnd; ++r)
+                         {
+                             vtkIdType begin = this->RegionOffsets[r];
+                             vtkIdType n = this->RegionOffsets[r + 1] - begin;
+                             if (n == 0)
+                                 continue;
+                             const double *bounds = &this->RegionBounds[6 * r];
+                             best.assign(n, maxDist2);
+                             bestIds.assign(n, -1);
+                             double bound = maxDist2;
+
+                             double otherBounds[6];
+                             other->GetNodeBounds(other->Top, otherBounds);
+                             stack.clear();
+                             stack.emplace_back(other->Top, AUtils::BoundsToBoundsDistance2(bounds, otherBounds));
+                             while (!stack.empty())
+                             {
+                                 vtkKdNode *node = stack.back().first;
+                                 double nodeDist2 = stack.back().second;
+                                 stack.pop_back();
+                                 if (nodeDist2 > bound)
+                                     continue;
+
+                                 if (node->GetLeft() == nullptr)
+                                 {
+                                     vtkIdType otherBegin, otherEnd;
+                                     other->GetNodeRange(node, otherBegin, otherEnd);
+                                     other->GetNodeBounds(node, otherBounds);
+                                     for (vtkIdType i = 0; i < n; ++i)
+                                     {
+                                         double p[3];
+                                         this->GetRegionPoint(begin + i, p);
+                                         if (AUtils::BoundsDistance2(otherBounds, p) > best[i])
+                                             continue;
+                                         for (vtkIdType j = otherBegin; j < otherEnd; ++j)
+                                         {
+                                             double q[3];
+                                             other->GetRegionPoint(j, q);
+                                             double d2 = vtkMath::Distance2BetweenPoints(p, q);
+                                             // 距离恰好为 maxDistance 的点同样计入
+                                             if (d2 < best[i] || (bestIds[i] < 0 && d2 <= best[i]))
+                                             {
+                                                 best[i] = d2;
+                                                 bestIds[i] = other->RegionPointIds[j];
+                                             }
+                                         }
+                                     }
+                                     bound = *std::max_element(best.begin(), best.end());
+                                     continue;
+                                 }
+
+                                 // 先访问较近的子节点
+                                 double leftBounds[6], rightBounds[6];
+                                 other->GetNodeBounds(node->GetLeft(), leftBounds);
+                                 other->GetNodeBounds(node->GetRight(), rightBounds);
+                                 double leftDist2 = AUtils::BoundsToBoundsDistance2(bounds, leftBounds);
+                                 double rightDist2 = AUtils::BoundsToBoundsDistance2(bounds, rightBounds);
+                                 if (leftDist2 <= rightDist2)
+                                 {
+                                     stack.emplace_back(node->GetRight(), rightDist2);
+                                     stack.emplace_back(node->GetLeft(), leftDist2);
+                                 }
+                                 else
+                                 {
+                                     stack.emplace_back(node->GetLeft(), leftDist2);
+                                     stack.emplace_back(node->GetRight(), rightDist2);
+                                 }
+                             }
+
+                             for (vtkIdType i = 0; i < n; ++i)
+                             {
+                                 vtkIdType id = this->RegionPointIds[begin + i];
+                                 closestIds[id] = bestIds[i];
+                                 if (closestDist2)
+                                     closestDist2[id] = bestIds[i] < 0 ? VTK_DOUBLE_MAX : best[i];
+                             }
+                         }
+                     });
 }
 
-std::vector<vtkKdNode *> AvtkKdTree::getPath(vtkKdNode *current, vtkKdNode *target) const
+std::vector<CubeFrame *> AvtkKdTree::GetRegionsBoundariesByLevel(int level)
 {
-    // 处理空节点情况，直接返回空路径
-    if (!current)
+    std::vector<CubeFrame *> frames;
+
+    // 遍历该层级的每个节点，获取边界并创建对应的CubeFrame
+    for (vtkKdNode *node : this->GetNodesAtLevel(level))
+    {
+        double bounds[6];
+        node->GetBounds(bounds);
+        frames.push_back(new CubeFrame(bounds));
+    }
+    return frames;
+}
+
+int AvtkKdTree::GetNumberOfRegionsAtLevel(int level)
+{
+    return static_cast<int>(this->GetNodesAtLevel(level).size());
+}
+
+int AvtkKdTree::GetMaxLevel() const
+{
+    this->UpdateLevelIndex();
+    return static_cast<int>(this->LevelNodes.size()) - 1;
+}
+
+const std::vector<vtkKdNode *> &AvtkKdTree::GetNodesAtLevel(int level) const
+{
+    static const std::vector<vtkKdNode *> empty;
+    this->UpdateLevelIndex();
+    if (level < 0 || level >= static_cast<int>(this->LevelNodes.size()))
+        return empty;
+    return this->LevelNodes[level];
+}
+
+void AvtkKdTree::UpdateLevelIndex() const
+{
+    if (this->IndexedTop == this->Top && (!this->Top || !this->LevelNodes.empty()))
+        return;
+
+    this->IndexedTop = this->Top;
+    this->LevelNodes.clear();
+    if (!this->Top)
+        return;
+
+    // 逐层广度优先遍历
+    std::vector<vtkKdNode *> level = {this->Top};
+    while (!level.empty())
+    {
+        std::vector<vtkKdNode *> next;
+        next.reserve(2 * level.size());
+        for (vtkKdNode *node : level)
+        {
+            if (node->GetLeft())
+                next.push_back(node->GetLeft());
+            if (node->GetRight())
+                next.push_back(node->GetRight());
+        }
+        this->LevelNodes.push_back(std::move(level));
+        level = std::move(next);
+    }
+}
+
+std::vector<CubeFrame *> AvtkKdTree::GetRegionBoundsByPoint(double x, double y, double z)
+{
+    int regionID = this->GetRegionContainingPoint(x, y, z);
+    if (regionID < 0)
         return {};
 
-    // 当前节点即为目标节点，返回单节点路径
-    if (current == target)
-        return {current};
+    vtkKdNode *targetNode = this->RegionList[regionID];
+    if (!targetNode)
+        return {};
 
-    // 递归查找左子树路径
-    auto leftPath = this->getPath(current->GetLeft(), target);
-    if (!leftPath.empty())
+    /**
+     * 获取从根节点到目标节点的完整路径
+     */
+    std::vector<vtkKdNode *> path = this->GetPathFromRootToNode(targetNode);
+    if (path.empty())
+        return {};
+
+    /**
+     * 遍历路径中的每个节点，收集其边界框信息
+     */
+    std::vector<CubeFrame *> frames;
+    for (auto node : path)
     {
-        // 将当前节点插入左子路径开头并返回
-        leftPath.insert(leftPath.begin(), current);
-        return leftPath;
+        double bounds[6];
+        node->GetBounds(bounds);
+        frames.push_back(new CubeFrame(bounds));
     }
+    return frames;
+}
 
-    // 递归查找右子树路径
-    auto rightPath = this->getPath(current->GetRight(), target);
-    if (!rightPath.empty())
+void AvtkKdTree::FindPointsWithinRadius(double R, const double x[3], vtkIdList *result)
+{
+    // 没有区域点缓存（如以 vtkKdTree::BuildLocatorFromPoints 构建）时交给vtkKdTree处理
+    if (this->RegionOffsets.empty())
     {
-        // 将当前节点插入右子路径开头并返回
-        rightPath.insert(rightPath.begin(), current);
-        return rightPath;
+        this->vtkKdTree::FindPointsWithinRadius(R, x, result);
+        return;
     }
+    result->Reset();
 
-    // 双子树均未找到路径，返回空列表
-    return {};
+    AUtils::SphereShape sphere;
+    sphere.Init(x, R);
+    this->FindPointsInShape(this->Top, sphere, result);
 }
 
-int AvtkKdTree::CountNodesAtLevel(vtkKdNode *node, int currentLevel, int targetLevel)
+void AvtkKdTree::FindPointsInArea(double *area, vtkIdList *ids)
 {
-    /* 如果节点为空，返回0 */
-    if (!node)
-        return 0;
+    ids->Reset();
+    if (this->RegionOffsets.empty())
+    {
+        vtkNew<vtkIdTypeArray> found;
+        this->vtkKdTree::FindPointsInArea(area, found);
+        AUtils::AppendIds(ids, found->GetPointer(0), found->GetNumberOfTuples());
+        return;
+    }
 
-    /* 如果当前层级超过目标层级，提前返回0 */
-    if (currentLevel > targetLevel)
-        return 0;
+    AUtils::AreaShape areaShape;
+    areaShape.Init(area);
+    this->FindPointsInShape(this->Top, areaShape, ids);
+}
 
-    /* 根据当前层级是否为目标层级返回计数结果或递归统计左右子节点 */
-    return (currentLevel == targetLevel) ? 1
-                                         : CountNodesAtLevel(node->GetLeft(), currentLevel + 1, targetLevel) + CountNodesAtLevel(node->GetRight(), currentLevel + 1, targetLevel);
+void AvtkKdTree::FindPointsInCuboid(double cuboid[8][3], vtkIdList *ids)
+{
+    ids->Reset();
+    if (!this->CheckRegionPointCache())
+        return;
+
+    // 面的平面方程与分离轴在每次查询中只计算一次
+    AUtils::CuboidShape cuboidShape;
+    cuboidShape.Init(cuboid);
+    this->FindPointsInShape(this->Top, cuboidShape, ids);
+}
+
+void AvtkKdTree::FindPointsInConvexPolytope(const double *planes, int numPlanes, vtkIdList *ids)
+{
+    ids->Reset();
+    if (!this->CheckRegionPointCache())
+        return;
+
+    AUtils::ConvexPolytopeShape polytope;
+    polytope.Init(planes, numPlanes);
+    this->FindPointsInShape(this->Top, polytope, ids);
+}
+
+void AvtkKdTree::FindPointsInTube(const double *points, int numPoints, double radius, vtkIdList *ids)
+{
+    ids->Reset();
+    if (!this->CheckRegionPointCache())
+        return;
+
+    // 线段的层次结构在每次查询中只构建一次
+    AUtils::TubeShape tube;
+    tube.Init(points, numPoints, radius);
+    this->FindPointsInShape(this->Top, tube, ids);
+}
+
+std::vector<vtkKdNode *> AvtkKdTree::GetPathFromRootToNode(vtkKdNode *target) const
+{
+    return this->getPath(this->Top, target);
+}
+
+std::vector<vtkKdNode *> AvtkKdTree::getPath(vtkKdNode *current, vtkKdNode *target) const
+{
+    if (!current)
+        return {};
+
+    // 从目标节点沿父节点回溯，未经过current时说明目标不在其子树中
+    std::vector<vtkKdNode *> path;
+    for (vtkKdNode *node = target; node; node = node->GetUp())
+    {
+        path.push_back(node);
+        if (node == current)
+        {
+            std::reverse(path.begin(), path.end());
+            return path;
+        }
+    }
+    return {};
 }
 
 int AvtkKdTree::GetNodeLevel(vtkKdNode *node) const
@@ -303,12 +1391,12 @@ int AvtkKdTree::FindNodeLevel(
 {
     if (!current)
         return -1;
-    if (current == target)
-        return currentLevel;
-    // 递归搜索左子节点层级
-    int left = FindNodeLevel(current->GetLeft(), target, currentLevel + 1);
-    if (left != -1)
-        return left;
-    // 若左子树未找到，则递归搜索右子节点层级
-    return FindNodeLevel(current->GetRight(), target, currentLevel + 1);
-}
\ No newline at end of file
+    // 沿父节点向上计数，直到到达current
+    int depth = 0;
+    for (vtkKdNode *node = target; node; node = node->GetUp(), ++depth)
+    {
+        if (node == current)
+            return currentLevel + depth;
+    }
+    return -1;
+}
@@ -1,25 +1,234 @@
 #include "AvtkKdTreePointLocator.h"
 
+#include "AvtkFlatKdTree.h"
+#include "AvtkIncrementalKdTree.h"
 #include "AvtkKdTree.h"
+#include "AvtkUniformGrid.h"
+#include "vtkDoubleArray.h"
+#include "vtkIdList.h"
+#include "vtkIdTypeArray.h"
+#include "vtkMath.h"
+#include "vtkNew.h"
 #include "vtkObjectFactory.h"
+#include "vtkPointData.h"
 #include "vtkPointSet.h"
+#include "vtkPolyData.h"
+#include "vtkPoints.h"
+#include "vtkSMPThreadLocal.h"
+#include "vtkSMPTools.h"
+#include "vtkTimerLog.h"
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
 
 //------------------------------------------------------------------------------
 vtkStandardNewMacro(AvtkKdTreePointLocator);
 
+namespace
+{
+//------------------------------------------------------------------------------
+// Closest point per query position, written directly into the output arrays.
+template <typename TTree>
+struct BatchClosestPoint
+{
+  TTree *Tree;
+  const double *X;
+  vtkIdType *Ids;
+  double *Dist2;
+  bool Approximate;
+  double Epsilon;
+  int MaxLeaves;
+
+  void operator()(vtkIdType begin, vtkIdType end)
+  {
+    for (vtkIdType q = begin; q < end; ++q)
+    {
+      double x[3] = { this->X[3 * q], this->X[3 * q + 1], this->X[3 * q + 2] };
+      double dist2;
+      this->Ids[q] = this->Approximate
+        ? this->Tree->FindApproximateClosestPoint(x, this->Epsilon, this->MaxLeaves, dist2)
+        : this->Tree->FindClosestPoint(x, dist2);
+      if (this->Dist2)
+      {
+        this->Dist2[q] = dist2;
+      }
+    }
+  }
+};
+
+//------------------------------------------------------------------------------
+// Backends whose query signatures differ from the flat trees, for the generic
+// lambdas passed to DispatchSearchStructure().
+template <typename TTreePointer>
+using IsKdTree = std::is_same<std::remove_pointer_t<TTreePointer>, AvtkKdTree>;
+template <typename TTreePointer>
+using IsUniformGrid = std::is_same<std::remove_pointer_t<TTreePointer>, AvtkUniformGrid>;
+
+//------------------------------------------------------------------------------
+// Empty CSR result of numQueries queries.
+void ClearBatchResult(vtkIdType numQueries, vtkIdTypeArray *offsets, vtkIdTypeArray *ids)
+{
+  offsets->SetNumberOfComponents(1);
+  offsets->SetNumberOfValues(numQueries + 1);
+  std::fill_n(offsets->GetPointer(0), numQueries + 1, vtkIdType(0));
+  ids->SetNumberOfComponents(1);
+  ids->SetNumberOfValues(0);
+}
+
+//------------------------------------------------------------------------------
+// Name of a TreeType for error messages.
+const char *TreeTypeName(int treeType)
+{
+  switch (treeType)
+  {
+    case AvtkKdTreePointLocator::VTK_KD_TREE:
+      return "VTK_KD_TREE";
+    case AvtkKdTreePointLocator::FLAT_KD_TREE:
+      return "FLAT_KD_TREE";
+    case AvtkKdTreePointLocator::INCREMENTAL_KD_TREE:
+      return "INCREMENTAL_KD_TREE";
+    case AvtkKdTreePointLocator::UNIFORM_GRID:
+      return "UNIFORM_GRID";
+    default:
+      return "(unknown)";
+  }
+}
+
+//------------------------------------------------------------------------------
+// Coordinates of all points of a dataset as consecutive (x, y, z) triples.
+void GetDataSetPoints(vtkDataSet *dataSet, std::vector<double> &x)
+{
+  vtkIdType numPoints = dataSet ? dataSet->GetNumberOfPoints() : 0;
+  x.resize(3 * numPoints);
+  for (vtkIdType i = 0; i < numPoints; ++i)
+  {
+    dataSet->GetPoint(i, x.data() + 3 * i);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Runs one vtkIdList producing query per position. Each thread appends its
+// results to a private buffer; the buffers are scattered into a CSR layout
+// once the counts of all queries are known.
+template <typename QueryFunctor>
+struct BatchIdListQuery
+{
+  struct Chunk
+  {
+    vtkIdType Begin;
+    vtkIdType End;
+    size_t Start;
+  };
+
+  struct LocalData
+  {
+    vtkSmartPointer<vtkIdList> Scratch;
+    std::vector<vtkIdType> Ids;
+    std::vector<Chunk> Chunks;
+  };
+
+  const double *X;
+  QueryFunctor Query;
+  std::vector<vtkIdType> Counts;
+  vtkSMPThreadLocal<LocalData> TLocal;
+
+  BatchIdListQuery(vtkIdType numQueries, const double *x, QueryFunctor query)
+    : X(x)
+    , Query(query)
+    , Counts(numQueries, 0)
+  {
+  }
+
+  void Initialize() { this->TLocal.Local().Scratch = vtkSmartPointer<vtkIdList>::New(); }
+
+  void operator()(vtkIdType begin, vtkIdType end)
+  {
+    LocalData &local = this->TLocal.Local();
+    Chunk chunk = { begin, end, local.Ids.size() };
+    for (vtkIdType q = begin; q < end; ++q)
+    {
+      this->Query(this->X + 3 * q, local.Scratch);
+      this->Counts[q] = local.Scratch->GetNumberOfIds();
+      local.Ids.insert(local.Ids.end(), local.Scratch->begin(), local.Scratch->end());
+    }
+    local.Chunks.push_back(chunk);
+  }
+
+  void Reduce() {}
+
+  void Gather(vtkIdTypeArray *offsets, vtkIdTypeArray *ids)
+  {
+    vtkIdType numQueries = static_cast<vtkIdType>(this->Counts.size());
+    offsets->SetNumberOfComponents(1);
+    offsets->SetNumberOfValues(numQueries + 1);
+    vtkIdType *off = offsets->GetPointer(0);
+    off[0] = 0;
+    for (vtkIdType q = 0; q < numQueries; ++q)
+    {
+      off[q + 1] = off[q] + this->Counts[q];
+    }
+
+    ids->SetNumberOfComponents(1);
+    ids->SetNumberOfValues(off[numQueries]);
+    vtkIdType *out = ids->GetPointer(0);
+
+    std::vector<std::pair<const LocalData *, const Chunk *>> chunks;
+    for (auto &local : this->TLocal)
+    {
+      for (const auto &chunk : local.Chunks)
+      {
+        chunks.emplace_back(&local, &chunk);
+      }
+    }
+    vtkSMPTools::For(0, static_cast<vtkIdType>(chunks.size()),
+      [&](vtkIdType begin, vtkIdType end)
+      {
+        for (vtkIdType c = begin; c < end; ++c)
+        {
+          const LocalData *local = chunks[c].first;
+          const Chunk *chunk = chunks[c].second;
+          std::copy(local->Ids.begin() + chunk->Start,
+            local->Ids.begin() + chunk->Start + (off[chunk->End] - off[chunk->Begin]),
+            out + off[chunk->Begin]);
+        }
+      });
+  }
+};
+
+template <typename QueryFunctor>
+void RunBatchIdListQuery(vtkIdType numQueries, const double *x, QueryFunctor query,
+  vtkIdTypeArray *offsets, vtkIdTypeArray *ids)
+{
+  BatchIdListQuery<QueryFunctor> batch(numQueries, x, query);
+  vtkSMPTools::For(0, numQueries, batch);
+  batch.Gather(offsets, ids);
+}
+}
+
 //------------------------------------------------------------------------------
 AvtkKdTreePointLocator::AvtkKdTreePointLocator()
 {
   this->KdTree = nullptr;
+  this->FlatKdTree = nullptr;
+  this->IncrementalKdTree = nullptr;
+  this->UniformGrid = nullptr;
+  this->NumberOfIndexedPoints = 0;
+  this->IndexedPointsMTime = 0;
+  this->ApproximationEpsilon = 0.0;
+  this->MaxNumberOfLeavesVisited = 0;
+  this->TreeType = VTK_KD_TREE;
+  this->NumberOfPointsPerLeaf = 16;
+  this->GridCellSize = 0.0;
+  this->ParallelBuild = 0;
+  this->SinglePrecision = 0;
+  this->BuildElapsedTime = 0.0;
 }
 
 //------------------------------------------------------------------------------
 AvtkKdTreePointLocator::~AvtkKdTreePointLocator()
 {
-  if (this->KdTree)
-  {
-    this->KdTree->Delete();
-  }
+  this->FreeSearchStructure();
 }
 
 //------------------------------------------------------------------------------
@@ -27,8 +236,26 @@ vtkIdType AvtkKdTreePointLocator::FindClosestPoint(const double x[3])
 {
   this->BuildLocator();
   double dist2;
+  if (this->IsApproximate())
+  {
+    return this->FindClosestPoint(x, dist2, nullptr);
+  }
 
-  return this->KdTree->FindClosestPoint(x[0], x[1], x[2], dist2);
+  vtkIdType id = -1;
+  this->DispatchSearchStructure(
+    [&](auto *tree)
+    {
+      if constexpr (IsKdTree<decltype(tree)>::value)
+      {
+        // vtkKdTree takes the position as non-const
+        id = tree->FindClosestPoint(x[0], x[1], x[2], dist2);
+      }
+      else
+      {
+        id = tree->FindClosestPoint(x, dist2);
+      }
+    });
+  return id;
 }
 
 //------------------------------------------------------------------------------
@@ -36,33 +263,561 @@ vtkIdType AvtkKdTreePointLocator::FindClosestPointWithinRadius(
     double radius, const double x[3], double &dist2)
 {
   this->BuildLocator();
-  return this->KdTree->FindClosestPointWithinRadius(radius, x, dist2);
+  vtkIdType id = -1;
+  dist2 = VTK_DOUBLE_MAX;
+  this->DispatchSearchStructure(
+    [&](auto *tree) { id = tree->FindClosestPointWithinRadius(radius, x, dist2); });
+  return id;
 }
 
 //------------------------------------------------------------------------------
 void AvtkKdTreePointLocator::FindClosestNPoints(int N, const double x[3], vtkIdList *result)
 {
   this->BuildLocator();
-  this->KdTree->FindClosestNPoints(N, x, result);
+  if (this->IsApproximate())
+  {
+    this->FindClosestNPoints(N, x, result, nullptr);
+    return;
+  }
+  if (!this->DispatchSearchStructure([&](auto *tree) { tree->FindClosestNPoints(N, x, result); }))
+  {
+    result->Reset();
+  }
+}
+
+//------------------------------------------------------------------------------
+vtkIdType AvtkKdTreePointLocator::FindClosestPoint(const double x[3], double &dist2, int *leavesVisited)
+{
+  this->BuildLocator();
+  double epsilon = this->ApproximationEpsilon;
+  int maxLeaves = this->MaxNumberOfLeavesVisited;
+  vtkIdType id = -1;
+  dist2 = VTK_DOUBLE_MAX;
+  if (leavesVisited)
+  {
+    *leavesVisited = 0;
+  }
+  this->DispatchSearchStructure(
+    [&](auto *tree)
+    {
+      if constexpr (IsUniformGrid<decltype(tree)>::value)
+      {
+        // the grid search is always exact, leavesVisited reports the visited cells
+        id = tree->FindClosestPoint(x, dist2, leavesVisited);
+      }
+      else
+      {
+        id = tree->FindApproximateClosestPoint(x, epsilon, maxLeaves, dist2, leavesVisited);
+      }
+    });
+  return id;
+}
+
+//------------------------------------------------------------------------------
+void AvtkKdTreePointLocator::FindClosestNPoints(int N, const double x[3], vtkIdList *result, int *leavesVisited)
+{
+  this->BuildLocator();
+  double epsilon = this->ApproximationEpsilon;
+  int maxLeaves = this->MaxNumberOfLeavesVisited;
+  bool found = this->DispatchSearchStructure(
+    [&](auto *tree)
+    {
+      if constexpr (IsUniformGrid<decltype(tree)>::value)
+      {
+        tree->FindClosestNPoints(N, x, result, leavesVisited);
+      }
+      else
+      {
+        tree->FindApproximateClosestNPoints(N, x, epsilon, maxLeaves, result, leavesVisited);
+      }
+    });
+  if (!found)
+  {
+    result->Reset();
+    if (leavesVisited)
+    {
+      *leavesVisited = 0;
+    }
+  }
 }
 
 //------------------------------------------------------------------------------
 void AvtkKdTreePointLocator::FindPointsWithinRadius(double R, const double x[3], vtkIdList *result)
 {
   this->BuildLocator();
-  this->KdTree->FindPointsWithinRadius(R, x, result);
+  if (!this->DispatchSearchStructure([&](auto *tree) { tree->FindPointsWithinRadius(R, x, result); }))
+  {
+    result->Reset();
+  }
 }
 
 void AvtkKdTreePointLocator::FindPointsWithinArea(double *area, vtkIdList *result)
 {
   this->BuildLocator();
-  this->KdTree->FindPointsInArea(area, result);
+  if (!this->DispatchSearchStructure([&](auto *tree) { tree->FindPointsInArea(area, result); }))
+  {
+    result->Reset();
+  }
 }
 
 void AvtkKdTreePointLocator::FindPointsWithinCuboid(double cuboid[8][3], vtkIdList *result)
 {
   this->BuildLocator();
-  this->KdTree->FindPointsInCuboid(cuboid, result);
+  if (!this->DispatchSearchStructure([&](auto *tree) { tree->FindPointsInCuboid(cuboid, result); }))
+  {
+    result->Reset();
+  }
+}
+
+//------------------------------------------------------------------------------
+void AvtkKdTreePointLocator::FindPointsWithinConvexPolytope(
+  const double *planes, int numPlanes, vtkIdList *result)
+{
+  this->BuildLocator();
+  if (!this->DispatchSearchStructure(
+        [&](auto *tree) { tree->FindPointsInConvexPolytope(planes, numPlanes, result); }))
+  {
+    result->Reset();
+  }
+}
+
+//------------------------------------------------------------------------------
+void AvtkKdTreePointLocator::FindPointsWithinCylinder(
+    const double point[3], const double direction[3], double radius, vtkIdList *result)
+{
+  this->BuildLocator();
+  if (!this->DispatchSearchStructure(
+        [&](auto *tree) { tree->FindPointsInCylinder(point, direction, radius, result); }))
+  {
+    result->Reset();
+  }
+}
+
+//------------------------------------------------------------------------------
+void AvtkKdTreePointLocator::FindPointsWithinCapsule(
+    const double p0[3], const double p1[3], double radius, vtkIdList *result)
+{
+  this->BuildLocator();
+  if (!this->DispatchSearchStructure([&](auto *tree) { tree->FindPointsInCapsule(p0, p1, radius, result); }))
+  {
+    result->Reset();
+  }
+}
+
+//------------------------------------------------------------------------------
+void AvtkKdTreePointLocator::FindPointsWithinTube(const double *points, int numPoints, double radius,
+  vtkIdList *result, vtkIdTypeArray *segmentIds, vtkDoubleArray *parameters)
+{
+  this->BuildLocator();
+  if (!this->DispatchSearchStructure(
+        [&](auto *tree) { tree->FindPointsInTube(points, numPoints, radius, result); }))
+  {
+    result->Reset();
+  }
+  if (!segmentIds && !parameters)
+  {
+    return;
+  }
+
+  // closest approach of every found point, only the found points pay for it
+  AUtils::TubeShape tube;
+  tube.Init(points, numPoints, radius);
+  vtkIdType numIds = result->GetNumberOfIds();
+  if (segmentIds)
+  {
+    segmentIds->SetNumberOfComponents(1);
+    segmentIds->SetNumberOfTuples(numIds);
+  }
+  if (parameters)
+  {
+    parameters->SetNumberOfComponents(1);
+    parameters->SetNumberOfTuples(numIds);
+  }
+  const vtkIdType *ids = result->GetPointer(0);
+  vtkIdType *segmentOut = segmentIds ? segmentIds->GetPointer(0) : nullptr;
+  double *parameterOut = parameters ? parameters->GetPointer(0) : nullptr;
+  vtkSMPTools::For(0, numIds,
+    [&](vtkIdType begin, vtkIdType end)
+    {
+      double x[3];
+      for (vtkIdType i = begin; i < end; ++i)
+      {
+        this->DataSet->GetPoint(ids[i], x);
+        int segment;
+        double t;
+        tube.ClosestSegment(x, segment, t);
+        if (segmentOut)
+        {
+          segmentOut[i] = segment;
+        }
+        if (parameterOut)
+        {
+          parameterOut[i] = t;
+        }
+      }
+    });
+}
+
+//------------------------------------------------------------------------------
+vtkIdType AvtkKdTreePointLocator::CountPointsWithinRadius(double R, const double x[3])
+{
+  AUtils::SphereShape sphere;
+  sphere.Init(x, R);
+  return this->CountPointsInShape(sphere);
+}
+
+vtkIdType AvtkKdTreePointLocator::CountPointsWithinArea(double *area)
+{
+  AUtils::AreaShape areaShape;
+  areaShape.Init(area);
+  return this->CountPointsInShape(areaShape);
+}
+
+vtkIdType AvtkKdTreePointLocator::CountPointsWithinCuboid(double cuboid[8][3])
+{
+  AUtils::CuboidShape cuboidShape;
+  cuboidShape.Init(cuboid);
+  return this->CountPointsInShape(cuboidShape);
+}
+
+vtkIdType AvtkKdTreePointLocator::CountPointsWithinConvexPolytope(const double *planes, int numPlanes)
+{
+  AUtils::ConvexPolytopeShape polytope;
+  polytope.Init(planes, numPlanes);
+  return this->CountPointsInShape(polytope);
+}
+
+vtkIdType AvtkKdTreePointLocator::CountPointsWithinCylinder(
+    const double point[3], const double direction[3], double radius)
+{
+  AUtils::CylinderShape cylinder;
+  if (!cylinder.InitCylinder(point, direction, radius))
+  {
+    vtkErrorMacro(<< "CountPointsWithinCylinder - direction vector is zero");
+    return 0;
+  }
+  return this->CountPointsInShape(cylinder);
+}
+
+vtkIdType AvtkKdTreePointLocator::CountPointsWithinCapsule(const double p0[3], const double p1[3], double radius)
+{
+  AUtils::CylinderShape capsule;
+  capsule.InitCapsule(p0, p1, radius);
+  return this->CountPointsInShape(capsule);
+}
+
+vtkIdType AvtkKdTreePointLocator::CountPointsWithinTube(const double *points, int numPoints, double radius)
+{
+  AUtils::TubeShape tube;
+  tube.Init(points, numPoints, radius);
+  return this->CountPointsInShape(tube);
+}
+
+//------------------------------------------------------------------------------
+vtkIdType AvtkKdTreePointLocator::ComputeStatisticsWithinRadius(
+  double R, const double x[3], AUtils::PointStatistics &stats)
+{
+  AUtils::SphereShape sphere;
+  sphere.Init(x, R);
+  return this->ComputeStatisticsInShape(sphere, stats);
+}
+
+vtkIdType AvtkKdTreePointLocator::ComputeStatisticsWithinArea(double *area, AUtils::PointStatistics &stats)
+{
+  AUtils::AreaShape areaShape;
+  areaShape.Init(area);
+  return this->ComputeStatisticsInShape(areaShape, stats);
+}
+
+vtkIdType AvtkKdTreePointLocator::ComputeStatisticsWithinCuboid(
+  double cuboid[8][3], AUtils::PointStatistics &stats)
+{
+  AUtils::CuboidShape cuboidShape;
+  cuboidShape.Init(cuboid);
+  return this->ComputeStatisticsInShape(cuboidShape, stats);
+}
+
+vtkIdType AvtkKdTreePointLocator::ComputeStatisticsWithinConvexPolytope(
+  const double *planes, int numPlanes, AUtils::PointStatistics &stats)
+{
+  AUtils::ConvexPolytopeShape polytope;
+  polytope.Init(planes, numPlanes);
+  return this->ComputeStatisticsInShape(polytope, stats);
+}
+
+vtkIdType AvtkKdTreePointLocator::ComputeStatisticsWithinCylinder(
+  const double point[3], const double direction[3], double radius, AUtils::PointStatistics &stats)
+{
+  AUtils::CylinderShape cylinder;
+  if (!cylinder.InitCylinder(point, direction, radius))
+  {
+    vtkErrorMacro(<< "ComputeStatisticsWithinCylinder - direction vector is zero");
+    stats = AUtils::PointStatistics();
+    return 0;
+  }
+  return this->ComputeStatisticsInShape(cylinder, stats);
+}
+
+vtkIdType AvtkKdTreePointLocator::ComputeStatisticsWithinCapsule(
+  const double p0[3], const double p1[3], double radius, AUtils::PointStatistics &stats)
+{
+  AUtils::CylinderShape capsule;
+  capsule.InitCapsule(p0, p1, radius);
+  return this->ComputeStatisticsInShape(capsule, stats);
+}
+
+//------------------------------------------------------------------------------
+void AvtkKdTreePointLocator::UpdatePointNormals()
+{
+  if (!this->KdTree)
+  {
+    return;
+  }
+  // readers of a published snapshot may still use the shared tree
+  if (this->KdTree->GetReferenceCount() > 1)
+  {
+    this->BuildLocatorInternal();
+    return;
+  }
+  this->KdTree->UpdatePointNormals(this->GetPointNormals());
+}
+
+//------------------------------------------------------------------------------
+vtkDataArray *AvtkKdTreePointLocator::GetPointNormals()
+{
+  vtkDataArray *normals = this->DataSet ? this->DataSet->GetPointData()->GetNormals() : nullptr;
+  if (normals &&
+    (normals->GetNumberOfComponents() != 3 ||
+      normals->GetNumberOfTuples() != this->DataSet->GetNumberOfPoints()))
+  {
+    return nullptr;
+  }
+  return normals;
+}
+
+//------------------------------------------------------------------------------
+void AvtkKdTreePointLocator::FindClosestPointsBatch(
+    vtkIdType numQueries, const double *x, vtkIdTypeArray *ids, vtkDoubleArray *dist2)
+{
+  this->BuildLocator();
+  ids->SetNumberOfComponents(1);
+  ids->SetNumberOfValues(numQueries);
+  if (dist2)
+  {
+    dist2->SetNumberOfComponents(1);
+    dist2->SetNumberOfValues(numQueries);
+  }
+
+  double *d2 = dist2 ? dist2->GetPointer(0) : nullptr;
+  bool approximate = this->IsApproximate();
+  double epsilon = this->ApproximationEpsilon;
+  int maxLeaves = this->MaxNumberOfLeavesVisited;
+  bool found = this->DispatchSearchStructure(
+    [&](auto *tree)
+    {
+      if constexpr (IsUniformGrid<decltype(tree)>::value)
+      {
+        vtkIdType *out = ids->GetPointer(0);
+        vtkSMPTools::For(0, numQueries,
+          [tree, x, out, d2](vtkIdType begin, vtkIdType end)
+          {
+            for (vtkIdType q = begin; q < end; ++q)
+            {
+              double dist2;
+              out[q] = tree->FindClosestPoint(x + 3 * q, dist2);
+              if (d2)
+              {
+                d2[q] = dist2;
+              }
+            }
+          });
+      }
+      else
+      {
+        BatchClosestPoint<std::remove_pointer_t<decltype(tree)>> batch = { tree, x, ids->GetPointer(0), d2, approximate, epsilon, maxLeaves };
+        vtkSMPTools::For(0, numQueries, batch);
+      }
+    });
+  if (!found)
+  {
+    std::fill_n(ids->GetPointer(0), numQueries, vtkIdType(-1));
+    if (d2)
+    {
+      std::fill_n(d2, numQueries, VTK_DOUBLE_MAX);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void AvtkKdTreePointLocator::FindClosestNPointsBatch(vtkIdType numQueries, int N, const double *x,
+    vtkIdTypeArray *offsets, vtkIdTypeArray *ids, vtkDoubleArray *dist2)
+{
+  this->BuildLocator();
+  bool approximate = this->IsApproximate();
+  double epsilon = this->ApproximationEpsilon;
+  int maxLeaves = this->MaxNumberOfLeavesVisited;
+  bool found = this->DispatchSearchStructure(
+    [&](auto *tree)
+    {
+      RunBatchIdListQuery(
+        numQueries, x, [tree, N, approximate, epsilon, maxLeaves](const double *q, vtkIdList *result)
+        {
+          if constexpr (IsUniformGrid<decltype(tree)>::value)
+            tree->FindClosestNPoints(N, q, result);
+          else if (approximate)
+            tree->FindApproximateClosestNPoints(N, q, epsilon, maxLeaves, result);
+          else
+            tree->FindClosestNPoints(N, q, result);
+        },
+        offsets, ids);
+    });
+  if (!found)
+  {
+    ClearBatchResult(numQueries, offsets, ids);
+  }
+  if (dist2)
+  {
+    this->ComputeBatchDistances(numQueries, x, offsets, ids, dist2);
+  }
+}
+
+//------------------------------------------------------------------------------
+void AvtkKdTreePointLocator::FindPointsWithinRadiusBatch(vtkIdType numQueries, double R,
+    const double *x, vtkIdTypeArray *offsets, vtkIdTypeArray *ids, vtkDoubleArray *dist2)
+{
+  this->BuildLocator();
+  bool found = this->DispatchSearchStructure(
+    [&](auto *tree)
+    {
+      RunBatchIdListQuery(
+        numQueries, x, [tree, R](const double *q, vtkIdList *result)
+        { tree->FindPointsWithinRadius(R, q, result); },
+        offsets, ids);
+    });
+  if (!found)
+  {
+    ClearBatchResult(numQueries, offsets, ids);
+  }
+  if (dist2)
+  {
+    this->ComputeBatchDistances(numQueries, x, offsets, ids, dist2);
+  }
+}
+
+//------------------------------------------------------------------------------
+void AvtkKdTreePointLocator::FindPairsWithinRadius(
+  AvtkKdTreePointLocator *other, double R, vtkIdTypeArray *pairs, vtkDoubleArray *dist2)
+{
+  this->BuildLocator();
+  other->BuildLocator();
+  if (this->KdTree && other->KdTree)
+  {
+    this->KdTree->FindPairsWithinRadius(other->KdTree, R, pairs, dist2);
+    return;
+  }
+
+  // query other with the points of this dataset, then flatten the CSR result
+  std::vector<double> x;
+  GetDataSetPoints(this->DataSet, x);
+  vtkIdType numQueries = static_cast<vtkIdType>(x.size() / 3);
+  vtkNew<vtkIdTypeArray> offsets;
+  vtkNew<vtkIdTypeArray> ids;
+  vtkNew<vtkDoubleArray> idDist2;
+  other->FindPointsWithinRadiusBatch(numQueries, R, x.data(), offsets, ids, dist2 ? idDist2.Get() : nullptr);
+
+  vtkIdType numPairs = ids->GetNumberOfValues();
+  pairs->SetNumberOfComponents(2);
+  pairs->SetNumberOfTuples(numPairs);
+  if (dist2)
+  {
+    dist2->SetNumberOfComponents(1);
+    dist2->SetNumberOfTuples(numPairs);
+  }
+  const vtkIdType *offset = offsets->GetPointer(0);
+  vtkIdType *pairIds = pairs->GetPointer(0);
+  vtkSMPTools::For(0, numQueries,
+    [&](vtkIdType begin, vtkIdType end)
+    {
+      std::vector<std::pair<vtkIdType, double>> segment;
+      for (vtkIdType q = begin; q < end; ++q)
+      {
+        segment.clear();
+        for (vtkIdType k = offset[q]; k < offset[q + 1]; ++k)
+        {
+          segment.emplace_back(ids->GetValue(k), dist2 ? idDist2->GetValue(k) : 0.0);
+        }
+        std::sort(segment.begin(), segment.end());
+        for (size_t k = 0; k < segment.size(); ++k)
+        {
+          vtkIdType pair = offset[q] + static_cast<vtkIdType>(k);
+          pairIds[2 * pair] = q;
+          pairIds[2 * pair + 1] = segment[k].first;
+          if (dist2)
+          {
+            dist2->SetValue(pair, segment[k].second);
+          }
+        }
+      }
+    });
+}
+
+//------------------------------------------------------------------------------
+void AvtkKdTreePointLocator::FindClosestPointsInLocator(
+  AvtkKdTreePointLocator *other, vtkIdTypeArray *ids, vtkDoubleArray *dist2, double maxDistance)
+{
+  this->BuildLocator();
+  other->BuildLocator();
+  if (this->KdTree && other->KdTree)
+  {
+    this->KdTree->FindClosestPointsInTree(other->KdTree, ids, dist2, maxDistance);
+    return;
+  }
+
+  std::vector<double> x;
+  GetDataSetPoints(this->DataSet, x);
+  vtkIdType numQueries = static_cast<vtkIdType>(x.size() / 3);
+  vtkNew<vtkDoubleArray> closestDist2;
+  vtkDoubleArray *distances = dist2 ? dist2 : closestDist2.Get();
+  other->FindClosestPointsBatch(numQueries, x.data(), ids, distances);
+
+  // drop the closest points beyond maxDistance
+  const double maxDist2 = maxDistance < VTK_DOUBLE_MAX ? maxDistance * maxDistance : VTK_DOUBLE_MAX;
+  vtkIdType *closestIds = ids->GetPointer(0);
+  double *d2 = distances->GetPointer(0);
+  for (vtkIdType q = 0; q < numQueries; ++q)
+  {
+    if (closestIds[q] < 0 || d2[q] > maxDist2)
+    {
+      closestIds[q] = -1;
+      d2[q] = VTK_DOUBLE_MAX;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void AvtkKdTreePointLocator::ComputeBatchDistances(vtkIdType numQueries, const double *x,
+    vtkIdTypeArray *offsets, vtkIdTypeArray *ids, vtkDoubleArray *dist2)
+{
+  const vtkIdType *off = offsets->GetPointer(0);
+  const vtkIdType *pointIds = ids->GetPointer(0);
+  dist2->SetNumberOfComponents(1);
+  dist2->SetNumberOfValues(off[numQueries]);
+  double *out = dist2->GetPointer(0);
+  vtkDataSet *dataSet = this->DataSet;
+
+  vtkSMPTools::For(0, numQueries,
+    [&](vtkIdType begin, vtkIdType end)
+    {
+      double p[3];
+      for (vtkIdType q = begin; q < end; ++q)
+      {
+        for (vtkIdType j = off[q]; j < off[q + 1]; ++j)
+        {
+          dataSet->GetPoint(pointIds[j], p);
+          out[j] = vtkMath::Distance2BetweenPoints(x + 3 * q, p);
+        }
+      }
+    });
 }
 
 //------------------------------------------------------------------------------
@@ -73,18 +828,42 @@ void AvtkKdTreePointLocator::FreeSearchStructure()
     this->KdTree->Delete();
     this->KdTree = nullptr;
   }
+  if (this->FlatKdTree)
+  {
+    this->FlatKdTree->Delete();
+    this->FlatKdTree = nullptr;
+  }
+  if (this->IncrementalKdTree)
+  {
+    this->IncrementalKdTree->Delete();
+    this->IncrementalKdTree = nullptr;
+  }
+  if (this->UniformGrid)
+  {
+    this->UniformGrid->Delete();
+    this->UniformGrid = nullptr;
+  }
+  this->NumberOfIndexedPoints = 0;
+  this->IndexedPointData = nullptr;
 }
 
 //------------------------------------------------------------------------------
 void AvtkKdTreePointLocator::BuildLocator()
 {
   // don't rebuild if build time is newer than modified and dataset modified time
-  if (this->KdTree && this->BuildTime > this->MTime && this->BuildTime > this->DataSet->GetMTime())
+  bool hasTree = this->KdTree || this->FlatKdTree || this->IncrementalKdTree || this->UniformGrid;
+  if (hasTree && this->BuildTime > this->MTime && this->BuildTime > this->DataSet->GetMTime())
   {
     return;
   }
+  // the incremental tree only indexes the points appended since the last build
+  if (this->IncrementalKdTree && this->BuildTime > this->MTime && this->OnlyPointsAppended())
+  {
+    this->UpdateIncrementalKdTree();
+    return;
+  }
   // don't rebuild if UseExistingSearchStructure is ON and a search structure already exists
-  if (this->KdTree && this->UseExistingSearchStructure)
+  if (hasTree && this->UseExistingSearchStructure)
   {
     this->BuildTime.Modified();
     vtkDebugMacro(<< "BuildLocator exited - UseExistingSearchStructure");
@@ -102,13 +881,13 @@ void AvtkKdTreePointLocator::ForceBuildLocator()
 //------------------------------------------------------------------------------
 void AvtkKdTreePointLocator::BuildLocatorInternal()
 {
+  // a failed build leaves no search structure, the queries then return nothing
+  this->FreeSearchStructure();
   if (!this->DataSet || (this->DataSet->GetNumberOfPoints()) < 1)
   {
     vtkErrorMacro(<< "No points to build");
     return;
   }
-  // Prepare
-  this->FreeSearchStructure();
 
   vtkPointSet *pointSet = vtkPointSet::SafeDownCast(this->GetDataSet());
   if (!pointSet)
@@ -116,19 +895,343 @@ void AvtkKdTreePointLocator::BuildLocatorInternal()
     vtkErrorMacro("AvtkKdTreePointLocator requires a PointSet to build locator.");
     return;
   }
-  this->KdTree = AvtkKdTree::New();
-  this->KdTree->SetUseExistingSearchStructure(this->UseExistingSearchStructure);
-  this->KdTree->SetDataSet(pointSet);
-  this->KdTree->BuildLocatorFromPoints(pointSet);
-  this->KdTree->GetBounds(this->Bounds);
+
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  if (this->TreeType == INCREMENTAL_KD_TREE)
+  {
+    this->IncrementalKdTree = AvtkIncrementalKdTree::New();
+    this->IncrementalKdTree->SetNumberOfPointsPerLeaf(this->NumberOfPointsPerLeaf);
+    this->IncrementalKdTree->SetParallelBuild(this->ParallelBuild);
+    this->IncrementalKdTree->SetSinglePrecision(this->SinglePrecision);
+    this->IncrementalKdTree->BuildFromPoints(pointSet->GetPoints());
+    // points hidden by RemovePoint() stay hidden while the dataset is the same
+    if (this->RemovedPointsDataSet != this->DataSet)
+    {
+      this->RemovedPointIds.clear();
+      this->RemovedPointsDataSet = this->DataSet;
+    }
+    this->RemovedPointIds.erase(
+      this->RemovedPointIds.lower_bound(pointSet->GetNumberOfPoints()), this->RemovedPointIds.end());
+    for (vtkIdType id : this->RemovedPointIds)
+    {
+      this->IncrementalKdTree->RemovePoint(id);
+    }
+    this->IncrementalKdTree->GetBounds(this->Bounds);
+    this->NumberOfIndexedPoints = pointSet->GetNumberOfPoints();
+    this->IndexedPointData = pointSet->GetPoints()->GetData();
+    this->IndexedPointsMTime = pointSet->GetPoints()->GetMTime();
+  }
+  else if (this->TreeType == FLAT_KD_TREE)
+  {
+    this->FlatKdTree = AvtkFlatKdTree::New();
+    this->FlatKdTree->SetNumberOfPointsPerLeaf(this->NumberOfPointsPerLeaf);
+    this->FlatKdTree->SetParallelBuild(this->ParallelBuild);
+    this->FlatKdTree->SetSinglePrecision(this->SinglePrecision);
+    this->FlatKdTree->BuildFromPoints(pointSet->GetPoints());
+    this->FlatKdTree->GetBounds(this->Bounds);
+  }
+  else if (this->TreeType == UNIFORM_GRID)
+  {
+    this->UniformGrid = AvtkUniformGrid::New();
+    this->UniformGrid->SetCellSize(this->GridCellSize);
+    this->UniformGrid->SetNumberOfPointsPerCell(this->NumberOfPointsPerLeaf);
+    this->UniformGrid->SetParallelBuild(this->ParallelBuild);
+    this->UniformGrid->SetSinglePrecision(this->SinglePrecision);
+    this->UniformGrid->BuildFromPoints(pointSet->GetPoints());
+    this->UniformGrid->GetBounds(this->Bounds);
+  }
+  else
+  {
+    this->KdTree = AvtkKdTree::New();
+    this->KdTree->SetUseExistingSearchStructure(this->UseExistingSearchStructure);
+    this->KdTree->SetParallelBuild(this->ParallelBuild);
+    this->KdTree->SetSinglePrecision(this->SinglePrecision);
+    this->KdTree->SetDataSet(pointSet);
+    this->KdTree->BuildLocatorFromPoints(pointSet);
+    this->KdTree->GetBounds(this->Bounds);
+  }
+  timer->StopTimer();
+  this->BuildElapsedTime = timer->GetElapsedTime();
+  vtkDebugMacro(<< "Built locator in " << this->BuildElapsedTime << " s");
+  this->BuildTime.Modified();
+  if (this->Snapshot)
+  {
+    this->PublishSnapshot();
+  }
+}
+
+//------------------------------------------------------------------------------
+void AvtkKdTreePointLocator::UpdateIncrementalKdTree()
+{
+  vtkPointSet *pointSet = vtkPointSet::SafeDownCast(this->GetDataSet());
+  vtkPoints *points = pointSet ? pointSet->GetPoints() : nullptr;
+  if (!points)
+  {
+    vtkErrorMacro(<< "AvtkKdTreePointLocator requires a PointSet to update the incremental tree.");
+    return;
+  }
+  vtkIdType numPoints = points->GetNumberOfPoints();
+
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  if (numPoints > this->NumberOfIndexedPoints)
+  {
+    this->DetachIncrementalKdTree();
+    this->IncrementalKdTree->InsertPoints(points, this->NumberOfIndexedPoints, numPoints);
+    this->IncrementalKdTree->GetBounds(this->Bounds);
+  }
+  timer->StopTimer();
+  this->BuildElapsedTime = timer->GetElapsedTime();
+  vtkDebugMacro(<< "Inserted " << numPoints - this->NumberOfIndexedPoints << " points in "
+                << this->BuildElapsedTime << " s");
+  this->NumberOfIndexedPoints = numPoints;
+  this->IndexedPointsMTime = points->GetMTime();
+  this->BuildTime.Modified();
+}
+
+//------------------------------------------------------------------------------
+bool AvtkKdTreePointLocator::OnlyPointsAppended()
+{
+  vtkPointSet *pointSet = vtkPointSet::SafeDownCast(this->GetDataSet());
+  vtkPoints *points = pointSet ? pointSet->GetPoints() : nullptr;
+  if (!points || points->GetData() != this->IndexedPointData)
+  {
+    return false;
+  }
+  // a modified point array without new points can only have been edited in place
+  vtkIdType numPoints = points->GetNumberOfPoints();
+  return numPoints > this->NumberOfIndexedPoints ||
+    (numPoints == this->NumberOfIndexedPoints && points->GetMTime() == this->IndexedPointsMTime);
+}
+
+//------------------------------------------------------------------------------
+vtkTypeUInt64 AvtkKdTreePointLocator::ComputeTreeSettingsKey()
+{
+  vtkPointSet *pointSet = vtkPointSet::SafeDownCast(this->GetDataSet());
+  vtkPoints *points = pointSet ? pointSet->GetPoints() : nullptr;
+  vtkIdType numPoints = points ? points->GetNumberOfPoints() : 0;
+  int dataType = numPoints > 0 ? points->GetDataType() : VTK_DOUBLE;
+
+  // the settings that change the built tree
+  vtkTypeUInt64 settings[4] = { static_cast<vtkTypeUInt64>(dataType), static_cast<vtkTypeUInt64>(numPoints),
+    static_cast<vtkTypeUInt64>(this->NumberOfPointsPerLeaf), this->SinglePrecision ? 1u : 0u };
+  return AUtils::Checksum(settings, sizeof(settings));
+}
+
+//------------------------------------------------------------------------------
+vtkTypeUInt64 AvtkKdTreePointLocator::ComputeTreeFileKey()
+{
+  vtkPointSet *pointSet = vtkPointSet::SafeDownCast(this->GetDataSet());
+  vtkPoints *points = pointSet ? pointSet->GetPoints() : nullptr;
+  vtkIdType numPoints = points ? points->GetNumberOfPoints() : 0;
+  int dataType = numPoints > 0 ? points->GetDataType() : VTK_DOUBLE;
+
+  // the settings, then the raw coordinates
+  vtkTypeUInt64 key = this->ComputeTreeSettingsKey();
+  if (numPoints < 1)
+  {
+    return key;
+  }
+  if (dataType == VTK_FLOAT || dataType == VTK_DOUBLE)
+  {
+    size_t size = 3 * static_cast<size_t>(numPoints) * (dataType == VTK_FLOAT ? sizeof(float) : sizeof(double));
+    return AUtils::Checksum(points->GetData()->GetVoidPointer(0), size, key);
+  }
+  std::vector<double> coords(3 * numPoints);
+  for (vtkIdType i = 0; i < numPoints; ++i)
+  {
+    points->GetPoint(i, &coords[3 * i]);
+  }
+  return AUtils::Checksum(coords.data(), coords.size() * sizeof(double), key);
+}
+
+//------------------------------------------------------------------------------
+bool AvtkKdTreePointLocator::Save(const char *path)
+{
+  return this->SaveTreeFile(path, false, 0);
+}
+
+//------------------------------------------------------------------------------
+bool AvtkKdTreePointLocator::SaveWithSourceKey(const char *path, vtkTypeUInt64 sourceKey)
+{
+  return this->SaveTreeFile(path, true, sourceKey);
+}
+
+//------------------------------------------------------------------------------
+bool AvtkKdTreePointLocator::SaveTreeFile(const char *path, bool useSourceKey, vtkTypeUInt64 sourceKey)
+{
+  // Only the flat kd-tree has a file format; refuse before building anything.
+  if (this->TreeType != FLAT_KD_TREE)
+  {
+    vtkErrorMacro(<< "Save is not supported for TreeType " << TreeTypeName(this->TreeType)
+                  << "; select FLAT_KD_TREE to save the locator");
+    return false;
+  }
+  this->BuildLocator();
+  if (!this->FlatKdTree)
+  {
+    vtkErrorMacro(<< "Save requires a built FLAT_KD_TREE");
+    return false;
+  }
+  vtkTypeUInt64 key = useSourceKey
+    ? AUtils::Checksum(&sourceKey, sizeof(sourceKey), this->ComputeTreeSettingsKey())
+    : this->ComputeTreeFileKey();
+  return this->FlatKdTree->Save(path, key);
+}
+
+//------------------------------------------------------------------------------
+bool AvtkKdTreePointLocator::Load(const char *path, bool verifyChecksum)
+{
+  vtkPointSet *pointSet = vtkPointSet::SafeDownCast(this->GetDataSet());
+  if (!pointSet || pointSet->GetNumberOfPoints() < 1)
+  {
+    vtkErrorMacro(<< "Load requires a point set with points");
+    return false;
+  }
+  return this->LoadTreeFile(path, this->ComputeTreeFileKey(), verifyChecksum);
+}
+
+//------------------------------------------------------------------------------
+bool AvtkKdTreePointLocator::LoadWithSourceKey(const char *path, vtkTypeUInt64 sourceKey, bool verifyChecksum)
+{
+  vtkPointSet *pointSet = vtkPointSet::SafeDownCast(this->GetDataSet());
+  if (!pointSet || pointSet->GetNumberOfPoints() < 1)
+  {
+    vtkErrorMacro(<< "Load requires a point set with points");
+    return false;
+  }
+  return this->LoadTreeFile(
+    path, AUtils::Checksum(&sourceKey, sizeof(sourceKey), this->ComputeTreeSettingsKey()), verifyChecksum);
+}
+
+//------------------------------------------------------------------------------
+bool AvtkKdTreePointLocator::LoadTreeFile(const char *path, vtkTypeUInt64 key, bool verifyChecksum)
+{
+  vtkNew<vtkTimerLog> timer;
+  timer->StartTimer();
+  AvtkFlatKdTree *tree = AvtkFlatKdTree::New();
+  if (!tree->Load(path, key, verifyChecksum))
+  {
+    tree->Delete();
+    return false;
+  }
+
+  this->FreeSearchStructure();
+  this->SetTreeType(FLAT_KD_TREE);
+  this->FlatKdTree = tree;
+  this->FlatKdTree->GetBounds(this->Bounds);
+  timer->StopTimer();
+  this->BuildElapsedTime = timer->GetElapsedTime();
+  vtkDebugMacro(<< "Loaded locator from " << path << " in " << this->BuildElapsedTime << " s");
   this->BuildTime.Modified();
+  if (this->Snapshot)
+  {
+    this->PublishSnapshot();
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool AvtkKdTreePointLocator::RemovePoint(vtkIdType id)
+{
+  this->BuildLocator();
+  if (!this->IncrementalKdTree)
+  {
+    vtkErrorMacro(<< "RemovePoint requires TreeType INCREMENTAL_KD_TREE");
+    return false;
+  }
+  if (!this->IncrementalKdTree->HasPoint(id))
+  {
+    return false;
+  }
+  this->DetachIncrementalKdTree();
+  this->RemovedPointIds.insert(id);
+  return this->IncrementalKdTree->RemovePoint(id);
+}
+
+//------------------------------------------------------------------------------
+bool AvtkKdTreePointLocator::RestorePoint(vtkIdType id)
+{
+  this->BuildLocator();
+  if (!this->IncrementalKdTree)
+  {
+    vtkErrorMacro(<< "RestorePoint requires TreeType INCREMENTAL_KD_TREE");
+    return false;
+  }
+  if (id < 0 || id >= this->NumberOfIndexedPoints || this->IncrementalKdTree->HasPoint(id))
+  {
+    return false;
+  }
+  this->DetachIncrementalKdTree();
+  this->IncrementalKdTree->InsertPoint(id, this->DataSet->GetPoint(id));
+  this->RemovedPointIds.erase(id);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+vtkSmartPointer<AvtkPointLocatorSnapshot> AvtkKdTreePointLocator::Freeze()
+{
+  this->BuildLocator();
+  // rebuilds and detached incremental trees are new objects, so an unchanged
+  // structure is recognized by identity
+  AvtkPointLocatorSnapshot *current = this->Snapshot;
+  if (!current || current->KdTree != this->KdTree || current->FlatKdTree != this->FlatKdTree ||
+    current->IncrementalKdTree != this->IncrementalKdTree || current->UniformGrid != this->UniformGrid ||
+    current->ApproximationEpsilon != this->ApproximationEpsilon ||
+    current->MaxNumberOfLeavesVisited != this->MaxNumberOfLeavesVisited)
+  {
+    this->PublishSnapshot();
+  }
+  return this->GetSnapshot();
+}
+
+//------------------------------------------------------------------------------
+vtkSmartPointer<AvtkPointLocatorSnapshot> AvtkKdTreePointLocator::GetSnapshot()
+{
+  std::lock_guard<std::mutex> lock(this->SnapshotMutex);
+  return this->Snapshot;
+}
+
+//------------------------------------------------------------------------------
+void AvtkKdTreePointLocator::PublishSnapshot()
+{
+  auto snapshot = vtkSmartPointer<AvtkPointLocatorSnapshot>::New();
+  snapshot->KdTree = this->KdTree;
+  snapshot->FlatKdTree = this->FlatKdTree;
+  snapshot->IncrementalKdTree = this->IncrementalKdTree;
+  snapshot->UniformGrid = this->UniformGrid;
+  snapshot->TreeType = this->TreeType;
+  std::copy(this->Bounds, this->Bounds + 6, snapshot->Bounds);
+  snapshot->ApproximationEpsilon = this->ApproximationEpsilon;
+  snapshot->MaxNumberOfLeavesVisited = this->MaxNumberOfLeavesVisited;
+
+  // the previous snapshot is released outside the lock
+  std::lock_guard<std::mutex> lock(this->SnapshotMutex);
+  std::swap(this->Snapshot, snapshot);
+}
+
+//------------------------------------------------------------------------------
+void AvtkKdTreePointLocator::DetachIncrementalKdTree()
+{
+  if (!this->IncrementalKdTree || this->IncrementalKdTree->GetReferenceCount() < 2)
+  {
+    return;
+  }
+  AvtkIncrementalKdTree *copy = AvtkIncrementalKdTree::New();
+  copy->ShallowCopy(this->IncrementalKdTree);
+  this->IncrementalKdTree->Delete();
+  this->IncrementalKdTree = copy;
 }
 
 //------------------------------------------------------------------------------
 void AvtkKdTreePointLocator::GenerateRepresentation(int level, vtkPolyData *pd)
 {
   this->BuildLocator();
-  this->KdTree->GenerateRepresentation(level, pd);
+  if (!this->DispatchSearchStructure([&](auto *tree) { tree->GenerateRepresentation(level, pd); }))
+  {
+    pd->Initialize();
+  }
 }
 
 AvtkKdTree *AvtkKdTreePointLocator::GetKdTree()
@@ -136,10 +1239,38 @@ AvtkKdTree *AvtkKdTreePointLocator::GetKdTree()
   return KdTree;
 }
 
+AvtkFlatKdTree *AvtkKdTreePointLocator::GetFlatKdTree()
+{
+  return FlatKdTree;
+}
+
+AvtkIncrementalKdTree *AvtkKdTreePointLocator::GetIncrementalKdTree()
+{
+  return IncrementalKdTree;
+}
+
+AvtkUniformGrid *AvtkKdTreePointLocator::GetUniformGrid()
+{
+  return UniformGrid;
+}
+
 //------------------------------------------------------------------------------
 void AvtkKdTreePointLocator::PrintSelf(ostream &os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
 
   os << indent << "KdTree " << this->KdTree << "\n";
+  os << indent << "FlatKdTree " << this->FlatKdTree << "\n";
+  os << indent << "IncrementalKdTree " << this->IncrementalKdTree << "\n";
+  os << indent << "UniformGrid " << this->UniformGrid << "\n";
+  os << indent << "NumberOfIndexedPoints " << this->NumberOfIndexedPoints << "\n";
+  os << indent << "TreeType " << this->TreeType << "\n";
+  os << indent << "NumberOfPointsPerLeaf " << this->NumberOfPointsPerLeaf << "\n";
+  os << indent << "GridCellSize " << this->GridCellSize << "\n";
+  os << indent << "ParallelBuild " << this->ParallelBuild << "\n";
+  os << indent << "SinglePrecision " << this->SinglePrecision << "\n";
+  os << indent << "BuildElapsedTime " << this->BuildElapsedTime << "\n";
+  os << indent << "ApproximationEpsilon " << this->ApproximationEpsilon << "\n";
+  os << indent << "MaxNumberOfLeavesVisited " << this->MaxNumberOfLeavesVisited << "\n";
+  os << indent << "Snapshot " << this->Snapshot.Get() << "\n";
 }
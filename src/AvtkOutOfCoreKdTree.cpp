@@ -0,0 +1,975 @@
+#include "AvtkOutOfCoreKdTree.h"
+#include "vtkNew.h"
+#include "vtkObjectFactory.h"
+#include "vtkTimerLog.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <queue>
+
+vtkStandardNewMacro(AvtkOutOfCoreKdTree);
+
+namespace
+{
+    // 顺序读取临时点文件时每块的点数
+    const vtkIdType SpillChunkSize = 1 << 16;
+
+    // 每个页面写缓冲的最小点数
+    const size_t MinimumPageBufferSize = 64;
+
+    // 页面点数超过 NumberOfPointsPerPage 的这一倍数时再次划分，最多划分的遍数
+    const vtkIdType PageSizeLimitFactor = 2;
+    const int MaxPageSplitPasses = 4;
+
+    // 再次划分时每个预计页面的最少样本数
+    const vtkIdType MinimumSamplesPerPage = 8;
+
+    // 索引文件的格式版本，文件布局改变时递增
+    const vtkTypeUInt32 IndexFileVersion = 1;
+    const char IndexFileMagic[8] = {'A', 'O', 'C', 'T', 'R', 'E', 'E', '\0'};
+    // 按本机字节序写入，用于识别字节序不同的文件
+    const vtkTypeUInt32 IndexFileByteOrder = 0x01020304;
+
+    /**
+     * 索引文件的文件头，之后依次为顶层节点、各页面的点数与各页面文件的字节数。
+     */
+    struct IndexFileHeader
+    {
+        char Magic[8];
+        vtkTypeUInt32 Version;
+        vtkTypeUInt32 ByteOrder;
+        vtkTypeInt32 NumberOfNodes;
+        vtkTypeInt32 NumberOfPages;
+        vtkTypeInt64 NumberOfPoints;
+        vtkTypeUInt64 Key;
+        vtkTypeUInt64 Checksum; // 之后所有数组的校验值
+    };
+
+    /**
+     * 按页面写回的临时文件中的一个点。
+     */
+    struct PagePoint
+    {
+        double X[3];
+        vtkIdType Id;
+    };
+
+    bool RemoveFile(const std::string &path)
+    {
+        return std::remove(path.c_str()) == 0;
+    }
+
+    vtkTypeUInt64 GetFileSize(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        return file ? static_cast<vtkTypeUInt64>(file.tellg()) : 0;
+    }
+
+    /**
+     * 读取已有索引文件的页面数，文件不存在或不是索引文件时返回0。
+     */
+    int ReadNumberOfPages(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        IndexFileHeader header;
+        if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+            std::memcmp(header.Magic, IndexFileMagic, sizeof(header.Magic)) != 0 || header.NumberOfPages < 0)
+            return 0;
+        return header.NumberOfPages;
+    }
+}
+
+AvtkOutOfCoreKdTree::~AvtkOutOfCoreKdTree()
+{
+    this->Close();
+}
+
+std::string AvtkOutOfCoreKdTree::GetPagePath(int page) const
+{
+    return this->Path + ".page" + std::to_string(page);
+}
+
+vtkTypeUInt64 AvtkOutOfCoreKdTree::GetPageKey(int page) const
+{
+    vtkTypeInt64 value = page;
+    return AUtils::Checksum(&value, sizeof(value), this->Key);
+}
+
+void AvtkOutOfCoreKdTree::Close()
+{
+    if (this->Building)
+    {
+        this->SpillFile.close();
+        RemoveFile(this->Path + ".points.tmp");
+        this->Building = false;
+    }
+    this->ReleasePages();
+    this->Path.clear();
+    this->Key = 0;
+    this->NumberOfPoints = 0;
+    this->Nodes.clear();
+    this->PageCounts.clear();
+    this->PageSizes.clear();
+    std::vector<double>().swap(this->Sample);
+    std::lock_guard<std::mutex> lock(this->CacheMutex);
+    this->ResidentPages.clear();
+    this->PageUsagePositions.clear();
+    this->NumberOfPageLoads = 0;
+}
+
+void AvtkOutOfCoreKdTree::ReleasePages()
+{
+    std::lock_guard<std::mutex> lock(this->CacheMutex);
+    for (int page : this->PageUsage)
+    {
+        this->ResidentPages[page] = nullptr;
+    }
+    this->PageUsage.clear();
+    this->ResidentSize = 0;
+}
+
+bool AvtkOutOfCoreKdTree::BeginBuild(const char *path)
+{
+    this->Close();
+    if (!path)
+    {
+        vtkErrorMacro(<< "AvtkOutOfCoreKdTree - no path to build to");
+        return false;
+    }
+    this->Path = path;
+    std::string spillPath = this->Path + ".points.tmp";
+    this->SpillFile.open(spillPath, std::ios::binary | std::ios::trunc);
+    if (!this->SpillFile)
+    {
+        vtkErrorMacro(<< "AvtkOutOfCoreKdTree - cannot open " << spillPath << " for writing");
+        this->Path.clear();
+        return false;
+    }
+    this->Building = true;
+    this->SampleGenerator.seed(0);
+    return true;
+}
+
+bool AvtkOutOfCoreKdTree::AddPoints(const double *coords, vtkIdType numPoints)
+{
+    if (!this->Building)
+    {
+        vtkErrorMacro(<< "AvtkOutOfCoreKdTree - AddPoints called outside BeginBuild/EndBuild");
+        return false;
+    }
+    if (numPoints <= 0)
+        return true;
+
+    this->SpillFile.write(reinterpret_cast<const char *>(coords),
+                          static_cast<std::streamsize>(3 * numPoints * sizeof(double)));
+    if (!this->SpillFile)
+    {
+        vtkErrorMacro(<< "AvtkOutOfCoreKdTree - failed to write " << this->Path << ".points.tmp");
+        return false;
+    }
+
+    // 蓄水池抽样，样本与传入的分块方式无关
+    for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+        const double *p = coords + 3 * i;
+        vtkIdType id = this->NumberOfPoints + i;
+        if (id < this->SampleSize)
+        {
+            this->Sample.insert(this->Sample.end(), p, p + 3);
+            continue;
+        }
+        std::uniform_int_distribution<vtkIdType> pick(0, id);
+        vtkIdType j = pick(this->SampleGenerator);
+        if (j < this->SampleSize)
+            std::copy(p, p + 3, this->Sample.begin() + 3 * j);
+    }
+    this->NumberOfPoints += numPoints;
+    return true;
+}
+
+bool AvtkOutOfCoreKdTree::AddPoints(vtkPoints *points)
+{
+    if (!points)
+        return this->AddPoints(nullptr, 0);
+    vtkIdType numPoints = points->GetNumberOfPoints();
+    std::vector<double> coords(3 * std::min(numPoints, SpillChunkSize));
+    for (vtkIdType begin = 0; begin < numPoints; begin += SpillChunkSize)
+    {
+        vtkIdType n = std::min(SpillChunkSize, numPoints - begin);
+        for (vtkIdType i = 0; i < n; ++i)
+        {
+            points->GetPoint(begin + i, &coords[3 * i]);
+        }
+        if (!this->AddPoints(coords.data(), n))
+            return false;
+    }
+    return true;
+}
+
+template <typename F>
+bool AvtkOutOfCoreKdTree::ReadSpillFile(F &&f)
+{
+    std::ifstream file(this->Path + ".points.tmp", std::ios::binary);
+    if (!file)
+        return false;
+    std::vector<double> coords(3 * SpillChunkSize);
+    for (vtkIdType begin = 0; begin < this->NumberOfPoints; begin += SpillChunkSize)
+    {
+        vtkIdType n = std::min(SpillChunkSize, this->NumberOfPoints - begin);
+        file.read(reinterpret_cast<char *>(coords.data()), static_cast<std::streamsize>(3 * n * sizeof(double)));
+        if (!file)
+            return false;
+        f(coords.data(), begin, n);
+    }
+    return true;
+}
+
+vtkTypeInt32 AvtkOutOfCoreKdTree::BuildTopNode(vtkIdType begin, vtkIdType end, std::vector<vtkIdType> &order,
+                                               double pointsPerSample)
+{
+    TopNode node;
+    std::memset(&node, 0, sizeof(node));
+    node.Left = node.Right = node.Page = -1;
+    vtkTypeInt32 index = static_cast<vtkTypeInt32>(this->Nodes.size());
+    this->Nodes.push_back(node);
+
+    const double *sample = this->Sample.data();
+    double bounds[6] = {VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX};
+    for (vtkIdType i = begin; i < end; ++i)
+    {
+        const double *p = sample + 3 * order[i];
+        for (int k = 0; k < 3; ++k)
+        {
+            bounds[2 * k] = std::min(bounds[2 * k], p[k]);
+            bounds[2 * k + 1] = std::max(bounds[2 * k + 1], p[k]);
+        }
+    }
+    int dim = 0;
+    for (int k = 1; k < 3; ++k)
+    {
+        if (bounds[2 * k + 1] - bounds[2 * k] > bounds[2 * dim + 1] - bounds[2 * dim])
+            dim = k;
+    }
+
+    // 按样本所占的比例估计节点内的实际点数，不超过页面点数或无法再划分时成为页面
+    double estimate = static_cast<double>(end - begin) * pointsPerSample;
+    if (estimate <= static_cast<double>(this->NumberOfPointsPerPage) || end - begin < 2 ||
+        !(bounds[2 * dim + 1] > bounds[2 * dim]))
+    {
+        this->Nodes[index].Page = static_cast<vtkTypeInt32>(this->PageCounts.size());
+        this->PageCounts.push_back(0);
+        return index;
+    }
+
+    // 以样本中位数划分，坐标小于划分值的点属于左子树，与 RoutePoint 一致
+    auto coord = [sample, dim](vtkIdType i)
+    { return sample[3 * i + dim]; };
+    vtkIdType mid = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                     [&coord](vtkIdType a, vtkIdType b)
+                     { return coord(a) < coord(b); });
+    double split = coord(order[mid]);
+    auto isLeft = [&](vtkIdType i)
+    { return coord(i) < split; };
+    vtkIdType cut = std::partition(order.begin() + begin, order.begin() + end, isLeft) - order.begin();
+    if (cut == begin)
+    {
+        // 中位数等于最小值，划分值取下一个更大的坐标，左子树为所有取最小值的点
+        double next = VTK_DOUBLE_MAX;
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            if (coord(order[i]) > split)
+                next = std::min(next, coord(order[i]));
+        }
+        split = next;
+        cut = std::partition(order.begin() + begin, order.begin() + end, isLeft) - order.begin();
+    }
+
+    vtkTypeInt32 left = this->BuildTopNode(begin, cut, order, pointsPerSample);
+    vtkTypeInt32 right = this->BuildTopNode(cut, end, order, pointsPerSample);
+    TopNode &current = this->Nodes[index];
+    current.SplitDim = dim;
+    current.SplitValue = split;
+    current.Left = left;
+    current.Right = right;
+    return index;
+}
+
+vtkTypeInt32 AvtkOutOfCoreKdTree::RoutePoint(const double p[3]) const
+{
+    vtkTypeInt32 node = 0;
+    while (this->Nodes[node].Page < 0)
+    {
+        const TopNode &current = this->Nodes[node];
+        node = p[current.SplitDim] < current.SplitValue ? current.Left : current.Right;
+    }
+    return this->Nodes[node].Page;
+}
+
+void AvtkOutOfCoreKdTree::UpdateNodeBounds(vtkTypeInt32 node)
+{
+    TopNode &current = this->Nodes[node];
+    if (current.Page >= 0)
+        return;
+    this->UpdateNodeBounds(current.Left);
+    this->UpdateNodeBounds(current.Right);
+    const double *left = this->Nodes[current.Left].Bounds;
+    const double *right = this->Nodes[current.Right].Bounds;
+    for (int k = 0; k < 3; ++k)
+    {
+        current.Bounds[2 * k] = std::min(left[2 * k], right[2 * k]);
+        current.Bounds[2 * k + 1] = std::max(left[2 * k + 1], right[2 * k + 1]);
+    }
+}
+
+bool AvtkOutOfCoreKdTree::EndBuild()
+{
+    if (!this->Building)
+    {
+        vtkErrorMacro(<< "AvtkOutOfCoreKdTree - EndBuild called without BeginBuild");
+        return false;
+    }
+    this->SpillFile.close();
+    this->Building = false;
+    std::string spillPath = this->Path + ".points.tmp";
+    if (!this->SpillFile || this->NumberOfPoints == 0)
+    {
+        if (this->NumberOfPoints == 0)
+            vtkErrorMacro(<< "AvtkOutOfCoreKdTree - no points to build");
+        else
+            vtkErrorMacro(<< "AvtkOutOfCoreKdTree - failed to write " << spillPath);
+        RemoveFile(spillPath);
+        this->Close();
+        return false;
+    }
+
+    vtkNew<vtkTimerLog> timer;
+    timer->StartTimer();
+
+    // 由样本划分顶层树，每个叶子对应一个页面
+    std::vector<vtkIdType> order(this->Sample.size() / 3);
+    std::iota(order.begin(), order.end(), vtkIdType(0));
+    this->Nodes.clear();
+    this->PageCounts.clear();
+    this->BuildTopNode(0, static_cast<vtkIdType>(order.size()), order,
+                       static_cast<double>(this->NumberOfPoints) / static_cast<double>(order.size()));
+    std::vector<vtkIdType>().swap(order);
+    std::vector<double>().swap(this->Sample);
+
+    // 第一遍：各页面的点数与紧包围盒。样本的估计偏差使页面超过点数上限时，
+    // 由这些页面自己的样本再次划分并重新统计
+    std::vector<double> pageBounds;
+    bool ok = this->CountPages(pageBounds);
+    bool split = true;
+    for (int pass = 0; ok && split && pass < MaxPageSplitPasses; ++pass)
+    {
+        ok = this->SplitOversizedPages(pageBounds, split);
+        if (ok && split)
+            ok = this->CountPages(pageBounds);
+    }
+    int numPages = this->GetNumberOfPages();
+    for (auto &node : this->Nodes)
+    {
+        if (node.Page >= 0)
+            std::copy_n(&pageBounds[6 * node.Page], 6, node.Bounds);
+    }
+    this->UpdateNodeBounds(0);
+
+    // 第二遍：按页面写回，每个页面的点在临时文件中连续存放，缓冲写满后写入一次
+    std::string pagesPath = this->Path + ".pages.tmp";
+    std::vector<vtkIdType> cursors(numPages + 1, 0);
+    for (int page = 0; page < numPages; ++page)
+    {
+        cursors[page + 1] = cursors[page] + this->PageCounts[page];
+    }
+    if (ok)
+    {
+        std::ofstream pagesFile(pagesPath, std::ios::binary | std::ios::trunc);
+        size_t bufferSize = std::max(MinimumPageBufferSize,
+                                     static_cast<size_t>(this->BuildBufferSize) * 1024 / (sizeof(PagePoint) * numPages));
+        std::vector<std::vector<PagePoint>> buffers(numPages);
+        auto flush = [&](int page)
+        {
+            std::vector<PagePoint> &buffer = buffers[page];
+            pagesFile.seekp(static_cast<std::streamoff>(cursors[page] * sizeof(PagePoint)));
+            pagesFile.write(reinterpret_cast<const char *>(buffer.data()),
+                            static_cast<std::streamsize>(buffer.size() * sizeof(PagePoint)));
+            cursors[page] += static_cast<vtkIdType>(buffer.size());
+            buffer.clear();
+        };
+        ok = pagesFile && this->ReadSpillFile([&](const double *coords, vtkIdType firstId, vtkIdType n)
+                                              {
+                                                  for (vtkIdType i = 0; i < n; ++i)
+                                                  {
+                                                      const double *p = coords + 3 * i;
+                                                      int page = this->RoutePoint(p);
+                                                      std::vector<PagePoint> &buffer = buffers[page];
+                                                      if (buffer.capacity() < bufferSize)
+                                                          buffer.reserve(bufferSize);
+                                                      buffer.push_back({{p[0], p[1], p[2]}, firstId + i});
+                                                      if (buffer.size() == bufferSize)
+                                                          flush(page);
+                                                  }
+                                              });
+        for (int page = 0; ok && page < numPages; ++page)
+        {
+            if (!buffers[page].empty())
+                flush(page);
+        }
+        pagesFile.close();
+        ok = ok && pagesFile;
+    }
+    RemoveFile(spillPath);
+
+    // 页面先写入 path.page<i>.tmp，索引文件替换成功后才改为正式的文件名，
+    // 失败时已有的索引与页面保持不变
+    int previousPages = ReadNumberOfPages(this->Path);
+    if (ok)
+        ok = this->WritePages();
+    RemoveFile(pagesPath);
+    if (ok)
+        ok = this->WriteIndex();
+    if (ok)
+    {
+        for (int page = 0; page < numPages; ++page)
+        {
+            std::string pagePath = this->GetPagePath(page);
+            if (this->PageCounts[page] == 0)
+                RemoveFile(pagePath);
+            else if (!AUtils::ReplaceFile((pagePath + ".tmp").c_str(), pagePath.c_str()))
+                ok = false;
+        }
+        // 删除上一次构建多出的页面
+        for (int page = numPages; RemoveFile(this->GetPagePath(page)) || page < previousPages; ++page)
+            ;
+    }
+    if (!ok)
+    {
+        for (int page = 0; page < numPages; ++page)
+            RemoveFile(this->GetPagePath(page) + ".tmp");
+        vtkErrorMacro(<< "AvtkOutOfCoreKdTree - failed to build " << this->Path);
+        this->Close();
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->CacheMutex);
+        this->ResidentPages.assign(numPages, nullptr);
+        this->PageUsagePositions.assign(numPages, this->PageUsage.end());
+    }
+    timer->StopTimer();
+    vtkDebugMacro(<< "Built out-of-core kd-tree with " << this->NumberOfPoints << " points in " << numPages
+                  << " pages in " << timer->GetElapsedTime() << " s");
+    this->Modified();
+    return true;
+}
+
+bool AvtkOutOfCoreKdTree::CountPages(std::vector<double> &pageBounds)
+{
+    int numPages = this->GetNumberOfPages();
+    this->PageCounts.assign(numPages, 0);
+    pageBounds.resize(6 * numPages);
+    for (int page = 0; page < numPages; ++page)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            pageBounds[6 * page + 2 * k] = VTK_DOUBLE_MAX;
+            pageBounds[6 * page + 2 * k + 1] = -VTK_DOUBLE_MAX;
+        }
+    }
+    return this->ReadSpillFile([&](const double *coords, vtkIdType, vtkIdType n)
+                               {
+                                   for (vtkIdType i = 0; i < n; ++i)
+                                   {
+                                       const double *p = coords + 3 * i;
+                                       vtkTypeInt32 page = this->RoutePoint(p);
+                                       ++this->PageCounts[page];
+                                       double *bounds = &pageBounds[6 * page];
+                                       for (int k = 0; k < 3; ++k)
+                                       {
+                                           bounds[2 * k] = std::min(bounds[2 * k], p[k]);
+                                           bounds[2 * k + 1] = std::max(bounds[2 * k + 1], p[k]);
+                                       }
+                                   }
+                               });
+}
+
+bool AvtkOutOfCoreKdTree::SplitOversizedPages(const std::vector<double> &pageBounds, bool &split)
+{
+    // 超过上限且点不全部重合的页面才能再划分
+    int numPages = this->GetNumberOfPages();
+    vtkIdType maxCount = PageSizeLimitFactor * this->NumberOfPointsPerPage;
+    std::vector<int> slots(numPages, -1);
+    std::vector<int> oversized;
+    for (int page = 0; page < numPages; ++page)
+    {
+        const double *bounds = &pageBounds[6 * page];
+        if (this->PageCounts[page] > maxCount &&
+            (bounds[1] > bounds[0] || bounds[3] > bounds[2] || bounds[5] > bounds[4]))
+        {
+            slots[page] = static_cast<int>(oversized.size());
+            oversized.push_back(page);
+        }
+    }
+    split = !oversized.empty();
+    if (!split)
+        return true;
+
+    // 再读一遍临时文件，对每个超限页面的点分别做蓄水池抽样：平分 SampleSize，
+    // 且每个预计划分出的页面至少有 MinimumSamplesPerPage 个样本
+    vtkIdType share = this->SampleSize / static_cast<vtkIdType>(oversized.size());
+    std::vector<vtkIdType> quotas(oversized.size());
+    for (size_t slot = 0; slot < oversized.size(); ++slot)
+    {
+        vtkIdType pieces = this->PageCounts[oversized[slot]] / this->NumberOfPointsPerPage + 1;
+        quotas[slot] = std::max(share, MinimumSamplesPerPage * pieces);
+    }
+    std::vector<std::vector<double>> samples(oversized.size());
+    std::vector<vtkIdType> seen(oversized.size(), 0);
+    this->SampleGenerator.seed(static_cast<std::mt19937_64::result_type>(numPages));
+    bool ok = this->ReadSpillFile([&](const double *coords, vtkIdType, vtkIdType n)
+                                  {
+                                      for (vtkIdType i = 0; i < n; ++i)
+                                      {
+                                          const double *p = coords + 3 * i;
+                                          int slot = slots[this->RoutePoint(p)];
+                                          if (slot < 0)
+                                              continue;
+                                          std::vector<double> &sample = samples[slot];
+                                          vtkIdType id = seen[slot]++;
+                                          vtkIdType quota = quotas[slot];
+                                          if (id < quota)
+                                          {
+                                              sample.insert(sample.end(), p, p + 3);
+                                              continue;
+                                          }
+                                          std::uniform_int_distribution<vtkIdType> pick(0, id);
+                                          vtkIdType j = pick(this->SampleGenerator);
+                                          if (j < quota)
+                                              std::copy(p, p + 3, sample.begin() + 3 * j);
+                                      }
+                                  });
+    if (!ok)
+        return false;
+
+    // 以新的子树替换页面的叶子，子树根节点的内容拷贝到原叶子的位置
+    std::vector<vtkTypeInt32> leaves(numPages, -1);
+    for (size_t node = 0; node < this->Nodes.size(); ++node)
+    {
+        if (this->Nodes[node].Page >= 0)
+            leaves[this->Nodes[node].Page] = static_cast<vtkTypeInt32>(node);
+    }
+    for (size_t slot = 0; slot < oversized.size(); ++slot)
+    {
+        int page = oversized[slot];
+        this->Sample.swap(samples[slot]);
+        std::vector<double>().swap(samples[slot]);
+        std::vector<vtkIdType> order(this->Sample.size() / 3);
+        std::iota(order.begin(), order.end(), vtkIdType(0));
+        vtkTypeInt32 root = this->BuildTopNode(0, static_cast<vtkIdType>(order.size()), order,
+                                               static_cast<double>(this->PageCounts[page]) /
+                                                   static_cast<double>(order.size()));
+        this->Nodes[leaves[page]] = this->Nodes[root];
+        std::vector<double>().swap(this->Sample);
+    }
+    this->RenumberPages();
+    return true;
+}
+
+void AvtkOutOfCoreKdTree::RenumberPages()
+{
+    // 按深度优先顺序重新存放节点并为叶子编号，去掉被替换的子树根节点
+    std::vector<TopNode> nodes;
+    nodes.reserve(this->Nodes.size());
+    int numPages = 0;
+    std::function<vtkTypeInt32(vtkTypeInt32)> copyNode = [&](vtkTypeInt32 node) -> vtkTypeInt32
+    {
+        vtkTypeInt32 index = static_cast<vtkTypeInt32>(nodes.size());
+        nodes.push_back(this->Nodes[node]);
+        if (this->Nodes[node].Page >= 0)
+        {
+            nodes[index].Page = numPages++;
+            return index;
+        }
+        vtkTypeInt32 left = copyNode(this->Nodes[node].Left);
+        vtkTypeInt32 right = copyNode(this->Nodes[node].Right);
+        nodes[index].Left = left;
+        nodes[index].Right = right;
+        return index;
+    };
+    copyNode(0);
+    this->Nodes.swap(nodes);
+    this->PageCounts.assign(numPages, 0);
+}
+
+bool AvtkOutOfCoreKdTree::WritePages()
+{
+    int numPages = this->GetNumberOfPages();
+
+    // 顶层树确定后即可计算本次构建的key
+    this->Key = AUtils::Checksum(this->Nodes.data(), this->Nodes.size() * sizeof(TopNode),
+                                 AUtils::Checksum(this->PageCounts.data(), this->PageCounts.size() * sizeof(vtkIdType)));
+    this->PageSizes.assign(numPages, 0);
+
+    std::ifstream pagesFile(this->Path + ".pages.tmp", std::ios::binary);
+    if (!pagesFile)
+        return false;
+    std::vector<PagePoint> points;
+    std::vector<double> coords;
+    std::vector<vtkIdType> ids;
+    for (int page = 0; page < numPages; ++page)
+    {
+        // 页面在临时文件中按顺序连续存放，逐页读取，同一时刻只有一个页面在内存中
+        vtkIdType n = this->PageCounts[page];
+        if (n == 0)
+            continue;
+        points.resize(n);
+        pagesFile.read(reinterpret_cast<char *>(points.data()), static_cast<std::streamsize>(n * sizeof(PagePoint)));
+        if (!pagesFile)
+            return false;
+        coords.resize(3 * n);
+        ids.resize(n);
+        for (vtkIdType i = 0; i < n; ++i)
+        {
+            std::copy_n(points[i].X, 3, &coords[3 * i]);
+            ids[i] = points[i].Id;
+        }
+
+        vtkNew<AvtkFlatKdTree> tree;
+        tree->SetNumberOfPointsPerLeaf(this->NumberOfPointsPerLeaf);
+        tree->SetSinglePrecision(this->SinglePrecision);
+        tree->SetParallelBuild(1);
+        tree->BuildFromPoints(coords, ids);
+        std::string pagePath = this->GetPagePath(page) + ".tmp";
+        if (!tree->Save(pagePath.c_str(), this->GetPageKey(page)))
+            return false;
+        this->PageSizes[page] = GetFileSize(pagePath);
+    }
+    return true;
+}
+
+bool AvtkOutOfCoreKdTree::WriteIndex()
+{
+    IndexFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.Magic, IndexFileMagic, sizeof(header.Magic));
+    header.Version = IndexFileVersion;
+    header.ByteOrder = IndexFileByteOrder;
+    header.NumberOfNodes = static_cast<vtkTypeInt32>(this->Nodes.size());
+    header.NumberOfPages = this->GetNumberOfPages();
+    header.NumberOfPoints = this->NumberOfPoints;
+    header.Key = this->Key;
+    size_t nodesSize = this->Nodes.size() * sizeof(TopNode);
+    size_t countsSize = this->PageCounts.size() * sizeof(vtkIdType);
+    size_t sizesSize = this->PageSizes.size() * sizeof(vtkTypeUInt64);
+    header.Checksum = AUtils::Checksum(this->Nodes.data(), nodesSize);
+    header.Checksum = AUtils::Checksum(this->PageCounts.data(), countsSize, header.Checksum);
+    header.Checksum = AUtils::Checksum(this->PageSizes.data(), sizesSize, header.Checksum);
+
+    std::string tmpPath = this->Path + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(this->Nodes.data()), static_cast<std::streamsize>(nodesSize));
+        file.write(reinterpret_cast<const char *>(this->PageCounts.data()), static_cast<std::streamsize>(countsSize));
+        file.write(reinterpret_cast<const char *>(this->PageSizes.data()), static_cast<std::streamsize>(sizesSize));
+        file.close();
+        if (!file)
+        {
+            RemoveFile(tmpPath);
+            return false;
+        }
+    }
+    if (!AUtils::ReplaceFile(tmpPath.c_str(), this->Path.c_str()))
+    {
+        RemoveFile(tmpPath);
+        return false;
+    }
+    return true;
+}
+
+bool AvtkOutOfCoreKdTree::Open(const char *path)
+{
+    this->Close();
+    if (!path)
+        return false;
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        vtkDebugMacro(<< "Cannot open out-of-core kd-tree index " << path);
+        return false;
+    }
+    vtkTypeUInt64 fileSize = static_cast<vtkTypeUInt64>(file.tellg());
+    file.seekg(0);
+
+    IndexFileHeader header;
+    if (fileSize < sizeof(header) || !file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.Magic, IndexFileMagic, sizeof(header.Magic)) != 0)
+    {
+        vtkErrorMacro(<< "AvtkOutOfCoreKdTree - " << path << " is not an out-of-core kd-tree index");
+        return false;
+    }
+    if (header.Version != IndexFileVersion || header.ByteOrder != IndexFileByteOrder)
+    {
+        vtkErrorMacro(<< "AvtkOutOfCoreKdTree - " << path << " was written by an incompatible version or platform");
+        return false;
+    }
+
+    // 页面数为节点数的一半加一，文件大小必须与文件头一致
+    bool valid = header.NumberOfNodes > 0 && header.NumberOfPages == header.NumberOfNodes / 2 + 1 &&
+                 header.NumberOfPoints > 0;
+    size_t nodesSize = static_cast<size_t>(header.NumberOfNodes) * sizeof(TopNode);
+    size_t countsSize = static_cast<size_t>(header.NumberOfPages) * sizeof(vtkIdType);
+    size_t sizesSize = static_cast<size_t>(header.NumberOfPages) * sizeof(vtkTypeUInt64);
+    valid = valid && fileSize == sizeof(header) + nodesSize + countsSize + sizesSize;
+    if (valid)
+    {
+        this->Nodes.resize(header.NumberOfNodes);
+        this->PageCounts.resize(header.NumberOfPages);
+        this->PageSizes.resize(header.NumberOfPages);
+        file.read(reinterpret_cast<char *>(this->Nodes.data()), static_cast<std::streamsize>(nodesSize));
+        file.read(reinterpret_cast<char *>(this->PageCounts.data()), static_cast<std::streamsize>(countsSize));
+        file.read(reinterpret_cast<char *>(this->PageSizes.data()), static_cast<std::streamsize>(sizesSize));
+        valid = static_cast<bool>(file);
+    }
+    if (valid)
+    {
+        vtkTypeUInt64 checksum = AUtils::Checksum(this->Nodes.data(), nodesSize);
+        checksum = AUtils::Checksum(this->PageCounts.data(), countsSize, checksum);
+        checksum = AUtils::Checksum(this->PageSizes.data(), sizesSize, checksum);
+        valid = checksum == header.Checksum;
+    }
+    // 子节点与页面的下标必须在范围内，遍历时不再检查
+    for (size_t i = 0; valid && i < this->Nodes.size(); ++i)
+    {
+        const TopNode &node = this->Nodes[i];
+        if (node.Page >= 0)
+            valid = node.Page < header.NumberOfPages && node.Left < 0 && node.Right < 0;
+        else
+            valid = node.Left > static_cast<vtkTypeInt32>(i) && node.Left < header.NumberOfNodes &&
+                    node.Right > static_cast<vtkTypeInt32>(i) && node.Right < header.NumberOfNodes &&
+                    node.SplitDim >= 0 && node.SplitDim < 3;
+    }
+    if (!valid)
+    {
+        this->Nodes.clear();
+        this->PageCounts.clear();
+        this->PageSizes.clear();
+        vtkErrorMacro(<< "AvtkOutOfCoreKdTree - " << path << " is truncated or corrupt");
+        return false;
+    }
+
+    this->Path = path;
+    this->Key = header.Key;
+    this->NumberOfPoints = header.NumberOfPoints;
+    {
+        std::lock_guard<std::mutex> lock(this->CacheMutex);
+        this->ResidentPages.assign(header.NumberOfPages, nullptr);
+        this->PageUsagePositions.assign(header.NumberOfPages, this->PageUsage.end());
+    }
+    this->Modified();
+    return true;
+}
+
+vtkSmartPointer<AvtkFlatKdTree> AvtkOutOfCoreKdTree::GetPage(int page) const
+{
+    if (page < 0 || page >= this->GetNumberOfPages() || this->PageCounts[page] == 0)
+        return nullptr;
+    {
+        std::lock_guard<std::mutex> lock(this->CacheMutex);
+        if (this->ResidentPages[page])
+        {
+            this->PageUsage.splice(this->PageUsage.begin(), this->PageUsage, this->PageUsagePositions[page]);
+            return this->ResidentPages[page];
+        }
+    }
+
+    // 在锁外映射文件，其它线程可以同时使用已加载的页面
+    auto tree = vtkSmartPointer<AvtkFlatKdTree>::New();
+    std::string pagePath = this->GetPagePath(page);
+    if (!tree->Load(pagePath.c_str(), this->GetPageKey(page)))
+    {
+        vtkErrorMacro(<< "AvtkOutOfCoreKdTree - cannot load page " << pagePath);
+        return nullptr;
+    }
+    ++this->NumberOfPageLoads;
+
+    std::lock_guard<std::mutex> lock(this->CacheMutex);
+    if (this->ResidentPages[page])
+    {
+        // 其它线程已加载同一页面
+        this->PageUsage.splice(this->PageUsage.begin(), this->PageUsage, this->PageUsagePositions[page]);
+        return this->ResidentPages[page];
+    }
+    this->ResidentPages[page] = tree;
+    this->PageUsage.push_front(page);
+    this->PageUsagePositions[page] = this->PageUsage.begin();
+    this->ResidentSize += this->PageSizes[page];
+    this->EvictPages(page);
+    return tree;
+}
+
+void AvtkOutOfCoreKdTree::EvictPages(int keep) const
+{
+    vtkTypeUInt64 budget = static_cast<vtkTypeUInt64>(this->PageCacheSize) * 1024;
+    while (this->ResidentSize > budget && this->PageUsage.size() > 1)
+    {
+        int victim = this->PageUsage.back();
+        if (victim == keep)
+            break;
+        this->PageUsage.pop_back();
+        this->PageUsagePositions[victim] = this->PageUsage.end();
+        this->ResidentSize -= this->PageSizes[victim];
+        // 正在查询中的页面由查询持有的引用保持映射，引用释放后解除映射
+        this->ResidentPages[victim] = nullptr;
+    }
+}
+
+int AvtkOutOfCoreKdTree::GetNumberOfResidentPages() const
+{
+    std::lock_guard<std::mutex> lock(this->CacheMutex);
+    return static_cast<int>(this->PageUsage.size());
+}
+
+unsigned long AvtkOutOfCoreKdTree::GetResidentMemorySize() const
+{
+    std::lock_guard<std::mutex> lock(this->CacheMutex);
+    return static_cast<unsigned long>(this->ResidentSize / 1024);
+}
+
+void AvtkOutOfCoreKdTree::GetBounds(double bounds[6]) const
+{
+    if (this->Nodes.empty())
+    {
+        std::fill_n(bounds, 6, 0.0);
+        return;
+    }
+    std::copy_n(this->Nodes[0].Bounds, 6, bounds);
+}
+
+void AvtkOutOfCoreKdTree::SearchClosestPoints(const double x[3], size_t N,
+                                              std::vector<std::pair<double, vtkIdType>> &heap) const
+{
+    if (N == 0 || this->Nodes.empty())
+        return;
+
+    // 按包围盒距离从近到远访问顶层节点，距离超过当前第N近距离时结束，之后的页面不会加载
+    using Entry = std::pair<double, vtkTypeInt32>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    queue.emplace(AUtils::BoundsDistance2(this->Nodes[0].Bounds, x), 0);
+    while (!queue.empty())
+    {
+        Entry entry = queue.top();
+        if (heap.size() == N && entry.first > heap.front().first)
+            break;
+        queue.pop();
+        const TopNode &node = this->Nodes[entry.second];
+        if (node.Page >= 0)
+        {
+            vtkSmartPointer<AvtkFlatKdTree> page = this->GetPage(node.Page);
+            if (page)
+                page->SearchClosestPoints(x, N, heap);
+            continue;
+        }
+        queue.emplace(AUtils::BoundsDistance2(this->Nodes[node.Left].Bounds, x), node.Left);
+        queue.emplace(AUtils::BoundsDistance2(this->Nodes[node.Right].Bounds, x), node.Right);
+    }
+}
+
+vtkIdType AvtkOutOfCoreKdTree::FindClosestPoint(const double x[3], double &dist2) const
+{
+    std::vector<std::pair<double, vtkIdType>> heap;
+    this->SearchClosestPoints(x, 1, heap);
+    if (heap.empty())
+    {
+        dist2 = VTK_DOUBLE_MAX;
+        return -1;
+    }
+    dist2 = heap.front().first;
+    return heap.front().second;
+}
+
+vtkIdType AvtkOutOfCoreKdTree::FindClosestPointWithinRadius(double radius, const double x[3], double &dist2) const
+{
+    // 以 R² 作为初始上界，包围盒在半径之外的页面不会加载。
+    // 哨兵略大于 R²，恰好位于半径上的点仍能替换它
+    std::vector<std::pair<double, vtkIdType>> heap(1, {std::nextafter(radius * radius, VTK_DOUBLE_MAX), -1});
+    this->SearchClosestPoints(x, 1, heap);
+    if (heap.front().second < 0)
+    {
+        dist2 = VTK_DOUBLE_MAX;
+        return -1;
+    }
+    dist2 = heap.front().first;
+    return heap.front().second;
+}
+
+void AvtkOutOfCoreKdTree::FindClosestNPoints(int N, const double x[3], vtkIdList *result) const
+{
+    result->Reset();
+    if (N <= 0 || this->NumberOfPoints == 0)
+        return;
+
+    size_t maxCount = std::min(static_cast<size_t>(N), static_cast<size_t>(this->NumberOfPoints));
+    std::vector<std::pair<double, vtkIdType>> heap;
+    heap.reserve(maxCount);
+    this->SearchClosestPoints(x, maxCount, heap);
+
+    std::sort_heap(heap.begin(), heap.end());
+    result->SetNumberOfIds(static_cast<vtkIdType>(heap.size()));
+    for (size_t i = 0; i < heap.size(); ++i)
+    {
+        result->SetId(static_cast<vtkIdType>(i), heap[i].second);
+    }
+}
+
+template <typename Shape>
+void AvtkOutOfCoreKdTree::FindPointsInShape(const Shape &shape, vtkIdList *ids) const
+{
+    ids->Reset();
+    this->VisitPointsInShape(shape, [ids](const vtkIdType *segment, vtkIdType n)
+                             { AUtils::AppendIds(ids, segment, n); });
+}
+
+void AvtkOutOfCoreKdTree::FindPointsWithinRadius(double R, const double x[3], vtkIdList *result) const
+{
+    AUtils::SphereShape sphere;
+    sphere.Init(x, R);
+    this->FindPointsInShape(sphere, result);
+}
+
+void AvtkOutOfCoreKdTree::FindPointsInArea(const double area[6], vtkIdList *ids) const
+{
+    AUtils::AreaShape areaShape;
+    areaShape.Init(area);
+    this->FindPointsInShape(areaShape, ids);
+}
+
+void AvtkOutOfCoreKdTree::FindPointsInCuboid(const double cuboid[8][3], vtkIdList *ids) const
+{
+    AUtils::CuboidShape cuboidShape;
+    cuboidShape.Init(cuboid);
+    this->FindPointsInShape(cuboidShape, ids);
+}
+
+void AvtkOutOfCoreKdTree::PrintSelf(ostream &os, vtkIndent indent)
+{
+    this->Superclass::PrintSelf(os, indent);
+    os << indent << "Path: " << this->Path << "\n";
+    os << indent << "NumberOfPoints: " << this->NumberOfPoints << "\n";
+    os << indent << "NumberOfPages: " << this->GetNumberOfPages() << "\n";
+    os << indent << "NumberOfPointsPerPage: " << this->NumberOfPointsPerPage << "\n";
+    os << indent << "NumberOfPointsPerLeaf: " << this->NumberOfPointsPerLeaf << "\n";
+    os << indent << "SampleSize: " << this->SampleSize << "\n";
+    os << indent << "SinglePrecision: " << this->SinglePrecision << "\n";
+    os << indent << "PageCacheSize: " << this->PageCacheSize << "\n";
+    os << indent << "BuildBufferSize: " << this->BuildBufferSize << "\n";
+    os << indent << "ResidentPages: " << this->GetNumberOfResidentPages() << "\n";
+    os << indent << "PageLoads: " << this->GetNumberOfPageLoads() << "\n";
+}
@@ -0,0 +1,224 @@
+#include "AvtkPointLocatorSnapshot.h"
+
+#include "vtkIdList.h"
+#include "vtkObjectFactory.h"
+
+#include <algorithm>
+
+//------------------------------------------------------------------------------
+vtkStandardNewMacro(AvtkPointLocatorSnapshot);
+
+namespace
+{
+//------------------------------------------------------------------------------
+template <typename Shape>
+void FindPointsInShape(const AvtkPointLocatorSnapshot *snapshot, const Shape &shape, vtkIdList *result)
+{
+  result->Reset();
+  snapshot->VisitPointsInShape(
+    shape, [result](const vtkIdType *ids, vtkIdType n) { AUtils::AppendIds(result, ids, n); });
+}
+}
+
+//------------------------------------------------------------------------------
+void AvtkPointLocatorSnapshot::GetBounds(double bounds[6]) const
+{
+  std::copy(this->Bounds, this->Bounds + 6, bounds);
+}
+
+//------------------------------------------------------------------------------
+vtkIdType AvtkPointLocatorSnapshot::FindClosestPoint(const double x[3]) const
+{
+  double dist2;
+  return this->FindClosestPoint(x, dist2);
+}
+
+//------------------------------------------------------------------------------
+vtkIdType AvtkPointLocatorSnapshot::FindClosestPoint(const double x[3], double &dist2) const
+{
+  double epsilon = this->ApproximationEpsilon;
+  int maxLeaves = this->MaxNumberOfLeavesVisited;
+  bool approximate = this->IsApproximate();
+  dist2 = VTK_DOUBLE_MAX;
+  if (this->IncrementalKdTree)
+  {
+    return approximate
+      ? this->IncrementalKdTree->FindApproximateClosestPoint(x, epsilon, maxLeaves, dist2)
+      : this->IncrementalKdTree->FindClosestPoint(x, dist2);
+  }
+  if (this->FlatKdTree)
+  {
+    return approximate ? this->FlatKdTree->FindApproximateClosestPoint(x, epsilon, maxLeaves, dist2)
+                       : this->FlatKdTree->FindClosestPoint(x, dist2);
+  }
+  if (this->UniformGrid)
+  {
+    // the grid search is always exact
+    return this->UniformGrid->FindClosestPoint(x, dist2);
+  }
+  if (this->KdTree)
+  {
+    return approximate ? this->KdTree->FindApproximateClosestPoint(x, epsilon, maxLeaves, dist2)
+                       : this->KdTree->FindClosestPoint(x[0], x[1], x[2], dist2);
+  }
+  return -1;
+}
+
+//------------------------------------------------------------------------------
+vtkIdType AvtkPointLocatorSnapshot::FindClosestPointWithinRadius(
+  double radius, const double x[3], double &dist2) const
+{
+  dist2 = VTK_DOUBLE_MAX;
+  if (this->IncrementalKdTree)
+  {
+    return this->IncrementalKdTree->FindClosestPointWithinRadius(radius, x, dist2);
+  }
+  if (this->FlatKdTree)
+  {
+    return this->FlatKdTree->FindClosestPointWithinRadius(radius, x, dist2);
+  }
+  if (this->UniformGrid)
+  {
+    return this->UniformGrid->FindClosestPointWithinRadius(radius, x, dist2);
+  }
+  if (this->KdTree)
+  {
+    return this->KdTree->FindClosestPointWithinRadius(radius, x, dist2);
+  }
+  return -1;
+}
+
+//------------------------------------------------------------------------------
+void AvtkPointLocatorSnapshot::FindClosestNPoints(int N, const double x[3], vtkIdList *result) const
+{
+  double epsilon = this->ApproximationEpsilon;
+  int maxLeaves = this->MaxNumberOfLeavesVisited;
+  bool approximate = this->IsApproximate();
+  if (this->IncrementalKdTree)
+  {
+    if (approximate)
+    {
+      this->IncrementalKdTree->FindApproximateClosestNPoints(N, x, epsilon, maxLeaves, result);
+    }
+    else
+    {
+      this->IncrementalKdTree->FindClosestNPoints(N, x, result);
+    }
+  }
+  else if (this->FlatKdTree)
+  {
+    if (approximate)
+    {
+      this->FlatKdTree->FindApproximateClosestNPoints(N, x, epsilon, maxLeaves, result);
+    }
+    else
+    {
+      this->FlatKdTree->FindClosestNPoints(N, x, result);
+    }
+  }
+  else if (this->UniformGrid)
+  {
+    this->UniformGrid->FindClosestNPoints(N, x, result);
+  }
+  else if (this->KdTree)
+  {
+    if (approximate)
+    {
+      this->KdTree->FindApproximateClosestNPoints(N, x, epsilon, maxLeaves, result);
+    }
+    else
+    {
+      this->KdTree->FindClosestNPoints(N, x, result);
+    }
+  }
+  else
+  {
+    result->Reset();
+  }
+}
+
+//------------------------------------------------------------------------------
+void AvtkPointLocatorSnapshot::FindPointsWithinRadius(double R, const double x[3], vtkIdList *result) const
+{
+  AUtils::SphereShape sphere;
+  sphere.Init(x, R);
+  FindPointsInShape(this, sphere, result);
+}
+
+//------------------------------------------------------------------------------
+void AvtkPointLocatorSnapshot::FindPointsWithinArea(const double area[6], vtkIdList *result) const
+{
+  AUtils::AreaShape areaShape;
+  areaShape.Init(area);
+  FindPointsInShape(this, areaShape, result);
+}
+
+//------------------------------------------------------------------------------
+void AvtkPointLocatorSnapshot::FindPointsWithinCuboid(const double cuboid[8][3], vtkIdList *result) const
+{
+  AUtils::CuboidShape cuboidShape;
+  cuboidShape.Init(cuboid);
+  FindPointsInShape(this, cuboidShape, result);
+}
+
+//------------------------------------------------------------------------------
+void AvtkPointLocatorSnapshot::FindPointsWithinConvexPolytope(
+  const double *planes, int numPlanes, vtkIdList *result) const
+{
+  AUtils::ConvexPolytopeShape polytope;
+  polytope.Init(planes, numPlanes);
+  FindPointsInShape(this, polytope, result);
+}
+
+//------------------------------------------------------------------------------
+void AvtkPointLocatorSnapshot::FindPointsWithinCylinder(
+  const double point[3], const double direction[3], double radius, vtkIdList *result) const
+{
+  AUtils::CylinderShape cylinder;
+  if (!cylinder.InitCylinder(point, direction, radius))
+  {
+    result->Reset();
+    return;
+  }
+  FindPointsInShape(this, cylinder, result);
+}
+
+//------------------------------------------------------------------------------
+void AvtkPointLocatorSnapshot::FindPointsWithinCapsule(
+  const double p0[3], const double p1[3], double radius, vtkIdList *result) const
+{
+  AUtils::CylinderShape capsule;
+  capsule.InitCapsule(p0, p1, radius);
+  FindPointsInShape(this, capsule, result);
+}
+
+//------------------------------------------------------------------------------
+void AvtkPointLocatorSnapshot::FindPointsWithinTube(
+  const double *points, int numPoints, double radius, vtkIdList *result) const
+{
+  AUtils::TubeShape tube;
+  tube.Init(points, numPoints, radius);
+  FindPointsInShape(this, tube, result);
+}
+
+//------------------------------------------------------------------------------
+vtkIdType AvtkPointLocatorSnapshot::CountPointsWithinRadius(double R, const double x[3]) const
+{
+  AUtils::SphereShape sphere;
+  sphere.Init(x, R);
+  return this->CountPointsInShape(sphere);
+}
+
+//------------------------------------------------------------------------------
+void AvtkPointLocatorSnapshot::PrintSelf(ostream &os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+
+  os << indent << "KdTree " << this->KdTree.Get() << "\n";
+  os << indent << "FlatKdTree " << this->FlatKdTree.Get() << "\n";
+  os << indent << "IncrementalKdTree " << this->IncrementalKdTree.Get() << "\n";
+  os << indent << "UniformGrid " << this->UniformGrid.Get() << "\n";
+  os << indent << "TreeType " << this->TreeType << "\n";
+  os << indent << "ApproximationEpsilon " << this->ApproximationEpsilon << "\n";
+  os << indent << "MaxNumberOfLeavesVisited " << this->MaxNumberOfLeavesVisited << "\n";
+}
@@ -0,0 +1,1166 @@
+#include "AvtkTriangleBVH.h"
+#include "MappedFile.h"
+#include "vtkObjectFactory.h"
+#include "vtkCellArray.h"
+#include "vtkDataArray.h"
+#include "vtkFloatArray.h"
+#include "vtkMath.h"
+#include "vtkNew.h"
+#include "vtkPointData.h"
+#include "vtkPoints.h"
+#include "vtkSMPTools.h"
+#include "vtkTimerLog.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+
+vtkStandardNewMacro(AvtkTriangleBVH);
+
+namespace
+{
+    // 查询时的遍历栈深度，中位数划分的树深度不超过 log2(三角形数) + 1
+    const int MaxTraversalDepth = 128;
+
+    inline double BoxDistance2(const double bounds[6], const double x[3])
+    {
+        double d2 = 0.0;
+        for (int i = 0; i < 3; ++i)
+        {
+            double d = std::max({bounds[2 * i] - x[i], 0.0, x[i] - bounds[2 * i + 1]});
+            d2 += d * d;
+        }
+        return d2;
+    }
+
+    /**
+     * 射线进入包围盒时的参数，射线与包围盒在 [0, maxDistance] 内不相交时返回false。
+     * invDirection 为方向分量的倒数，分量为0时只检查起点是否在该方向的范围内。
+     */
+    inline bool RayBoxEntry(const double bounds[6], const double origin[3], const double direction[3],
+                            const double invDirection[3], double maxDistance, double &entry)
+    {
+        double tMin = 0.0;
+        double tMax = maxDistance;
+        for (int i = 0; i < 3; ++i)
+        {
+            if (direction[i] == 0.0)
+            {
+                if (origin[i] < bounds[2 * i] || origin[i] > bounds[2 * i + 1])
+                    return false;
+                continue;
+            }
+            double t0 = (bounds[2 * i] - origin[i]) * invDirection[i];
+            double t1 = (bounds[2 * i + 1] - origin[i]) * invDirection[i];
+            if (t0 > t1)
+                std::swap(t0, t1);
+            tMin = std::max(tMin, t0);
+            tMax = std::min(tMax, t1);
+            if (tMin > tMax)
+                return false;
+        }
+        entry = tMin;
+        return true;
+    }
+
+    /**
+     * 单位化射线方向并计算各分量的倒数，方向为0时返回false。
+     */
+    inline bool PrepareRay(const double direction[3], double unit[3], double invDirection[3])
+    {
+        std::copy_n(direction, 3, unit);
+        if (vtkMath::Normalize(unit) == 0.0)
+            return false;
+        for (int i = 0; i < 3; ++i)
+        {
+            invDirection[i] = unit[i] != 0.0 ? 1.0 / unit[i] : 0.0;
+        }
+        return true;
+    }
+
+    /**
+     * 点到线段 ab 的最近点参数，t 在 [0, 1] 内。
+     */
+    inline double ClosestSegmentParameter(const double a[3], const double b[3], const double x[3])
+    {
+        double ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        double ax[3] = {x[0] - a[0], x[1] - a[1], x[2] - a[2]};
+        double len2 = vtkMath::Dot(ab, ab);
+        if (len2 <= 0.0)
+            return 0.0;
+        return std::min(std::max(vtkMath::Dot(ab, ax) / len2, 0.0), 1.0);
+    }
+
+    /**
+     * 顶点 a 处由 b、c 张成的夹角。
+     */
+    inline double CornerAngle(const double a[3], const double b[3], const double c[3])
+    {
+        double u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        double v[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        double cross[3];
+        vtkMath::Cross(u, v, cross);
+        return std::atan2(vtkMath::Norm(cross), vtkMath::Dot(u, v));
+    }
+
+    // BVH文件的格式版本，文件布局改变时递增
+    const vtkTypeUInt32 BVHFileVersion = 2;
+    const char BVHFileMagic[8] = {'A', 'B', 'V', 'H', 'T', 'R', 'E', 'E'};
+    // 按本机字节序写入，用于识别字节序不同的文件
+    const vtkTypeUInt32 BVHFileByteOrder = 0x01020304;
+
+    /**
+     * BVH文件的文件头，之后依次为节点、点坐标、三角形的点序号与边序号、单元id、面法向量、点与边的伪法向量，
+     * 数组之间没有填充。
+     */
+    struct BVHFileHeader
+    {
+        char Magic[8];
+        vtkTypeUInt32 Version;
+        vtkTypeUInt32 ByteOrder;
+        vtkTypeUInt32 IdTypeSize;
+        vtkTypeUInt32 NodeSize;
+        vtkTypeInt32 NumberOfTrianglesPerLeaf;
+        vtkTypeInt32 Reserved;
+        vtkTypeInt64 NumberOfNodes;
+        vtkTypeInt64 NumberOfTriangles;
+        vtkTypeInt64 NumberOfPoints;
+        vtkTypeInt64 NumberOfEdges;
+        vtkTypeUInt64 Key;      // 调用方给出的数据标识
+        vtkTypeUInt64 Checksum; // 所有数组的校验值
+    };
+}
+
+void AvtkTriangleBVH::Initialize()
+{
+    this->Nodes.clear();
+    this->Points.clear();
+    this->TrianglePoints.clear();
+    this->TriangleEdges.clear();
+    this->CellIds.clear();
+    this->FaceNormals.clear();
+    this->PointNormals.clear();
+    this->EdgeNormals.clear();
+}
+
+void AvtkTriangleBVH::BuildFromPolyData(vtkPolyData *polyData)
+{
+    vtkNew<vtkTimerLog> timer;
+    timer->StartTimer();
+
+    this->Initialize();
+    vtkPoints *points = polyData ? polyData->GetPoints() : nullptr;
+    vtkCellArray *polys = polyData ? polyData->GetPolys() : nullptr;
+    if (!points || !polys || polys->GetNumberOfCells() < 1)
+    {
+        vtkDebugMacro(<< "AvtkTriangleBVH - no triangles to build");
+        this->Modified();
+        return;
+    }
+
+    // 多边形单元的id排在顶点与线单元之后
+    vtkIdType cellOffset = polyData->GetNumberOfVerts() + polyData->GetNumberOfLines();
+    std::vector<vtkIdType> pointIds;
+    std::vector<vtkIdType> cellIds;
+    for (vtkIdType c = 0; c < polys->GetNumberOfCells(); ++c)
+    {
+        vtkIdType npts;
+        const vtkIdType *pts;
+        polys->GetCellAtId(c, npts, pts);
+        if (npts != 3)
+            continue;
+        pointIds.insert(pointIds.end(), pts, pts + 3);
+        cellIds.push_back(cellOffset + c);
+    }
+    vtkIdType numTriangles = static_cast<vtkIdType>(cellIds.size());
+    if (numTriangles < 1)
+    {
+        vtkDebugMacro(<< "AvtkTriangleBVH - no triangles to build");
+        this->Modified();
+        return;
+    }
+    // 点与边的序号为32位
+    if (numTriangles > VTK_TYPE_INT32_MAX / 3)
+    {
+        vtkErrorMacro(<< "AvtkTriangleBVH - too many triangles: " << numTriangles);
+        this->Modified();
+        return;
+    }
+
+    // 按重心递归构建，三角形按节点顺序重排
+    std::vector<double> centroids(3 * numTriangles);
+    std::vector<double> triangleBounds(6 * numTriangles);
+    vtkSMPTools::For(0, numTriangles, [&](vtkIdType begin, vtkIdType end)
+                     {
+                         for (vtkIdType t = begin; t < end; ++t)
+                         {
+                             double v[3][3];
+                             for (int k = 0; k < 3; ++k)
+                             {
+                                 points->GetPoint(pointIds[3 * t + k], v[k]);
+                             }
+                             for (int i = 0; i < 3; ++i)
+                             {
+                                 centroids[3 * t + i] = (v[0][i] + v[1][i] + v[2][i]) / 3.0;
+                                 triangleBounds[6 * t + 2 * i] = std::min({v[0][i], v[1][i], v[2][i]});
+                                 triangleBounds[6 * t + 2 * i + 1] = std::max({v[0][i], v[1][i], v[2][i]});
+                             }
+                         }
+                     });
+    std::vector<vtkIdType> order(numTriangles);
+    for (vtkIdType t = 0; t < numTriangles; ++t)
+    {
+        order[t] = t;
+    }
+    this->Nodes.reserve(2 * (numTriangles / this->NumberOfTrianglesPerLeaf + 1));
+    this->BuildNode(0, numTriangles, order, centroids, triangleBounds);
+    // 叶子可能少于 NumberOfTrianglesPerLeaf 个三角形，节点数超过预留时按倍数增长，这里释放多余的容量
+    this->Nodes.shrink_to_fit();
+
+    // 点按重排后的三角形中首次出现的顺序编号，同一叶子的三角形引用的点在内存中相邻
+    std::vector<vtkTypeInt32> pointIndex(points->GetNumberOfPoints(), -1);
+    std::vector<vtkIdType> usedPointIds;
+    this->TrianglePoints.resize(3 * numTriangles);
+    this->CellIds.resize(numTriangles);
+    for (vtkIdType t = 0; t < numTriangles; ++t)
+    {
+        vtkIdType src = order[t];
+        for (int k = 0; k < 3; ++k)
+        {
+            vtkIdType id = pointIds[3 * src + k];
+            if (pointIndex[id] < 0)
+            {
+                pointIndex[id] = static_cast<vtkTypeInt32>(usedPointIds.size());
+                usedPointIds.push_back(id);
+            }
+            this->TrianglePoints[3 * t + k] = pointIndex[id];
+        }
+        this->CellIds[t] = cellIds[src];
+    }
+    vtkIdType numPoints = static_cast<vtkIdType>(usedPointIds.size());
+    this->Points.resize(3 * numPoints);
+    vtkSMPTools::For(0, numPoints, [&](vtkIdType begin, vtkIdType end)
+                     {
+                         for (vtkIdType p = begin; p < end; ++p)
+                         {
+                             points->GetPoint(usedPointIds[p], &this->Points[3 * p]);
+                         }
+                     });
+
+    // 有点法向量时，面的朝向与顶点法向量一致
+    std::vector<double> orientation(numTriangles, 1.0);
+    vtkDataArray *normals = polyData->GetPointData() ? polyData->GetPointData()->GetNormals() : nullptr;
+    if (normals && normals->GetNumberOfTuples() == points->GetNumberOfPoints())
+    {
+        for (vtkIdType t = 0; t < numTriangles; ++t)
+        {
+            const double *v0 = &this->Points[3 * this->TrianglePoints[3 * t]];
+            const double *v1 = &this->Points[3 * this->TrianglePoints[3 * t + 1]];
+            const double *v2 = &this->Points[3 * this->TrianglePoints[3 * t + 2]];
+            double u1[3] = {v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2]};
+            double u2[3] = {v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2]};
+            double faceNormal[3];
+            vtkMath::Cross(u1, u2, faceNormal);
+            double sum[3] = {0.0, 0.0, 0.0};
+            for (int k = 0; k < 3; ++k)
+            {
+                double n[3];
+                normals->GetTuple(pointIds[3 * order[t] + k], n);
+                sum[0] += n[0];
+                sum[1] += n[1];
+                sum[2] += n[2];
+            }
+            if (vtkMath::Dot(sum, faceNormal) < 0.0)
+                orientation[t] = -1.0;
+        }
+    }
+    this->ComputePseudoNormals(orientation);
+
+    timer->StopTimer();
+    this->BuildElapsedTime = timer->GetElapsedTime();
+    vtkDebugMacro(<< "Built triangle BVH with " << numTriangles << " triangles in " << this->BuildElapsedTime << " s");
+    this->Modified();
+}
+
+void AvtkTriangleBVH::ComputePseudoNormals(const std::vector<double> &orientation)
+{
+    vtkIdType numTriangles = static_cast<vtkIdType>(this->CellIds.size());
+    vtkIdType numPoints = static_cast<vtkIdType>(this->Points.size() / 3);
+    this->FaceNormals.resize(3 * numTriangles);
+    std::vector<double> pointNormals(3 * numPoints, 0.0);
+
+    // 面法向量，按 orientation 定向，退化三角形为0；
+    // 顶点伪法向量：相邻面法向量按该顶点处的顶角加权求和
+    for (vtkIdType t = 0; t < numTriangles; ++t)
+    {
+        const vtkTypeInt32 *ids = &this->TrianglePoints[3 * t];
+        const double *v[3] = {&this->Points[3 * ids[0]], &this->Points[3 * ids[1]], &this->Points[3 * ids[2]]};
+        double u[3] = {v[1][0] - v[0][0], v[1][1] - v[0][1], v[1][2] - v[0][2]};
+        double w[3] = {v[2][0] - v[0][0], v[2][1] - v[0][1], v[2][2] - v[0][2]};
+        double *n = &this->FaceNormals[3 * t];
+        vtkMath::Cross(u, w, n);
+        vtkMath::Normalize(n);
+        vtkMath::MultiplyScalar(n, orientation[t]);
+        for (int k = 0; k < 3; ++k)
+        {
+            double angle = CornerAngle(v[k], v[(k + 1) % 3], v[(k + 2) % 3]);
+            double *vertexNormal = &pointNormals[3 * ids[k]];
+            for (int i = 0; i < 3; ++i)
+            {
+                vertexNormal[i] += angle * n[i];
+            }
+        }
+    }
+
+    // 伪法向量只用于判断符号，单精度存储
+    this->PointNormals.assign(pointNormals.begin(), pointNormals.end());
+
+    // 边伪法向量：共享该边的所有面的法向量之和。边以 (较小点序号, 较大点序号) 为键排序后分组，
+    // 每组编一个序号，组内的三角形边都引用它
+    std::vector<std::pair<vtkTypeUInt64, vtkTypeInt32>> edges(3 * numTriangles);
+    for (vtkIdType t = 0; t < numTriangles; ++t)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            vtkTypeUInt64 a = static_cast<vtkTypeUInt64>(this->TrianglePoints[3 * t + k]);
+            vtkTypeUInt64 b = static_cast<vtkTypeUInt64>(this->TrianglePoints[3 * t + (k + 1) % 3]);
+            edges[3 * t + k] = {(std::min(a, b) << 32) | std::max(a, b), static_cast<vtkTypeInt32>(3 * t + k)};
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    this->TriangleEdges.resize(3 * numTriangles);
+    this->EdgeNormals.clear();
+    for (size_t first = 0; first < edges.size();)
+    {
+        size_t last = first + 1;
+        while (last < edges.size() && edges[last].first == edges[first].first)
+        {
+            ++last;
+        }
+        vtkTypeInt32 edge = static_cast<vtkTypeInt32>(this->EdgeNormals.size() / 3);
+        double sum[3] = {0.0, 0.0, 0.0};
+        for (size_t e = first; e < last; ++e)
+        {
+            const double *n = &this->FaceNormals[3 * (edges[e].second / 3)];
+            sum[0] += n[0];
+            sum[1] += n[1];
+            sum[2] += n[2];
+            this->TriangleEdges[edges[e].second] = edge;
+        }
+        for (int i = 0; i < 3; ++i)
+        {
+            this->EdgeNormals.push_back(static_cast<float>(sum[i]));
+        }
+        first = last;
+    }
+    this->EdgeNormals.shrink_to_fit();
+}
+
+void AvtkTriangleBVH::BuildNode(vtkIdType begin, vtkIdType end, std::vector<vtkIdType> &order,
+                                const std::vector<double> &centroids, const std::vector<double> &triangleBounds)
+{
+    vtkIdType index = static_cast<vtkIdType>(this->Nodes.size());
+    this->Nodes.emplace_back();
+    Node &node = this->Nodes.back();
+    double centroidBounds[6] = {VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX,
+                                -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX};
+    std::copy_n(centroidBounds, 6, node.Bounds);
+    for (vtkIdType i = begin; i < end; ++i)
+    {
+        const double *b = &triangleBounds[6 * order[i]];
+        const double *c = &centroids[3 * order[i]];
+        for (int k = 0; k < 3; ++k)
+        {
+            node.Bounds[2 * k] = std::min(node.Bounds[2 * k], b[2 * k]);
+            node.Bounds[2 * k + 1] = std::max(node.Bounds[2 * k + 1], b[2 * k + 1]);
+            centroidBounds[2 * k] = std::min(centroidBounds[2 * k], c[k]);
+            centroidBounds[2 * k + 1] = std::max(centroidBounds[2 * k + 1], c[k]);
+        }
+    }
+
+    if (end - begin <= this->NumberOfTrianglesPerLeaf)
+    {
+        node.First = begin;
+        node.Right = -1;
+        node.Count = static_cast<int>(end - begin);
+        return;
+    }
+
+    // 在重心包围盒最长的方向上按中位数划分
+    int axis = 0;
+    for (int k = 1; k < 3; ++k)
+    {
+        if (centroidBounds[2 * k + 1] - centroidBounds[2 * k] > centroidBounds[2 * axis + 1] - centroidBounds[2 * axis])
+            axis = k;
+    }
+    vtkIdType mid = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                     [&centroids, axis](vtkIdType a, vtkIdType b)
+                     { return centroids[3 * a + axis] < centroids[3 * b + axis]; });
+    node.First = index + 1;
+    node.Count = 0;
+
+    // 递归时 Nodes 可能重新分配，之后通过下标访问节点
+    this->BuildNode(begin, mid, order, centroids, triangleBounds);
+    vtkIdType right = static_cast<vtkIdType>(this->Nodes.size());
+    this->BuildNode(mid, end, order, centroids, triangleBounds);
+    this->Nodes[index].Right = right;
+}
+
+double AvtkTriangleBVH::ClosestPointOnTriangle(vtkIdType t, const double x[3], double closest[3], double bary[3],
+                                               int &feature) const
+{
+    const vtkTypeInt32 *ids = &this->TrianglePoints[3 * t];
+    const double *a = &this->Points[3 * ids[0]];
+    const double *b = &this->Points[3 * ids[1]];
+    const double *c = &this->Points[3 * ids[2]];
+    double ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    double ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    double ap[3] = {x[0] - a[0], x[1] - a[1], x[2] - a[2]};
+    double bp[3] = {x[0] - b[0], x[1] - b[1], x[2] - b[2]};
+    double cp[3] = {x[0] - c[0], x[1] - c[1], x[2] - c[2]};
+
+    // 按 Voronoi 区域依次判断最近点所在的特征
+    double d1 = vtkMath::Dot(ab, ap);
+    double d2 = vtkMath::Dot(ac, ap);
+    double d3 = vtkMath::Dot(ab, bp);
+    double d4 = vtkMath::Dot(ac, bp);
+    double d5 = vtkMath::Dot(ab, cp);
+    double d6 = vtkMath::Dot(ac, cp);
+    double vc = d1 * d4 - d3 * d2;
+    double vb = d5 * d2 - d1 * d6;
+    double va = d3 * d6 - d5 * d4;
+    double u = 1.0, v = 0.0, w = 0.0;
+    if (d1 <= 0.0 && d2 <= 0.0)
+    {
+        feature = 0;
+    }
+    else if (d3 >= 0.0 && d4 <= d3)
+    {
+        feature = 1;
+        u = 0.0;
+        v = 1.0;
+    }
+    else if (d6 >= 0.0 && d5 <= d6)
+    {
+        feature = 2;
+        u = 0.0;
+        w = 1.0;
+    }
+    else if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+    {
+        feature = 3;
+        v = d1 / (d1 - d3);
+        u = 1.0 - v;
+    }
+    else if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0)
+    {
+        feature = 4;
+        w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        u = 0.0;
+        v = 1.0 - w;
+    }
+    else if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+    {
+        feature = 5;
+        w = d2 / (d2 - d6);
+        u = 1.0 - w;
+    }
+    else if (va + vb + vc > 0.0)
+    {
+        feature = 6;
+        v = vb / (va + vb + vc);
+        w = vc / (va + vb + vc);
+        u = 1.0 - v - w;
+    }
+    else
+    {
+        // 退化三角形，取三条边上的最近点
+        const double *corners[3] = {a, b, c};
+        double best = VTK_DOUBLE_MAX;
+        for (int k = 0; k < 3; ++k)
+        {
+            const double *p = corners[k];
+            const double *q = corners[(k + 1) % 3];
+            double s = ClosestSegmentParameter(p, q, x);
+            double y[3] = {p[0] + s * (q[0] - p[0]), p[1] + s * (q[1] - p[1]), p[2] + s * (q[2] - p[2])};
+            double dist2 = vtkMath::Distance2BetweenPoints(x, y);
+            if (dist2 < best)
+            {
+                best = dist2;
+                double weights[3] = {0.0, 0.0, 0.0};
+                weights[k] = 1.0 - s;
+                weights[(k + 1) % 3] = s;
+                u = weights[0];
+                v = weights[1];
+                w = weights[2];
+                feature = 3 + k;
+            }
+        }
+    }
+
+    for (int i = 0; i < 3; ++i)
+    {
+        closest[i] = u * a[i] + v * b[i] + w * c[i];
+    }
+    bary[0] = u;
+    bary[1] = v;
+    bary[2] = w;
+    return vtkMath::Distance2BetweenPoints(x, closest);
+}
+
+vtkIdType AvtkTriangleBVH::SearchClosestPoint(const double x[3], vtkIdType seed, AUtils::SurfacePoint &result) const
+{
+    result.CellId = -1;
+    result.Distance = VTK_DOUBLE_MAX;
+    if (this->Nodes.empty())
+        return -1;
+
+    double best = VTK_DOUBLE_MAX;
+    vtkIdType bestTriangle = -1;
+    int bestFeature = 6;
+    // 先求到种子三角形的距离，作为遍历的初始上界
+    if (seed >= 0)
+    {
+        best = this->ClosestPointOnTriangle(seed, x, result.Point, result.Barycentric, bestFeature);
+        bestTriangle = seed;
+    }
+
+    // 深度优先遍历，先访问较近的子节点
+    vtkIdType stack[MaxTraversalDepth];
+    double stackDist2[MaxTraversalDepth];
+    int top = 0;
+    stack[top] = 0;
+    stackDist2[top++] = BoxDistance2(this->Nodes[0].Bounds, x);
+    while (top > 0)
+    {
+        --top;
+        if (stackDist2[top] >= best)
+            continue;
+        const Node &node = this->Nodes[stack[top]];
+        if (node.Count > 0)
+        {
+            for (vtkIdType t = node.First; t < node.First + node.Count; ++t)
+            {
+                double closest[3], bary[3];
+                int feature;
+                double dist2 = this->ClosestPointOnTriangle(t, x, closest, bary, feature);
+                if (dist2 < best)
+                {
+                    best = dist2;
+                    bestTriangle = t;
+                    bestFeature = feature;
+                    std::copy_n(closest, 3, result.Point);
+                    std::copy_n(bary, 3, result.Barycentric);
+                }
+            }
+            continue;
+        }
+
+        vtkIdType near = node.First;
+        vtkIdType far = node.Right;
+        double nearDist2 = BoxDistance2(this->Nodes[near].Bounds, x);
+        double farDist2 = BoxDistance2(this->Nodes[far].Bounds, x);
+        if (farDist2 < nearDist2)
+        {
+            std::swap(near, far);
+            std::swap(nearDist2, farDist2);
+        }
+        if (farDist2 < best)
+        {
+            stack[top] = far;
+            stackDist2[top++] = farDist2;
+        }
+        if (nearDist2 < best)
+        {
+            stack[top] = near;
+            stackDist2[top++] = nearDist2;
+        }
+    }
+
+    // 符号由最近特征的伪法向量决定
+    double normal[3];
+    if (bestFeature < 3)
+        std::copy_n(&this->PointNormals[3 * this->TrianglePoints[3 * bestTriangle + bestFeature]], 3, normal);
+    else if (bestFeature < 6)
+        std::copy_n(&this->EdgeNormals[3 * this->TriangleEdges[3 * bestTriangle + bestFeature - 3]], 3, normal);
+    else
+        std::copy_n(&this->FaceNormals[3 * bestTriangle], 3, normal);
+    double diff[3] = {x[0] - result.Point[0], x[1] - result.Point[1], x[2] - result.Point[2]};
+    double distance = std::sqrt(best);
+    result.Distance = vtkMath::Dot(diff, normal) < 0.0 ? -distance : distance;
+    result.CellId = this->CellIds[bestTriangle];
+    return bestTriangle;
+}
+
+bool AvtkTriangleBVH::FindClosestPoint(const double x[3], AUtils::SurfacePoint &result) const
+{
+    return this->SearchClosestPoint(x, -1, result) >= 0;
+}
+
+double AvtkTriangleBVH::GetSignedDistance(const double x[3]) const
+{
+    AUtils::SurfacePoint result;
+    this->FindClosestPoint(x, result);
+    return result.Distance;
+}
+
+void AvtkTriangleBVH::FindClosestPointsBatch(vtkIdType numQueries, const double *x, vtkDoubleArray *distances,
+                                             vtkIdTypeArray *cellIds, vtkDoubleArray *closestPoints,
+                                             vtkDoubleArray *barycentrics) const
+{
+    distances->SetNumberOfComponents(1);
+    distances->SetNumberOfValues(numQueries);
+    if (cellIds)
+    {
+        cellIds->SetNumberOfComponents(1);
+        cellIds->SetNumberOfValues(numQueries);
+    }
+    if (closestPoints)
+    {
+        closestPoints->SetNumberOfComponents(3);
+        closestPoints->SetNumberOfTuples(numQueries);
+    }
+    if (barycentrics)
+    {
+        barycentrics->SetNumberOfComponents(3);
+        barycentrics->SetNumberOfTuples(numQueries);
+    }
+
+    double *dist = distances->GetPointer(0);
+    vtkIdType *ids = cellIds ? cellIds->GetPointer(0) : nullptr;
+    double *points = closestPoints ? closestPoints->GetPointer(0) : nullptr;
+    double *bary = barycentrics ? barycentrics->GetPointer(0) : nullptr;
+    vtkSMPTools::For(0, numQueries, [&](vtkIdType begin, vtkIdType end)
+                     {
+                         AUtils::SurfacePoint result;
+                         for (vtkIdType q = begin; q < end; ++q)
+                         {
+                             this->FindClosestPoint(x + 3 * q, result);
+                             dist[q] = result.Distance;
+                             if (ids)
+                                 ids[q] = result.CellId;
+                             if (points)
+                                 std::copy_n(result.Point, 3, points + 3 * q);
+                             if (bary)
+                                 std::copy_n(result.Barycentric, 3, bary + 3 * q);
+                         }
+                     });
+}
+
+bool AvtkTriangleBVH::IntersectTriangle(vtkIdType t, const double origin[3], const double direction[3],
+                                        double &distance, double &u, double &v) const
+{
+    // Moller-Trumbore
+    const vtkTypeInt32 *ids = &this->TrianglePoints[3 * t];
+    const double *a = &this->Points[3 * ids[0]];
+    const double *b = &this->Points[3 * ids[1]];
+    const double *c = &this->Points[3 * ids[2]];
+    double e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    double e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    double p[3];
+    vtkMath::Cross(direction, e2, p);
+    double det = vtkMath::Dot(e1, p);
+    // 射线与三角形平行或三角形退化
+    if (det == 0.0)
+        return false;
+    double invDet = 1.0 / det;
+    double s[3] = {origin[0] - a[0], origin[1] - a[1], origin[2] - a[2]};
+    u = vtkMath::Dot(s, p) * invDet;
+    if (u < 0.0 || u > 1.0)
+        return false;
+    double q[3];
+    vtkMath::Cross(s, e1, q);
+    v = vtkMath::Dot(direction, q) * invDet;
+    if (v < 0.0 || u + v > 1.0)
+        return false;
+    distance = vtkMath::Dot(e2, q) * invDet;
+    return distance >= 0.0;
+}
+
+void AvtkTriangleBVH::FillRayHit(vtkIdType t, const double origin[3], const double direction[3], double distance,
+                                 double u, double v, AUtils::RayHit &hit) const
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        hit.Point[i] = origin[i] + distance * direction[i];
+    }
+    hit.Distance = distance;
+    std::copy_n(&this->FaceNormals[3 * t], 3, hit.Normal);
+    hit.Barycentric[0] = 1.0 - u - v;
+    hit.Barycentric[1] = u;
+    hit.Barycentric[2] = v;
+    hit.CellId = this->CellIds[t];
+}
+
+bool AvtkTriangleBVH::IntersectRay(const double origin[3], const double direction[3], AUtils::RayHit &hit,
+                                   double maxDistance) const
+{
+    hit.CellId = -1;
+    hit.Distance = VTK_DOUBLE_MAX;
+    double unit[3], invDirection[3], entry;
+    if (this->Nodes.empty() || !PrepareRay(direction, unit, invDirection) ||
+        !RayBoxEntry(this->Nodes[0].Bounds, origin, unit, invDirection, maxDistance, entry))
+        return false;
+
+    double best = maxDistance;
+    vtkIdType bestTriangle = -1;
+    double bestU = 0.0, bestV = 0.0;
+
+    // 深度优先遍历，先访问射线先进入的子节点
+    vtkIdType stack[MaxTraversalDepth];
+    double stackEntry[MaxTraversalDepth];
+    int top = 0;
+    stack[top] = 0;
+    stackEntry[top++] = entry;
+    while (top > 0)
+    {
+        --top;
+        if (stackEntry[top] > best)
+            continue;
+        const Node &node = this->Nodes[stack[top]];
+        if (node.Count > 0)
+        {
+            for (vtkIdType t = node.First; t < node.First + node.Count; ++t)
+            {
+                double distance, u, v;
+                if (this->IntersectTriangle(t, origin, unit, distance, u, v) && distance <= best)
+                {
+                    best = distance;
+                    bestTriangle = t;
+                    bestU = u;
+                    bestV = v;
+                }
+            }
+            continue;
+        }
+
+        vtkIdType near = node.First;
+        vtkIdType far = node.Right;
+        double nearEntry, farEntry;
+        bool hitNear = RayBoxEntry(this->Nodes[near].Bounds, origin, unit, invDirection, best, nearEntry);
+        bool hitFar = RayBoxEntry(this->Nodes[far].Bounds, origin, unit, invDirection, best, farEntry);
+        if (hitNear && hitFar && farEntry < nearEntry)
+        {
+            std::swap(near, far);
+            std::swap(nearEntry, farEntry);
+        }
+        else if (!hitNear)
+        {
+            std::swap(near, far);
+            std::swap(nearEntry, farEntry);
+            std::swap(hitNear, hitFar);
+        }
+        if (hitFar)
+        {
+            stack[top] = far;
+            stackEntry[top++] = farEntry;
+        }
+        if (hitNear)
+        {
+            stack[top] = near;
+            stackEntry[top++] = nearEntry;
+        }
+    }
+
+    if (bestTriangle < 0)
+        return false;
+    this->FillRayHit(bestTriangle, origin, unit, best, bestU, bestV, hit);
+    return true;
+}
+
+int AvtkTriangleBVH::IntersectRayAll(const double origin[3], const double direction[3],
+                                     std::vector<AUtils::RayHit> &hits, double maxDistance) const
+{
+    hits.clear();
+    double unit[3], invDirection[3], entry;
+    if (this->Nodes.empty() || !PrepareRay(direction, unit, invDirection))
+        return 0;
+
+    vtkIdType stack[MaxTraversalDepth];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const Node &node = this->Nodes[stack[--top]];
+        if (!RayBoxEntry(node.Bounds, origin, unit, invDirection, maxDistance, entry))
+            continue;
+        if (node.Count > 0)
+        {
+            for (vtkIdType t = node.First; t < node.First + node.Count; ++t)
+            {
+                double distance, u, v;
+                if (this->IntersectTriangle(t, origin, unit, distance, u, v) && distance <= maxDistance)
+                {
+                    hits.emplace_back();
+                    this->FillRayHit(t, origin, unit, distance, u, v, hits.back());
+                }
+            }
+            continue;
+        }
+        stack[top++] = node.Right;
+        stack[top++] = node.First;
+    }
+
+    std::sort(hits.begin(), hits.end(), [](const AUtils::RayHit &a, const AUtils::RayHit &b)
+              { return a.Distance < b.Distance; });
+    return static_cast<int>(hits.size());
+}
+
+void AvtkTriangleBVH::IntersectRays(vtkIdType numRays, const double *origins, const double *directions,
+                                    vtkDoubleArray *distances, vtkIdTypeArray *cellIds, vtkDoubleArray *points,
+                                    double maxDistance) const
+{
+    distances->SetNumberOfComponents(1);
+    distances->SetNumberOfValues(numRays);
+    if (cellIds)
+    {
+        cellIds->SetNumberOfComponents(1);
+        cellIds->SetNumberOfValues(numRays);
+    }
+    if (points)
+    {
+        points->SetNumberOfComponents(3);
+        points->SetNumberOfTuples(numRays);
+    }
+
+    double *dist = distances->GetPointer(0);
+    vtkIdType *ids = cellIds ? cellIds->GetPointer(0) : nullptr;
+    double *hitPoints = points ? points->GetPointer(0) : nullptr;
+    vtkSMPTools::For(0, numRays, [&](vtkIdType begin, vtkIdType end)
+                     {
+                         AUtils::RayHit hit;
+                         for (vtkIdType r = begin; r < end; ++r)
+                         {
+                             const double *origin = origins + 3 * r;
+                             bool found = this->IntersectRay(origin, directions + 3 * r, hit, maxDistance);
+                             dist[r] = hit.Distance;
+                             if (ids)
+                                 ids[r] = hit.CellId;
+                             if (hitPoints)
+                                 std::copy_n(found ? hit.Point : origin, 3, hitPoints + 3 * r);
+                         }
+                     });
+}
+
+template <typename T>
+void AvtkTriangleBVH::ComputeDistanceLine(const double start[3], double step, int count, double maxDistance,
+                                          T *values) const
+{
+    // 最近一次精确求出的距离与最近三角形，当前点与该点相距 (i - exactIndex) * step
+    double exactDistance = 0.0;
+    int exactIndex = -1;
+    vtkIdType triangle = -1;
+    AUtils::SurfacePoint result;
+    for (int i = 0; i < count; ++i)
+    {
+        double x[3] = {start[0] + i * step, start[1], start[2]};
+        // 距离是1-Lipschitz的，若仍在窄带外则符号与上一个精确距离相同
+        if (maxDistance > 0.0 && exactIndex >= 0 &&
+            std::abs(exactDistance) - (i - exactIndex) * step >= maxDistance)
+        {
+            values[i] = static_cast<T>(exactDistance < 0.0 ? -maxDistance : maxDistance);
+            continue;
+        }
+        // 相邻采样点的最近三角形通常相同或相邻，以上一个最近三角形为种子可以剪掉大部分节点
+        triangle = this->SearchClosestPoint(x, triangle, result);
+        exactDistance = result.Distance;
+        exactIndex = i;
+        double value = exactDistance;
+        if (maxDistance > 0.0)
+            value = std::min(std::max(value, -maxDistance), maxDistance);
+        values[i] = static_cast<T>(value);
+    }
+}
+
+void AvtkTriangleBVH::ComputeDistanceField(const double bounds[6], const int dims[3], double maxDistance,
+                                           int scalarType, vtkImageData *field) const
+{
+    if (dims[0] < 1 || dims[1] < 1 || dims[2] < 1)
+    {
+        vtkErrorMacro(<< "ComputeDistanceField - dimensions must be positive");
+        return;
+    }
+    if (scalarType != VTK_FLOAT && scalarType != VTK_DOUBLE)
+    {
+        vtkErrorMacro(<< "ComputeDistanceField - scalar type must be VTK_FLOAT or VTK_DOUBLE");
+        return;
+    }
+
+    double origin[3], spacing[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        origin[k] = bounds[2 * k];
+        spacing[k] = dims[k] > 1 ? (bounds[2 * k + 1] - bounds[2 * k]) / (dims[k] - 1) : 1.0;
+    }
+    field->Initialize();
+    field->SetDimensions(dims[0], dims[1], dims[2]);
+    field->SetOrigin(origin);
+    field->SetSpacing(spacing);
+
+    vtkIdType numLines = static_cast<vtkIdType>(dims[1]) * dims[2];
+    vtkSmartPointer<vtkDataArray> scalars;
+    if (scalarType == VTK_FLOAT)
+        scalars = vtkSmartPointer<vtkFloatArray>::New();
+    else
+        scalars = vtkSmartPointer<vtkDoubleArray>::New();
+    scalars->SetName("Distance");
+    scalars->SetNumberOfComponents(1);
+    scalars->SetNumberOfTuples(numLines * dims[0]);
+    void *data = scalars->GetVoidPointer(0);
+
+    // 没有三角形时所有点都在窄带外
+    if (this->Nodes.empty())
+    {
+        double value = maxDistance > 0.0 ? maxDistance : VTK_FLOAT_MAX;
+        vtkIdType numValues = numLines * dims[0];
+        if (scalarType == VTK_FLOAT)
+            std::fill_n(static_cast<float *>(data), numValues, static_cast<float>(value));
+        else
+            std::fill_n(static_cast<double *>(data), numValues, value);
+        field->GetPointData()->SetScalars(scalars);
+        return;
+    }
+
+    vtkSMPTools::For(0, numLines, [&](vtkIdType begin, vtkIdType end)
+                     {
+                         for (vtkIdType line = begin; line < end; ++line)
+                         {
+                             double start[3] = {origin[0], origin[1] + (line % dims[1]) * spacing[1],
+                                                origin[2] + (line / dims[1]) * spacing[2]};
+                             vtkIdType offset = line * dims[0];
+                             if (scalarType == VTK_FLOAT)
+                                 this->ComputeDistanceLine(start, spacing[0], dims[0], maxDistance,
+                                                           static_cast<float *>(data) + offset);
+                             else
+                                 this->ComputeDistanceLine(start, spacing[0], dims[0], maxDistance,
+                                                           static_cast<double *>(data) + offset);
+                         }
+                     });
+    field->GetPointData()->SetScalars(scalars);
+}
+
+bool AvtkTriangleBVH::Save(const char *path, vtkTypeUInt64 key) const
+{
+    if (!path)
+        return false;
+
+    BVHFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.Magic, BVHFileMagic, sizeof(header.Magic));
+    header.Version = BVHFileVersion;
+    header.ByteOrder = BVHFileByteOrder;
+    header.IdTypeSize = sizeof(vtkIdType);
+    header.NodeSize = sizeof(Node);
+    header.NumberOfTrianglesPerLeaf = this->NumberOfTrianglesPerLeaf;
+    header.NumberOfNodes = static_cast<vtkTypeInt64>(this->Nodes.size());
+    header.NumberOfTriangles = static_cast<vtkTypeInt64>(this->CellIds.size());
+    header.NumberOfPoints = static_cast<vtkTypeInt64>(this->Points.size() / 3);
+    header.NumberOfEdges = static_cast<vtkTypeInt64>(this->EdgeNormals.size() / 3);
+    header.Key = key;
+
+    const void *sections[8] = {this->Nodes.data(), this->Points.data(), this->TrianglePoints.data(),
+                               this->TriangleEdges.data(), this->CellIds.data(), this->FaceNormals.data(),
+                               this->PointNormals.data(), this->EdgeNormals.data()};
+    size_t sizes[8] = {this->Nodes.size() * sizeof(Node),
+                       this->Points.size() * sizeof(double),
+                       this->TrianglePoints.size() * sizeof(vtkTypeInt32),
+                       this->TriangleEdges.size() * sizeof(vtkTypeInt32),
+                       this->CellIds.size() * sizeof(vtkIdType),
+                       this->FaceNormals.size() * sizeof(double),
+                       this->PointNormals.size() * sizeof(float),
+                       this->EdgeNormals.size() * sizeof(float)};
+    for (int i = 0; i < 8; ++i)
+    {
+        header.Checksum = AUtils::Checksum(sections[i], sizes[i], header.Checksum);
+    }
+
+    // 先写入临时文件，完整写入后再替换目标文件
+    std::string tmpPath = AUtils::GetTempPath(path);
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            vtkErrorMacro(<< "AvtkTriangleBVH - cannot open " << tmpPath << " for writing");
+            return false;
+        }
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (int i = 0; i < 8; ++i)
+        {
+            file.write(static_cast<const char *>(sections[i]), static_cast<std::streamsize>(sizes[i]));
+        }
+        file.close();
+        if (!file)
+        {
+            vtkErrorMacro(<< "AvtkTriangleBVH - failed to write " << tmpPath);
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+    if (!AUtils::ReplaceFile(tmpPath.c_str(), path))
+    {
+        vtkErrorMacro(<< "AvtkTriangleBVH - cannot replace " << path);
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool AvtkTriangleBVH::Load(const char *path, vtkTypeUInt64 key, bool verifyChecksum)
+{
+    AUtils::MappedFile file;
+    if (!file.Open(path))
+    {
+        vtkDebugMacro(<< "Cannot map BVH file " << (path ? path : "(null)"));
+        return false;
+    }
+
+    BVHFileHeader header;
+    if (file.GetSize() < sizeof(header) || std::memcmp(file.GetData(), BVHFileMagic, sizeof(header.Magic)) != 0)
+    {
+        vtkErrorMacro(<< "AvtkTriangleBVH - " << path << " is not a BVH file");
+        return false;
+    }
+    std::memcpy(&header, file.GetData(), sizeof(header));
+    if (header.Version != BVHFileVersion || header.ByteOrder != BVHFileByteOrder ||
+        header.IdTypeSize != sizeof(vtkIdType) || header.NodeSize != sizeof(Node))
+    {
+        vtkErrorMacro(<< "AvtkTriangleBVH - " << path << " was written by an incompatible version or platform");
+        return false;
+    }
+    if (header.Key != key)
+    {
+        vtkDebugMacro(<< "BVH file " << path << " is stale");
+        return false;
+    }
+
+    // 各数组的大小由节点数、三角形数、点数与边数决定，文件大小必须与之一致
+    vtkTypeUInt64 numNodes = static_cast<vtkTypeUInt64>(header.NumberOfNodes);
+    vtkTypeUInt64 numTriangles = static_cast<vtkTypeUInt64>(header.NumberOfTriangles);
+    vtkTypeUInt64 numPoints = static_cast<vtkTypeUInt64>(header.NumberOfPoints);
+    vtkTypeUInt64 numEdges = static_cast<vtkTypeUInt64>(header.NumberOfEdges);
+    bool valid = header.NumberOfNodes >= 0 && header.NumberOfTriangles >= 0 && header.NumberOfPoints >= 0 &&
+                 header.NumberOfEdges >= 0 && header.NumberOfTriangles <= VTK_TYPE_INT32_MAX / 3 &&
+                 header.NumberOfNodes <= 2 * header.NumberOfTriangles &&
+                 header.NumberOfPoints <= 3 * header.NumberOfTriangles &&
+                 header.NumberOfEdges <= 3 * header.NumberOfTriangles && header.NumberOfTrianglesPerLeaf >= 1;
+    size_t sizes[8] = {numNodes * sizeof(Node),
+                       3 * numPoints * sizeof(double),
+                       3 * numTriangles * sizeof(vtkTypeInt32),
+                       3 * numTriangles * sizeof(vtkTypeInt32),
+                       numTriangles * sizeof(vtkIdType),
+                       3 * numTriangles * sizeof(double),
+                       3 * numPoints * sizeof(float),
+                       3 * numEdges * sizeof(float)};
+    const char *sections[8];
+    size_t offset = sizeof(header);
+    for (int i = 0; i < 8; ++i)
+    {
+        sections[i] = file.GetData() + offset;
+        offset += sizes[i];
+    }
+    valid = valid && offset == file.GetSize();
+    if (valid && verifyChecksum)
+    {
+        vtkTypeUInt64 checksum = 0;
+        for (int i = 0; i < 8; ++i)
+        {
+            checksum = AUtils::Checksum(sections[i], sizes[i], checksum);
+        }
+        valid = checksum == header.Checksum;
+    }
+    // 校验值只能发现损坏，不校验时同样要保证节点与序号不会使查询越界
+    valid = valid && IsValidStructure(reinterpret_cast<const Node *>(sections[0]), static_cast<vtkIdType>(numNodes),
+                                      static_cast<vtkIdType>(numTriangles),
+                                      reinterpret_cast<const vtkTypeInt32 *>(sections[2]),
+                                      static_cast<vtkIdType>(numPoints),
+                                      reinterpret_cast<const vtkTypeInt32 *>(sections[3]),
+                                      static_cast<vtkIdType>(numEdges));
+    if (!valid)
+    {
+        vtkErrorMacro(<< "AvtkTriangleBVH - " << path << " is truncated or corrupt");
+        return false;
+    }
+
+    this->Nodes.resize(numNodes);
+    this->Points.resize(3 * numPoints);
+    this->TrianglePoints.resize(3 * numTriangles);
+    this->TriangleEdges.resize(3 * numTriangles);
+    this->CellIds.resize(numTriangles);
+    this->FaceNormals.resize(3 * numTriangles);
+    this->PointNormals.resize(3 * numPoints);
+    this->EdgeNormals.resize(3 * numEdges);
+    void *targets[8] = {this->Nodes.data(), this->Points.data(), this->TrianglePoints.data(),
+                        this->TriangleEdges.data(), this->CellIds.data(), this->FaceNormals.data(),
+                        this->PointNormals.data(), this->EdgeNormals.data()};
+    for (int i = 0; i < 8; ++i)
+    {
+        if (sizes[i] > 0)
+            std::memcpy(targets[i], sections[i], sizes[i]);
+    }
+    this->NumberOfTrianglesPerLeaf = header.NumberOfTrianglesPerLeaf;
+    this->BuildElapsedTime = 0.0;
+    this->Modified();
+    return true;
+}
+
+bool AvtkTriangleBVH::IsValidStructure(const Node *nodes, vtkIdType numNodes, vtkIdType numTriangles,
+                                       const vtkTypeInt32 *trianglePoints, vtkIdType numPoints,
+                                       const vtkTypeInt32 *triangleEdges, vtkIdType numEdges)
+{
+    // 子节点的下标总是大于父节点，按下标顺序一遍即可求出所有节点的深度
+    std::vector<int> depth(numNodes, 0);
+    if (numNodes > 0)
+        depth[0] = 1;
+    for (vtkIdType i = 0; i < numNodes; ++i)
+    {
+        const Node &node = nodes[i];
+        // depth 为0表示没有父节点指向它
+        if (depth[i] == 0 || depth[i] > MaxTraversalDepth)
+            return false;
+        if (node.Count > 0)
+        {
+            if (node.First < 0 || node.First > numTriangles - node.Count)
+                return false;
+            continue;
+        }
+        if (node.Count < 0 || node.First != i + 1 || node.Right <= node.First || node.Right >= numNodes ||
+            depth[node.First] != 0 || depth[node.Right] != 0)
+            return false;
+        depth[node.First] = depth[i] + 1;
+        depth[node.Right] = depth[i] + 1;
+    }
+
+    for (vtkIdType i = 0; i < 3 * numTriangles; ++i)
+    {
+        if (trianglePoints[i] < 0 || trianglePoints[i] >= numPoints || triangleEdges[i] < 0 ||
+            triangleEdges[i] >= numEdges)
+            return false;
+    }
+    return true;
+}
+
+void AvtkTriangleBVH::PrintSelf(ostream &os, vtkIndent indent)
+{
+    this->Superclass::PrintSelf(os, indent);
+
+    os << indent << "NumberOfTrianglesPerLeaf: " << this->NumberOfTrianglesPerLeaf << "\n";
+    os << indent << "NumberOfTriangles: " << this->GetNumberOfTriangles() << "\n";
+    os << indent << "NumberOfNodes: " << this->Nodes.size() << "\n";
+    os << indent << "NumberOfPoints: " << this->Points.size() / 3 << "\n";
+    os << indent << "NumberOfEdges: " << this->EdgeNormals.size() / 3 << "\n";
+    os << indent << "BuildElapsedTime: " << this->BuildElapsedTime << "\n";
+}
+
+unsigned long AvtkTriangleBVH::GetActualMemorySize() const
+{
+    size_t size = this->Nodes.capacity() * sizeof(Node) + this->CellIds.capacity() * sizeof(vtkIdType) +
+                  (this->TrianglePoints.capacity() + this->TriangleEdges.capacity()) * sizeof(vtkTypeInt32) +
+                  (this->Points.capacity() + this->FaceNormals.capacity()) * sizeof(double) +
+                  (this->PointNormals.capacity() + this->EdgeNormals.capacity()) * sizeof(float);
+    return static_cast<unsigned long>((size + 1023) / 1024);
+}
@@ -0,0 +1,585 @@
+#include "AvtkUniformGrid.h"
+#include "SpaceFillingCurve.h"
+#include "vtkObjectFactory.h"
+#include "vtkCellArray.h"
+#include "vtkNew.h"
+#include "vtkSMPTools.h"
+#include "vtkTimerLog.h"
+
+#include <utility>
+
+vtkStandardNewMacro(AvtkUniformGrid);
+
+namespace
+{
+    // 每个方向的最大单元格数，与 Morton 编码每个分量的位数一致
+    const int MaxDimension = 1 << AUtils::CurveBits;
+
+    // 哈希表空位的标记，合法的编码最多 3 * CurveBits 位，不会与之相同
+    const vtkTypeUInt64 EmptyHashKey = ~vtkTypeUInt64(0);
+
+    inline vtkTypeUInt64 HashCellKey(vtkTypeUInt64 key)
+    {
+        key *= 0x9E3779B97F4A7C15ULL;
+        return key ^ (key >> 29);
+    }
+
+    /**
+     * SpreadBits 的逆运算，取出每3位中的最低位。
+     */
+    inline unsigned int CompactBits(vtkTypeUInt64 x)
+    {
+        x &= 0x1249249249249249ULL;
+        x = (x | (x >> 2)) & 0x10C30C30C30C30C3ULL;
+        x = (x | (x >> 4)) & 0x100F00F00F00F00FULL;
+        x = (x | (x >> 8)) & 0x1F0000FF0000FFULL;
+        x = (x | (x >> 16)) & 0x1F00000000FFFFULL;
+        x = (x | (x >> 32)) & 0x1FFFFFULL;
+        return static_cast<unsigned int>(x);
+    }
+
+    template <typename T>
+    void PushCandidates(const T *px, const T *py, const T *pz, const vtkIdType *ids, vtkIdType begin, vtkIdType end,
+                        const double x[3], size_t N, std::vector<std::pair<double, vtkIdType>> &heap)
+    {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            double dx = px[i] - x[0];
+            double dy = py[i] - x[1];
+            double dz = pz[i] - x[2];
+            AUtils::PushCandidate(heap, N, dx * dx + dy * dy + dz * dz, ids[i]);
+        }
+    }
+}
+
+void AvtkUniformGrid::Initialize()
+{
+    std::fill(this->Bounds, this->Bounds + 6, 0.0);
+    std::fill(this->Origin, this->Origin + 3, 0.0);
+    std::fill(this->Dimensions, this->Dimensions + 3, 1);
+    this->Spacing = 1.0;
+    this->Tolerance = 0.0;
+    this->CellKeys.clear();
+    this->CellOffsets.clear();
+    this->HashKeys.clear();
+    this->HashCells.clear();
+    this->HashMask = 0;
+    this->FloatStorage = false;
+    this->X.clear();
+    this->Y.clear();
+    this->Z.clear();
+    this->XF.clear();
+    this->YF.clear();
+    this->ZF.clear();
+    this->Ids.clear();
+}
+
+void AvtkUniformGrid::BuildFromPoints(vtkPoints *points)
+{
+    vtkNew<vtkTimerLog> timer;
+    timer->StartTimer();
+
+    this->Initialize();
+    vtkIdType numPoints = points ? points->GetNumberOfPoints() : 0;
+    if (numPoints < 1)
+    {
+        vtkErrorMacro(<< "AvtkUniformGrid - no points to build");
+        return;
+    }
+
+    // 单精度存储时坐标先舍入为float，单元格按舍入后的坐标划分
+    std::vector<double> coords(3 * numPoints);
+    const bool singlePrecision = this->SinglePrecision != 0;
+    auto copyPoints = [&](vtkIdType begin, vtkIdType end)
+    {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            double *p = &coords[3 * i];
+            points->GetPoint(i, p);
+            if (singlePrecision)
+            {
+                p[0] = static_cast<float>(p[0]);
+                p[1] = static_cast<float>(p[1]);
+                p[2] = static_cast<float>(p[2]);
+            }
+        }
+    };
+    if (this->ParallelBuild)
+        vtkSMPTools::For(0, numPoints, copyPoints);
+    else
+        copyPoints(0, numPoints);
+
+    this->Bounds[0] = this->Bounds[2] = this->Bounds[4] = VTK_DOUBLE_MAX;
+    this->Bounds[1] = this->Bounds[3] = this->Bounds[5] = -VTK_DOUBLE_MAX;
+    for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            this->Bounds[2 * k] = std::min(this->Bounds[2 * k], coords[3 * i + k]);
+            this->Bounds[2 * k + 1] = std::max(this->Bounds[2 * k + 1], coords[3 * i + k]);
+        }
+    }
+
+    // 选择单元格边长，自动选择时只计入非退化的方向
+    double extent[3];
+    double measure = 1.0;
+    int numAxes = 0;
+    double maxAbs = 0.0;
+    for (int k = 0; k < 3; ++k)
+    {
+        extent[k] = this->Bounds[2 * k + 1] - this->Bounds[2 * k];
+        this->Origin[k] = this->Bounds[2 * k];
+        maxAbs = std::max({maxAbs, std::abs(this->Bounds[2 * k]), std::abs(this->Bounds[2 * k + 1])});
+        if (extent[k] > 0.0)
+        {
+            measure *= extent[k];
+            ++numAxes;
+        }
+    }
+    double spacing = this->CellSize;
+    if (spacing <= 0.0)
+    {
+        spacing = numAxes > 0
+                      ? std::pow(measure * this->NumberOfPointsPerCell / static_cast<double>(numPoints), 1.0 / numAxes)
+                      : 1.0;
+    }
+    for (int k = 0; k < 3; ++k)
+    {
+        if (extent[k] / spacing >= MaxDimension - 1)
+            spacing = extent[k] / (MaxDimension - 1);
+    }
+    if (!(spacing > 0.0))
+        spacing = 1.0;
+    this->Spacing = spacing;
+    for (int k = 0; k < 3; ++k)
+    {
+        double dim = std::floor(extent[k] / spacing) + 1.0;
+        this->Dimensions[k] = static_cast<int>(std::min(dim, static_cast<double>(MaxDimension)));
+    }
+    this->Tolerance = 1e-9 * (spacing + maxAbs);
+
+    // 按单元格编码排序，(编码, id) 为严格全序，结果与线程数无关
+    std::vector<std::pair<vtkTypeUInt64, vtkIdType>> keys(numPoints);
+    auto computeKeys = [&](vtkIdType begin, vtkIdType end)
+    {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            const double *p = &coords[3 * i];
+            unsigned int c[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                c[k] = static_cast<unsigned int>(this->GetCellCoordinate(p[k], k));
+            }
+            keys[i] = std::make_pair(AUtils::MortonKey(c[0], c[1], c[2]), i);
+        }
+    };
+    if (this->ParallelBuild)
+    {
+        vtkSMPTools::For(0, numPoints, computeKeys);
+        vtkSMPTools::Sort(keys.begin(), keys.end());
+    }
+    else
+    {
+        computeKeys(0, numPoints);
+        std::sort(keys.begin(), keys.end());
+    }
+
+    // 按单元格顺序拷贝点坐标，同一单元格的点在内存中连续
+    this->FloatStorage = singlePrecision;
+    if (this->FloatStorage)
+    {
+        this->XF.resize(numPoints);
+        this->YF.resize(numPoints);
+        this->ZF.resize(numPoints);
+    }
+    else
+    {
+        this->X.resize(numPoints);
+        this->Y.resize(numPoints);
+        this->Z.resize(numPoints);
+    }
+    this->Ids.resize(numPoints);
+    auto gatherPoints = [&](vtkIdType begin, vtkIdType end)
+    {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            vtkIdType id = keys[i].second;
+            const double *p = &coords[3 * id];
+            if (this->FloatStorage)
+            {
+                this->XF[i] = static_cast<float>(p[0]);
+                this->YF[i] = static_cast<float>(p[1]);
+                this->ZF[i] = static_cast<float>(p[2]);
+            }
+            else
+            {
+                this->X[i] = p[0];
+                this->Y[i] = p[1];
+                this->Z[i] = p[2];
+            }
+            this->Ids[i] = id;
+        }
+    };
+    if (this->ParallelBuild)
+        vtkSMPTools::For(0, numPoints, gatherPoints);
+    else
+        gatherPoints(0, numPoints);
+
+    for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+        if (i == 0 || keys[i].first != keys[i - 1].first)
+        {
+            this->CellKeys.push_back(keys[i].first);
+            this->CellOffsets.push_back(i);
+        }
+    }
+    this->CellOffsets.push_back(numPoints);
+
+    // 开放寻址哈希表，容量为不小于两倍单元格数的2的幂，线性探测
+    size_t capacity = 2;
+    while (capacity < 2 * this->CellKeys.size())
+    {
+        capacity <<= 1;
+    }
+    this->HashMask = capacity - 1;
+    this->HashKeys.assign(capacity, EmptyHashKey);
+    this->HashCells.assign(capacity, -1);
+    for (size_t cell = 0; cell < this->CellKeys.size(); ++cell)
+    {
+        vtkTypeUInt64 slot = HashCellKey(this->CellKeys[cell]) & this->HashMask;
+        while (this->HashKeys[slot] != EmptyHashKey)
+        {
+            slot = (slot + 1) & this->HashMask;
+        }
+        this->HashKeys[slot] = this->CellKeys[cell];
+        this->HashCells[slot] = static_cast<vtkIdType>(cell);
+    }
+
+    timer->StopTimer();
+    this->BuildElapsedTime = timer->GetElapsedTime();
+    vtkDebugMacro(<< "Built uniform grid with " << numPoints << " points in " << this->CellKeys.size()
+                  << " cells in " << this->BuildElapsedTime << " s");
+    this->Modified();
+}
+
+vtkIdType AvtkUniformGrid::FindCell(int i, int j, int k) const
+{
+    if (this->HashKeys.empty())
+        return -1;
+    vtkTypeUInt64 key = AUtils::MortonKey(static_cast<unsigned int>(i), static_cast<unsigned int>(j),
+                                          static_cast<unsigned int>(k));
+    vtkTypeUInt64 slot = HashCellKey(key) & this->HashMask;
+    while (this->HashKeys[slot] != EmptyHashKey)
+    {
+        if (this->HashKeys[slot] == key)
+            return this->HashCells[slot];
+        slot = (slot + 1) & this->HashMask;
+    }
+    return -1;
+}
+
+void AvtkUniformGrid::GetCellCoordinates(vtkIdType cell, int ijk[3]) const
+{
+    vtkTypeUInt64 key = this->CellKeys[cell];
+    ijk[0] = static_cast<int>(CompactBits(key >> 2));
+    ijk[1] = static_cast<int>(CompactBits(key >> 1));
+    ijk[2] = static_cast<int>(CompactBits(key));
+}
+
+void AvtkUniformGrid::GetRangeBounds(const int lo[3], const int hi[3], double bounds[6]) const
+{
+    for (int k = 0; k < 3; ++k)
+    {
+        bounds[2 * k] = this->Origin[k] + lo[k] * this->Spacing - this->Tolerance;
+        bounds[2 * k + 1] = this->Origin[k] + (hi[k] + 1) * this->Spacing + this->Tolerance;
+    }
+}
+
+void AvtkUniformGrid::GetBounds(double bounds[6]) const
+{
+    std::copy(this->Bounds, this->Bounds + 6, bounds);
+}
+
+template <typename Shape>
+void AvtkUniformGrid::FindPointsInShape(const Shape &shape, vtkIdList *ids) const
+{
+    ids->Reset();
+    this->VisitPointsInShape(shape, [ids](const vtkIdType *segment, vtkIdType n)
+                             { AUtils::AppendIds(ids, segment, n); });
+}
+
+void AvtkUniformGrid::PushCellCandidates(vtkIdType cell, const double x[3], size_t N,
+                                         std::vector<std::pair<double, vtkIdType>> &heap) const
+{
+    vtkIdType begin = this->CellOffsets[cell];
+    vtkIdType end = this->CellOffsets[cell + 1];
+    if (this->FloatStorage)
+        PushCandidates(this->XF.data(), this->YF.data(), this->ZF.data(), this->Ids.data(), begin, end, x, N, heap);
+    else
+        PushCandidates(this->X.data(), this->Y.data(), this->Z.data(), this->Ids.data(), begin, end, x, N, heap);
+}
+
+int AvtkUniformGrid::SearchClosestPoints(const double x[3], size_t N,
+                                         std::vector<std::pair<double, vtkIdType>> &heap) const
+{
+    if (N == 0 || this->Ids.empty())
+        return 0;
+
+    int center[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        center[k] = this->GetCellCoordinate(x[k], k);
+    }
+
+    // 按切比雪夫距离逐层访问以 center 为中心的单元格
+    int cellsVisited = 0;
+    const vtkIdType numCells = this->GetNumberOfCells();
+    for (int r = 0;; ++r)
+    {
+        int lo[3], hi[3];
+        double shellCells = 1.0;
+        double innerCells = 1.0;
+        for (int k = 0; k < 3; ++k)
+        {
+            lo[k] = std::max(center[k] - r, 0);
+            hi[k] = std::min(center[k] + r, this->Dimensions[k] - 1);
+            shellCells *= hi[k] - lo[k] + 1;
+            innerCells *= std::max(std::min(center[k] + r - 1, this->Dimensions[k] - 1) -
+                                       std::max(center[k] - r + 1, 0) + 1,
+                                   0);
+        }
+        shellCells -= r > 0 ? innerCells : 0.0;
+
+        // 外层的单元格多于非空单元格时，改为按距离遍历剩余的非空单元格
+        if (shellCells > static_cast<double>(numCells))
+        {
+            std::vector<std::pair<double, vtkIdType>> cells;
+            for (vtkIdType cell = 0; cell < numCells; ++cell)
+            {
+                int ijk[3];
+                this->GetCellCoordinates(cell, ijk);
+                if (std::max({std::abs(ijk[0] - center[0]), std::abs(ijk[1] - center[1]), std::abs(ijk[2] - center[2])}) < r)
+                    continue;
+                double bounds[6];
+                this->GetRangeBounds(ijk, ijk, bounds);
+                double dist2 = AUtils::BoundsDistance2(bounds, x);
+                if (heap.size() < N || dist2 <= heap.front().first)
+                    cells.emplace_back(dist2, cell);
+            }
+            std::sort(cells.begin(), cells.end());
+            for (const auto &cell : cells)
+            {
+                if (heap.size() == N && cell.first > heap.front().first)
+                    break;
+                this->PushCellCandidates(cell.second, x, N, heap);
+                ++cellsVisited;
+            }
+            return cellsVisited;
+        }
+
+        for (int k = lo[2]; k <= hi[2]; ++k)
+        {
+            for (int j = lo[1]; j <= hi[1]; ++j)
+            {
+                bool onFace = std::abs(k - center[2]) == r || std::abs(j - center[1]) == r;
+                for (int i = lo[0]; i <= hi[0]; ++i)
+                {
+                    // 内部只访问位于本层上的两端
+                    if (!onFace && i != center[0] - r && i != center[0] + r)
+                    {
+                        i = std::max(i, center[0] + r - 1);
+                        continue;
+                    }
+                    vtkIdType cell = this->FindCell(i, j, k);
+                    if (cell < 0)
+                        continue;
+                    this->PushCellCandidates(cell, x, N, heap);
+                    ++cellsVisited;
+                }
+            }
+        }
+
+        // 未访问的单元格都在 [center - r, center + r] 之外，到这些单元格的距离不小于到该范围各外侧面的距离
+        double lowerBound = VTK_DOUBLE_MAX;
+        bool remaining = false;
+        for (int k = 0; k < 3; ++k)
+        {
+            if (center[k] - r > 0)
+            {
+                remaining = true;
+                double face = this->Origin[k] + (center[k] - r) * this->Spacing;
+                lowerBound = std::min(lowerBound, std::max(x[k] - face, 0.0));
+            }
+            if (center[k] + r < this->Dimensions[k] - 1)
+            {
+                remaining = true;
+                double face = this->Origin[k] + (center[k] + r + 1) * this->Spacing;
+                lowerBound = std::min(lowerBound, std::max(face - x[k], 0.0));
+            }
+        }
+        if (!remaining)
+            return cellsVisited;
+        lowerBound = std::max(lowerBound - this->Tolerance, 0.0);
+        if (heap.size() == N && lowerBound * lowerBound > heap.front().first)
+            return cellsVisited;
+    }
+}
+
+vtkIdType AvtkUniformGrid::FindClosestPoint(const double x[3], double &dist2, int *cellsVisited) const
+{
+    dist2 = VTK_DOUBLE_MAX;
+    std::vector<std::pair<double, vtkIdType>> heap;
+    heap.reserve(1);
+    int visited = this->SearchClosestPoints(x, 1, heap);
+    if (cellsVisited)
+        *cellsVisited = visited;
+    if (heap.empty())
+        return -1;
+    dist2 = heap.front().first;
+    return heap.front().second;
+}
+
+vtkIdType AvtkUniformGrid::FindClosestPointWithinRadius(double radius, const double x[3], double &dist2) const
+{
+    vtkIdType id = this->FindClosestPoint(x, dist2);
+    if (id < 0 || dist2 > radius * radius)
+        return -1;
+    return id;
+}
+
+void AvtkUniformGrid::FindClosestNPoints(int N, const double x[3], vtkIdList *result, int *cellsVisited) const
+{
+    result->Reset();
+    std::vector<std::pair<double, vtkIdType>> heap;
+    int visited = 0;
+    if (N > 0)
+    {
+        size_t maxCount = std::min(static_cast<size_t>(N), this->Ids.size());
+        heap.reserve(maxCount);
+        visited = this->SearchClosestPoints(x, maxCount, heap);
+    }
+    if (cellsVisited)
+        *cellsVisited = visited;
+
+    std::sort_heap(heap.begin(), heap.end());
+    result->SetNumberOfIds(static_cast<vtkIdType>(heap.size()));
+    for (size_t i = 0; i < heap.size(); ++i)
+    {
+        result->SetId(static_cast<vtkIdType>(i), heap[i].second);
+    }
+}
+
+void AvtkUniformGrid::FindPointsWithinRadius(double R, const double x[3], vtkIdList *result) const
+{
+    AUtils::SphereShape sphere;
+    sphere.Init(x, R);
+    this->FindPointsInShape(sphere, result);
+}
+
+void AvtkUniformGrid::FindPointsInArea(const double area[6], vtkIdList *ids) const
+{
+    AUtils::AreaShape areaShape;
+    areaShape.Init(area);
+    this->FindPointsInShape(areaShape, ids);
+}
+
+void AvtkUniformGrid::FindPointsInCuboid(const double cuboid[8][3], vtkIdList *ids) const
+{
+    AUtils::CuboidShape cuboidShape;
+    cuboidShape.Init(cuboid);
+    this->FindPointsInShape(cuboidShape, ids);
+}
+
+void AvtkUniformGrid::FindPointsInConvexPolytope(const double *planes, int numPlanes, vtkIdList *ids) const
+{
+    AUtils::ConvexPolytopeShape polytope;
+    polytope.Init(planes, numPlanes);
+    this->FindPointsInShape(polytope, ids);
+}
+
+void AvtkUniformGrid::FindPointsInTube(const double *points, int numPoints, double radius, vtkIdList *ids) const
+{
+    AUtils::TubeShape tube;
+    tube.Init(points, numPoints, radius);
+    this->FindPointsInShape(tube, ids);
+}
+
+void AvtkUniformGrid::FindPointsInCylinder(const double point[3], const double direction[3], double radius,
+                                           vtkIdList *ids) const
+{
+    AUtils::CylinderShape cylinder;
+    if (!cylinder.InitCylinder(point, direction, radius))
+    {
+        ids->Reset();
+        vtkErrorMacro(<< "FindPointsInCylinder - direction vector is zero");
+        return;
+    }
+    this->FindPointsInShape(cylinder, ids);
+}
+
+void AvtkUniformGrid::FindPointsInCapsule(const double p0[3], const double p1[3], double radius, vtkIdList *ids) const
+{
+    AUtils::CylinderShape capsule;
+    capsule.InitCapsule(p0, p1, radius);
+    this->FindPointsInShape(capsule, ids);
+}
+
+void AvtkUniformGrid::GenerateRepresentation(int, vtkPolyData *pd) const
+{
+    vtkNew<vtkPoints> pts;
+    vtkNew<vtkCellArray> polys;
+    // 角点顺序与AUtils::cubeIndices一致
+    const vtkIdType faces[6][4] = {
+        {0, 1, 3, 2}, {4, 5, 7, 6}, {0, 1, 5, 4}, {1, 3, 7, 5}, {3, 2, 6, 7}, {2, 0, 4, 6}};
+    for (vtkIdType cell = 0; cell < this->GetNumberOfCells(); ++cell)
+    {
+        int ijk[3];
+        this->GetCellCoordinates(cell, ijk);
+        double bounds[6];
+        for (int k = 0; k < 3; ++k)
+        {
+            bounds[2 * k] = this->Origin[k] + ijk[k] * this->Spacing;
+            bounds[2 * k + 1] = bounds[2 * k] + this->Spacing;
+        }
+        vtkIdType first = pts->GetNumberOfPoints();
+        for (int i = 0; i < 8; ++i)
+        {
+            pts->InsertNextPoint(bounds[(i & 1) ? 1 : 0], bounds[(i & 2) ? 3 : 2], bounds[(i & 4) ? 5 : 4]);
+        }
+        for (int f = 0; f < 6; ++f)
+        {
+            vtkIdType quad[4] = {first + faces[f][0], first + faces[f][1], first + faces[f][2], first + faces[f][3]};
+            polys->InsertNextCell(4, quad);
+        }
+    }
+    pd->Initialize();
+    pd->SetPoints(pts);
+    pd->SetPolys(polys);
+}
+
+void AvtkUniformGrid::PrintSelf(ostream &os, vtkIndent indent)
+{
+    this->Superclass::PrintSelf(os, indent);
+
+    os << indent << "CellSize: " << this->CellSize << "\n";
+    os << indent << "NumberOfPointsPerCell: " << this->NumberOfPointsPerCell << "\n";
+    os << indent << "Spacing: " << this->Spacing << "\n";
+    os << indent << "Dimensions: (" << this->Dimensions[0] << ", " << this->Dimensions[1] << ", "
+       << this->Dimensions[2] << ")\n";
+    os << indent << "NumberOfPoints: " << this->GetNumberOfPoints() << "\n";
+    os << indent << "NumberOfCells: " << this->GetNumberOfCells() << "\n";
+    os << indent << "ParallelBuild: " << this->ParallelBuild << "\n";
+    os << indent << "BuildElapsedTime: " << this->BuildElapsedTime << "\n";
+    os << indent << "SinglePrecision: " << this->SinglePrecision << "\n";
+}
+
+unsigned long AvtkUniformGrid::GetActualMemorySize() const
+{
+    size_t size = this->CellKeys.capacity() * sizeof(vtkTypeUInt64) +
+                  this->CellOffsets.capacity() * sizeof(vtkIdType) +
+                  this->HashKeys.capacity() * sizeof(vtkTypeUInt64) + this->HashCells.capacity() * sizeof(vtkIdType) +
+                  (this->X.capacity() + this->Y.capacity() + this->Z.capacity()) * sizeof(double) +
+                  (this->XF.capacity() + this->YF.capacity() + this->ZF.capacity()) * sizeof(float) +
+                  this->Ids.capacity() * sizeof(vtkIdType);
+    return static_cast<unsigned long>((size + 1023) / 1024);
+}
@@ -0,0 +1,577 @@
+#include "LeafKernels.h"
+
+#include <algorithm>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define AUTILS_LEAF_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC/Clang 需要为使用AVX2指令的函数单独开启目标指令集，MSVC 可以直接使用内建函数
+#if defined(AUTILS_LEAF_KERNELS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define AUTILS_TARGET_SSE2 __attribute__((target("sse2")))
+#define AUTILS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define AUTILS_TARGET_SSE2
+#define AUTILS_TARGET_AVX2
+#endif
+
+namespace AUtils
+{
+    namespace
+    {
+        template <typename Shape, typename T>
+        vtkIdType ScanScalar(const Shape &shape, const T *x, const T *y, const T *z,
+                             const vtkIdType *ids, vtkIdType begin, vtkIdType n, vtkIdType *out)
+        {
+            vtkIdType count = 0;
+            for (vtkIdType i = begin; i < n; ++i)
+            {
+                double p[3] = {x[i], y[i], z[i]};
+                if (shape.Contains(p))
+                    out[count++] = ids[i];
+            }
+            return count;
+        }
+
+        /**
+         * 按掩码位将通过测试的点id写入out。
+         */
+        inline vtkIdType EmitMask(int mask, int width, const vtkIdType *ids, vtkIdType *out)
+        {
+            vtkIdType count = 0;
+            for (int k = 0; k < width; ++k)
+            {
+                if (mask & (1 << k))
+                    out[count++] = ids[k];
+            }
+            return count;
+        }
+
+#ifdef AUTILS_LEAF_KERNELS_X86
+        bool CpuSupportsAvx2()
+        {
+#if defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7)
+                return false;
+            __cpuid(info, 1);
+            // 需要操作系统保存YMM寄存器 (OSXSAVE + XCR0)
+            if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)))
+                return false;
+            if ((_xgetbv(0) & 0x6) != 0x6)
+                return false;
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+#else
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        }
+
+        // ---------------------------------------------------------------- SSE2
+
+        // 单精度坐标读入后转换为双精度，之后的运算与双精度存储完全相同
+        AUTILS_TARGET_SSE2 inline __m128d LoadSSE2(const double *p)
+        {
+            return _mm_loadu_pd(p);
+        }
+
+        AUTILS_TARGET_SSE2 inline __m128d LoadSSE2(const float *p)
+        {
+            return _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p))));
+        }
+
+        template <typename T>
+        AUTILS_TARGET_SSE2 vtkIdType ScanSphereSSE2(const SphereShape &shape, const T *x, const T *y, const T *z,
+                                                    const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+        {
+            const __m128d cx = _mm_set1_pd(shape.Center[0]);
+            const __m128d cy = _mm_set1_pd(shape.Center[1]);
+            const __m128d cz = _mm_set1_pd(shape.Center[2]);
+            const __m128d r2 = _mm_set1_pd(shape.Radius2);
+            vtkIdType count = 0;
+            vtkIdType i = 0;
+            for (; i + 2 <= n; i += 2)
+            {
+                __m128d dx = _mm_sub_pd(LoadSSE2(x + i), cx);
+                __m128d dy = _mm_sub_pd(LoadSSE2(y + i), cy);
+                __m128d dz = _mm_sub_pd(LoadSSE2(z + i), cz);
+                __m128d d2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz));
+                count += EmitMask(_mm_movemask_pd(_mm_cmple_pd(d2, r2)), 2, ids + i, out + count);
+            }
+            return count + ScanScalar(shape, x, y, z, ids, i, n, out + count);
+        }
+
+        template <typename T>
+        AUTILS_TARGET_SSE2 vtkIdType ScanAreaSSE2(const AreaShape &shape, const T *x, const T *y, const T *z,
+                                                  const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+        {
+            const __m128d x0 = _mm_set1_pd(shape.Area[0]), x1 = _mm_set1_pd(shape.Area[1]);
+            const __m128d y0 = _mm_set1_pd(shape.Area[2]), y1 = _mm_set1_pd(shape.Area[3]);
+            const __m128d z0 = _mm_set1_pd(shape.Area[4]), z1 = _mm_set1_pd(shape.Area[5]);
+            vtkIdType count = 0;
+            vtkIdType i = 0;
+            for (; i + 2 <= n; i += 2)
+            {
+                __m128d px = LoadSSE2(x + i);
+                __m128d py = LoadSSE2(y + i);
+                __m128d pz = LoadSSE2(z + i);
+                __m128d in = _mm_and_pd(_mm_cmpge_pd(px, x0), _mm_cmple_pd(px, x1));
+                in = _mm_and_pd(in, _mm_and_pd(_mm_cmpge_pd(py, y0), _mm_cmple_pd(py, y1)));
+                in = _mm_and_pd(in, _mm_and_pd(_mm_cmpge_pd(pz, z0), _mm_cmple_pd(pz, z1)));
+                count += EmitMask(_mm_movemask_pd(in), 2, ids + i, out + count);
+            }
+            return count + ScanScalar(shape, x, y, z, ids, i, n, out + count);
+        }
+
+        template <typename T>
+        AUTILS_TARGET_SSE2 vtkIdType ScanCuboidSSE2(const CuboidShape &shape, const T *x, const T *y, const T *z,
+                                                    const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+        {
+            const __m128d zero = _mm_setzero_pd();
+            vtkIdType count = 0;
+            vtkIdType i = 0;
+            for (; i + 2 <= n; i += 2)
+            {
+                __m128d px = LoadSSE2(x + i);
+                __m128d py = LoadSSE2(y + i);
+                __m128d pz = LoadSSE2(z + i);
+                __m128d outside = _mm_setzero_pd();
+                for (int j = 0; j < 6; ++j)
+                {
+                    __m128d s = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(shape.Normals[j][0]), px),
+                                           _mm_mul_pd(_mm_set1_pd(shape.Normals[j][1]), py));
+                    s = _mm_add_pd(s, _mm_mul_pd(_mm_set1_pd(shape.Normals[j][2]), pz));
+                    s = _mm_add_pd(s, _mm_set1_pd(shape.D[j]));
+                    outside = _mm_or_pd(outside, _mm_cmpgt_pd(s, zero));
+                }
+                count += EmitMask(~_mm_movemask_pd(outside) & 0x3, 2, ids + i, out + count);
+            }
+            return count + ScanScalar(shape, x, y, z, ids, i, n, out + count);
+        }
+
+        template <typename T>
+        AUTILS_TARGET_SSE2 vtkIdType ScanPolytopeSSE2(const ConvexPolytopeShape &shape, const T *x, const T *y,
+                                                      const T *z, const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+        {
+            const __m128d zero = _mm_setzero_pd();
+            vtkIdType count = 0;
+            vtkIdType i = 0;
+            for (; i + 2 <= n; i += 2)
+            {
+                __m128d px = LoadSSE2(x + i);
+                __m128d py = LoadSSE2(y + i);
+                __m128d pz = LoadSSE2(z + i);
+                __m128d outside = _mm_setzero_pd();
+                const double *plane = shape.Planes.data();
+                for (int j = 0; j < shape.NumberOfPlanes; ++j, plane += 4)
+                {
+                    __m128d s = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(plane[0]), px),
+                                           _mm_mul_pd(_mm_set1_pd(plane[1]), py));
+                    s = _mm_add_pd(s, _mm_mul_pd(_mm_set1_pd(plane[2]), pz));
+                    s = _mm_add_pd(s, _mm_set1_pd(plane[3]));
+                    outside = _mm_or_pd(outside, _mm_cmpgt_pd(s, zero));
+                }
+                count += EmitMask(~_mm_movemask_pd(outside) & 0x3, 2, ids + i, out + count);
+            }
+            return count + ScanScalar(shape, x, y, z, ids, i, n, out + count);
+        }
+
+        template <typename T>
+        AUTILS_TARGET_SSE2 vtkIdType ScanCylinderSSE2(const CylinderShape &shape, const T *x, const T *y, const T *z,
+                                                      const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+        {
+            const __m128d ox = _mm_set1_pd(shape.Origin[0]);
+            const __m128d oy = _mm_set1_pd(shape.Origin[1]);
+            const __m128d oz = _mm_set1_pd(shape.Origin[2]);
+            const __m128d ax = _mm_set1_pd(shape.Axis[0]);
+            const __m128d ay = _mm_set1_pd(shape.Axis[1]);
+            const __m128d az = _mm_set1_pd(shape.Axis[2]);
+            const __m128d zero = _mm_setzero_pd();
+            const __m128d length = _mm_set1_pd(shape.Length);
+            const __m128d r2 = _mm_set1_pd(shape.Radius2);
+            vtkIdType count = 0;
+            vtkIdType i = 0;
+            for (; i + 2 <= n; i += 2)
+            {
+                __m128d vx = _mm_sub_pd(LoadSSE2(x + i), ox);
+                __m128d vy = _mm_sub_pd(LoadSSE2(y + i), oy);
+                __m128d vz = _mm_sub_pd(LoadSSE2(z + i), oz);
+                __m128d t = _mm_add_pd(_mm_add_pd(_mm_mul_pd(vx, ax), _mm_mul_pd(vy, ay)), _mm_mul_pd(vz, az));
+                if (shape.Finite)
+                    t = _mm_min_pd(length, _mm_max_pd(zero, t));
+                __m128d wx = _mm_sub_pd(vx, _mm_mul_pd(t, ax));
+                __m128d wy = _mm_sub_pd(vy, _mm_mul_pd(t, ay));
+                __m128d wz = _mm_sub_pd(vz, _mm_mul_pd(t, az));
+                __m128d d2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(wx, wx), _mm_mul_pd(wy, wy)), _mm_mul_pd(wz, wz));
+                count += EmitMask(_mm_movemask_pd(_mm_cmple_pd(d2, r2)), 2, ids + i, out + count);
+            }
+            return count + ScanScalar(shape, x, y, z, ids, i, n, out + count);
+        }
+
+        // ---------------------------------------------------------------- AVX2
+
+        AUTILS_TARGET_AVX2 inline __m256d LoadAVX2(const double *p)
+        {
+            return _mm256_loadu_pd(p);
+        }
+
+        AUTILS_TARGET_AVX2 inline __m256d LoadAVX2(const float *p)
+        {
+            return _mm256_cvtps_pd(_mm_loadu_ps(p));
+        }
+
+        template <typename T>
+        AUTILS_TARGET_AVX2 vtkIdType ScanSphereAVX2(const SphereShape &shape, const T *x, const T *y, const T *z,
+                                                    const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+        {
+            const __m256d cx = _mm256_set1_pd(shape.Center[0]);
+            const __m256d cy = _mm256_set1_pd(shape.Center[1]);
+            const __m256d cz = _mm256_set1_pd(shape.Center[2]);
+            const __m256d r2 = _mm256_set1_pd(shape.Radius2);
+            vtkIdType count = 0;
+            vtkIdType i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                __m256d dx = _mm256_sub_pd(LoadAVX2(x + i), cx);
+                __m256d dy = _mm256_sub_pd(LoadAVX2(y + i), cy);
+                __m256d dz = _mm256_sub_pd(LoadAVX2(z + i), cz);
+                __m256d d2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), _mm256_mul_pd(dz, dz));
+                count += EmitMask(_mm256_movemask_pd(_mm256_cmp_pd(d2, r2, _CMP_LE_OQ)), 4, ids + i, out + count);
+            }
+            return count + ScanScalar(shape, x, y, z, ids, i, n, out + count);
+        }
+
+        template <typename T>
+        AUTILS_TARGET_AVX2 vtkIdType ScanAreaAVX2(const AreaShape &shape, const T *x, const T *y, const T *z,
+                                                  const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+        {
+            const __m256d x0 = _mm256_set1_pd(shape.Area[0]), x1 = _mm256_set1_pd(shape.Area[1]);
+            const __m256d y0 = _mm256_set1_pd(shape.Area[2]), y1 = _mm256_set1_pd(shape.Area[3]);
+            const __m256d z0 = _mm256_set1_pd(shape.Area[4]), z1 = _mm256_set1_pd(shape.Area[5]);
+            vtkIdType count = 0;
+            vtkIdType i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                __m256d px = LoadAVX2(x + i);
+                __m256d py = LoadAVX2(y + i);
+                __m256d pz = LoadAVX2(z + i);
+                __m256d in = _mm256_and_pd(_mm256_cmp_pd(px, x0, _CMP_GE_OQ), _mm256_cmp_pd(px, x1, _CMP_LE_OQ));
+                in = _mm256_and_pd(in, _mm256_and_pd(_mm256_cmp_pd(py, y0, _CMP_GE_OQ), _mm256_cmp_pd(py, y1, _CMP_LE_OQ)));
+                in = _mm256_and_pd(in, _mm256_and_pd(_mm256_cmp_pd(pz, z0, _CMP_GE_OQ), _mm256_cmp_pd(pz, z1, _CMP_LE_OQ)));
+                count += EmitMask(_mm256_movemask_pd(in), 4, ids + i, out + count);
+            }
+            return count + ScanScalar(shape, x, y, z, ids, i, n, out + count);
+        }
+
+        template <typename T>
+        AUTILS_TARGET_AVX2 vtkIdType ScanCuboidAVX2(const CuboidShape &shape, const T *x, const T *y, const T *z,
+                                                    const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+        {
+            const __m256d zero = _mm256_setzero_pd();
+            vtkIdType count = 0;
+            vtkIdType i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                __m256d px = LoadAVX2(x + i);
+                __m256d py = LoadAVX2(y + i);
+                __m256d pz = LoadAVX2(z + i);
+                __m256d outside = _mm256_setzero_pd();
+                for (int j = 0; j < 6; ++j)
+                {
+                    __m256d s = _mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(shape.Normals[j][0]), px),
+                                              _mm256_mul_pd(_mm256_set1_pd(shape.Normals[j][1]), py));
+                    s = _mm256_add_pd(s, _mm256_mul_pd(_mm256_set1_pd(shape.Normals[j][2]), pz));
+                    s = _mm256_add_pd(s, _mm256_set1_pd(shape.D[j]));
+                    outside = _mm256_or_pd(outside, _mm256_cmp_pd(s, zero, _CMP_GT_OQ));
+                }
+                count += EmitMask(~_mm256_movemask_pd(outside) & 0xF, 4, ids + i, out + count);
+            }
+            return count + ScanScalar(shape, x, y, z, ids, i, n, out + count);
+        }
+
+        template <typename T>
+        AUTILS_TARGET_AVX2 vtkIdType ScanPolytopeAVX2(const ConvexPolytopeShape &shape, const T *x, const T *y,
+                                                      const T *z, const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+        {
+            const __m256d zero = _mm256_setzero_pd();
+            vtkIdType count = 0;
+            vtkIdType i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                __m256d px = LoadAVX2(x + i);
+                __m256d py = LoadAVX2(y + i);
+                __m256d pz = LoadAVX2(z + i);
+                __m256d outside = _mm256_setzero_pd();
+                const double *plane = shape.Planes.data();
+                for (int j = 0; j < shape.NumberOfPlanes; ++j, plane += 4)
+                {
+                    __m256d s = _mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(plane[0]), px),
+                                              _mm256_mul_pd(_mm256_set1_pd(plane[1]), py));
+                    s = _mm256_add_pd(s, _mm256_mul_pd(_mm256_set1_pd(plane[2]), pz));
+                    s = _mm256_add_pd(s, _mm256_set1_pd(plane[3]));
+                    outside = _mm256_or_pd(outside, _mm256_cmp_pd(s, zero, _CMP_GT_OQ));
+                }
+                count += EmitMask(~_mm256_movemask_pd(outside) & 0xF, 4, ids + i, out + count);
+            }
+            return count + ScanScalar(shape, x, y, z, ids, i, n, out + count);
+        }
+
+        template <typename T>
+        AUTILS_TARGET_AVX2 vtkIdType ScanCylinderAVX2(const CylinderShape &shape, const T *x, const T *y, const T *z,
+                                                      const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+        {
+            const __m256d ox = _mm256_set1_pd(shape.Origin[0]);
+            const __m256d oy = _mm256_set1_pd(shape.Origin[1]);
+            const __m256d oz = _mm256_set1_pd(shape.Origin[2]);
+            const __m256d ax = _mm256_set1_pd(shape.Axis[0]);
+            const __m256d ay = _mm256_set1_pd(shape.Axis[1]);
+            const __m256d az = _mm256_set1_pd(shape.Axis[2]);
+            const __m256d zero = _mm256_setzero_pd();
+            const __m256d length = _mm256_set1_pd(shape.Length);
+            const __m256d r2 = _mm256_set1_pd(shape.Radius2);
+            vtkIdType count = 0;
+            vtkIdType i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                __m256d vx = _mm256_sub_pd(LoadAVX2(x + i), ox);
+                __m256d vy = _mm256_sub_pd(LoadAVX2(y + i), oy);
+                __m256d vz = _mm256_sub_pd(LoadAVX2(z + i), oz);
+                __m256d t = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(vx, ax), _mm256_mul_pd(vy, ay)), _mm256_mul_pd(vz, az));
+                // 与 std::min(std::max(t, 0.0), Length) 的比较顺序一致
+                if (shape.Finite)
+                    t = _mm256_min_pd(length, _mm256_max_pd(zero, t));
+                __m256d wx = _mm256_sub_pd(vx, _mm256_mul_pd(t, ax));
+                __m256d wy = _mm256_sub_pd(vy, _mm256_mul_pd(t, ay));
+                __m256d wz = _mm256_sub_pd(vz, _mm256_mul_pd(t, az));
+                __m256d d2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(wx, wx), _mm256_mul_pd(wy, wy)), _mm256_mul_pd(wz, wz));
+                count += EmitMask(_mm256_movemask_pd(_mm256_cmp_pd(d2, r2, _CMP_LE_OQ)), 4, ids + i, out + count);
+            }
+            return count + ScanScalar(shape, x, y, z, ids, i, n, out + count);
+        }
+#endif
+
+        SimdLevel DetectSimdLevel()
+        {
+#ifdef AUTILS_LEAF_KERNELS_X86
+            if (CpuSupportsAvx2())
+                return SimdLevel::AVX2;
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+            return SimdLevel::SSE2;
+#else
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2") ? SimdLevel::SSE2 : SimdLevel::Scalar;
+#endif
+#else
+            return SimdLevel::Scalar;
+#endif
+        }
+
+        std::atomic<int> &CurrentSimdLevel()
+        {
+            static std::atomic<int> level(static_cast<int>(GetSupportedSimdLevel()));
+            return level;
+        }
+
+        /**
+         * 按当前指令集选择实现。
+         */
+        template <typename Shape, typename T, typename Kernel>
+        vtkIdType Dispatch(const Shape &shape, const T *x, const T *y, const T *z,
+                           const vtkIdType *ids, vtkIdType n, vtkIdType *out, Kernel sse2, Kernel avx2)
+        {
+            switch (static_cast<SimdLevel>(CurrentSimdLevel().load(std::memory_order_relaxed)))
+            {
+            case SimdLevel::AVX2:
+                if (avx2)
+                    return avx2(shape, x, y, z, ids, n, out);
+                break;
+            case SimdLevel::SSE2:
+                if (sse2)
+                    return sse2(shape, x, y, z, ids, n, out);
+                break;
+            default:
+                break;
+            }
+            return ScanScalar(shape, x, y, z, ids, 0, n, out);
+        }
+    }
+
+    namespace
+    {
+        template <typename T>
+        vtkIdType ScanTube(const TubeShape &shape, const T *x, const T *y, const T *z,
+                           const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+        {
+            if (n == 0)
+                return 0;
+            double bounds[6] = {double(x[0]), double(x[0]), double(y[0]), double(y[0]), double(z[0]), double(z[0])};
+            for (vtkIdType i = 1; i < n; ++i)
+            {
+                bounds[0] = std::min(bounds[0], double(x[i]));
+                bounds[1] = std::max(bounds[1], double(x[i]));
+                bounds[2] = std::min(bounds[2], double(y[i]));
+                bounds[3] = std::max(bounds[3], double(y[i]));
+                bounds[4] = std::min(bounds[4], double(z[i]));
+                bounds[5] = std::max(bounds[5], double(z[i]));
+            }
+
+            // 附近的线段过多时退回逐点遍历线段层次结构
+            const int maxSegments = 32;
+            int segments[maxSegments];
+            int numSegments = shape.CollectSegments(bounds, segments, maxSegments);
+            if (numSegments < 0)
+                return ScanScalar(shape, x, y, z, ids, 0, n, out);
+            if (numSegments == 0)
+                return 0;
+            if (numSegments == 1)
+                return ScanLeaf(shape.Segments[segments[0]], x, y, z, ids, n, out);
+
+            vtkIdType count = 0;
+            for (vtkIdType i = 0; i < n; ++i)
+            {
+                double p[3] = {x[i], y[i], z[i]};
+                for (int k = 0; k < numSegments; ++k)
+                {
+                    if (shape.Segments[segments[k]].Contains(p))
+                    {
+                        out[count++] = ids[i];
+                        break;
+                    }
+                }
+            }
+            return count;
+        }
+    }
+
+    SimdLevel GetSupportedSimdLevel()
+    {
+        static const SimdLevel level = DetectSimdLevel();
+        return level;
+    }
+
+    SimdLevel GetSimdLevel()
+    {
+        return static_cast<SimdLevel>(CurrentSimdLevel().load());
+    }
+
+    void SetSimdLevel(SimdLevel level)
+    {
+        int supported = static_cast<int>(GetSupportedSimdLevel());
+        CurrentSimdLevel().store(std::min(static_cast<int>(level), supported));
+    }
+
+#ifdef AUTILS_LEAF_KERNELS_X86
+#define AUTILS_LEAF_KERNEL(name) name
+#else
+#define AUTILS_LEAF_KERNEL(name) nullptr
+#endif
+
+    vtkIdType ScanLeaf(const SphereShape &shape, const double *x, const double *y, const double *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+    {
+        using Kernel = vtkIdType (*)(const SphereShape &, const double *, const double *, const double *,
+                                     const vtkIdType *, vtkIdType, vtkIdType *);
+        return Dispatch<SphereShape, double, Kernel>(shape, x, y, z, ids, n, out,
+                                                     AUTILS_LEAF_KERNEL(ScanSphereSSE2<double>), AUTILS_LEAF_KERNEL(ScanSphereAVX2<double>));
+    }
+
+    vtkIdType ScanLeaf(const SphereShape &shape, const float *x, const float *y, const float *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+    {
+        using Kernel = vtkIdType (*)(const SphereShape &, const float *, const float *, const float *,
+                                     const vtkIdType *, vtkIdType, vtkIdType *);
+        return Dispatch<SphereShape, float, Kernel>(shape, x, y, z, ids, n, out,
+                                                    AUTILS_LEAF_KERNEL(ScanSphereSSE2<float>), AUTILS_LEAF_KERNEL(ScanSphereAVX2<float>));
+    }
+
+    vtkIdType ScanLeaf(const AreaShape &shape, const double *x, const double *y, const double *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+    {
+        using Kernel = vtkIdType (*)(const AreaShape &, const double *, const double *, const double *,
+                                     const vtkIdType *, vtkIdType, vtkIdType *);
+        return Dispatch<AreaShape, double, Kernel>(shape, x, y, z, ids, n, out,
+                                                   AUTILS_LEAF_KERNEL(ScanAreaSSE2<double>), AUTILS_LEAF_KERNEL(ScanAreaAVX2<double>));
+    }
+
+    vtkIdType ScanLeaf(const AreaShape &shape, const float *x, const float *y, const float *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+    {
+        using Kernel = vtkIdType (*)(const AreaShape &, const float *, const float *, const float *,
+                                     const vtkIdType *, vtkIdType, vtkIdType *);
+        return Dispatch<AreaShape, float, Kernel>(shape, x, y, z, ids, n, out,
+                                                  AUTILS_LEAF_KERNEL(ScanAreaSSE2<float>), AUTILS_LEAF_KERNEL(ScanAreaAVX2<float>));
+    }
+
+    vtkIdType ScanLeaf(const CuboidShape &shape, const double *x, const double *y, const double *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+    {
+        using Kernel = vtkIdType (*)(const CuboidShape &, const double *, const double *, const double *,
+                                     const vtkIdType *, vtkIdType, vtkIdType *);
+        return Dispatch<CuboidShape, double, Kernel>(shape, x, y, z, ids, n, out,
+                                                     AUTILS_LEAF_KERNEL(ScanCuboidSSE2<double>), AUTILS_LEAF_KERNEL(ScanCuboidAVX2<double>));
+    }
+
+    vtkIdType ScanLeaf(const CuboidShape &shape, const float *x, const float *y, const float *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+    {
+        using Kernel = vtkIdType (*)(const CuboidShape &, const float *, const float *, const float *,
+                                     const vtkIdType *, vtkIdType, vtkIdType *);
+        return Dispatch<CuboidShape, float, Kernel>(shape, x, y, z, ids, n, out,
+                                                    AUTILS_LEAF_KERNEL(ScanCuboidSSE2<float>), AUTILS_LEAF_KERNEL(ScanCuboidAVX2<float>));
+    }
+
+    vtkIdType ScanLeaf(const ConvexPolytopeShape &shape, const double *x, const double *y, const double *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+    {
+        using Kernel = vtkIdType (*)(const ConvexPolytopeShape &, const double *, const double *, const double *,
+                                     const vtkIdType *, vtkIdType, vtkIdType *);
+        return Dispatch<ConvexPolytopeShape, double, Kernel>(shape, x, y, z, ids, n, out,
+                                                             AUTILS_LEAF_KERNEL(ScanPolytopeSSE2<double>), AUTILS_LEAF_KERNEL(ScanPolytopeAVX2<double>));
+    }
+
+    vtkIdType ScanLeaf(const ConvexPolytopeShape &shape, const float *x, const float *y, const float *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+    {
+        using Kernel = vtkIdType (*)(const ConvexPolytopeShape &, const float *, const float *, const float *,
+                                     const vtkIdType *, vtkIdType, vtkIdType *);
+        return Dispatch<ConvexPolytopeShape, float, Kernel>(shape, x, y, z, ids, n, out,
+                                                            AUTILS_LEAF_KERNEL(ScanPolytopeSSE2<float>), AUTILS_LEAF_KERNEL(ScanPolytopeAVX2<float>));
+    }
+
+    vtkIdType ScanLeaf(const CylinderShape &shape, const double *x, const double *y, const double *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+    {
+        using Kernel = vtkIdType (*)(const CylinderShape &, const double *, const double *, const double *,
+                                     const vtkIdType *, vtkIdType, vtkIdType *);
+        return Dispatch<CylinderShape, double, Kernel>(shape, x, y, z, ids, n, out,
+                                                       AUTILS_LEAF_KERNEL(ScanCylinderSSE2<double>), AUTILS_LEAF_KERNEL(ScanCylinderAVX2<double>));
+    }
+
+    vtkIdType ScanLeaf(const CylinderShape &shape, const float *x, const float *y, const float *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+    {
+        using Kernel = vtkIdType (*)(const CylinderShape &, const float *, const float *, const float *,
+                                     const vtkIdType *, vtkIdType, vtkIdType *);
+        return Dispatch<CylinderShape, float, Kernel>(shape, x, y, z, ids, n, out,
+                                                      AUTILS_LEAF_KERNEL(ScanCylinderSSE2<float>), AUTILS_LEAF_KERNEL(ScanCylinderAVX2<float>));
+    }
+
+    vtkIdType ScanLeaf(const TubeShape &shape, const double *x, const double *y, const double *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+    {
+        return ScanTube(shape, x, y, z, ids, n, out);
+    }
+
+    vtkIdType ScanLeaf(const TubeShape &shape, const float *x, const float *y, const float *z,
+                       const vtkIdType *ids, vtkIdType n, vtkIdType *out)
+    {
+        return ScanTube(shape, x, y, z, ids, n, out);
+    }
+};
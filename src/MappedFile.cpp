@@ -0,0 +1,215 @@
+#include "MappedFile.h"
+#include "vtkSMPTools.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const vtkTypeUInt64 Prime1 = 0x9E3779B185EBCA87ULL;
+    const vtkTypeUInt64 Prime2 = 0xC2B2AE3D27D4EB4FULL;
+
+    // Checksum 的分块大小
+    const size_t ChecksumBlockSize = size_t(1) << 20;
+
+    inline vtkTypeUInt64 Rotate(vtkTypeUInt64 x, int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    inline vtkTypeUInt64 Mix(vtkTypeUInt64 h, vtkTypeUInt64 v)
+    {
+        h ^= Rotate(v * Prime2, 31) * Prime1;
+        return Rotate(h, 27) * Prime1 + Prime2;
+    }
+
+    inline vtkTypeUInt64 Finalize(vtkTypeUInt64 h)
+    {
+        h ^= h >> 33;
+        h *= Prime2;
+        h ^= h >> 29;
+        h *= Prime1;
+        h ^= h >> 32;
+        return h;
+    }
+
+    /**
+     * 单个数据块的校验值，4路交错处理8字节的字，尾部不足8字节的部分补0。
+     */
+    vtkTypeUInt64 BlockChecksum(const unsigned char *data, size_t size, vtkTypeUInt64 seed)
+    {
+        vtkTypeUInt64 lanes[4] = {seed + Prime1, seed + Prime2, seed, seed - Prime1};
+        size_t numWords = size / 8;
+        for (size_t i = 0; i < numWords; ++i)
+        {
+            vtkTypeUInt64 word;
+            std::memcpy(&word, data + 8 * i, 8);
+            lanes[i & 3] = Mix(lanes[i & 3], word);
+        }
+        vtkTypeUInt64 tail = 0;
+        std::memcpy(&tail, data + 8 * numWords, size - 8 * numWords);
+
+        vtkTypeUInt64 h = Rotate(lanes[0], 1) + Rotate(lanes[1], 7) + Rotate(lanes[2], 12) + Rotate(lanes[3], 18);
+        h = Mix(h, tail);
+        return Finalize(h ^ static_cast<vtkTypeUInt64>(size));
+    }
+}
+
+namespace AUtils
+{
+    bool MappedFile::Open(const char *path)
+    {
+        this->Close();
+        if (!path)
+            return false;
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+        {
+            CloseHandle(file);
+            return false;
+        }
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping)
+        {
+            CloseHandle(file);
+            return false;
+        }
+        void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!data)
+        {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+        this->FileHandle = file;
+        this->MappingHandle = mapping;
+        this->Data = static_cast<const char *>(data);
+        this->Size = static_cast<size_t>(size.QuadPart);
+#else
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0)
+        {
+            close(fd);
+            return false;
+        }
+        void *data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        // 映射建立后文件描述符不再需要
+        close(fd);
+        if (data == MAP_FAILED)
+            return false;
+        this->Data = static_cast<const char *>(data);
+        this->Size = static_cast<size_t>(st.st_size);
+#endif
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if (!this->Data)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(this->Data);
+        CloseHandle(this->MappingHandle);
+        CloseHandle(this->FileHandle);
+        this->FileHandle = nullptr;
+        this->MappingHandle = nullptr;
+#else
+        munmap(const_cast<char *>(this->Data), this->Size);
+#endif
+        this->Data = nullptr;
+        this->Size = 0;
+    }
+
+    vtkTypeUInt64 Checksum(const void *data, size_t size, vtkTypeUInt64 seed)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        vtkIdType numBlocks = static_cast<vtkIdType>((size + ChecksumBlockSize - 1) / ChecksumBlockSize);
+        std::vector<vtkTypeUInt64> blocks(numBlocks);
+        auto checksumBlocks = [&](vtkIdType begin, vtkIdType end)
+        {
+            for (vtkIdType b = begin; b < end; ++b)
+            {
+                size_t offset = static_cast<size_t>(b) * ChecksumBlockSize;
+                size_t blockSize = std::min(ChecksumBlockSize, size - offset);
+                blocks[b] = BlockChecksum(bytes + offset, blockSize, seed);
+            }
+        };
+        if (numBlocks > 1)
+            vtkSMPTools::For(0, numBlocks, checksumBlocks);
+        else
+            checksumBlocks(0, numBlocks);
+
+        vtkTypeUInt64 h = seed ^ Prime1;
+        for (vtkTypeUInt64 block : blocks)
+        {
+            h = Mix(h, block);
+        }
+        return Finalize(h ^ static_cast<vtkTypeUInt64>(size));
+    }
+
+    vtkTypeUInt64 GetFileKey(const char *path)
+    {
+        if (!path)
+            return 0;
+        vtkTypeUInt64 values[2]; // 大小与修改时间
+#ifdef _WIN32
+        WIN32_FILE_ATTRIBUTE_DATA attributes;
+        if (!GetFileAttributesExA(path, GetFileExInfoStandard, &attributes))
+            return 0;
+        values[0] = (vtkTypeUInt64(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+        values[1] = (vtkTypeUInt64(attributes.ftLastWriteTime.dwHighDateTime) << 32) |
+                  attributes.ftLastWriteTime.dwLowDateTime;
+#else
+        struct stat st;
+        if (stat(path, &st) != 0)
+            return 0;
+        values[0] = static_cast<vtkTypeUInt64>(st.st_size);
+        values[1] = static_cast<vtkTypeUInt64>(st.st_mtime);
+#endif
+        vtkTypeUInt64 key = Checksum(path, std::strlen(path), Checksum(values, sizeof(values)));
+        // 0 保留表示没有标识
+        return key != 0 ? key : 1;
+    }
+
+    std::string GetTempPath(const char *path)
+    {
+        static std::atomic<vtkTypeUInt64> counter(0);
+#ifdef _WIN32
+        vtkTypeUInt64 pid = GetCurrentProcessId();
+#else
+        vtkTypeUInt64 pid = static_cast<vtkTypeUInt64>(getpid());
+#endif
+        return std::string(path) + ".tmp." + std::to_string(pid) + "." + std::to_string(counter++);
+    }
+
+    bool ReplaceFile(const char *tmpPath, const char *path)
+    {
+        if (std::rename(tmpPath, path) == 0)
+            return true;
+        // 部分平台上 rename 不能覆盖已有文件
+        std::remove(path);
+        return std::rename(tmpPath, path) == 0;
+    }
+}
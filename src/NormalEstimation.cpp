@@ -0,0 +1,324 @@
+#include "NormalEstimation.h"
+#include "AvtkKdTreePointLocator.h"
+#include "PointStatistics.h"
+#include "vtkIdList.h"
+#include "vtkMath.h"
+#include "vtkSMPThreadLocal.h"
+#include "vtkSMPTools.h"
+#include "vtkSmartPointer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    struct NeighborDistance
+    {
+        double Distance2;
+        vtkIdType Id;
+
+        bool operator<(const NeighborDistance &other) const
+        {
+            return Distance2 < other.Distance2 || (Distance2 == other.Distance2 && Id < other.Id);
+        }
+    };
+
+    /**
+     * 按点并行：查询邻域，累加协方差并做特征分解；需要时记录最近的若干邻点供定向使用。
+     */
+    struct EstimateNormalsFunctor
+    {
+        struct LocalData
+        {
+            vtkSmartPointer<vtkIdList> Scratch;
+            std::vector<NeighborDistance> Distances;
+        };
+
+        vtkPoints *Points;
+        AvtkKdTreePointLocator *Locator;
+        const AUtils::NormalEstimationOptions &Options;
+        float *Normals;
+        float *Curvature;
+        vtkIdType *Neighbors;
+        int NumberOfNeighbors;
+        vtkSMPThreadLocal<LocalData> TLocal;
+
+        EstimateNormalsFunctor(vtkPoints *points, AvtkKdTreePointLocator *locator,
+                               const AUtils::NormalEstimationOptions &options, float *normals, float *curvature,
+                               vtkIdType *neighbors, int numNeighbors)
+            : Points(points), Locator(locator), Options(options), Normals(normals), Curvature(curvature),
+              Neighbors(neighbors), NumberOfNeighbors(numNeighbors)
+        {
+        }
+
+        void Initialize() { this->TLocal.Local().Scratch = vtkSmartPointer<vtkIdList>::New(); }
+
+        void operator()(vtkIdType begin, vtkIdType end)
+        {
+            LocalData &local = this->TLocal.Local();
+            vtkIdList *ids = local.Scratch;
+            double p[3], q[3];
+            double cov[3][3], eigVectors[3][3], eigValues[3];
+            double *covRows[3] = {cov[0], cov[1], cov[2]};
+            double *vecRows[3] = {eigVectors[0], eigVectors[1], eigVectors[2]};
+            AUtils::PointStatisticsAccumulator accumulator;
+
+            for (vtkIdType i = begin; i < end; ++i)
+            {
+                this->Points->GetPoint(i, p);
+                if (this->Options.Radius > 0.0)
+                    this->Locator->FindPointsWithinRadius(this->Options.Radius, p, ids);
+                else
+                    this->Locator->FindClosestNPoints(this->Options.NumberOfNeighbors, p, ids);
+
+                // 以查询点为平移原点累加，邻域内的坐标差很小，远离原点时仍然稳定
+                accumulator.Init(p);
+                local.Distances.clear();
+                vtkIdType numIds = ids->GetNumberOfIds();
+                for (vtkIdType j = 0; j < numIds; ++j)
+                {
+                    vtkIdType id = ids->GetId(j);
+                    this->Points->GetPoint(id, q);
+                    accumulator.AddPoint(q);
+                    if (this->Neighbors && id != i)
+                        local.Distances.push_back({vtkMath::Distance2BetweenPoints(p, q), id});
+                }
+
+                float *normal = this->Normals + 3 * i;
+                normal[0] = normal[1] = normal[2] = 0.0f;
+                double curvature = 0.0;
+                AUtils::PointStatistics stats;
+                accumulator.AddTo(stats);
+                if (stats.Count >= 3 && stats.GetCovariance(cov))
+                {
+                    // 特征值按降序排列，特征向量按列存放，最小特征值对应第3列
+                    vtkMath::Jacobi(covRows, eigValues, vecRows);
+                    double sum = eigValues[0] + eigValues[1] + eigValues[2];
+                    if (sum > 0.0)
+                    {
+                        double n[3] = {eigVectors[0][2], eigVectors[1][2], eigVectors[2][2]};
+                        vtkMath::Normalize(n);
+                        normal[0] = static_cast<float>(n[0]);
+                        normal[1] = static_cast<float>(n[1]);
+                        normal[2] = static_cast<float>(n[2]);
+                        curvature = std::max(0.0, eigValues[2]) / sum;
+                    }
+                }
+                if (this->Curvature)
+                    this->Curvature[i] = static_cast<float>(curvature);
+
+                if (this->Neighbors)
+                {
+                    size_t m = std::min(local.Distances.size(), static_cast<size_t>(this->NumberOfNeighbors));
+                    std::partial_sort(local.Distances.begin(), local.Distances.begin() + m, local.Distances.end());
+                    vtkIdType *out = this->Neighbors + static_cast<size_t>(i) * this->NumberOfNeighbors;
+                    for (int k = 0; k < this->NumberOfNeighbors; ++k)
+                        out[k] = static_cast<size_t>(k) < m ? local.Distances[k].Id : -1;
+                }
+            }
+        }
+
+        void Reduce() {}
+    };
+
+    inline double Dot(const float *a, const float *b)
+    {
+        return static_cast<double>(a[0]) * b[0] + static_cast<double>(a[1]) * b[1] + static_cast<double>(a[2]) * b[2];
+    }
+
+    inline void Flip(float *n)
+    {
+        n[0] = -n[0];
+        n[1] = -n[1];
+        n[2] = -n[2];
+    }
+
+    /**
+     * 法向量朝向视点的程度，正值表示朝向视点。
+     */
+    inline double FacingViewpoint(vtkPoints *points, vtkIdType id, const float *n, const double viewpoint[3])
+    {
+        double p[3];
+        points->GetPoint(id, p);
+        return (viewpoint[0] - p[0]) * n[0] + (viewpoint[1] - p[1]) * n[1] + (viewpoint[2] - p[2]) * n[2];
+    }
+
+    void OrientTowardViewpoint(vtkPoints *points, const double viewpoint[3], float *normals)
+    {
+        vtkSMPTools::For(0, points->GetNumberOfPoints(),
+                         [&](vtkIdType begin, vtkIdType end)
+                         {
+                             for (vtkIdType i = begin; i < end; ++i)
+                             {
+                                 if (FacingViewpoint(points, i, normals + 3 * i, viewpoint) < 0.0)
+                                     Flip(normals + 3 * i);
+                             }
+                         });
+    }
+
+    /**
+     * 在邻域图上按 Prim 算法扩展最小生成树，边权 1 - |ni·nj|，子节点的方向与父节点一致。
+     * k近邻关系不对称，先补上反向边（按目标点分组的 CSR，共 n·k 个id），
+     * 否则没有被其他点列为近邻的点会被分成单独的连通部分，只能按视点定向。
+     * 每个连通部分传播完成后以离视点最近的点为准整体翻转，使该点的法向量朝向视点：
+     * 视点在封闭物体外时得到朝外的法向量，视点在扫描站位时得到朝向扫描仪的法向量。
+     */
+    void OrientAlongSpanningTree(vtkPoints *points, const double viewpoint[3], const vtkIdType *neighbors,
+                                 int numNeighbors, float *normals)
+    {
+        struct Edge
+        {
+            double Weight;
+            vtkIdType From;
+            vtkIdType To;
+
+            bool operator>(const Edge &other) const { return Weight > other.Weight; }
+        };
+
+        vtkIdType numPoints = points->GetNumberOfPoints();
+
+        // 反向边：reverseIds[reverseOffsets[j], reverseOffsets[j + 1]) 为把 j 列为近邻的点
+        std::vector<vtkIdType> reverseOffsets(numPoints + 1, 0);
+        for (size_t e = 0; e < static_cast<size_t>(numPoints) * numNeighbors; ++e)
+        {
+            if (neighbors[e] >= 0)
+                ++reverseOffsets[neighbors[e] + 1];
+        }
+        for (vtkIdType j = 0; j < numPoints; ++j)
+            reverseOffsets[j + 1] += reverseOffsets[j];
+        std::vector<vtkIdType> reverseIds(reverseOffsets[numPoints]);
+        {
+            std::vector<vtkIdType> fill(reverseOffsets.begin(), reverseOffsets.end() - 1);
+            for (vtkIdType i = 0; i < numPoints; ++i)
+            {
+                const vtkIdType *nbrs = neighbors + static_cast<size_t>(i) * numNeighbors;
+                for (int k = 0; k < numNeighbors && nbrs[k] >= 0; ++k)
+                    reverseIds[fill[nbrs[k]]++] = i;
+            }
+        }
+
+        std::vector<char> visited(numPoints, 0);
+        std::vector<vtkIdType> component;
+        std::priority_queue<Edge, std::vector<Edge>, std::greater<Edge>> heap;
+
+        auto pushEdge = [&](vtkIdType from, vtkIdType to)
+        {
+            if (!visited[to])
+                heap.push({1.0 - std::fabs(Dot(normals + 3 * from, normals + 3 * to)), from, to});
+        };
+        auto pushEdges = [&](vtkIdType from)
+        {
+            const vtkIdType *nbrs = neighbors + static_cast<size_t>(from) * numNeighbors;
+            for (int k = 0; k < numNeighbors && nbrs[k] >= 0; ++k)
+                pushEdge(from, nbrs[k]);
+            for (vtkIdType r = reverseOffsets[from]; r < reverseOffsets[from + 1]; ++r)
+                pushEdge(from, reverseIds[r]);
+        };
+
+        for (vtkIdType seed = 0; seed < numPoints; ++seed)
+        {
+            if (visited[seed])
+                continue;
+            component.clear();
+            visited[seed] = 1;
+            component.push_back(seed);
+            pushEdges(seed);
+            while (!heap.empty())
+            {
+                Edge edge = heap.top();
+                heap.pop();
+                if (visited[edge.To])
+                    continue;
+                visited[edge.To] = 1;
+                component.push_back(edge.To);
+                if (Dot(normals + 3 * edge.From, normals + 3 * edge.To) < 0.0)
+                    Flip(normals + 3 * edge.To);
+                pushEdges(edge.To);
+            }
+
+            vtkIdType nearest = seed;
+            double nearestDist2 = VTK_DOUBLE_MAX;
+            for (vtkIdType id : component)
+            {
+                double p[3];
+                points->GetPoint(id, p);
+                double dist2 = vtkMath::Distance2BetweenPoints(p, viewpoint);
+                if (dist2 < nearestDist2)
+                {
+                    nearestDist2 = dist2;
+                    nearest = id;
+                }
+            }
+            if (FacingViewpoint(points, nearest, normals + 3 * nearest, viewpoint) < 0.0)
+            {
+                for (vtkIdType id : component)
+                    Flip(normals + 3 * id);
+            }
+        }
+    }
+};
+
+void AUtils::EstimateNormals(vtkPoints *points, AvtkKdTreePointLocator *locator, const NormalEstimationOptions &options,
+                             vtkFloatArray *normals, vtkFloatArray *curvature)
+{
+    if (!points || !locator || !normals)
+        throw std::invalid_argument("EstimateNormals: points, locator and normals must not be null");
+    if (options.Radius <= 0.0 && options.NumberOfNeighbors < 3)
+        throw std::invalid_argument("EstimateNormals: at least 3 neighbors are required");
+
+    // 数组大小已经一致时不再调整，已挂在数据集上的数组原地写入，不改变数据集的修改时间
+    vtkIdType numPoints = points->GetNumberOfPoints();
+    if (normals->GetNumberOfComponents() != 3 || normals->GetNumberOfTuples() != numPoints)
+    {
+        normals->SetNumberOfComponents(3);
+        normals->SetNumberOfTuples(numPoints);
+    }
+    if (curvature && (curvature->GetNumberOfComponents() != 1 || curvature->GetNumberOfTuples() != numPoints))
+    {
+        curvature->SetNumberOfComponents(1);
+        curvature->SetNumberOfTuples(numPoints);
+    }
+    if (numPoints == 0)
+        return;
+
+    // 并行查询前构建，查询过程中不会再触发构建
+    locator->BuildLocator();
+
+    int numOrientNeighbors = 0;
+    std::vector<vtkIdType> neighbors;
+    if (options.Orientation == NormalOrientation::MinimumSpanningTree)
+    {
+        numOrientNeighbors = std::max(1, options.NumberOfOrientationNeighbors);
+        neighbors.resize(static_cast<size_t>(numPoints) * numOrientNeighbors);
+    }
+
+    EstimateNormalsFunctor estimate(points, locator, options, normals->GetPointer(0),
+                                    curvature ? curvature->GetPointer(0) : nullptr,
+                                    neighbors.empty() ? nullptr : neighbors.data(), numOrientNeighbors);
+    vtkSMPTools::For(0, numPoints, estimate);
+
+    OrientNormals(points, options, neighbors.empty() ? nullptr : neighbors.data(), numOrientNeighbors, normals);
+}
+
+void AUtils::OrientNormals(vtkPoints *points, const NormalEstimationOptions &options, const vtkIdType *neighbors,
+                           int numNeighbors, vtkFloatArray *normals)
+{
+    switch (options.Orientation)
+    {
+    case NormalOrientation::None:
+        break;
+    case NormalOrientation::Viewpoint:
+        OrientTowardViewpoint(points, options.Viewpoint, normals->GetPointer(0));
+        break;
+    case NormalOrientation::MinimumSpanningTree:
+        if (!neighbors || numNeighbors <= 0)
+            throw std::invalid_argument("OrientNormals: spanning tree orientation requires a neighbor graph");
+        OrientAlongSpanningTree(points, options.Viewpoint, neighbors, numNeighbors, normals->GetPointer(0));
+        break;
+    }
+}
@@ -1,12 +1,54 @@
 #include "PointNormalProcessor.h"
+#include <vtkCellArray.h>
+#include <vtkErrorCode.h>
+#include <vtkFieldData.h>
+#include <vtkFloatArray.h>
+#include <vtkSMPTools.h>
+#include <vtkStringArray.h>
+#include <vtkXMLPolyDataReader.h>
+#include <vtkXMLPolyDataWriter.h>
+
+#include <cstdio>
+
+namespace
+{
+    // 缓存的处理后数据中保存键与重排映射的场数据数组，读取后移除
+    const char *CacheKeyArrayName = "AUtilsCacheKey";
+    const char *CacheOrderArrayName = "AUtilsNewToOldPointIds";
+
+    /**
+     * 输入已带有完整的点法向量，且只包含三角形、线段与单点时，三角化与法向量计算不会改变它。
+     */
+    bool IsTriangulatedWithNormals(vtkPolyData *polyData)
+    {
+        vtkDataArray *normals = polyData->GetPointData()->GetNormals();
+        if (!normals || normals->GetNumberOfComponents() != 3 ||
+            normals->GetNumberOfTuples() != polyData->GetNumberOfPoints())
+            return false;
+        if (polyData->GetNumberOfStrips() > 0)
+            return false;
+        // 每个单元至少有 3/2/1 个点，总数相等时全部为三角形/线段/单点
+        vtkCellArray *polys = polyData->GetPolys();
+        vtkCellArray *lines = polyData->GetLines();
+        vtkCellArray *verts = polyData->GetVerts();
+        return polys->GetNumberOfConnectivityIds() == 3 * polys->GetNumberOfCells() &&
+               lines->GetNumberOfConnectivityIds() == 2 * lines->GetNumberOfCells() &&
+               verts->GetNumberOfConnectivityIds() == verts->GetNumberOfCells();
+    }
+};
 
 PointNormalProcessor::PointNormalProcessor()
 {
     pointLocator = vtkSmartPointer<AvtkKdTreePointLocator>::New();
+    surfaceLocator = vtkSmartPointer<AvtkTriangleBVH>::New();
     arrowSource = vtkSmartPointer<vtkArrowSource>::New();
     glyph3D = vtkSmartPointer<vtkGlyph3D>::New();
     glyph3D->SetSourceConnection(arrowSource->GetOutputPort());
+    glyph3D->SetVectorModeToUseNormal();
+    glyph3D->SetScaleFactor(1.0);
+    // 以管线连接，箭头只在 actor 可见并渲染时由 mapper 按需生成
     arrowPipeline = std::make_unique<VisualizationPipeline>();
+    arrowPipeline->SetInputConnection(glyph3D->GetOutputPort());
     arrowPipeline->SetVisibility(false);
 }
 
@@ -15,6 +57,7 @@ void PointNormalProcessor::SetInput(VisualizationPipeline *pipeline)
     inputData = pipeline->GetOutput();
     if (!inputData)
         throw std::runtime_error("Input data is not set");
+    connectionSource = nullptr;
     Update();
 }
 
@@ -23,6 +66,7 @@ void PointNormalProcessor::SetInput(vtkPolyData *polyData)
     inputData = polyData;
     if (!inputData)
         throw std::runtime_error("Input data is not set");
+    connectionSource = nullptr;
     Update();
 }
 
@@ -40,21 +84,255 @@ void PointNormalProcessor::SetInputConnection(vtkAlgorithmOutput *port)
     if (!polyData)
         throw std::runtime_error("Pipeline output is not vtkPolyData");
 
-    // 创建一个新的vtkPolyData对象作为输入数据的深拷贝
-    inputData = vtkSmartPointer<vtkPolyData>::New();
-    // 浅拷贝polyData到inputData，因为数据结构不会被修改，仅复制指针
-    inputData->ShallowCopy(polyData);
+    // 同一输出未被修改时沿用上次的拷贝，Update 不会重新计算
+    if (!inputData || polyData != connectionSource || polyData->GetMTime() != connectionSourceMTime)
+    {
+        // 创建一个新的vtkPolyData对象作为输入数据的深拷贝
+        inputData = vtkSmartPointer<vtkPolyData>::New();
+        // 浅拷贝polyData到inputData，因为数据结构不会被修改，仅复制指针
+        inputData->ShallowCopy(polyData);
+        connectionSource = polyData;
+        connectionSourceMTime = polyData->GetMTime();
+    }
 
     // 调用Update方法处理输入数据，尽管这里没有显示Update的实现
     Update();
 }
 
+void PointNormalProcessor::SetPointLocator(AvtkKdTreePointLocator *locator)
+{
+    if (!locator)
+        throw std::invalid_argument("Point locator is null");
+    if (pointLocator == locator)
+        return;
+    pointLocator = locator;
+    locatorModified = true;
+    if (processedPolyData)
+        BuildLocator();
+}
+
+void PointNormalProcessor::SetLocatorCacheFile(const std::string &path)
+{
+    if (locatorCacheFile == path)
+        return;
+    locatorCacheFile = path;
+    locatorModified = true;
+    // 缓存整个处理结果时，新的缓存文件需要重新读取或写入处理后的数据
+    if (cacheSourceKey != 0)
+        normalsModified = true;
+}
+
+void PointNormalProcessor::SetCacheSourceKey(vtkTypeUInt64 key)
+{
+    if (cacheSourceKey == key)
+        return;
+    cacheSourceKey = key;
+    normalsModified = true;
+}
+
+void PointNormalProcessor::SetPointOrdering(AUtils::SpaceFillingCurve curve)
+{
+    if (pointOrdering == curve)
+        return;
+    pointOrdering = curve;
+    normalsModified = true;
+}
+
+void PointNormalProcessor::SetNormalMethod(AUtils::NormalMethod method)
+{
+    if (normalMethod == method)
+        return;
+    normalMethod = method;
+    normalsModified = true;
+}
+
+void PointNormalProcessor::SetNormalEstimationOptions(const AUtils::NormalEstimationOptions &options)
+{
+    normalEstimationOptions = options;
+    if (normalMethod == AUtils::NormalMethod::PointCloud)
+        normalsModified = true;
+}
+
+void PointNormalProcessor::SetComputeCurvature(bool compute)
+{
+    if (computeCurvature == compute)
+        return;
+    computeCurvature = compute;
+    if (normalMethod == AUtils::NormalMethod::PointCloud)
+        normalsModified = true;
+}
+
 void PointNormalProcessor::BuildLocator()
 {
+    locatorInput = processedPolyData;
+    locatorInputMTime = processedPolyData->GetMTime();
+    locatorModified = false;
+
+    // 三角形BVH只依赖处理后的数据，只更换点定位器时不重建；数据变化时只标记过期，由 GetSurface 在第一次表面查询时构建
+    if (processedPolyData != surfaceInput || processedPolyData->GetMTime() != surfaceInputMTime)
+    {
+        surfaceInput = processedPolyData;
+        surfaceInputMTime = processedPolyData->GetMTime();
+        surfaceBuilt = false;
+    }
     pointLocator->SetDataSet(processedPolyData);
+    // 缓存文件有效时直接映射，否则构建后写入缓存；有来源标识时以标识为键，不对点坐标求校验值
+    if (!locatorCacheFile.empty() && pointLocator->GetTreeType() == AvtkKdTreePointLocator::FLAT_KD_TREE)
+    {
+        if (cacheSourceKey != 0 && processedFromSource)
+        {
+            vtkTypeUInt64 key = ComputeCacheKey();
+            if (!pointLocator->LoadWithSourceKey(locatorCacheFile.c_str(), key))
+            {
+                pointLocator->BuildLocator();
+                pointLocator->SaveWithSourceKey(locatorCacheFile.c_str(), key);
+            }
+        }
+        else if (!pointLocator->Load(locatorCacheFile.c_str()))
+        {
+            pointLocator->BuildLocator();
+            pointLocator->Save(locatorCacheFile.c_str());
+        }
+        return;
+    }
     pointLocator->BuildLocator();
 }
 
+vtkTypeUInt64 PointNormalProcessor::ComputeCacheKey() const
+{
+    const AUtils::NormalEstimationOptions &options = normalEstimationOptions;
+    bool pointCloud = normalMethod == AUtils::NormalMethod::PointCloud;
+    // PCA 参数只在 PointCloud 方式下影响结果
+    double values[] = {static_cast<double>(normalMethod),
+                       static_cast<double>(pointOrdering),
+                       static_cast<double>(surfaceLocator->GetNumberOfTrianglesPerLeaf()),
+                       pointCloud && computeCurvature ? 1.0 : 0.0,
+                       pointCloud ? static_cast<double>(options.NumberOfNeighbors) : 0.0,
+                       pointCloud ? options.Radius : 0.0,
+                       pointCloud ? static_cast<double>(options.Orientation) : 0.0,
+                       pointCloud ? options.Viewpoint[0] : 0.0,
+                       pointCloud ? options.Viewpoint[1] : 0.0,
+                       pointCloud ? options.Viewpoint[2] : 0.0,
+                       pointCloud ? static_cast<double>(options.NumberOfOrientationNeighbors) : 0.0};
+    return AUtils::Checksum(values, sizeof(values), cacheSourceKey);
+}
+
+bool PointNormalProcessor::LoadCache()
+{
+    vtkTypeUInt64 key = ComputeCacheKey();
+    // BVH文件只读文件头就能判断是否过期，先于处理后的数据检查
+    std::string bvhPath = locatorCacheFile + ".bvh";
+    std::string dataPath = locatorCacheFile + ".vtp";
+    if (!surfaceLocator->Load(bvhPath.c_str(), key))
+        return false;
+    // BVH已换成缓存中的数据，之后的检查失败时须重建
+    surfaceBuilt = false;
+    vtkNew<vtkXMLPolyDataReader> reader;
+    if (!reader->CanReadFile(dataPath.c_str()))
+        return false;
+    reader->SetFileName(dataPath.c_str());
+    reader->Update();
+    vtkSmartPointer<vtkPolyData> output = reader->GetOutput();
+    vtkFieldData *fieldData = output->GetFieldData();
+    vtkStringArray *keyArray = vtkStringArray::SafeDownCast(fieldData->GetAbstractArray(CacheKeyArrayName));
+    if (reader->GetErrorCode() != vtkErrorCode::NoError || !keyArray || keyArray->GetNumberOfValues() != 1 ||
+        keyArray->GetValue(0) != std::to_string(key))
+        return false;
+
+    vtkIdType numPoints = output->GetNumberOfPoints();
+    vtkDataArray *order = fieldData->GetArray(CacheOrderArrayName);
+    std::vector<vtkIdType> newToOld;
+    std::vector<vtkIdType> oldToNew;
+    if (order)
+    {
+        if (order->GetNumberOfTuples() != numPoints)
+            return false;
+        newToOld.resize(numPoints);
+        oldToNew.resize(numPoints);
+        for (vtkIdType i = 0; i < numPoints; ++i)
+        {
+            newToOld[i] = static_cast<vtkIdType>(order->GetTuple1(i));
+            if (newToOld[i] < 0 || newToOld[i] >= numPoints)
+                return false;
+            oldToNew[newToOld[i]] = i;
+        }
+    }
+    fieldData->RemoveArray(CacheKeyArrayName);
+    fieldData->RemoveArray(CacheOrderArrayName);
+
+    processedPolyData = output;
+    newToOldPointIds.swap(newToOld);
+    oldToNewPointIds.swap(oldToNew);
+    processedFromSource = true;
+    normalsInput = inputData;
+    normalsInputMTime = inputData->GetMTime();
+    normalsModified = false;
+    surfaceInput = processedPolyData;
+    surfaceInputMTime = processedPolyData->GetMTime();
+    surfaceBuilt = true;
+    return true;
+}
+
+void PointNormalProcessor::SaveCache()
+{
+    vtkTypeUInt64 key = ComputeCacheKey();
+    // 键与重排映射写入拷贝的场数据，不改动处理后的数据
+    vtkNew<vtkPolyData> copy;
+    copy->ShallowCopy(processedPolyData);
+    vtkNew<vtkFieldData> fieldData;
+    fieldData->ShallowCopy(processedPolyData->GetFieldData());
+    vtkNew<vtkStringArray> keyArray;
+    keyArray->SetName(CacheKeyArrayName);
+    keyArray->InsertNextValue(std::to_string(key));
+    fieldData->AddArray(keyArray);
+    if (!newToOldPointIds.empty())
+    {
+        vtkNew<vtkIdTypeArray> order;
+        order->SetName(CacheOrderArrayName);
+        order->SetNumberOfValues(static_cast<vtkIdType>(newToOldPointIds.size()));
+        std::copy(newToOldPointIds.begin(), newToOldPointIds.end(), order->GetPointer(0));
+        fieldData->AddArray(order);
+    }
+    copy->SetFieldData(fieldData);
+
+    // 未压缩的原始二进制数据，读取时不需要解码
+    std::string dataPath = locatorCacheFile + ".vtp";
+    std::string tmpPath = AUtils::GetTempPath(dataPath.c_str());
+    vtkNew<vtkXMLPolyDataWriter> writer;
+    writer->SetInputData(copy);
+    writer->SetFileName(tmpPath.c_str());
+    writer->SetDataModeToAppended();
+    writer->EncodeAppendedDataOff();
+    writer->SetCompressorTypeToNone();
+    writer->SetHeaderTypeToUInt64();
+    if (!writer->Write() || !AUtils::ReplaceFile(tmpPath.c_str(), dataPath.c_str()))
+    {
+        std::remove(tmpPath.c_str());
+        return;
+    }
+    GetSurface()->Save((locatorCacheFile + ".bvh").c_str(), key);
+}
+
+AvtkTriangleBVH *PointNormalProcessor::GetSurface() const
+{
+    // 双重检查：已构建时只有一次原子读，未构建时只有一个线程构建，其余线程等待
+    if (!surfaceBuilt.load(std::memory_order_acquire))
+    {
+        std::lock_guard<std::mutex> lock(surfaceMutex);
+        if (!surfaceBuilt.load(std::memory_order_relaxed))
+        {
+            surfaceLocator->BuildFromPolyData(processedPolyData);
+            surfaceBuilt.store(true, std::memory_order_release);
+        }
+    }
+    return surfaceLocator;
+}
+
+AvtkTriangleBVH *PointNormalProcessor::GetSurfaceLocator() const
+{
+    return GetSurface();
+}
+
 double *PointNormalProcessor::GetPoint(vtkIdType id) const
 {
     return processedPolyData->GetPoint(id);
@@ -86,54 +364,29 @@ vtkSmartPointer<vtkIdList> PointNormalProcessor::FindPointsInCylinder(const doub
 
 void PointNormalProcessor::FindPointsInCylinder(const double *point, const double *direction, double radius, vtkIdList *resultIds)
 {
-    // 归一化方向向量
+    CheckDirection(direction);
+    pointLocator->FindPointsWithinCylinder(point, direction, radius, resultIds);
+}
+
+void PointNormalProcessor::CheckDirection(const double *direction)
+{
     double norm = std::sqrt(direction[0] * direction[0] +
                             direction[1] * direction[1] +
                             direction[2] * direction[2]);
     if (norm < 1e-8)
         throw std::invalid_argument("Direction vector is zero.");
-    double u[3] = {direction[0] / norm, direction[1] / norm, direction[2] / norm};
-
-    // 调用新函数获取包围盒的投影范围
-    std::array<double, 2> projRange = ComputeBoundingBoxProjectionRange(point, u);
-    double minProj = projRange[0];
-    double maxProj = projRange[1];
-
-    // 将范围适当扩展，以确保覆盖整个圆柱体区域（在两端各扩展一个 radius）
-    double start = minProj - radius * radiusRatio;
-    double end = maxProj + radius * radiusRatio;
-
-    // 基于球体搜索方式获取候选点集：先生成球体中心，再利用 GetUniquePointsInSpheres 汇总查询结果
-    double sphereRadius = radius * radiusRatio;
-    double step = sphereRadius * intervalRatio;
-
-    double vecStart[3] = {
-        point[0] + start * u[0],
-        point[1] + start * u[1],
-        point[2] + start * u[2]};
-    double vecEnd[3] = {
-        point[0] + end * u[0],
-        point[1] + end * u[1],
-        point[2] + end * u[2]};
-
-    std::vector<std::array<double, 3>> sphereCenters = GenerateSphereCenters(vecStart, vecEnd, step, sphereRadius);
-    vtkSmartPointer<vtkIdList> candidatePoints = GetUniquePointsInSpheres(sphereCenters, sphereRadius);
-
-    // 对候选点进行圆柱体内的筛选
-    for (vtkIdType i = 0; i < candidatePoints->GetNumberOfIds(); i++)
-    {
-        vtkIdType pid = candidatePoints->GetId(i);
-        double p[3];
-        processedPolyData->GetPoint(pid, p);
-        double v[3] = {p[0] - point[0],
-                       p[1] - point[1],
-                       p[2] - point[2]};
-        double proj = ComputeProjection(v, u);
-        double vLenSq = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
-        double perpSq = vLenSq - proj * proj;
-        if (perpSq <= radius * radius)
-            resultIds->InsertNextId(pid);
-    }
+}
+
+vtkSmartPointer<vtkIdList> PointNormalProcessor::FindPointsInCapsule(const double *start, const double *end, double radius)
+{
+    vtkNew<vtkIdList> resultIds;
+    FindPointsInCapsule(start, end, radius, resultIds);
+    return resultIds;
+}
+
+void PointNormalProcessor::FindPointsInCapsule(const double *start, const double *end, double radius, vtkIdList *resultIds)
+{
+    pointLocator->FindPointsWithinCapsule(start, end, radius, resultIds);
 }
 
 void PointNormalProcessor::FindPointsInArea(double *area, vtkIdList *ids)
@@ -146,11 +399,134 @@ void PointNormalProcessor::FindPointsInCuboid(double cuboid[8][3], vtkIdList *id
     pointLocator->FindPointsWithinCuboid(cuboid, ids);
 }
 
+void PointNormalProcessor::FindPointsInConvexPolytope(const double *planes, int numPlanes, vtkIdList *ids)
+{
+    pointLocator->FindPointsWithinConvexPolytope(planes, numPlanes, ids);
+}
+
+void PointNormalProcessor::FindPointsInConvexPolytope(vtkPlanes *planes, vtkIdList *ids)
+{
+    if (!planes)
+        throw std::invalid_argument("FindPointsInConvexPolytope: planes is null");
+
+    // vtkPlanes 的法向指向外部，平面经过对应的点，常数项 d = -n·p
+    int numPlanes = planes->GetNumberOfPlanes();
+    std::vector<double> coefficients(4 * numPlanes);
+    for (int j = 0; j < numPlanes; ++j)
+    {
+        double normal[3], origin[3];
+        planes->GetNormals()->GetTuple(j, normal);
+        planes->GetPoints()->GetPoint(j, origin);
+        std::copy_n(normal, 3, &coefficients[4 * j]);
+        coefficients[4 * j + 3] = -vtkMath::Dot(normal, origin);
+    }
+    pointLocator->FindPointsWithinConvexPolytope(coefficients.data(), numPlanes, ids);
+}
+
+void PointNormalProcessor::FindPointsInTube(const double *points, int numPoints, double radius, vtkIdList *ids,
+                                            vtkIdTypeArray *segmentIds, vtkDoubleArray *parameters)
+{
+    pointLocator->FindPointsWithinTube(points, numPoints, radius, ids, segmentIds, parameters);
+}
+
+vtkIdType PointNormalProcessor::CountPointsWithinRadius(double radius, const double *center) const
+{
+    return pointLocator->CountPointsWithinRadius(radius, center);
+}
+
+vtkIdType PointNormalProcessor::CountPointsInCylinder(const double *point, const double *direction, double radius)
+{
+    CheckDirection(direction);
+    return pointLocator->CountPointsWithinCylinder(point, direction, radius);
+}
+
+vtkIdType PointNormalProcessor::CountPointsInCapsule(const double *start, const double *end, double radius)
+{
+    return pointLocator->CountPointsWithinCapsule(start, end, radius);
+}
+
+vtkIdType PointNormalProcessor::CountPointsInArea(double *area)
+{
+    return pointLocator->CountPointsWithinArea(area);
+}
+
+vtkIdType PointNormalProcessor::CountPointsInCuboid(double cuboid[8][3])
+{
+    return pointLocator->CountPointsWithinCuboid(cuboid);
+}
+
+vtkIdType PointNormalProcessor::CountPointsInConvexPolytope(const double *planes, int numPlanes)
+{
+    return pointLocator->CountPointsWithinConvexPolytope(planes, numPlanes);
+}
+
+vtkIdType PointNormalProcessor::CountPointsInTube(const double *points, int numPoints, double radius)
+{
+    return pointLocator->CountPointsWithinTube(points, numPoints, radius);
+}
+
+AUtils::PointStatistics PointNormalProcessor::GetStatisticsWithinRadius(double radius, const double *center)
+{
+    AUtils::PointStatistics stats;
+    pointLocator->ComputeStatisticsWithinRadius(radius, center, stats);
+    return stats;
+}
+
+AUtils::PointStatistics PointNormalProcessor::GetStatisticsInCylinder(const double *point, const double *direction,
+                                                                      double radius)
+{
+    CheckDirection(direction);
+    AUtils::PointStatistics stats;
+    pointLocator->ComputeStatisticsWithinCylinder(point, direction, radius, stats);
+    return stats;
+}
+
+AUtils::PointStatistics PointNormalProcessor::GetStatisticsInCapsule(const double *start, const double *end,
+                                                                     double radius)
+{
+    AUtils::PointStatistics stats;
+    pointLocator->ComputeStatisticsWithinCapsule(start, end, radius, stats);
+    return stats;
+}
+
+AUtils::PointStatistics PointNormalProcessor::GetStatisticsInArea(double *area)
+{
+    AUtils::PointStatistics stats;
+    pointLocator->ComputeStatisticsWithinArea(area, stats);
+    return stats;
+}
+
+AUtils::PointStatistics PointNormalProcessor::GetStatisticsInCuboid(double cuboid[8][3])
+{
+    AUtils::PointStatistics stats;
+    pointLocator->ComputeStatisticsWithinCuboid(cuboid, stats);
+    return stats;
+}
+
+AUtils::PointStatistics PointNormalProcessor::GetStatisticsInConvexPolytope(const double *planes, int numPlanes)
+{
+    AUtils::PointStatistics stats;
+    pointLocator->ComputeStatisticsWithinConvexPolytope(planes, numPlanes, stats);
+    return stats;
+}
+
 vtkIdType PointNormalProcessor::FindClosestPoint(const double x[3]) const
 {
     return pointLocator->FindClosestPoint(x);
 }
 
+void PointNormalProcessor::FindPairsWithinRadius(const PointNormalProcessor &other, double radius,
+                                                 vtkIdTypeArray *pairs, vtkDoubleArray *dist2) const
+{
+    pointLocator->FindPairsWithinRadius(other.pointLocator, radius, pairs, dist2);
+}
+
+void PointNormalProcessor::FindClosestPoints(const PointNormalProcessor &other, vtkIdTypeArray *ids,
+                                             vtkDoubleArray *dist2, double maxDistance) const
+{
+    pointLocator->FindClosestPointsInLocator(other.pointLocator, ids, dist2, maxDistance);
+}
+
 void PointNormalProcessor::GetMeanNormal(vtkIdList *ids, double *normal)
 {
     auto normals = GetNormals();
@@ -173,6 +549,38 @@ void PointNormalProcessor::GetMeanNormal(vtkIdList *ids, double *normal)
     }
 }
 
+bool PointNormalProcessor::GetMeanNormalWithinRadius(double radius, const double *center, double *normal)
+{
+    return GetStatisticsWithinRadius(radius, center).GetMeanNormal(normal);
+}
+
+bool PointNormalProcessor::GetMeanNormalInCylinder(const double *point, const double *direction, double radius,
+                                                   double *normal)
+{
+    return GetStatisticsInCylinder(point, direction, radius).GetMeanNormal(normal);
+}
+
+bool PointNormalProcessor::GetMeanNormalInCapsule(const double *start, const double *end, double radius,
+                                                  double *normal)
+{
+    return GetStatisticsInCapsule(start, end, radius).GetMeanNormal(normal);
+}
+
+bool PointNormalProcessor::GetMeanNormalInArea(double *area, double *normal)
+{
+    return GetStatisticsInArea(area).GetMeanNormal(normal);
+}
+
+bool PointNormalProcessor::GetMeanNormalInCuboid(double cuboid[8][3], double *normal)
+{
+    return GetStatisticsInCuboid(cuboid).GetMeanNormal(normal);
+}
+
+bool PointNormalProcessor::GetMeanNormalInConvexPolytope(const double *planes, int numPlanes, double *normal)
+{
+    return GetStatisticsInConvexPolytope(planes, numPlanes).GetMeanNormal(normal);
+}
+
 void PointNormalProcessor::SetGlyph3DVisibility(bool visibility)
 {
     arrowPipeline->SetVisibility(visibility);
@@ -181,7 +589,6 @@ void PointNormalProcessor::SetGlyph3DVisibility(bool visibility)
 void PointNormalProcessor::SetGlyph3DScaleFactor(double scaleFactor)
 {
     glyph3D->SetScaleFactor(scaleFactor);
-    glyph3D->Update();
 }
 
 vtkSmartPointer<vtkActor> PointNormalProcessor::GetArrowActor()
@@ -201,9 +608,17 @@ void PointNormalProcessor::SetIntervalRatio(double ratio)
 
 double PointNormalProcessor::GetDistance(const double x[3]) const
 {
+    AvtkTriangleBVH *surface = GetSurface();
+    if (surface->GetNumberOfTriangles() > 0)
+        return surface->GetSignedDistance(x);
+
     auto id = FindClosestPoint(x);
-    auto normal = processedPolyData->GetPointData()->GetNormals()->GetTuple3(id);
-    auto point = processedPolyData->GetPoint(id);
+    if (id < 0)
+        throw std::runtime_error("GetDistance: no data, call Update first");
+    // GetTuple3/GetPoint(id) 返回共享的内部缓冲区，距离场会在多个线程中调用本函数，这里读入局部数组
+    double normal[3], point[3];
+    processedPolyData->GetPointData()->GetNormals()->GetTuple(id, normal);
+    processedPolyData->GetPoint(id, point);
     auto distance = std::sqrt(vtkMath::Distance2BetweenPoints(x, point));
 
     // 计算向量差
@@ -214,32 +629,290 @@ double PointNormalProcessor::GetDistance(const double x[3]) const
     return distance;
 }
 
+bool PointNormalProcessor::FindClosestSurfacePoint(const double x[3], AUtils::SurfacePoint &result) const
+{
+    return GetSurface()->FindClosestPoint(x, result);
+}
+
+void PointNormalProcessor::GetDistances(vtkIdType numQueries, const double *x, vtkDoubleArray *distances,
+                                        vtkIdTypeArray *cellIds, vtkDoubleArray *closestPoints) const
+{
+    GetSurface()->FindClosestPointsBatch(numQueries, x, distances, cellIds, closestPoints);
+}
+
+bool PointNormalProcessor::IntersectRay(const double origin[3], const double direction[3], AUtils::RayHit &hit,
+                                        double maxDistance) const
+{
+    return GetSurface()->IntersectRay(origin, direction, hit, maxDistance);
+}
+
+int PointNormalProcessor::IntersectRayAll(const double origin[3], const double direction[3],
+                                          std::vector<AUtils::RayHit> &hits, double maxDistance) const
+{
+    return GetSurface()->IntersectRayAll(origin, direction, hits, maxDistance);
+}
+
+void PointNormalProcessor::IntersectRays(vtkIdType numRays, const double *origins, const double *directions,
+                                         vtkDoubleArray *distances, vtkIdTypeArray *cellIds, vtkDoubleArray *points,
+                                         double maxDistance) const
+{
+    GetSurface()->IntersectRays(numRays, origins, directions, distances, cellIds, points, maxDistance);
+}
+
+vtkSmartPointer<vtkImageData> PointNormalProcessor::ComputeDistanceField(const double bounds[6], const int dims[3],
+                                                                        double maxDistance,
+                                                                        bool singlePrecision) const
+{
+    if (dims[0] < 1 || dims[1] < 1 || dims[2] < 1)
+        throw std::invalid_argument("ComputeDistanceField: dimensions must be positive");
+    if (maxDistance < 0.0)
+        throw std::invalid_argument("ComputeDistanceField: maxDistance must be non-negative");
+
+    vtkSmartPointer<vtkImageData> field = vtkSmartPointer<vtkImageData>::New();
+    int scalarType = singlePrecision ? VTK_FLOAT : VTK_DOUBLE;
+    AvtkTriangleBVH *surface = GetSurface();
+    if (surface->GetNumberOfTriangles() > 0)
+    {
+        surface->ComputeDistanceField(bounds, dims, maxDistance, scalarType, field);
+        return field;
+    }
+
+    // 没有三角形时逐点按最近点的法向量计算
+    if (!processedPolyData || processedPolyData->GetNumberOfPoints() == 0)
+        throw std::runtime_error("ComputeDistanceField: no data, call Update first");
+
+    double origin[3], spacing[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        origin[k] = bounds[2 * k];
+        spacing[k] = dims[k] > 1 ? (bounds[2 * k + 1] - bounds[2 * k]) / (dims[k] - 1) : 1.0;
+    }
+    field->SetDimensions(dims[0], dims[1], dims[2]);
+    field->SetOrigin(origin);
+    field->SetSpacing(spacing);
+
+    vtkIdType numPoints = static_cast<vtkIdType>(dims[0]) * dims[1] * dims[2];
+    vtkSmartPointer<vtkDataArray> scalars;
+    if (singlePrecision)
+        scalars = vtkSmartPointer<vtkFloatArray>::New();
+    else
+        scalars = vtkSmartPointer<vtkDoubleArray>::New();
+    scalars->SetName("Distance");
+    scalars->SetNumberOfComponents(1);
+    scalars->SetNumberOfTuples(numPoints);
+    void *data = scalars->GetVoidPointer(0);
+
+    // 先在当前线程完成定位器的构建，循环内的查询只读取已建好的结构
+    pointLocator->BuildLocator();
+    vtkSMPTools::For(0, numPoints, [&](vtkIdType begin, vtkIdType end)
+                     {
+                         for (vtkIdType id = begin; id < end; ++id)
+                         {
+                             vtkIdType line = id / dims[0];
+                             double x[3] = {origin[0] + (id % dims[0]) * spacing[0],
+                                            origin[1] + (line % dims[1]) * spacing[1],
+                                            origin[2] + (line / dims[1]) * spacing[2]};
+                             double distance = GetDistance(x);
+                             if (maxDistance > 0.0)
+                                 distance = std::min(std::max(distance, -maxDistance), maxDistance);
+                             if (singlePrecision)
+                                 static_cast<float *>(data)[id] = static_cast<float>(distance);
+                             else
+                                 static_cast<double *>(data)[id] = distance;
+                         }
+                     });
+    field->GetPointData()->SetScalars(scalars);
+    return field;
+}
+
 void PointNormalProcessor::Update()
 {
-    // 三角化处理
-    vtkNew<vtkTriangleFilter> triangleFilter;
-    triangleFilter->SetInputData(inputData);
-    triangleFilter->Update();
-    vtkSmartPointer<vtkPolyData> processedData = triangleFilter->GetOutput();
+    if (!inputData)
+        throw std::runtime_error("Input data is not set");
 
-    // 计算法向量
-    vtkNew<vtkPolyDataNormals> normalGenerator;
-    normalGenerator->SetInputData(processedData);
-    normalGenerator->SetComputePointNormals(true);
-    normalGenerator->SetSplitting(false);
-    normalGenerator->SetConsistency(false);
-    normalGenerator->SetAutoOrientNormals(true);
-    normalGenerator->Update();
+    // 有来源标识与缓存文件时先读取缓存，缓存无效时计算后写入
+    bool useCache = cacheSourceKey != 0 && !locatorCacheFile.empty();
+    bool saveCache = false;
+    if (normalsModified || inputData != normalsInput || inputData->GetMTime() != normalsInputMTime)
+    {
+        if (!useCache || !LoadCache())
+        {
+            UpdateNormals();
+            saveCache = useCache;
+        }
+    }
 
-    processedPolyData = normalGenerator->GetOutput();
-    BuildLocator();
+    if (locatorModified || processedPolyData != locatorInput || processedPolyData->GetMTime() != locatorInputMTime)
+        BuildLocator();
 
+    if (saveCache)
+        SaveCache();
+
+    // 同一数据不会修改 glyph3D，箭头只在数据或参数变化后的下一次渲染时重新生成
     glyph3D->SetInputData(processedPolyData);
+}
 
-    glyph3D->SetVectorModeToUseNormal();
-    glyph3D->SetScaleFactor(1.0);
-    glyph3D->Update();
-    arrowPipeline->SetInput(glyph3D->GetOutput());
+void PointNormalProcessor::UpdateNormals()
+{
+    normalsInput = inputData;
+    normalsInputMTime = inputData->GetMTime();
+    normalsModified = false;
+    processedFromSource = true;
+
+    if (normalMethod == AUtils::NormalMethod::PointCloud)
+    {
+        // 点云不三角化，点坐标深拷贝，AppendPoints 追加点时不改动输入数据
+        processedPolyData = vtkSmartPointer<vtkPolyData>::New();
+        processedPolyData->ShallowCopy(inputData);
+        vtkNew<vtkPoints> points;
+        if (inputData->GetPoints())
+            points->DeepCopy(inputData->GetPoints());
+        processedPolyData->SetPoints(points);
+    }
+    else if (IsTriangulatedWithNormals(inputData))
+    {
+        // 已是带法向量的三角网格，三角化与法向量计算都不会改变它
+        processedPolyData = vtkSmartPointer<vtkPolyData>::New();
+        processedPolyData->ShallowCopy(inputData);
+    }
+    else
+    {
+        // 三角化处理
+        vtkNew<vtkTriangleFilter> triangleFilter;
+        triangleFilter->SetInputData(inputData);
+        triangleFilter->Update();
+        vtkSmartPointer<vtkPolyData> processedData = triangleFilter->GetOutput();
+
+        // 计算法向量
+        vtkNew<vtkPolyDataNormals> normalGenerator;
+        normalGenerator->SetInputData(processedData);
+        normalGenerator->SetComputePointNormals(true);
+        normalGenerator->SetSplitting(false);
+        normalGenerator->SetConsistency(false);
+        normalGenerator->SetAutoOrientNormals(true);
+        normalGenerator->Update();
+
+        processedPolyData = normalGenerator->GetOutput();
+    }
+
+    // 按空间填充曲线重排点，点数据与单元连接关系同步改写
+    oldToNewPointIds.clear();
+    newToOldPointIds.clear();
+    if (pointOrdering != AUtils::SpaceFillingCurve::None && processedPolyData->GetNumberOfPoints() > 0)
+    {
+        AUtils::ComputeCurveOrder(processedPolyData->GetPoints(), pointOrdering, newToOldPointIds);
+        vtkSmartPointer<vtkPolyData> reordered = vtkSmartPointer<vtkPolyData>::New();
+        AUtils::ReorderPoints(processedPolyData, newToOldPointIds, reordered, oldToNewPointIds);
+        processedPolyData = reordered;
+    }
+
+    // 法向量数组在构建定位器之前挂到点数据上，估计时原地写入，不会使定位器过期
+    vtkSmartPointer<vtkFloatArray> normals;
+    vtkSmartPointer<vtkFloatArray> curvature;
+    if (normalMethod == AUtils::NormalMethod::PointCloud)
+    {
+        vtkIdType numPoints = processedPolyData->GetNumberOfPoints();
+        normals = vtkSmartPointer<vtkFloatArray>::New();
+        normals->SetName("Normals");
+        normals->SetNumberOfComponents(3);
+        normals->SetNumberOfTuples(numPoints);
+        processedPolyData->GetPointData()->SetNormals(normals);
+        processedPolyData->GetPointData()->RemoveArray("Curvature");
+        if (computeCurvature)
+        {
+            curvature = vtkSmartPointer<vtkFloatArray>::New();
+            curvature->SetName("Curvature");
+            curvature->SetNumberOfComponents(1);
+            curvature->SetNumberOfTuples(numPoints);
+            processedPolyData->GetPointData()->AddArray(curvature);
+        }
+
+        // PCA 的邻域查询使用点定位器，在这里提前构建，Update 的定位器阶段随后跳过
+        BuildLocator();
+        AUtils::EstimateNormals(processedPolyData->GetPoints(), pointLocator, normalEstimationOptions, normals, curvature);
+        // vtkKdTree 类型的节点汇总量在构建时读取法向量，写入后只刷新法向量之和，不重建树
+        pointLocator->UpdatePointNormals();
+    }
+}
+
+void PointNormalProcessor::AppendPoints(vtkPoints *points, vtkDataArray *normals)
+{
+    if (!processedPolyData)
+        throw std::runtime_error("Input data is not set");
+    if (!points || points->GetNumberOfPoints() == 0)
+        return;
+
+    vtkDataArray *currentNormals = processedPolyData->GetPointData()->GetNormals();
+    if (currentNormals && (!normals || normals->GetNumberOfTuples() != points->GetNumberOfPoints() ||
+                           normals->GetNumberOfComponents() != currentNormals->GetNumberOfComponents()))
+        throw std::invalid_argument("Normals with the components of the existing normals must be given for every appended point");
+
+    // 处理后的数据可能与输入共用点坐标与点数据数组（浅拷贝或滤波器直接传递），
+    // 第一次追加前复制一份，不改动调用者的数据，也不改变输入的修改时间
+    vtkPoints *currentPoints = processedPolyData->GetPoints();
+    if (currentPoints == inputData->GetPoints())
+    {
+        vtkNew<vtkPoints> points;
+        points->DeepCopy(currentPoints);
+        processedPolyData->SetPoints(points);
+        currentPoints = points;
+    }
+    vtkPointData *pointData = processedPolyData->GetPointData();
+    vtkPointData *inputPointData = inputData->GetPointData();
+    bool sharesArrays = currentNormals && currentNormals == inputPointData->GetNormals();
+    for (int a = 0; a < pointData->GetNumberOfArrays() && !sharesArrays; ++a)
+    {
+        for (int b = 0; b < inputPointData->GetNumberOfArrays() && !sharesArrays; ++b)
+            sharesArrays = pointData->GetAbstractArray(a) == inputPointData->GetAbstractArray(b);
+    }
+    if (sharesArrays)
+    {
+        vtkNew<vtkPointData> pointDataCopy;
+        pointDataCopy->DeepCopy(pointData);
+        pointData->ShallowCopy(pointDataCopy);
+        currentNormals = pointData->GetNormals();
+    }
+
+    vtkIdType numPoints = currentPoints->GetNumberOfPoints();
+    vtkIdType numAppended = points->GetNumberOfPoints();
+    for (vtkIdType i = 0; i < numAppended; ++i)
+    {
+        currentPoints->InsertNextPoint(points->GetPoint(i));
+        if (currentNormals)
+            currentNormals->InsertNextTuple(normals->GetTuple(i));
+    }
+
+    // 其余点数据数组（如曲率、标量）与点数保持一致，新增项为0
+    for (int a = 0; a < pointData->GetNumberOfArrays(); ++a)
+    {
+        vtkAbstractArray *array = pointData->GetAbstractArray(a);
+        if (array == currentNormals)
+            continue;
+        vtkIdType begin = std::min(array->GetNumberOfTuples(), numPoints);
+        array->SetNumberOfTuples(numPoints + numAppended);
+        if (vtkDataArray *dataArray = vtkDataArray::SafeDownCast(array))
+        {
+            for (int c = 0; c < dataArray->GetNumberOfComponents(); ++c)
+            {
+                for (vtkIdType i = begin; i < numPoints + numAppended; ++i)
+                    dataArray->SetComponent(i, c, 0.0);
+            }
+        }
+        array->Modified();
+    }
+    currentPoints->Modified();
+    processedPolyData->Modified();
+
+    // 只追加了点，三角形BVH不变；点定位器已更新，下次 Update 不再重建
+    pointLocator->BuildLocator();
+    locatorInputMTime = processedPolyData->GetMTime();
+    surfaceInputMTime = processedPolyData->GetMTime();
+    processedFromSource = false;
+}
+
+bool PointNormalProcessor::RemovePoint(vtkIdType id)
+{
+    return pointLocator->RemovePoint(id);
 }
 
 std::vector<std::array<double, 3>> PointNormalProcessor::GenerateSphereCenters(
@@ -300,12 +973,16 @@ std::vector<std::array<double, 3>> PointNormalProcessor::GenerateSphereCenters(
 std::vector<CubeFrame *> PointNormalProcessor::GetRegionsBoundariesByLevel(int level)
 {
     auto kdTree = pointLocator->GetKdTree();
+    if (!kdTree)
+        return {};
     return kdTree->GetRegionsBoundariesByLevel(level);
 }
 
 std::vector<CubeFrame *> PointNormalProcessor::GetRegionBoundsByPoint(double x, double y, double z)
 {
     auto kdTree = pointLocator->GetKdTree();
+    if (!kdTree)
+        return {};
     return kdTree->GetRegionBoundsByPoint(x, y, z);
 }
 
@@ -319,11 +996,8 @@ vtkSmartPointer<vtkIdList> PointNormalProcessor::GetUniquePointsInSpheres(
     for (const auto &center : sphereCenters)
     {
         // center.data() 返回指向数组首地址
-        vtkSmartPointer<vtkIdList> sphereIds = FindPointsWithinRadius(sphereRadius, center.data());
-        for (vtkIdType i = 0; i < sphereIds->GetNumberOfIds(); i++)
-        {
-            uniqueIds.insert(sphereIds->GetId(i));
-        }
+        ForEachPointWithinRadius(sphereRadius, center.data(), [&uniqueIds](vtkIdType id)
+                                 { uniqueIds.insert(id); });
     }
 
     // 将去重后的点 id 转换为 vtkIdList 返回
@@ -335,39 +1009,3 @@ vtkSmartPointer<vtkIdList> PointNormalProcessor::GetUniquePointsInSpheres(
 
     return resultIds;
 }
-
-double PointNormalProcessor::ComputeProjection(const double v[3], const double u[3]) const
-{
-    return v[0] * u[0] + v[1] * u[1] + v[2] * u[2];
-}
-
-std::array<double, 2> PointNormalProcessor::ComputeBoundingBoxProjectionRange(const double point[3], const double direction[3]) const
-{
-    double bounds[6];
-    processedPolyData->GetBounds(bounds);
-
-    std::array<double, 2> range = {std::numeric_limits<double>::max(), -std::numeric_limits<double>::max()};
-    // 定义包围盒8个角点
-    double corners[8][3] = {
-        {bounds[0], bounds[2], bounds[4]},
-        {bounds[1], bounds[2], bounds[4]},
-        {bounds[0], bounds[3], bounds[4]},
-        {bounds[1], bounds[3], bounds[4]},
-        {bounds[0], bounds[2], bounds[5]},
-        {bounds[1], bounds[2], bounds[5]},
-        {bounds[0], bounds[3], bounds[5]},
-        {bounds[1], bounds[3], bounds[5]}};
-
-    for (int i = 0; i < 8; i++)
-    {
-        double vec[3] = {corners[i][0] - point[0],
-                         corners[i][1] - point[1],
-                         corners[i][2] - point[2]};
-        double proj = ComputeProjection(vec, direction);
-        if (proj < range[0])
-            range[0] = proj;
-        if (proj > range[1])
-            range[1] = proj;
-    }
-    return range;
-}
@@ -0,0 +1,186 @@
+#include "SpaceFillingCurve.h"
+#include "vtkCellArray.h"
+#include "vtkCellData.h"
+#include "vtkIdList.h"
+#include "vtkNew.h"
+#include "vtkPointData.h"
+#include "vtkSMPTools.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+    /**
+     * 将低21位展开到每3位中的最低位。
+     */
+    inline vtkTypeUInt64 SpreadBits(unsigned int v)
+    {
+        vtkTypeUInt64 x = v & 0x1FFFFFu;
+        x = (x | (x << 32)) & 0x1F00000000FFFFULL;
+        x = (x | (x << 16)) & 0x1F0000FF0000FFULL;
+        x = (x | (x << 8)) & 0x100F00F00F00F00FULL;
+        x = (x | (x << 4)) & 0x10C30C30C30C30C3ULL;
+        x = (x | (x << 2)) & 0x1249249249249249ULL;
+        return x;
+    }
+
+    /**
+     * 用于重排单元连接关系，逐个单元把点id替换为新id。
+     */
+    void RemapCells(vtkCellArray *input, vtkCellArray *output, const std::vector<vtkIdType> &oldToNew)
+    {
+        output->DeepCopy(input);
+        vtkNew<vtkIdList> cell;
+        for (vtkIdType c = 0; c < output->GetNumberOfCells(); ++c)
+        {
+            output->GetCellAtId(c, cell);
+            for (vtkIdType i = 0; i < cell->GetNumberOfIds(); ++i)
+            {
+                cell->SetId(i, oldToNew[cell->GetId(i)]);
+            }
+            output->ReplaceCellAtId(c, cell);
+        }
+    }
+}
+
+namespace AUtils
+{
+    vtkTypeUInt64 MortonKey(unsigned int x, unsigned int y, unsigned int z)
+    {
+        return (SpreadBits(x) << 2) | (SpreadBits(y) << 1) | SpreadBits(z);
+    }
+
+    vtkTypeUInt64 HilbertKey(unsigned int x, unsigned int y, unsigned int z)
+    {
+        const unsigned int mask = (1u << CurveBits) - 1;
+        unsigned int X[3] = {x & mask, y & mask, z & mask};
+
+        // 坐标转换为 Hilbert 索引的转置形式
+        const unsigned int M = 1u << (CurveBits - 1);
+        for (unsigned int Q = M; Q > 1; Q >>= 1)
+        {
+            unsigned int P = Q - 1;
+            for (int i = 0; i < 3; ++i)
+            {
+                if (X[i] & Q)
+                {
+                    X[0] ^= P;
+                }
+                else
+                {
+                    unsigned int t = (X[0] ^ X[i]) & P;
+                    X[0] ^= t;
+                    X[i] ^= t;
+                }
+            }
+        }
+        // 格雷编码
+        X[1] ^= X[0];
+        X[2] ^= X[1];
+        unsigned int t = 0;
+        for (unsigned int Q = M; Q > 1; Q >>= 1)
+        {
+            if (X[2] & Q)
+                t ^= Q - 1;
+        }
+        for (int i = 0; i < 3; ++i)
+        {
+            X[i] ^= t;
+        }
+
+        // 转置形式的各位交错即为索引
+        return MortonKey(X[0], X[1], X[2]);
+    }
+
+    void ComputeCurveOrder(vtkPoints *points, SpaceFillingCurve curve, std::vector<vtkIdType> &newToOld)
+    {
+        vtkIdType numPoints = points ? points->GetNumberOfPoints() : 0;
+        newToOld.resize(numPoints);
+        for (vtkIdType i = 0; i < numPoints; ++i)
+        {
+            newToOld[i] = i;
+        }
+        if (curve == SpaceFillingCurve::None || numPoints < 2)
+            return;
+
+        // 在包围盒的外接立方体内量化，各方向的分辨率相同
+        double bounds[6];
+        points->GetBounds(bounds);
+        double extent = std::max({bounds[1] - bounds[0], bounds[3] - bounds[2], bounds[5] - bounds[4]});
+        const double maxCoord = static_cast<double>((1u << CurveBits) - 1);
+        double scale = extent > 0.0 ? maxCoord / extent : 0.0;
+
+        std::vector<std::pair<vtkTypeUInt64, vtkIdType>> keys(numPoints);
+        vtkSMPTools::For(0, numPoints, [&](vtkIdType begin, vtkIdType end)
+                         {
+                             for (vtkIdType i = begin; i < end; ++i)
+                             {
+                                 double p[3];
+                                 points->GetPoint(i, p);
+                                 unsigned int q[3];
+                                 for (int k = 0; k < 3; ++k)
+                                 {
+                                     double v = (p[k] - bounds[2 * k]) * scale;
+                                     q[k] = static_cast<unsigned int>(std::min(std::max(v, 0.0), maxCoord));
+                                 }
+                                 vtkTypeUInt64 key = curve == SpaceFillingCurve::Hilbert ? HilbertKey(q[0], q[1], q[2])
+                                                                                         : MortonKey(q[0], q[1], q[2]);
+                                 keys[i] = std::make_pair(key, i);
+                             }
+                         });
+        vtkSMPTools::Sort(keys.begin(), keys.end());
+        for (vtkIdType i = 0; i < numPoints; ++i)
+        {
+            newToOld[i] = keys[i].second;
+        }
+    }
+
+    void ReorderPoints(vtkPolyData *input, const std::vector<vtkIdType> &newToOld, vtkPolyData *output,
+                       std::vector<vtkIdType> &oldToNew)
+    {
+        vtkIdType numPoints = input->GetNumberOfPoints();
+        oldToNew.assign(numPoints, -1);
+        for (vtkIdType i = 0; i < numPoints; ++i)
+        {
+            oldToNew[newToOld[i]] = i;
+        }
+
+        vtkNew<vtkIdList> fromIds;
+        vtkNew<vtkIdList> toIds;
+        fromIds->SetNumberOfIds(numPoints);
+        toIds->SetNumberOfIds(numPoints);
+        for (vtkIdType i = 0; i < numPoints; ++i)
+        {
+            fromIds->SetId(i, newToOld[i]);
+            toIds->SetId(i, i);
+        }
+
+        vtkNew<vtkPoints> points;
+        points->SetDataType(input->GetPoints()->GetDataType());
+        points->SetNumberOfPoints(numPoints);
+        input->GetPoints()->GetPoints(fromIds, points);
+
+        vtkNew<vtkCellArray> verts, lines, polys, strips;
+        RemapCells(input->GetVerts(), verts, oldToNew);
+        RemapCells(input->GetLines(), lines, oldToNew);
+        RemapCells(input->GetPolys(), polys, oldToNew);
+        RemapCells(input->GetStrips(), strips, oldToNew);
+
+        // output 可以与 input 相同，先取出点数据与单元数据再重置
+        vtkNew<vtkPointData> pointData;
+        pointData->CopyAllocate(input->GetPointData(), numPoints);
+        pointData->CopyData(input->GetPointData(), fromIds, toIds);
+        vtkNew<vtkCellData> cellData;
+        cellData->ShallowCopy(input->GetCellData());
+
+        output->Initialize();
+        output->SetPoints(points);
+        output->SetVerts(verts);
+        output->SetLines(lines);
+        output->SetPolys(polys);
+        output->SetStrips(strips);
+        output->GetPointData()->ShallowCopy(pointData);
+        output->GetCellData()->ShallowCopy(cellData);
+    }
+}
@@ -0,0 +1,104 @@
+/**
+ * INCREMENTAL_KD_TREE 的追加、删除与恢复：每一步的半径查询与最近点结果与暴力搜索比较，
+ * 删除的点在重建后仍然不可见。
+ */
+#include "AvtkKdTreePointLocator.h"
+#include "TestUtilities.h"
+
+#include <vtkMath.h>
+
+#include <set>
+
+namespace
+{
+    /**
+     * 暴力计算半径 radius 内、不在 removed 中的点。
+     */
+    std::vector<vtkIdType> BruteForceRadius(vtkPolyData *polyData, const double x[3], double radius,
+                                            const std::set<vtkIdType> &removed)
+    {
+        std::vector<vtkIdType> ids;
+        for (vtkIdType i = 0; i < polyData->GetNumberOfPoints(); ++i)
+        {
+            double p[3];
+            polyData->GetPoint(i, p);
+            if (!removed.count(i) && vtkMath::Distance2BetweenPoints(p, x) <= radius * radius)
+                ids.push_back(i);
+        }
+        return ids;
+    }
+
+    bool MatchesBruteForce(AvtkKdTreePointLocator *locator, vtkPolyData *polyData,
+                           const std::set<vtkIdType> &removed)
+    {
+        std::mt19937 generator(11);
+        std::uniform_real_distribution<double> uniform(-10, 10);
+        vtkNew<vtkIdList> result;
+        for (int q = 0; q < 50; ++q)
+        {
+            double x[3] = {uniform(generator), uniform(generator), uniform(generator) * 0.5};
+            locator->FindPointsWithinRadius(1.5, x, result);
+            if (!AUtils::Testing::SameIds(result, BruteForceRadius(polyData, x, 1.5, removed)))
+                return false;
+        }
+        return true;
+    }
+}
+
+int main()
+{
+    auto polyData = AUtils::Testing::RandomCloud(20000, 6);
+    vtkPoints *points = polyData->GetPoints();
+    vtkNew<AvtkKdTreePointLocator> locator;
+    locator->SetDataSet(polyData);
+    locator->SetTreeTypeToIncrementalKdTree();
+    locator->BuildLocator();
+    std::set<vtkIdType> removed;
+    AUTILS_CHECK(MatchesBruteForce(locator, polyData, removed));
+
+    // 追加的点插入已有的树，不重建
+    AvtkIncrementalKdTree *tree = locator->GetIncrementalKdTree();
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<double> uniform(-10, 10);
+    for (int i = 0; i < 3000; ++i)
+        points->InsertNextPoint(uniform(generator), uniform(generator), uniform(generator) * 0.5);
+    polyData->Modified();
+    locator->BuildLocator();
+    AUTILS_CHECK(locator->GetIncrementalKdTree() == tree);
+    AUTILS_CHECK(locator->GetIncrementalKdTree()->GetNumberOfPoints() == 23000);
+    AUTILS_CHECK(MatchesBruteForce(locator, polyData, removed));
+
+    // 删除与恢复
+    for (vtkIdType id = 0; id < 23000; id += 7)
+    {
+        AUTILS_CHECK(locator->RemovePoint(id));
+        removed.insert(id);
+    }
+    AUTILS_CHECK(!locator->RemovePoint(7));
+    AUTILS_CHECK(MatchesBruteForce(locator, polyData, removed));
+    AUTILS_CHECK(locator->RestorePoint(21));
+    AUTILS_CHECK(!locator->RestorePoint(22));
+    removed.erase(21);
+    AUTILS_CHECK(MatchesBruteForce(locator, polyData, removed));
+
+    // 原地移动点且不追加时重建，删除的点在重建后仍不可见
+    double far[3] = {-500.0, -500.0, -500.0};
+    points->SetPoint(1, far);
+    points->Modified();
+    polyData->Modified();
+    AUTILS_CHECK(locator->FindClosestPoint(far) == 1);
+    AUTILS_CHECK(locator->GetIncrementalKdTree() != tree);
+    AUTILS_CHECK(MatchesBruteForce(locator, polyData, removed));
+    locator->ForceBuildLocator();
+    AUTILS_CHECK(MatchesBruteForce(locator, polyData, removed));
+    points->SetPoint(14, far);
+    points->Modified();
+    polyData->Modified();
+    AUTILS_CHECK(locator->FindClosestPoint(far) == 1);
+
+    // 更换数据集后删除标记失效
+    auto other = AUtils::Testing::RandomCloud(5000, 8);
+    locator->SetDataSet(other);
+    AUTILS_CHECK(MatchesBruteForce(locator, other, {}));
+    return 0;
+}
@@ -0,0 +1,143 @@
+/**
+ * PCA 法向量估计在已知曲面上的结果：带微小噪声的平面与球面。
+ * 检查法向量与解析法向量的夹角、三种定向方式的朝向以及平面的表面变化度。
+ */
+#include "AvtkKdTreePointLocator.h"
+#include "NormalEstimation.h"
+#include "TestUtilities.h"
+
+#include <vtkFloatArray.h>
+#include <vtkMath.h>
+
+#include <cmath>
+
+namespace
+{
+    vtkSmartPointer<vtkPolyData> NoisyPlane(int numPoints, unsigned seed)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<double> uniform(-10, 10);
+        std::uniform_real_distribution<double> noise(-0.005, 0.005);
+        vtkNew<vtkPoints> points;
+        points->SetDataTypeToDouble();
+        for (int i = 0; i < numPoints; ++i)
+            points->InsertNextPoint(uniform(generator), uniform(generator), 3.0 + noise(generator));
+        auto polyData = vtkSmartPointer<vtkPolyData>::New();
+        polyData->SetPoints(points);
+        return polyData;
+    }
+
+    vtkSmartPointer<vtkPolyData> NoisySphere(int numPoints, const double center[3], double radius, unsigned seed)
+    {
+        std::mt19937 generator(seed);
+        std::normal_distribution<double> normal(0, 1);
+        std::uniform_real_distribution<double> noise(-0.005, 0.005);
+        vtkNew<vtkPoints> points;
+        points->SetDataTypeToDouble();
+        for (int i = 0; i < numPoints; ++i)
+        {
+            double d[3] = {normal(generator), normal(generator), normal(generator)};
+            double r = (radius + noise(generator)) / std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+            points->InsertNextPoint(center[0] + r * d[0], center[1] + r * d[1], center[2] + r * d[2]);
+        }
+        auto polyData = vtkSmartPointer<vtkPolyData>::New();
+        polyData->SetPoints(points);
+        return polyData;
+    }
+
+    /**
+     * 统计与解析法向量夹角大于约18度的点数，以及与解析法向量反向的点数。
+     */
+    template <typename ExactNormal>
+    void CompareNormals(vtkPolyData *polyData, vtkFloatArray *normals, ExactNormal exact, int &deviating,
+                        int &reversed)
+    {
+        deviating = reversed = 0;
+        for (vtkIdType i = 0; i < polyData->GetNumberOfPoints(); ++i)
+        {
+            double p[3], n[3], e[3];
+            polyData->GetPoint(i, p);
+            normals->GetTuple(i, n);
+            exact(p, e);
+            double dot = n[0] * e[0] + n[1] * e[1] + n[2] * e[2];
+            if (std::fabs(dot) < 0.95)
+                ++deviating;
+            if (dot < 0.0)
+                ++reversed;
+        }
+    }
+}
+
+int main()
+{
+    using namespace AUtils;
+
+    // 平面 z = 3，视点在平面上方：默认的视点定向全部朝 +z，表面变化度接近0
+    {
+        auto plane = NoisyPlane(4000, 1);
+        vtkNew<AvtkKdTreePointLocator> locator;
+        locator->SetDataSet(plane);
+        NormalEstimationOptions options;
+        AUTILS_CHECK(options.Orientation == NormalOrientation::Viewpoint);
+        options.Viewpoint[2] = 100.0;
+        vtkNew<vtkFloatArray> normals;
+        vtkNew<vtkFloatArray> curvature;
+        EstimateNormals(plane->GetPoints(), locator, options, normals, curvature);
+        AUTILS_CHECK(normals->GetNumberOfTuples() == plane->GetNumberOfPoints());
+
+        int deviating, reversed;
+        CompareNormals(plane, normals, [](const double *, double *e) { e[0] = 0.0; e[1] = 0.0; e[2] = 1.0; },
+                       deviating, reversed);
+        AUTILS_CHECK(deviating == 0);
+        AUTILS_CHECK(reversed == 0);
+        for (vtkIdType i = 0; i < plane->GetNumberOfPoints(); ++i)
+            AUTILS_CHECK(curvature->GetValue(i) < 0.01f);
+    }
+
+    // 半径10的球面，分别用视点（球心，法向量朝内）与最小生成树（视点在球外，法向量朝外）定向
+    const double center[3] = {1000.0, -500.0, 0.0};
+    auto sphere = NoisySphere(6000, center, 10.0, 2);
+    auto outward = [&center](const double *p, double *e)
+    {
+        double length = std::sqrt(vtkMath::Distance2BetweenPoints(p, center));
+        for (int k = 0; k < 3; ++k)
+            e[k] = (p[k] - center[k]) / length;
+    };
+    for (NormalOrientation orientation : {NormalOrientation::Viewpoint, NormalOrientation::MinimumSpanningTree})
+    {
+        vtkNew<AvtkKdTreePointLocator> locator;
+        locator->SetDataSet(sphere);
+        locator->SetTreeTypeToFlatKdTree();
+        NormalEstimationOptions options;
+        options.Orientation = orientation;
+        for (int k = 0; k < 3; ++k)
+            options.Viewpoint[k] = center[k];
+        if (orientation == NormalOrientation::MinimumSpanningTree)
+            options.Viewpoint[0] += 100.0;
+        vtkNew<vtkFloatArray> normals;
+        EstimateNormals(sphere->GetPoints(), locator, options, normals);
+
+        int deviating, reversed;
+        CompareNormals(sphere, normals, outward, deviating, reversed);
+        AUTILS_CHECK(deviating < sphere->GetNumberOfPoints() / 100);
+        if (orientation == NormalOrientation::Viewpoint)
+            AUTILS_CHECK(reversed == sphere->GetNumberOfPoints());
+        else
+            AUTILS_CHECK(reversed == 0);
+    }
+
+    // 不定向时只检查法向量所在的直线
+    {
+        vtkNew<AvtkKdTreePointLocator> locator;
+        locator->SetDataSet(sphere);
+        NormalEstimationOptions options;
+        options.Orientation = NormalOrientation::None;
+        options.Radius = 1.5;
+        vtkNew<vtkFloatArray> normals;
+        EstimateNormals(sphere->GetPoints(), locator, options, normals);
+        int deviating, reversed;
+        CompareNormals(sphere, normals, outward, deviating, reversed);
+        AUTILS_CHECK(deviating < sphere->GetNumberOfPoints() / 100);
+    }
+    return 0;
+}
@@ -0,0 +1,181 @@
+/**
+ * AvtkKdTree 的串行与并行构建：每个点恰好属于一个区域且位于该区域的空间包围盒内，
+ * 半径、包围盒与最近点查询（在区域点缓存上实现的vtkKdTree接口）与暴力搜索一致，坐标大量重复的点集同样成立。
+ */
+#include "AvtkKdTree.h"
+#include "TestUtilities.h"
+
+#include <vtkIdTypeArray.h>
+#include <vtkMath.h>
+
+#include <cmath>
+
+namespace
+{
+    std::vector<vtkIdType> BruteForceRadius(vtkPolyData *polyData, const double x[3], double radius)
+    {
+        std::vector<vtkIdType> ids;
+        for (vtkIdType i = 0; i < polyData->GetNumberOfPoints(); ++i)
+        {
+            double p[3];
+            polyData->GetPoint(i, p);
+            if (vtkMath::Distance2BetweenPoints(p, x) <= radius * radius)
+                ids.push_back(i);
+        }
+        return ids;
+    }
+
+    /**
+     * 区域划分是点集的一个划分，且每个点位于所在区域的包围盒内。
+     */
+    bool RegionsPartitionPoints(AvtkKdTree *tree, vtkPolyData *polyData)
+    {
+        std::vector<int> seen(polyData->GetNumberOfPoints(), 0);
+        for (int r = 0; r < tree->GetNumberOfRegions(); ++r)
+        {
+            double bounds[6];
+            tree->GetRegionBounds(r, bounds);
+            auto ids = vtkSmartPointer<vtkIdTypeArray>::Take(tree->GetPointsInRegion(r));
+            if (!ids)
+                return false;
+            for (vtkIdType i = 0; i < ids->GetNumberOfTuples(); ++i)
+            {
+                vtkIdType id = ids->GetValue(i);
+                if (id < 0 || id >= polyData->GetNumberOfPoints() || seen[id]++)
+                    return false;
+                double p[3];
+                polyData->GetPoint(id, p);
+                for (int k = 0; k < 3; ++k)
+                {
+                    if (p[k] < bounds[2 * k] || p[k] > bounds[2 * k + 1])
+                        return false;
+                }
+            }
+        }
+        return std::find(seen.begin(), seen.end(), 0) == seen.end();
+    }
+
+    bool QueriesMatchBruteForce(AvtkKdTree *tree, vtkPolyData *polyData, double radius)
+    {
+        std::mt19937 generator(17);
+        std::uniform_real_distribution<double> uniform(-10, 10);
+        vtkNew<vtkIdList> result;
+        for (int q = 0; q < 30; ++q)
+        {
+            double x[3] = {uniform(generator), uniform(generator), uniform(generator) * 0.5};
+            std::vector<vtkIdType> expected = BruteForceRadius(polyData, x, radius);
+            tree->FindPointsWithinRadius(radius, x, result);
+            if (!AUtils::Testing::SameIds(result, expected))
+                return false;
+
+            double area[6] = {x[0] - radius, x[0] + radius, x[1] - radius, x[1] + radius, x[2] - radius, x[2] + radius};
+            vtkNew<vtkIdTypeArray> inArea;
+            tree->FindPointsInArea(area, inArea);
+            std::vector<vtkIdType> expectedInArea;
+            for (vtkIdType i = 0; i < polyData->GetNumberOfPoints(); ++i)
+            {
+                double p[3];
+                polyData->GetPoint(i, p);
+                if (p[0] >= area[0] && p[0] <= area[1] && p[1] >= area[2] && p[1] <= area[3] &&
+                    p[2] >= area[4] && p[2] <= area[5])
+                    expectedInArea.push_back(i);
+            }
+            std::vector<vtkIdType> actualInArea(inArea->GetPointer(0), inArea->GetPointer(0) + inArea->GetNumberOfTuples());
+            std::sort(actualInArea.begin(), actualInArea.end());
+            if (actualInArea != expectedInArea)
+                return false;
+
+            // 最近点只比较距离，距离相同的点可以任取其一
+            double nearest2 = VTK_DOUBLE_MAX;
+            for (vtkIdType i = 0; i < polyData->GetNumberOfPoints(); ++i)
+            {
+                double p[3];
+                polyData->GetPoint(i, p);
+                nearest2 = std::min(nearest2, vtkMath::Distance2BetweenPoints(p, x));
+            }
+            double dist2;
+            vtkIdType closest = tree->FindClosestPoint(x, dist2);
+            if (closest < 0 || dist2 != nearest2)
+                return false;
+            tree->FindClosestNPoints(5, x, result);
+            if (result->GetNumberOfIds() != 5)
+                return false;
+            double first[3];
+            polyData->GetPoint(result->GetId(0), first);
+            if (vtkMath::Distance2BetweenPoints(first, x) != nearest2)
+                return false;
+        }
+        return true;
+    }
+
+    int CheckBuild(vtkPolyData *polyData, double radius)
+    {
+        for (vtkTypeBool parallel : {0, 1})
+        {
+            vtkNew<AvtkKdTree> tree;
+            tree->SetParallelBuild(parallel);
+            tree->BuildLocatorFromPoints(polyData);
+            AUTILS_CHECK(tree->GetNumberOfRegions() > 1);
+            AUTILS_CHECK(RegionsPartitionPoints(tree, polyData));
+            AUTILS_CHECK(QueriesMatchBruteForce(tree, polyData, radius));
+        }
+        return 0;
+    }
+}
+
+int main()
+{
+    // 点数超过并行选择的阈值，顶层节点走并行划分
+    auto polyData = AUtils::Testing::RandomCloud(150000, 21);
+    if (CheckBuild(polyData, 0.8))
+        return 1;
+
+    // 坐标取整后大量重复，相等的点须落在划分的同一侧
+    auto lattice = AUtils::Testing::RandomCloud(100000, 22);
+    vtkPoints *points = lattice->GetPoints();
+    for (vtkIdType i = 0; i < points->GetNumberOfPoints(); ++i)
+    {
+        double p[3];
+        points->GetPoint(i, p);
+        points->SetPoint(i, std::round(p[0]), std::round(p[1]), std::round(p[2]));
+    }
+    if (CheckBuild(lattice, 1.5))
+        return 1;
+
+    // 重复点映射到坐标相同的点中id最小的一个
+    vtkNew<AvtkKdTree> latticeTree;
+    latticeTree->BuildLocatorFromPoints(lattice);
+    auto uniqueIds = vtkSmartPointer<vtkIdTypeArray>::Take(latticeTree->BuildMapForDuplicatePoints(0.0f));
+    AUTILS_CHECK(uniqueIds && uniqueIds->GetNumberOfTuples() == lattice->GetNumberOfPoints());
+    for (vtkIdType i = 0; i < lattice->GetNumberOfPoints(); i += 97)
+    {
+        double p[3], q[3];
+        lattice->GetPoint(i, p);
+        vtkIdType first = uniqueIds->GetValue(i);
+        AUTILS_CHECK(first >= 0 && first <= i);
+        lattice->GetPoint(first, q);
+        AUTILS_CHECK(vtkMath::Distance2BetweenPoints(p, q) == 0.0);
+        AUTILS_CHECK(latticeTree->FindPoint(p) >= 0);
+        for (vtkIdType j = 0; j < first; ++j)
+        {
+            lattice->GetPoint(j, q);
+            AUTILS_CHECK(vtkMath::Distance2BetweenPoints(p, q) > 0.0);
+        }
+    }
+
+    // 所有点重合时不划分
+    vtkNew<vtkPoints> same;
+    for (int i = 0; i < 1000; ++i)
+        same->InsertNextPoint(1, 2, 3);
+    vtkNew<vtkPolyData> coincident;
+    coincident->SetPoints(same);
+    vtkNew<AvtkKdTree> tree;
+    tree->ParallelBuildOn();
+    tree->BuildLocatorFromPoints(coincident.GetPointer());
+    AUTILS_CHECK(tree->GetNumberOfRegions() == 1);
+    double x[3] = {1, 2, 3};
+    vtkNew<vtkIdList> result;
+    tree->FindPointsWithinRadius(0.1, x, result);
+    AUTILS_CHECK(result->GetNumberOfIds() == 1000);
+    return 0;
+}
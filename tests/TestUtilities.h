@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vtkIdList.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+/**
+ * 测试用的检查宏：条件不成立时打印位置并令 main 返回1，ctest 据此判定失败。
+ */
+#define AUTILS_CHECK(condition)                                                        \
+    do                                                                                 \
+    {                                                                                  \
+        if (!(condition))                                                              \
+        {                                                                              \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            return 1;                                                                  \
+        }                                                                              \
+    } while (0)
+
+namespace AUtils
+{
+    namespace Testing
+    {
+        /**
+         * 在 [-10, 10] x [-10, 10] x [-5, 5] 内均匀随机生成点，不含单元。
+         */
+        inline vtkSmartPointer<vtkPolyData> RandomCloud(vtkIdType numPoints, unsigned seed)
+        {
+            std::mt19937 generator(seed);
+            std::uniform_real_distribution<double> uniform(-10, 10);
+            vtkNew<vtkPoints> points;
+            points->SetDataTypeToDouble();
+            for (vtkIdType i = 0; i < numPoints; ++i)
+                points->InsertNextPoint(uniform(generator), uniform(generator), uniform(generator) * 0.5);
+            auto polyData = vtkSmartPointer<vtkPolyData>::New();
+            polyData->SetPoints(points);
+            return polyData;
+        }
+
+        /**
+         * 以排序后的点id比较两个结果，忽略顺序。
+         */
+        inline bool SameIds(vtkIdList *ids, std::vector<vtkIdType> expected)
+        {
+            std::vector<vtkIdType> actual(ids->begin(), ids->end());
+            std::sort(actual.begin(), actual.end());
+            std::sort(expected.begin(), expected.end());
+            return actual == expected;
+        }
+    };
+};